@@ -63,6 +63,8 @@
 /**
  * @def MY_BAUD_RATE
  * @brief Serial output baud rate (debug prints and serial gateway speed).
+ *
+ * At 16 MHz AVR 250000, 500000 and 1000000 are exact, 115200 is 2.1% off. Native USB (SAMD, 32U4) ignores it.
  */
 #ifndef MY_BAUD_RATE
 #define MY_BAUD_RATE 115200
@@ -71,6 +73,14 @@
 // Disables over-the-air reset of node
 //#define MY_DISABLE_REMOTE_RESET
 
+/**
+* @def MY_CONFIG_FLUSH_INTERVAL_MS
+* @brief Interval (in ms) to commit deferred config writes on platforms with emulated or external EEPROM (ESP8266, SAMD)
+*/
+#ifndef MY_CONFIG_FLUSH_INTERVAL_MS
+#define MY_CONFIG_FLUSH_INTERVAL_MS ((uint32_t)1000)
+#endif
+
 /**********************************
 *  Radio selection and node config
 ***********************************/
@@ -81,6 +91,31 @@
 //#define MY_RADIO_RFM69
 //#define MY_RS485
 
+/**
+* @def MY_RADIO_DUAL
+* @brief Gateways and repeaters: run two of MY_RADIO_NRF24, MY_RADIO_RFM69 and MY_RS485 side by side, e.g. two radios
+* on the shared SPI bus (separate CS/CE and IRQ pins) or an RS485 backbone with a radio for the local children.
+*
+* Broadcasts go out on both links, unicasts on the link the next hop was last heard on (tried on both while unknown,
+* e.g. after a reboot, the radio first). A repeater on an RS485 backbone finds its parent on the wire like any other.
+* Frames are limited to 32 bytes (no MY_RFM69_MAX_MESSAGE_LENGTH) and MY_RFM69_DEFERRED_IRQ is enabled so the
+* RFM69 ISR does not use the SPI bus. Not compatible with MY_TRANSPORT_ATC.
+*/
+//#define MY_RADIO_DUAL
+
+/**
+* @def MY_RADIO_LOOPBACK
+* @brief In-process transport for host builds (ARDUINO_ARCH_NATIVE, see tests/Native). Frames are injected with transportLoopbackInject() and sent frames are passed to the handler set with transportLoopbackSetHandler().
+*/
+//#define MY_RADIO_LOOPBACK
+/**
+* @def MY_LOOPBACK_RX_BUFFER_SIZE
+* @brief Number of injected frames the loopback transport buffers (power of two)
+*/
+#ifndef MY_LOOPBACK_RX_BUFFER_SIZE
+#define MY_LOOPBACK_RX_BUFFER_SIZE 8
+#endif
+
 /**
 * @def MY_TRANSPORT_SANITY_CHECK
 * @brief If enabled, node will check transport in regular intervals to detect HW issues and re-initialize in case of failure. This feature is enabled for all repeater nodes (incl. GW)
@@ -93,6 +128,203 @@
 #ifndef MY_TRANSPORT_SANITY_CHECK_INTERVAL
 #define MY_TRANSPORT_SANITY_CHECK_INTERVAL ((uint32_t)60000)
 #endif
+/**
+* @def MY_TRANSPORT_ASYNC_SEND
+* @brief If enabled, repeaters relay messages asynchronously, i.e. RX and GW I/O are processed while the frame is in flight. NRF24 and RFM69 transmit asynchronously (RFM69 also sends its ACKs from the main loop), other transports fall back to blocking sends.
+*/
+//#define MY_TRANSPORT_ASYNC_SEND
+/**
+* @def MY_TRANSPORT_TX_QUEUE_SIZE
+* @brief If defined, messages from the controller and relayed messages are queued and sent from transportProcess(). Frames to the same next hop are sent back to back and failed transmissions are retried with backoff.
+*/
+//#define MY_TRANSPORT_TX_QUEUE_SIZE 4
+/**
+* @def MY_TRANSPORT_TX_QUEUE_RETRIES
+* @brief Max number of retries for a queued message before it is dropped
+*/
+#ifndef MY_TRANSPORT_TX_QUEUE_RETRIES
+#define MY_TRANSPORT_TX_QUEUE_RETRIES 3
+#endif
+/**
+* @def MY_TRANSPORT_TX_QUEUE_BACKOFF
+* @brief Delay (in ms) before the first retry of a queued message, doubled with each retry
+*/
+#ifndef MY_TRANSPORT_TX_QUEUE_BACKOFF
+#define MY_TRANSPORT_TX_QUEUE_BACKOFF 20
+#endif
+/**
+* @def MY_MESSAGE_POOL_SIZE
+* @brief If defined, the transport TX queue (#MY_TRANSPORT_TX_QUEUE_SIZE), the gateway RX queue (#MY_GATEWAY_RX_QUEUE_SIZE) and signing handshakes take their message buffers from one pool of this many messages. The queues only hold handles, controller commands move from the RX to the TX queue without a copy and nested signing handshakes fail cleanly when the pool is exhausted. With signing one buffer is kept out of reach of the queues, queued messages are signed when they are sent.
+*/
+//#define MY_MESSAGE_POOL_SIZE 8
+/**
+* @def MY_TRANSPORT_FPAR_STORM_CONTROL
+* @brief If enabled, find parent requests are sent after a random delay within #MY_TRANSPORT_FPAR_BACKOFF_MS, doubled with each retry, and repeaters answer all requests received within #MY_TRANSPORT_FPAR_JITTER_MS together (one uplink check) instead of blocking up to 1s per request. Keeps the channel usable when all children of a restarted gateway or repeater search a parent at once.
+*/
+//#define MY_TRANSPORT_FPAR_STORM_CONTROL
+/**
+* @def MY_TRANSPORT_FPAR_BACKOFF_MS
+* @brief Window (in ms) of the random find parent request delay, doubled with each retry
+*/
+#ifndef MY_TRANSPORT_FPAR_BACKOFF_MS
+#define MY_TRANSPORT_FPAR_BACKOFF_MS 500
+#endif
+/**
+* @def MY_TRANSPORT_FPAR_JITTER_MS
+* @brief Max random delay (in ms) of find parent responses, requests received meanwhile are answered with the first one
+*/
+#ifndef MY_TRANSPORT_FPAR_JITTER_MS
+#define MY_TRANSPORT_FPAR_JITTER_MS 300
+#endif
+/**
+* @def MY_TRANSPORT_FPAR_PENDING
+* @brief Max number of find parent requests answered together, further requests are answered on their retry
+*/
+#ifndef MY_TRANSPORT_FPAR_PENDING
+#define MY_TRANSPORT_FPAR_PENDING 8
+#endif
+/**
+* @def MY_TRANSPORT_GATEWAY_BEACON
+* @brief If enabled, the gateway broadcasts I_GATEWAY_BEACON when its transport is ready. Children searching a parent (e.g. after the gateway restart failed their uplink) rebind to their previous parent as soon as it relays the beacon, without discovery. Enable on all nodes.
+*/
+//#define MY_TRANSPORT_GATEWAY_BEACON
+/**
+* @def MY_TRANSPORT_CUT_THROUGH
+* @brief If enabled, repeaters relay frames not addressed to them right after reading the header: the routing table and last hop are updated and the received bytes are sent on as they are, without payload formatting or signing. Ping/pong (hop counter) and queued relays (#MY_TRANSPORT_TX_QUEUE_SIZE) take the regular path.
+*/
+//#define MY_TRANSPORT_CUT_THROUGH
+/**
+* @def MY_TRANSPORT_FIFO_BUDGET_US
+* @brief If defined, transportProcess() handles received messages for at most this many microseconds per call (at least one message) instead of up to MAX_SUBSEQ_MSGS messages. Cheap frames are relayed in bursts, expensive ones (e.g. signed) leave the rest for the next call.
+*/
+//#define MY_TRANSPORT_FIFO_BUDGET_US 2000
+/**
+* @def MY_TRANSPORT_DEDUP_SIZE
+* @brief If defined, the last received messages are remembered (5 bytes each) and repeated copies, e.g. retries after a lost ACK or copies relayed via two paths, are neither relayed nor handed to receive() again. Frames carry a sequence number of the sender after the payload, a value sent twice is not a duplicate. Relayed messages are remembered once forwarded, so the retry of a failed relay gets through. Internal, signed and full length messages are not filtered. Enable on all nodes.
+*/
+//#define MY_TRANSPORT_DEDUP_SIZE 8
+/**
+* @def MY_TRANSPORT_DEDUP_WINDOW_MS
+* @brief Time (in ms, max. 60000) an identical message from the same sender is considered a duplicate
+*/
+#ifndef MY_TRANSPORT_DEDUP_WINDOW_MS
+#define MY_TRANSPORT_DEDUP_WINDOW_MS 2000
+#endif
+/**
+* @def MY_TRANSPORT_MAILBOX_SIZE
+* @brief If defined, repeaters and GWs keep messages for direct children that did not ACK them (e.g. sleeping nodes, 36 bytes each). They are sent as soon as the child transmits again, e.g. the heartbeat sent by smartSleep().
+*/
+//#define MY_TRANSPORT_MAILBOX_SIZE 4
+/**
+* @def MY_TRANSPORT_MAILBOX_TTL_MS
+* @brief Time (in ms) a message is kept in the mailbox
+*/
+#ifndef MY_TRANSPORT_MAILBOX_TTL_MS
+#define MY_TRANSPORT_MAILBOX_TTL_MS ((uint32_t)10*60*1000ul)
+#endif
+/**
+* @def MY_TRANSPORT_FW_CACHE_SIZE
+* @brief If defined, repeaters and GWs keep the last forwarded unsigned OTA firmware blocks (23 bytes each) and answer ST_FIRMWARE_REQUESTs for them locally. A node requesting a block it was already served from the cache is passed on to the controller.
+*/
+//#define MY_TRANSPORT_FW_CACHE_SIZE 8
+/**
+* @def MY_TRANSPORT_FRAGMENTATION
+* @brief If enabled, sendFragmented() splits payloads larger than MAX_PAYLOAD into I_FRAGMENT messages (up to 16) and the recipient reassembles them for receiveFragmented(). An ACK is only sent once all fragments arrived.
+*/
+//#define MY_TRANSPORT_FRAGMENTATION
+/**
+* @def MY_TRANSPORT_FRAGMENT_MAX_SIZE
+* @brief Largest payload (in bytes, max. 22 + 15 * 23 with 32 byte messages) that can be reassembled
+*/
+#ifndef MY_TRANSPORT_FRAGMENT_MAX_SIZE
+#define MY_TRANSPORT_FRAGMENT_MAX_SIZE 128
+#endif
+/**
+* @def MY_TRANSPORT_REASSEMBLY_BUFFERS
+* @brief Number of payloads from different senders reassembled at the same time (MY_TRANSPORT_FRAGMENT_MAX_SIZE + 14 bytes each)
+*/
+#ifndef MY_TRANSPORT_REASSEMBLY_BUFFERS
+#define MY_TRANSPORT_REASSEMBLY_BUFFERS 1
+#endif
+/**
+* @def MY_TRANSPORT_REASSEMBLY_TIMEOUT_MS
+* @brief Time (in ms) after which an incomplete payload is discarded
+*/
+#ifndef MY_TRANSPORT_REASSEMBLY_TIMEOUT_MS
+#define MY_TRANSPORT_REASSEMBLY_TIMEOUT_MS 2000
+#endif
+/**
+* @def MY_TRANSPORT_ATC
+* @brief If enabled, the transmit power is adapted per neighbour: NRF24 lowers the PA level while frames are ACKed without retransmissions, RFM69 keeps the RSSI of the ACKs close to @ref MY_RFM69_ATC_TARGET_RSSI. Failed transmissions return to full power. Broadcasts are always sent at the configured level.
+*/
+//#define MY_TRANSPORT_ATC
+/**
+* @def MY_TRANSPORT_ATC_NEIGHBOURS
+* @brief Number of neighbours with individual transmit power (3 bytes each), the least recently added one is replaced
+*/
+#ifndef MY_TRANSPORT_ATC_NEIGHBOURS
+#define MY_TRANSPORT_ATC_NEIGHBOURS 4
+#endif
+/**
+* @def MY_TRANSPORT_ATC_STEP_DOWN
+* @brief Number of consecutive good transmissions to a neighbour before its transmit power is lowered by one step
+*/
+#ifndef MY_TRANSPORT_ATC_STEP_DOWN
+#define MY_TRANSPORT_ATC_STEP_DOWN 8
+#endif
+/**
+* @def MY_TRANSPORT_PARENT_SCORING
+* @brief If enabled, find parent weighs the distance of each candidate against the RSSI of its reply (coarse on NRF24) and penalizes the parent that failed last. A GW-direct reply above @ref MY_TRANSPORT_PARENT_GOOD_RSSI ends the search immediately.
+*/
+//#define MY_TRANSPORT_PARENT_SCORING
+/**
+* @def MY_TRANSPORT_PARENT_GOOD_RSSI
+* @brief RSSI (in dBm) from which a parent link counts as good, every dB below adds to the parent score (16 per hop)
+*/
+#ifndef MY_TRANSPORT_PARENT_GOOD_RSSI
+#define MY_TRANSPORT_PARENT_GOOD_RSSI (-70)
+#endif
+/**
+* @def MY_TRANSPORT_LINK_QUALITY
+* @brief If enabled, nodes keep averaged ACK ratio and RSSI of the uplink. When it degrades, a new parent is searched in the background while the current one stays in use, instead of waiting for a series of failed transmissions. Searches are at least a minute apart.
+*/
+//#define MY_TRANSPORT_LINK_QUALITY
+/**
+* @def MY_TRANSPORT_LINK_QUALITY_MIN
+* @brief Averaged ACK ratio (255 = all ACKed) below which the uplink counts as degraded
+*/
+#ifndef MY_TRANSPORT_LINK_QUALITY_MIN
+#define MY_TRANSPORT_LINK_QUALITY_MIN 192
+#endif
+/**
+* @def MY_TRANSPORT_TRACE
+* @brief If enabled, received and sent frames are recorded in a binary ring (8 bytes per entry) instead of formatted TSF:MSG:READ/SEND debug prints. With MY_DEBUG, entries are printed one at a time when no frames are pending. The controller can fetch the ring with I_DEBUG "T".
+*/
+//#define MY_TRANSPORT_TRACE
+/**
+* @def MY_TRANSPORT_TRACE_SIZE
+* @brief Number of entries in the trace ring, the oldest entry is overwritten
+*/
+#ifndef MY_TRANSPORT_TRACE_SIZE
+#define MY_TRANSPORT_TRACE_SIZE 16
+#endif
+/**
+* @def MY_RAM_ROUTING_TABLE_FEATURE
+* @brief If enabled, repeaters and GWs keep a RAM copy of the routing table (292 bytes: 256 routes, a 32 byte bitmap of changed routes and the last save time) and write changed routes back to EEPROM lazily.
+*/
+//#define MY_RAM_ROUTING_TABLE_FEATURE
+/**
+* @def MY_ROUTING_TABLE_SAVE_INTERVAL_MS
+* @brief Interval (in ms) to write changed routes from RAM back to EEPROM
+*/
+#ifndef MY_ROUTING_TABLE_SAVE_INTERVAL_MS
+#define MY_ROUTING_TABLE_SAVE_INTERVAL_MS ((uint32_t)30*60*1000ul)
+#endif
+/**
+* @def MY_SPARSE_ROUTING_TABLE_SIZE
+* @brief If defined, repeaters keep routes to at most this many nodes in a sorted RAM table and evict the least recently seen node when full. Routes are written through to EEPROM.
+*/
+//#define MY_SPARSE_ROUTING_TABLE_SIZE 32
 /**
  * @def MY_REGISTRATION_FEATURE
  * @brief If enabled, node has to register to gateway/controller before allowed to send sensor data.
@@ -163,6 +395,160 @@
 #define MY_SMART_SLEEP_WAIT_DURATION 500
 #endif
 
+/**
+ * @def MY_SMART_SLEEP_PENDING
+ * @brief If enabled, smartSleep() stops listening as soon as the controller answered the heartbeat with I_PENDING
+ * and the announced number of messages (possibly none) arrived.
+ *
+ * Without an answer the full MY_SMART_SLEEP_WAIT_DURATION is used, so older controllers keep working.
+ */
+//#define MY_SMART_SLEEP_PENDING
+
+/**
+ * @def MY_WARM_BOOT
+ * @brief If enabled, nodes restart with the parent, distance and registration of the last complete boot
+ * and skip presentation if it did not change since then (e.g. after a watchdog reset or brown-out).
+ *
+ * The presentation (including anything presentation() sends) is compared by hash, a new sketch, node ID or
+ * parent presents as usual. The controller can still request the presentation with I_PRESENTATION and failing
+ * uplink transmissions trigger a new parent search.
+ */
+//#define MY_WARM_BOOT
+
+/**
+ * @def MY_CONFIG_IMAGE
+ * @brief If enabled, the core EEPROM fields (node ID, parent, distance, controller config, signing tables and node
+ * lock counter) are also kept in a versioned, CRC protected image that is loaded into RAM with one read at boot.
+ *
+ * Each update writes the image to the next of #MY_CONFIG_IMAGE_SLOTS slots, the valid slot with the highest sequence
+ * number is loaded. An interrupted write leaves the previous slot intact. Fields that do not match the image at boot
+ * (EEPROM corruption, a bootloader or older firmware) are restored from it. If all of them are erased (0xFF, e.g. by
+ * ClearEepromConfig) the image is reset to the erased fields instead. The original fields are still written, the
+ * bootloader reads them. ClearEepromConfig and the 'E' debug command also erase the slots.
+ */
+//#define MY_CONFIG_IMAGE
+
+/**
+ * @def MY_CONFIG_IMAGE_SLOTS
+ * @brief Number of configuration image slots (73 bytes each) written in turn.
+ */
+#ifndef MY_CONFIG_IMAGE_SLOTS
+#define MY_CONFIG_IMAGE_SLOTS 4
+#endif
+
+/**
+ * @def MY_STATS_FEATURE
+ * @brief If enabled, nodes keep performance counters (TX/RX, routing, signing, sleep and loop latency, 22 bytes)
+ * and report them when the controller sends I_STATS. See NodeStats for the payload layout.
+ */
+//#define MY_STATS_FEATURE
+
+/**
+ * @def MY_ENERGY_FEATURE
+ * @brief If enabled, nodes account MCU awake and sleep time, radio TX and RX listen time and ATSHA204 active time
+ * and report them when the controller sends I_ENERGY. See NodeEnergy for the payload layout.
+ */
+//#define MY_ENERGY_FEATURE
+
+/**
+ * @def MY_TIME_SERVICE
+ * @brief Keep controller time locally, see timeNow(). The node synchronises with I_TIME, estimates the drift of
+ * its clock and only requests time again when the error bound exceeds @ref MY_TIME_MAX_ERROR_MS. requestTime()
+ * is answered locally while the bound holds. Repeaters and gateways with the service answer the I_TIME requests
+ * of their children from their own clock.
+ */
+//#define MY_TIME_SERVICE
+
+/**
+ * @def MY_TIME_MAX_ERROR_MS
+ * @brief Error bound of timeNow() in ms that triggers a new synchronisation (controller time has 1s resolution).
+ */
+#ifndef MY_TIME_MAX_ERROR_MS
+#define MY_TIME_MAX_ERROR_MS 3000
+#endif
+
+/**
+ * @def MY_TIME_DRIFT_PPM
+ * @brief Assumed clock error in ppm until the drift has been measured (WDT timed sleep is good for +-10%).
+ */
+#ifndef MY_TIME_DRIFT_PPM
+#define MY_TIME_DRIFT_PPM 20000
+#endif
+
+/**
+ * @def MY_PROFILE_FEATURE
+ * @brief If enabled, _process() times its stages (leds, inclusion, gateway, transport, tasks) and the time the sketch
+ * spends between two calls with hwMicros(). Min/avg/max and a histogram per stage are reported on I_PROFILE,
+ * see ProfileReport. Adds about 100 bytes of RAM and a few microseconds per _process() call.
+ */
+//#define MY_PROFILE_FEATURE
+
+/**
+ * @def MY_LOADTEST_FEATURE
+ * @brief Enable on the gateway and the nodes under test: nodes send sequenced, timestamped probes with
+ * sendLoadTestProbe() (see examples/LoadTestSensor), the gateway echoes them and accounts loss, reordering,
+ * duplicates and round trip times per node. The controller requests the result with I_LOADTEST, see LoadTestReport.
+ */
+//#define MY_LOADTEST_FEATURE
+
+/**
+ * @def MY_LOADTEST_NODES
+ * @brief Number of nodes the gateway accounts at once with @ref MY_LOADTEST_FEATURE (43 bytes of RAM each).
+ */
+#ifndef MY_LOADTEST_NODES
+#define MY_LOADTEST_NODES 4
+#endif
+
+/**
+ * @def MY_TASKS
+ * @brief Enable the cooperative scheduler with this many task slots, see scheduleEvery() and scheduleAfter().
+ *
+ * Tasks run from _process(), so the radio is serviced between them while the sketch waits. Not used
+ * while sleeping, see @ref MY_SLEEP_TASKS for sleeping nodes.
+ */
+//#define MY_TASKS 4
+
+/**
+ * @def MY_REPORT_POLICIES
+ * @brief Enable report by exception in send() with this many (sensor, type) policies, see setReportPolicy() (33 bytes of RAM each).
+ */
+//#define MY_REPORT_POLICIES 2
+
+/**
+ * @def MY_SLEEP_TASKS
+ * @brief Enable the sleep scheduler with this many task slots, see scheduleTask() and sleepTasks().
+ */
+//#define MY_SLEEP_TASKS 4
+
+/**
+ * @def MY_SLEEP_COALESCE_MS
+ * @brief Tasks due within this many ms are run together with the current wake up.
+ *
+ * Merging wake ups saves radio power-ups at the cost of running tasks early.
+ */
+#ifndef MY_SLEEP_COALESCE_MS
+#define MY_SLEEP_COALESCE_MS 1000
+#endif
+
+/**
+ * @def MY_SLEEP_CALIBRATE_WDT
+ * @brief Measure the watchdog oscillator against the system clock every this many sleeps (AVR only).
+ *
+ * The WDT oscillator drifts by up to +-10% with voltage and temperature. Each measurement
+ * keeps the MCU awake for 64ms with interrupts enabled, it is timed with micros().
+ */
+//#define MY_SLEEP_CALIBRATE_WDT 32
+
+/**
+ * @def MY_ADC_VCC_SETTLE_MS
+ * @brief Settle time in ms of the ADC reference before a supply voltage (or reference change) sampling (AVR only).
+ *
+ * The settle runs in the background as discarded conversions, started by hwAdcStart(HW_ADC_VCC, ...).
+ */
+#ifndef MY_ADC_VCC_SETTLE_MS
+#define MY_ADC_VCC_SETTLE_MS 70
+#endif
+
 /**********************************
 *  Over the air firmware updates
 ***********************************/
@@ -173,6 +559,42 @@
 // requires the MYSBootloader and disabled MY_OTA_FIRMWARE_FEATURE
 //#define MY_OTA_FIRMWARE_FEATURE
 
+/**
+ * @def MY_OTA_COMPRESSED
+ * @brief Define to download OTA firmware as compressed / delta image and decode it on the node.
+ *
+ * The controller serves a stream (as regular FW blocks, config blocks/crc refer to the stream)
+ * which starts with a @ref CompressedFWHeader followed by tokens:
+ * - 0x00-0x7F: (token + 1) literal bytes follow
+ * - 0x80-0xBF: copy (token & 0x3F) + 3 bytes from already decoded output, 2 byte LE distance follows
+ * - 0xC0-0xFF: copy (token & 0x3F) + 3 bytes from the running firmware, 2 byte LE address follows
+ *
+ * The stream is stored at FIRMWARE_COMPRESSED_OFFSET in external flash and decoded into the
+ * DualOptiboot image area once it passed the CRC check. The last token type makes the image a
+ * binary delta against the current firmware, so it must be built for the firmware the node runs.
+ */
+//#define MY_OTA_COMPRESSED
+
+/**
+ * @def MY_OTA_BROADCAST
+ * @brief Define to let the node join firmware sessions the controller broadcasts.
+ *
+ * A ST_FIRMWARE_CONFIG_RESPONSE sent to BROADCAST_ADDRESS starts an update on all nodes
+ * running the same firmware type. They store the ST_FIRMWARE_RESPONSE blocks streamed to
+ * BROADCAST_ADDRESS in any order and keep a bitmap of received blocks in external flash.
+ * Once the stream is silent for @ref MY_OTA_BROADCAST_TIMEOUT each node requests only the
+ * blocks it missed, using the regular unicast requests.
+ */
+//#define MY_OTA_BROADCAST
+
+/**
+ * @def MY_OTA_BROADCAST_TIMEOUT
+ * @brief Milliseconds without broadcast FW blocks before a node requests the missing ones.
+ */
+#ifndef MY_OTA_BROADCAST_TIMEOUT
+#define MY_OTA_BROADCAST_TIMEOUT 5000
+#endif
+
 /**
  * @def MY_OTA_FLASH_SS
  * @brief Slave select pin for external flash.
@@ -189,6 +611,32 @@
 #define MY_OTA_FLASH_JDECID 0x1F65
 #endif
 
+/**
+ * @def MY_OTA_WINDOW_SIZE
+ * @brief Number of firmware blocks requested from the controller at once (1-16).
+ *
+ * With a window larger than 1 the node sends requests for several consecutive blocks
+ * without waiting for each reply, writes replies to flash at the block index they carry
+ * and, on timeout, only re-requests the blocks of the window that are still missing.
+ * Every request is a regular ST_FIRMWARE_REQUEST, so no controller changes are needed.
+ * Keep it small on busy or multi-hop networks, each block in flight is a separate frame.
+ */
+#ifndef MY_OTA_WINDOW_SIZE
+#define MY_OTA_WINDOW_SIZE 1
+#endif
+
+/**
+ * @def MY_OTA_WRITE_QUEUE_SIZE
+ * @brief Number of received firmware blocks buffered in RAM while the flash is busy.
+ *
+ * Flash sectors are erased 4K at a time just ahead of the write position and blocks are
+ * programmed from this queue whenever the flash is idle, so the node keeps receiving while
+ * the flash erases or programs. Blocks arriving with a full queue are dropped and re-requested.
+ */
+#ifndef MY_OTA_WRITE_QUEUE_SIZE
+#define MY_OTA_WRITE_QUEUE_SIZE 4
+#endif
+
 
 /**********************************
 *  Gateway config
@@ -210,6 +658,162 @@
 #define MY_GATEWAY_MAX_SEND_LENGTH 120
 #endif
 
+/**
+ * @def MY_GATEWAY_BINARY_PROTOCOL
+ * @brief Define this to exchange messages with the controller as binary frames instead of ASCII lines.
+ *
+ * Frame: 0xA5, length, raw message (header and payload), crc8 over length and message.
+ * Applies to the serial, ethernet and MQTT gateway transports. Controller support is required.
+ */
+//#define MY_GATEWAY_BINARY_PROTOCOL
+
+/**
+ * @def MY_GATEWAY_TX_BUFFER_SIZE
+ * @brief Define this to pack messages to the controller into one write of up to this many bytes (ethernet and MQTT gateways).
+ *
+ * The buffer is written when full, after #MY_GATEWAY_TX_BUFFER_TIMEOUT_MS or on gatewayTransportFlush().
+ */
+//#define MY_GATEWAY_TX_BUFFER_SIZE 256
+
+/**
+ * @def MY_GATEWAY_TX_BUFFER_TIMEOUT_MS
+ * @brief Max time (ms) a message is held in the gateway transmit buffer.
+ */
+#ifndef MY_GATEWAY_TX_BUFFER_TIMEOUT_MS
+#define MY_GATEWAY_TX_BUFFER_TIMEOUT_MS 10
+#endif
+
+/**
+ * @def MY_GATEWAY_SERIAL_TX_BUFFER_SIZE
+ * @brief Define this to give the serial gateway an output buffer of this many bytes (at least #MY_GATEWAY_MAX_SEND_LENGTH).
+ *
+ * Messages are written as far as the serial (or native USB) transmit buffer has room, the rest on the next
+ * _process() calls, so printing does not block the radio. A message that does not fit waits until the buffer
+ * has been written out, see #MY_GATEWAY_SERIAL_TX_DROP.
+ */
+//#define MY_GATEWAY_SERIAL_TX_BUFFER_SIZE 256
+
+/**
+ * @def MY_GATEWAY_SERIAL_TX_DROP
+ * @brief Define this to drop messages that do not fit into the serial gateway output buffer instead of waiting.
+ */
+//#define MY_GATEWAY_SERIAL_TX_DROP
+
+/**
+ * @def MY_MQTT_SUBSCRIBE_PER_NODE
+ * @brief Define this to subscribe to the topics of every known node instead of one wildcard topic.
+ *
+ * The gateway, broadcast and all nodes in the routing table are subscribed on connect, new nodes
+ * when their first message is published. The broker then filters traffic of unknown nodes.
+ */
+//#define MY_MQTT_SUBSCRIBE_PER_NODE
+
+/**
+ * @def MY_MQTT_QOS1
+ * @brief Define this to publish and subscribe with QoS 1 on the MQTT gateway.
+ *
+ * Up to #MY_MQTT_INFLIGHT_WINDOW publishes wait for PUBACK and are republished after #MY_MQTT_RETRY_TIMEOUT_MS.
+ */
+//#define MY_MQTT_QOS1
+
+/**
+ * @def MY_MQTT_INFLIGHT_WINDOW
+ * @brief Max number of unacknowledged QoS 1 publishes.
+ */
+#ifndef MY_MQTT_INFLIGHT_WINDOW
+#define MY_MQTT_INFLIGHT_WINDOW 4
+#endif
+
+/**
+ * @def MY_MQTT_RETRY_TIMEOUT_MS
+ * @brief Time (ms) to wait for PUBACK before a QoS 1 publish is repeated.
+ */
+#ifndef MY_MQTT_RETRY_TIMEOUT_MS
+#define MY_MQTT_RETRY_TIMEOUT_MS 2000
+#endif
+
+/**
+ * @def MY_GATEWAY_CLIENT_BUFFER_SIZE
+ * @brief Define this to give every client of the ESP8266 gateway an output buffer of this many bytes.
+ *
+ * Clients are written without blocking, so a slow client does not stall the others.
+ * When a buffer overflows the oldest messages are dropped, see #MY_GATEWAY_CLIENT_DISCONNECT_SLOW.
+ */
+//#define MY_GATEWAY_CLIENT_BUFFER_SIZE 512
+
+/**
+ * @def MY_GATEWAY_CLIENT_DISCONNECT_SLOW
+ * @brief Define this to disconnect a client whose output buffer overflows instead of dropping messages.
+ */
+//#define MY_GATEWAY_CLIENT_DISCONNECT_SLOW
+
+/**
+ * @def MY_GATEWAY_RX_QUEUE_SIZE
+ * @brief Define this to buffer up to this many controller commands in the gateway.
+ *
+ * Commands are read from the link while there is room and handled one per _process() call.
+ * I_GATEWAY_BUSY (payload 1) is sent to the controller when the queue is full, I_GATEWAY_BUSY
+ * (payload 0) when it has drained to half. With #MY_MESSAGE_POOL_SIZE the gateway is also busy while the
+ * pool has no buffer for the queues.
+ */
+//#define MY_GATEWAY_RX_QUEUE_SIZE 8
+
+/**
+ * @def MY_GATEWAY_TX_QUEUE_SIZE
+ * @brief Define this to queue up to this many radio messages for the controller (one slot is kept free).
+ *
+ * transportProcess() drains the radio FIFO without waiting for network writes, the messages are
+ * formatted and written from gatewayTransportProcess() on the next _process() call. When the queue
+ * is full gatewayTransportQueue() returns false and the transport writes the queue out ahead of the
+ * message, nothing is dropped. Own messages of the gateway are sent after the queued ones.
+ */
+//#define MY_GATEWAY_TX_QUEUE_SIZE 8
+
+/**
+ * @def MY_GATEWAY_CACHE_SIZE
+ * @brief Define this to keep the last presentation, sketch info and C_SET values of the nodes in this many entries
+ * (sizeof(MyMessage) + 4 bytes each, i.e. MAX_MESSAGE_LENGTH + 5 on AVR).
+ *
+ * The cache is replayed to a (re)connecting controller (Ethernet/WiFi and MQTT gateways). An I_PRESENTATION request
+ * for a node is answered from the cache without radio traffic if the node's whole presentation is cached, otherwise
+ * it is forwarded. Broadcast I_PRESENTATION requests are answered from the cache and forwarded. The least recently
+ * updated entry is replaced when the cache is full.
+ */
+//#define MY_GATEWAY_CACHE_SIZE 32
+
+/**
+ * @def MY_GATEWAY_CACHE_ANSWER_REQ
+ * @brief Define this to answer C_REQ of the controller for values in #MY_GATEWAY_CACHE_SIZE from the cache.
+ *
+ * Sleeping nodes are then not needed for value requests, but the controller gets the last reported value
+ * instead of the live one. Without it C_REQ is forwarded to the node.
+ */
+//#define MY_GATEWAY_CACHE_ANSWER_REQ
+
+/**
+ * @def MY_GATEWAY_PENDING_QUEUE_SIZE
+ * @brief Number of messages held while the controller connection is down (#MY_CONTROLLER_IP_ADDRESS, TCP).
+ */
+#ifndef MY_GATEWAY_PENDING_QUEUE_SIZE
+#define MY_GATEWAY_PENDING_QUEUE_SIZE 4
+#endif
+
+/**
+ * @def MY_GATEWAY_RECONNECT_BACKOFF_MS
+ * @brief Wait (ms) after a failed controller connect, doubled on every further failure.
+ */
+#ifndef MY_GATEWAY_RECONNECT_BACKOFF_MS
+#define MY_GATEWAY_RECONNECT_BACKOFF_MS 500
+#endif
+
+/**
+ * @def MY_GATEWAY_RECONNECT_BACKOFF_MAX_MS
+ * @brief Max wait (ms) between controller connect attempts.
+ */
+#ifndef MY_GATEWAY_RECONNECT_BACKOFF_MAX_MS
+#define MY_GATEWAY_RECONNECT_BACKOFF_MAX_MS 30000
+#endif
+
 /**
  * @def MY_GATEWAY_MAX_CLIENTS
  * @brief Max number of parallel clients (sever mode).
@@ -236,6 +840,15 @@
 
 //#define MY_WITH_LEDS_BLINKING_INVERSE
 
+/**
+ * @def MY_LEDS_TIMER
+ * @brief Update the LEDs from the timer0 compare B interrupt instead of polling them in _process() (AVR only).
+ *
+ * The interrupt piggybacks on the millis() timer every 1.024 ms, i.e. no timer is taken from the sketch and
+ * PWM on the timer0 pins keeps working. Blink patterns stay correct while loop() blocks.
+ */
+//#define MY_LEDS_TIMER
+
 // The following defines can be used to set the port pin, that the LED is connected to
 // If one of the following is defined here, or in the sketch, MY_LEDS_BLINKING_FEATURE will be
 // enabled by default. (Replace x with the pin number you have the LED on)
@@ -327,6 +940,36 @@
 #define MY_VERIFICATION_TIMEOUT_MS 5000
 #endif
 
+/**
+ * @def MY_SIGNING_SESSIONS
+ * @brief Number of peers a node can have signing handshakes with at the same time.
+ *
+ * Each session holds the nonce issued to, or received from, one peer. Both the signing and the
+ * verifying side keep a table of this size. Gateways and repeaters default to 4, other nodes to 1.
+ */
+//#define MY_SIGNING_SESSIONS 4
+
+/**
+ * @def MY_SIGNING_NONCE_PREFETCH
+ * @brief Enable to sign messages with a nonce received in advance instead of a handshake per message.
+ *
+ * After verifying a signed message the receiver pushes a fresh nonce to the sender, which keeps it
+ * in its signing session for that node (see #MY_SIGNING_SESSIONS) and signs its next message to
+ * that node without requesting a nonce. If no valid nonce is kept, the normal handshake is used.<br>
+ * Issued nonces stay valid for #MY_SIGNING_NONCE_LIFETIME_MS, so both nodes of a pair have to enable this.
+ */
+//#define MY_SIGNING_NONCE_PREFETCH
+
+/**
+ * @def MY_SIGNING_NONCE_LIFETIME_MS
+ * @brief Time an issued nonce stays valid when #MY_SIGNING_NONCE_PREFETCH is enabled.
+ *
+ * Has to be larger than #MY_VERIFICATION_TIMEOUT_MS, which the signer keeps as margin.
+ */
+#ifndef MY_SIGNING_NONCE_LIFETIME_MS
+#define MY_SIGNING_NONCE_LIFETIME_MS 60000ul
+#endif
+
 /**
  * @def MY_SIGNING_NODE_WHITELISTING
  * @brief Enable to turn on whitelisting
@@ -338,7 +981,8 @@
  * nodes have to implement whitelisting for this to work.<br>
  * Note that a node can still transmit a non-salted message (i.e. have whitelisting disabled)
  * to a node that has whitelisting enabled (assuming the receiver does not have a matching entry
- * for the sender in it's whitelist). The whitelist to use is defined as the value of the flag.
+ * for the sender in it's whitelist). The whitelist to use is defined as the value of the flag.<br>
+ * Keep the entries sorted by nodeId, the sender is then found by binary search. Unsorted lists are scanned.
  */
 //#define MY_SIGNING_NODE_WHITELISTING {{.nodeId = GATEWAY_ADDRESS,.serial = {0x09,0x08,0x07,0x06,0x05,0x04,0x03,0x02,0x01}}}
 
@@ -352,10 +996,21 @@
 #define MY_SIGNING_ATSHA204_PIN 17
 #endif
 
+/**
+ * @def MY_SIGNING_ATSHA204_SERIAL
+ * @brief Define this to the hardware serial port driving the ATSHA204 single-wire interface instead of bit banging MY_SIGNING_ATSHA204_PIN.
+ *
+ * The SDA line is connected to TX (through a schottky diode, cathode at TX) and RX with a pull-up. Bits are sent
+ * and received as 230400 baud characters, so interrupts stay enabled during chip transactions. Do not use the
+ * port for debug prints or a serial gateway.
+ */
+//#define MY_SIGNING_ATSHA204_SERIAL Serial1
+
 /**
  * @def MY_SIGNING_SOFT_RANDOMSEED_PIN
  * @brief Pin used for random generation in soft signing
  *
+ * Seeds the fallback pseudo-RNG when the platform has no hardware entropy (SAMD21, AVR before the WDT pool is filled).
  * Do not connect anything to this when soft signing is enabled
  */
 #ifndef MY_SIGNING_SOFT_RANDOMSEED_PIN
@@ -369,24 +1024,103 @@
 /**
  * @def MY_RS485_BAUD_RATE
  * @brief The RS485 BAUD rate.
+ *
+ * The bus runs on AltSoftSerial (timer1 input capture/compare pins, e.g. RX 8 and TX 9 on ATMega328),
+ * the hardware UART stays free for debug output or a serial gateway. 19200 and 38400 work at 8 MHz.
  */
 #ifndef MY_RS485_BAUD_RATE
 #define MY_RS485_BAUD_RATE 9600
 #endif
 
+/**
+ * @def MY_RS485_SERIAL_RX_BUFFER_SIZE
+ * @brief Bytes AltSoftSerial buffers until the transport reads them (max 255).
+ *
+ * Has to cover the bytes arriving while the sketch blocks, e.g. 192 bytes per 100 ms at 19200 baud.
+ * Bytes beyond are dropped and the frame is lost.
+ */
+#ifndef MY_RS485_SERIAL_RX_BUFFER_SIZE
+#define MY_RS485_SERIAL_RX_BUFFER_SIZE 128
+#endif
+
+/**
+ * @def MY_RS485_SERIAL_TX_BUFFER_SIZE
+ * @brief Bytes AltSoftSerial buffers for sending (max 255).
+ *
+ * A frame is handed over at once and shifted out from the timer interrupt, which also releases DE
+ * after the last stop bit. Defaults to one full frame (MY_RS485_MAX_MESSAGE_LENGTH + 10 bytes), writing a
+ * frame that does not fit blocks until the rest has been queued.
+ */
+#ifndef MY_RS485_SERIAL_TX_BUFFER_SIZE
+#define MY_RS485_SERIAL_TX_BUFFER_SIZE (MY_RS485_MAX_MESSAGE_LENGTH < 245 ? MY_RS485_MAX_MESSAGE_LENGTH + 10 : 255)
+#endif
+
 /**
  * @def MY_RS485_MAX_MESSAGE_LENGTH
  * @brief The maximum message length used for RS485.
+ *
+ * With MY_RS485_MULTI_MESSAGE this is the frame size, raise it (max 255) to pack more messages.
  */
 #ifndef MY_RS485_MAX_MESSAGE_LENGTH
 #define MY_RS485_MAX_MESSAGE_LENGTH 40
 #endif
 
+/**
+ * @def MY_RS485_RX_BUFFER_SIZE
+ * @brief Number of complete RS485 frames buffered until the library picks them up (power of two).
+ *
+ * Each slot takes MY_RS485_MAX_MESSAGE_LENGTH + 2 bytes of RAM.
+ */
+#ifndef MY_RS485_RX_BUFFER_SIZE
+#define MY_RS485_RX_BUFFER_SIZE 2
+#endif
+
+/**
+ * @def MY_RS485_POLLED
+ * @brief Enable gateway-polled bus arbitration for RS485.
+ *
+ * The gateway becomes bus master and polls every node it has seen, plus one unknown
+ * address per cycle for discovery. A node only transmits one frame right after being
+ * polled, so there are no collisions and each node gets a bounded slot.
+ * Must be enabled on all nodes and the gateway of the bus.
+ */
+//#define MY_RS485_POLLED
+
+/**
+ * @def MY_RS485_POLL_SLOT
+ * @brief Time (ms) the gateway waits for a polled node to start its reply.
+ */
+#ifndef MY_RS485_POLL_SLOT
+#define MY_RS485_POLL_SLOT 10
+#endif
+
+/**
+ * @def MY_RS485_CRC16
+ * @brief Protect RS485 frames with a CRC-16 instead of the 8 bit sum.
+ *
+ * Must be enabled on all nodes and the gateway of the bus.
+ */
+//#define MY_RS485_CRC16
+
+/**
+ * @def MY_RS485_MULTI_MESSAGE
+ * @brief Pack several messages to the same destination into one RS485 frame.
+ *
+ * With MY_TRANSPORT_ASYNC_SEND, a message to the node of a frame still waiting for the bus (busy bus,
+ * back-off or poll slot) joins that frame instead of waiting for it. The messages share the status of
+ * the frame, which is reported once it is on the wire.
+ * Must be enabled on all nodes and the gateway of the bus.
+ */
+//#define MY_RS485_MULTI_MESSAGE
+
 /**********************************
 *  NRF24L01P Driver Defaults
 ***********************************/
 
 // Enables RF24 encryption (all nodes and gateway must have this enabled, and all must be personalized with the same AES key)
+// Frames are sent AES-CTR encrypted with a 4 byte nonce appended, only frames longer than 27 bytes are padded to 32 bytes.
+// The nonce counter continues from an epoch kept in EEPROM, which is incremented at every boot. SecurityPersonalizer
+// stores epoch 0 with the key; after the EEPROM was erased or cleared (epoch 0xFFFF) no frames are sent until then.
 //#define MY_RF24_ENABLE_ENCRYPTION
 
 /**
@@ -429,6 +1163,67 @@
 	#endif
 #endif
 
+/**
+ * @def MY_RF24_IRQ_PIN
+ * @brief Enable to use the RF24 IRQ pin. Override in sketch if needed.
+ *
+ * When set, incoming frames are read from the radio RX FIFO by an interrupt handler and stored
+ * in a RX buffer of @ref MY_RF24_RX_BUFFER_SIZE messages. The pin must be interrupt-capable (e.g. pin 2 on ATMega328).
+ */
+//#define MY_RF24_IRQ_PIN 2
+
+/**
+ * @def MY_RF24_RX_BUFFER_SIZE
+ * @brief Number of messages buffered in RAM when @ref MY_RF24_IRQ_PIN is set (33 bytes each, power of two).
+ */
+#ifndef MY_RF24_RX_BUFFER_SIZE
+#define MY_RF24_RX_BUFFER_SIZE 4
+#endif
+
+/**
+ * @def MY_RF24_ACK_PAYLOAD
+ * @brief Enable to deliver messages to unreachable (e.g. sleeping) children as ACK payload of their next uplink frame.
+ *
+ * A repeater or gateway stages a message for a direct child that failed to send, the radio returns it
+ * with the hardware ACK of the next frame it receives from that child. Only one message is staged at a time.
+ * Must be enabled on the children as well, they process such messages before going to sleep.
+ */
+//#define MY_RF24_ACK_PAYLOAD
+
+/**
+ * @def MY_RF24_ACK_PAYLOAD_LIFETIME_MS
+ * @brief Time (in ms) a staged ACK payload is kept before it can be replaced by a message for another child.
+ */
+#ifndef MY_RF24_ACK_PAYLOAD_LIFETIME_MS
+#define MY_RF24_ACK_PAYLOAD_LIFETIME_MS ((uint32_t)5*60*1000ul)
+#endif
+
+/**
+ * @def MY_RF24_CSMA
+ * @brief Enable to listen before talk: the RPD register (carrier above -64dBm) is checked before each transmission.
+ *
+ * While the channel is busy the transmission is deferred by a random backoff of up to MY_RF24_CSMA_BACKOFF_US,
+ * doubled on each attempt. After MY_RF24_CSMA_ATTEMPTS the frame is sent anyway and auto-retransmit takes over.
+ * Weak carriers (below -64dBm) are not detected.
+ */
+//#define MY_RF24_CSMA
+
+/**
+ * @def MY_RF24_CSMA_BACKOFF_US
+ * @brief Max random backoff (in us) after the first busy channel assessment, see MY_RF24_CSMA.
+ */
+#ifndef MY_RF24_CSMA_BACKOFF_US
+#define MY_RF24_CSMA_BACKOFF_US 500
+#endif
+
+/**
+ * @def MY_RF24_CSMA_ATTEMPTS
+ * @brief Number of busy channel assessments before sending anyway (backoff of the last one max. MY_RF24_CSMA_BACKOFF_US << (attempts-1), keep below 16ms).
+ */
+#ifndef MY_RF24_CSMA_ATTEMPTS
+#define MY_RF24_CSMA_ATTEMPTS 5
+#endif
+
 /**
  * @def MY_RF24_PA_LEVEL
  * @brief Default RF24 PA level. Override in sketch if needed.
@@ -468,6 +1263,11 @@
  * @brief RF24 radio network identifier.
  *
  * This acts as base value for sensor nodeId addresses. Change this (or channel) if you have more than one sensor network.
+ *
+ * The address LSB is the node ID of the recipient: a node listens on pipe 0 with its own ID and on
+ * pipe 1 for broadcasts (LSB 255). The other four RX pipes stay unused on purpose. A pipe per child on
+ * a repeater would need a second address LSB per parent, and all 256 values are taken by node IDs and
+ * broadcast. The pipes share the channel and receiver, so they would not reduce collisions either.
  */
 #ifndef MY_RF24_BASE_RADIO_ID
 #define MY_RF24_BASE_RADIO_ID 0x00,0xFC,0xE1,0xA8,0xA8
@@ -548,6 +1348,14 @@
 	#define MY_RFM69HW false
 #endif
 
+/**
+ * @def MY_RFM69_POWER_LEVEL
+ * @brief RFM69 transmit power level (0-31, see RFM69::setPowerLevel()). With @ref MY_TRANSPORT_ATC this is the maximum level.
+ */
+#ifndef MY_RFM69_POWER_LEVEL
+#define MY_RFM69_POWER_LEVEL 31
+#endif
+
 /**
  * @def MY_RFM69_NETWORKID
  * @brief RFM69 Network ID. Use the same for all nodes that will talk to each other.
@@ -584,6 +1392,51 @@
 	#endif
 #endif
 
+/**
+ * @def MY_RFM69_DEFERRED_IRQ
+ * @brief Define this to keep SPI transfers out of the RFM69 interrupt handler.
+ *
+ * The ISR only flags a received frame, the FIFO is read when the transport is polled and frames
+ * are queued in a RX buffer of @ref MY_RFM69_RX_BUFFER_SIZE messages. This avoids long interrupt
+ * latencies and conflicts with other SPI devices (SPI flash, W5100) used from the main loop.
+ */
+//#define MY_RFM69_DEFERRED_IRQ
+
+/**
+ * @def MY_RFM69_RX_BUFFER_SIZE
+ * @brief Number of messages buffered in RAM when @ref MY_RFM69_DEFERRED_IRQ is set (MAX_MESSAGE_LENGTH + 1 bytes each, power of two).
+ */
+#ifndef MY_RFM69_RX_BUFFER_SIZE
+#define MY_RFM69_RX_BUFFER_SIZE 4
+#endif
+
+/**
+ * @def MY_RFM69_CSMA_BACKOFF_MS
+ * @brief If defined, a transmission finding the channel busy (RSSI above CSMA_LIMIT) checks again after a random backoff
+ * of up to this many ms instead of right away, nodes waiting for the same frame to end no longer start together.
+ */
+//#define MY_RFM69_CSMA_BACKOFF_MS 10
+
+/**
+ * @def MY_RFM69_MAX_MESSAGE_LENGTH
+ * @brief Use frames of up to this size (header included, max. 61) instead of 32 bytes, i.e. a MAX_PAYLOAD of up to 54 bytes.
+ *
+ * All nodes and the gateway of the network must use the same value. Not compatible with signing.
+ * Raise @ref MY_GATEWAY_MAX_SEND_LENGTH if long P_CUSTOM payloads are forwarded in hex to the controller.
+ */
+//#define MY_RFM69_MAX_MESSAGE_LENGTH 61
+
+/**
+ * @def MY_RFM69_ATC_TARGET_RSSI
+ * @brief RSSI (in dBm) of the ACKs the transmit power is adjusted to when @ref MY_TRANSPORT_ATC is set.
+ */
+#ifndef MY_RFM69_ATC_TARGET_RSSI
+#define MY_RFM69_ATC_TARGET_RSSI (-80)
+#endif
+#if MY_RFM69_POWER_LEVEL > 31
+	#error MY_RFM69_POWER_LEVEL must be 0-31
+#endif
+
 // Enables RFM69 encryption (all nodes and gateway must have this enabled, and all must be personalized with the same AES key)
 //#define MY_RFM69_ENABLE_ENCRYPTION
 
@@ -696,10 +1549,66 @@
 #define MY_SIGNING_ATSHA204
 #define MY_SIGNING_SOFT
 #define MY_SIGNING_REQUEST_SIGNATURES
+#define MY_SIGNING_SESSIONS
+#define MY_SIGNING_NONCE_PREFETCH
+#define MY_SIGNING_ATSHA204_SERIAL
 #define MY_SIGNING_NODE_WHITELISTING {{.nodeId = GATEWAY_ADDRESS,.serial = {0x09,0x08,0x07,0x06,0x05,0x04,0x03,0x02,0x01}}}
 #define MY_IS_RFM69HW
+#define MY_RFM69_DEFERRED_IRQ
+#define MY_RFM69_CSMA_BACKOFF_MS
+#define MY_RFM69_MAX_MESSAGE_LENGTH
 #define MY_PARENT_NODE_IS_STATIC
+#define MY_SMART_SLEEP_PENDING
+#define MY_WARM_BOOT
+#define MY_CONFIG_IMAGE
+#define MY_STATS_FEATURE
+#define MY_ENERGY_FEATURE
+#define MY_TIME_SERVICE
+#define MY_PROFILE_FEATURE
+#define MY_LOADTEST_FEATURE
+#define MY_TASKS
+#define MY_REPORT_POLICIES
+#define MY_SLEEP_TASKS
+#define MY_SLEEP_CALIBRATE_WDT
 #define MY_REGISTRATION_CONTROLLER
 #define MY_DEBUG_VERBOSE_RF24
 #define MY_TRANSPORT_SANITY_CHECK
+#define MY_RF24_IRQ_PIN
+#define MY_RF24_ACK_PAYLOAD
+#define MY_RF24_CSMA
+#define MY_TRANSPORT_ASYNC_SEND
+#define MY_TRANSPORT_TX_QUEUE_SIZE
+#define MY_MESSAGE_POOL_SIZE
+#define MY_TRANSPORT_FIFO_BUDGET_US
+#define MY_TRANSPORT_CUT_THROUGH
+#define MY_TRANSPORT_FPAR_STORM_CONTROL
+#define MY_TRANSPORT_GATEWAY_BEACON
+#define MY_TRANSPORT_ATC
+#define MY_TRANSPORT_PARENT_SCORING
+#define MY_TRANSPORT_LINK_QUALITY
+#define MY_TRANSPORT_TRACE
+#define MY_RADIO_LOOPBACK
+#define MY_RADIO_DUAL
+#define MY_TRANSPORT_MAILBOX_SIZE
+#define MY_TRANSPORT_DEDUP_SIZE
+#define MY_TRANSPORT_FW_CACHE_SIZE
+#define MY_TRANSPORT_FRAGMENTATION
+#define MY_RS485_POLLED
+#define MY_RS485_CRC16
+#define MY_RS485_MULTI_MESSAGE
+#define MY_RAM_ROUTING_TABLE_FEATURE
+#define MY_OTA_COMPRESSED
+#define MY_OTA_BROADCAST
+#define MY_GATEWAY_BINARY_PROTOCOL
+#define MY_GATEWAY_TX_BUFFER_SIZE
+#define MY_GATEWAY_SERIAL_TX_BUFFER_SIZE
+#define MY_GATEWAY_SERIAL_TX_DROP
+#define MY_GATEWAY_RX_QUEUE_SIZE
+#define MY_GATEWAY_TX_QUEUE_SIZE
+#define MY_GATEWAY_CACHE_SIZE
+#define MY_GATEWAY_CACHE_ANSWER_REQ
+#define MY_GATEWAY_CLIENT_BUFFER_SIZE
+#define MY_GATEWAY_CLIENT_DISCONNECT_SLOW
+#define MY_MQTT_QOS1
+#define MY_MQTT_SUBSCRIBE_PER_NODE
 #endif
@@ -53,10 +53,41 @@
 #endif
 
 // Enable radio "feature" if one of the radio types was enabled
-#if defined(MY_RADIO_NRF24) || defined(MY_RADIO_RFM69) || defined(MY_RS485)
+#if defined(MY_RADIO_NRF24) || defined(MY_RADIO_RFM69) || defined(MY_RS485) || defined(MY_RADIO_LOOPBACK)
 	#define MY_RADIO_FEATURE
 #endif
 
+// RS485 bus on AltSoftSerial, buffer sizes of the driver
+#if defined(MY_RS485)
+	#define ALTSS_RX_BUFFER_SIZE MY_RS485_SERIAL_RX_BUFFER_SIZE
+	#define ALTSS_TX_BUFFER_SIZE MY_RS485_SERIAL_TX_BUFFER_SIZE
+#endif
+
+// Dual radio gateway: the RFM69 ISR must not use the SPI bus shared with the NRF24
+#if defined(MY_RADIO_DUAL) && !defined(MY_RFM69_DEFERRED_IRQ)
+	#define MY_RFM69_DEFERRED_IRQ
+#endif
+
+// Warm boot restores uplink state, gateways have none
+#if defined(MY_WARM_BOOT) && (defined(MY_GATEWAY_FEATURE) || !defined(MY_RADIO_FEATURE))
+	#undef MY_WARM_BOOT
+#endif
+
+// The gateway cache holds messages of radio nodes
+#if defined(MY_GATEWAY_CACHE_SIZE) && !defined(MY_RADIO_FEATURE)
+	#undef MY_GATEWAY_CACHE_SIZE
+#endif
+
+// Multi-message frames are an RS485 framing
+#if defined(MY_RS485_MULTI_MESSAGE) && !defined(MY_RS485)
+	#undef MY_RS485_MULTI_MESSAGE
+#endif
+
+// Output buffer of the serial gateway only
+#if defined(MY_GATEWAY_SERIAL_TX_BUFFER_SIZE) && !defined(MY_GATEWAY_SERIAL)
+	#undef MY_GATEWAY_SERIAL_TX_BUFFER_SIZE
+#endif
+
 // HARDWARE
 #if defined(ARDUINO_ARCH_ESP8266)
 	// Remove PSTR macros from debug prints
@@ -69,6 +100,9 @@
 	#include "core/MyHwATMega328.cpp"
 #elif defined(ARDUINO_ARCH_SAMD)
         #include "core/MyHwSAMD.cpp"
+#elif defined(ARDUINO_ARCH_NATIVE)
+	// host build, see tests/Native
+	#include "core/MyHwNative.cpp"
 #endif
 
 // LEDS
@@ -94,6 +128,11 @@
 	#define MY_LEDS_BLINKING_FEATURE
 #endif
 
+// timer driven LEDs are implemented for AVR, other platforms poll
+#if defined(MY_LEDS_TIMER) && !defined(ARDUINO_ARCH_AVR)
+	#undef MY_LEDS_TIMER
+#endif
+
 
 /**
  * @def MY_DEFAULT_LED_BLINK_PERIOD
@@ -144,6 +183,10 @@
 
 #include "core/MyIndication.cpp"
 
+#if defined(MY_MESSAGE_POOL_SIZE)
+	#include "core/MyMessagePool.cpp"
+#endif
+
 
 // INCLUSION MODE
 #if defined(MY_INCLUSION_MODE_FEATURE)
@@ -155,6 +198,13 @@
 #if defined(MY_SIGNING_ATSHA204) || defined(MY_SIGNING_SOFT)
 	#define MY_SIGNING_FEATURE
 #endif
+#if !defined(MY_SIGNING_SESSIONS)
+	#if defined(MY_GATEWAY_FEATURE) || defined(MY_REPEATER_FEATURE)
+		#define MY_SIGNING_SESSIONS 4
+	#else
+		#define MY_SIGNING_SESSIONS 1
+	#endif
+#endif
 #include "core/MySigning.cpp"
 #include "drivers/ATSHA204/sha256.cpp"
 #if defined(MY_SIGNING_FEATURE)
@@ -200,8 +250,13 @@
 		#error You must define a unique MY_MQTT_CLIENT_ID for this MQTT client
 	#endif
 
+	#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+		// coalesce PUBLISH packets into one client write
+		#define MQTT_OUT_BUFFER_SIZE MY_GATEWAY_TX_BUFFER_SIZE
+	#endif
 	#include "drivers/PubSubClient/PubSubClient.cpp"
 	#include "core/MyGatewayTransport.cpp"
+	#include "core/MyProtocolMySensors.cpp"
 	#include "core/MyGatewayTransportMQTTClient.cpp"
 #elif defined(MY_GATEWAY_FEATURE)
 	// GATEWAY - COMMON FUNCTIONS
@@ -241,7 +296,7 @@
 
 
 // RADIO
-#if defined(MY_RADIO_NRF24) || defined(MY_RADIO_RFM69) || defined(MY_RS485)
+#if defined(MY_RADIO_FEATURE)
 	// SOFTSPI
 	#ifdef MY_SOFTSPI
 		#if defined(ARDUINO_ARCH_ESP8266)
@@ -250,11 +305,62 @@
 		#include "drivers/AVR/DigitalIO/DigitalIO.h"
 	#endif
 
+	#if defined(MY_RAM_ROUTING_TABLE_FEATURE) && defined(MY_SPARSE_ROUTING_TABLE_SIZE)
+		#error Only one routing table store can be activated
+	#endif
 	#include "core/MyTransport.cpp"
-	#if (defined(MY_RADIO_NRF24) && defined(MY_RADIO_RFM69)) || (defined(MY_RADIO_NRF24) && defined(MY_RS485)) || (defined(MY_RADIO_RFM69) && defined(MY_RS485))
+	#if defined(MY_RADIO_DUAL)
+		#if !defined(MY_GATEWAY_FEATURE) && !defined(MY_REPEATER_FEATURE)
+			#error MY_RADIO_DUAL requires a gateway or repeater
+		#endif
+		#if defined(MY_RADIO_NRF24) + defined(MY_RADIO_RFM69) + defined(MY_RS485) != 2
+			#error MY_RADIO_DUAL requires two of MY_RADIO_NRF24, MY_RADIO_RFM69 and MY_RS485
+		#endif
+		#if defined(MY_RFM69_MAX_MESSAGE_LENGTH)
+			#error MY_RFM69_MAX_MESSAGE_LENGTH exceeds the frame size of the other link, not available with MY_RADIO_DUAL
+		#endif
+		#if defined(MY_TRANSPORT_ATC)
+			#error MY_TRANSPORT_ATC is not available with MY_RADIO_DUAL
+		#endif
+	#elif (defined(MY_RADIO_NRF24) && defined(MY_RADIO_RFM69)) || (defined(MY_RADIO_NRF24) && defined(MY_RS485)) || (defined(MY_RADIO_RFM69) && defined(MY_RS485))
+		#error Only one forward link driver can be activated
+	#endif
+	#if defined(MY_RADIO_LOOPBACK) && (defined(MY_RADIO_NRF24) || defined(MY_RADIO_RFM69) || defined(MY_RS485))
 		#error Only one forward link driver can be activated
 	#endif
-	#if defined(MY_RADIO_NRF24)
+	#if defined(MY_RF24_ACK_PAYLOAD) && !defined(MY_RADIO_NRF24)
+		#error MY_RF24_ACK_PAYLOAD requires MY_RADIO_NRF24
+	#endif
+	#if defined(MY_RADIO_DUAL)
+		#if defined(MY_RADIO_NRF24)
+			#if defined(MY_RF24_ENABLE_ENCRYPTION)
+				#include "drivers/AES/AES.cpp"
+			#endif
+			#include "drivers/RF24/RF24.cpp"
+		#endif
+		#if defined(MY_RADIO_RFM69)
+			#include "drivers/RFM69/RFM69.cpp"
+		#endif
+		#if defined(MY_RS485)
+			#include "drivers/AltSoftSerial/AltSoftSerial.cpp"
+		#endif
+		// both HALs define the transport interface, the dispatcher in MyTransportDual.cpp implements the global one
+		namespace MyTransportPrimary {
+			#if defined(MY_RADIO_NRF24)
+				#include "core/MyTransportNRF24.cpp"
+			#else
+				#include "core/MyTransportRFM69.cpp"
+			#endif
+		}
+		namespace MyTransportSecondary {
+			#if defined(MY_RS485)
+				#include "core/MyTransportRS485.cpp"
+			#else
+				#include "core/MyTransportRFM69.cpp"
+			#endif
+		}
+		#include "core/MyTransportDual.cpp"
+	#elif defined(MY_RADIO_NRF24)
 		#if defined(MY_RF24_ENABLE_ENCRYPTION)
 			#include "drivers/AES/AES.cpp"
 		#endif
@@ -266,6 +372,8 @@
 	#elif defined(MY_RADIO_RFM69)
 		#include "drivers/RFM69/RFM69.cpp"
 		#include "core/MyTransportRFM69.cpp"
+	#elif defined(MY_RADIO_LOOPBACK)
+		#include "core/MyTransportLoopback.cpp"
 	#endif
 #endif
 
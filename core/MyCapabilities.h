@@ -34,7 +34,9 @@
 #endif
 
 
-#if defined(MY_RADIO_NRF24)
+#if defined(MY_RADIO_DUAL)
+	#define MY_CAP_RADIO "D"
+#elif defined(MY_RADIO_NRF24)
 	#define MY_CAP_RADIO "N"
 #elif defined(MY_RADIO_RFM69)
 	#define MY_CAP_RADIO "R"
@@ -27,8 +27,12 @@
 #define EEPROM_PARENT_NODE_ID_ADDRESS (EEPROM_START+1)
 // EEPROM location of distance to gateway
 #define EEPROM_DISTANCE_ADDRESS (EEPROM_PARENT_NODE_ID_ADDRESS+1)
+// Size of routing table, one next hop per node ID
+#define SIZE_ROUTES 256
 #define EEPROM_ROUTES_ADDRESS (EEPROM_DISTANCE_ADDRESS+1) // Where to start storing routing information in EEPROM. Will allocate 256 bytes.
-#define EEPROM_CONTROLLER_CONFIG_ADDRESS (EEPROM_ROUTES_ADDRESS+256) // Location of controller sent configuration (we allow one payload of config data from controller)
+#define EEPROM_CONTROLLER_CONFIG_ADDRESS (EEPROM_ROUTES_ADDRESS+SIZE_ROUTES) // Location of controller sent configuration (we allow one payload of config data from controller)
+#define EEPROM_WARM_BOOT_ADDRESS (EEPROM_CONTROLLER_CONFIG_ADDRESS+16) // MY_WARM_BOOT record, uses 6 of the unused controller config bytes
+#define EEPROM_RF_ENCRYPTION_EPOCH_ADDRESS (EEPROM_CONTROLLER_CONFIG_ADDRESS+22) // MY_RF24_ENABLE_ENCRYPTION frame counter epoch, 2 bytes
 #define EEPROM_FIRMWARE_TYPE_ADDRESS (EEPROM_CONTROLLER_CONFIG_ADDRESS+24)
 #define EEPROM_FIRMWARE_VERSION_ADDRESS (EEPROM_FIRMWARE_TYPE_ADDRESS+2)
 #define EEPROM_FIRMWARE_BLOCKS_ADDRESS (EEPROM_FIRMWARE_VERSION_ADDRESS+2)
@@ -40,5 +44,6 @@
 #define EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS (EEPROM_SIGNING_SOFT_SERIAL_ADDRESS+9) // This is set with SecurityPersonalizer.ino
 #define EEPROM_NODE_LOCK_COUNTER (EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS+16)
 #define EEPROM_LOCAL_CONFIG_ADDRESS (EEPROM_NODE_LOCK_COUNTER+1) // First free address for sketch static configuration
+#define EEPROM_CONFIG_IMAGE_ADDRESS (EEPROM_LOCAL_CONFIG_ADDRESS+256) // MY_CONFIG_IMAGE slots, after the 256 bytes of saveState()
 
 #endif
@@ -18,47 +18,325 @@
  */
 
 #include "MyGatewayTransport.h"
+#if defined(MY_GATEWAY_CACHE_SIZE)
+	#include "MyTransport.h"
+#endif
 
 extern bool transportSendRoute(MyMessage &message);
+extern bool transportQueueMessage(MyMessage &message);
+#if defined(MY_MESSAGE_POOL_SIZE) && defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+	extern bool transportQueueHandle(msgPoolHandle handle);
+#endif
+extern bool transportFWCacheProcess(MyMessage &message);
 extern MyMessage _msg;
 
-inline void gatewayTransportProcess() {
-	if (gatewayTransportAvailable()) {
-		_msg = gatewayTransportReceive();
-		if (_msg.destination == GATEWAY_ADDRESS) {
-
-			// Check if sender requests an ack back.
-			if (mGetRequestAck(_msg)) {
-				// Copy message
-				_msgTmp = _msg;
-				mSetRequestAck(_msgTmp, false); // Reply without ack flag (otherwise we would end up in an eternal loop)
-				mSetAck(_msgTmp, true);
-				_msgTmp.sender = _nc.nodeId;
-				_msgTmp.destination = _msg.sender;
-				gatewayTransportSend(_msgTmp);
+extern bool isTransportReady();
+
+#if defined(MY_GATEWAY_RX_QUEUE_SIZE)
+	// controller commands waiting to be handled, oldest first
+	#if defined(MY_MESSAGE_POOL_SIZE)
+		static msgPoolHandle _gatewayRxQueue[MY_GATEWAY_RX_QUEUE_SIZE];
+	#else
+		static MyMessage _gatewayRxQueue[MY_GATEWAY_RX_QUEUE_SIZE];
+	#endif
+	static uint8_t _gatewayRxHead = 0;
+	static uint8_t _gatewayRxCount = 0;
+	static bool _gatewayRxBusy = false;
+
+	// tell controller to pause/resume sending
+	void gatewayTransportSetBusy(bool busy) {
+		_gatewayRxBusy = busy;
+		gatewayTransportSendQueued();
+		gatewayTransportSend(buildGw(_msgTmp, I_GATEWAY_BUSY).set((uint8_t)busy));
+	}
+
+	// pause when the queue or the pool is full, resume when both have room again
+	static void gatewayTransportUpdateBusy() {
+		#if defined(MY_MESSAGE_POOL_SIZE)
+			const uint8_t room = msgPoolQueueAvailable();
+		#else
+			const uint8_t room = 2;
+		#endif
+		if (!_gatewayRxBusy && (_gatewayRxCount == MY_GATEWAY_RX_QUEUE_SIZE || !room)) {
+			gatewayTransportSetBusy(true);
+		}
+		else if (_gatewayRxBusy && _gatewayRxCount <= MY_GATEWAY_RX_QUEUE_SIZE / 2 && room > 1) {
+			gatewayTransportSetBusy(false);
+		}
+	}
+#endif
+
+#if defined(MY_GATEWAY_TX_QUEUE_SIZE)
+	// radio messages to the controller: single producer (transport), single consumer (gatewayTransportProcess),
+	// each index is written by one side only
+	static MyMessage _gatewayTxQueue[MY_GATEWAY_TX_QUEUE_SIZE];
+	static volatile uint8_t _gatewayTxHead = 0;
+	static volatile uint8_t _gatewayTxTail = 0;
+	// slot written before it is published
+	#define GATEWAY_QUEUE_BARRIER() __asm__ __volatile__("" ::: "memory")
+#endif
+
+void gatewayTransportSendQueued() {
+#if defined(MY_GATEWAY_TX_QUEUE_SIZE)
+	uint8_t tail = _gatewayTxTail;
+	while (tail != _gatewayTxHead) {
+		GATEWAY_QUEUE_BARRIER();
+		(void)gatewayTransportSend(_gatewayTxQueue[tail]);
+		tail = (tail + 1) % MY_GATEWAY_TX_QUEUE_SIZE;
+		_gatewayTxTail = tail;
+	}
+#endif
+}
+
+#if defined(MY_GATEWAY_CACHE_SIZE)
+	// last presentation, sketch info and values of the nodes
+	typedef struct {
+		MyMessage message;
+		uint32_t stamp;		// update counter, 0: free
+	} gatewayCacheEntry;
+
+	static gatewayCacheEntry _gatewayCache[MY_GATEWAY_CACHE_SIZE];
+	static uint32_t _gatewayCacheStamp = 0;
+
+	static bool gatewayTransportCacheMatch(MyMessage &entry, MyMessage &message) {
+		if (entry.sender != message.sender || mGetCommand(entry) != mGetCommand(message)) return false;
+		// the type of a presentation is the sensor type, a re-presented child may change it
+		if (mGetCommand(message) == C_PRESENTATION) return entry.sensor == message.sensor;
+		if (mGetCommand(message) == C_INTERNAL) return entry.type == message.type;
+		return entry.sensor == message.sensor && entry.type == message.type;
+	}
+
+	static void gatewayTransportCacheStore(MyMessage &message) {
+		const uint8_t command = mGetCommand(message);
+		if (mGetAck(message) || !(command == C_PRESENTATION || command == C_SET ||
+			(command == C_INTERNAL && (message.type == I_SKETCH_NAME || message.type == I_SKETCH_VERSION)))) return;
+		gatewayCacheEntry *slot = NULL;
+		for (uint8_t i = 0; i < MY_GATEWAY_CACHE_SIZE && !slot; i++) {
+			if (_gatewayCache[i].stamp && gatewayTransportCacheMatch(_gatewayCache[i].message, message)) slot = &_gatewayCache[i];
+		}
+		if (!slot) {
+			// free entries have the lowest stamp
+			slot = &_gatewayCache[0];
+			for (uint8_t i = 1; i < MY_GATEWAY_CACHE_SIZE; i++) {
+				if (_gatewayCache[i].stamp < slot->stamp) slot = &_gatewayCache[i];
 			}
-			if (mGetCommand(_msg) == C_INTERNAL) {
-				if (_msg.type == I_VERSION) {
-					// Request for version. Create the response
-					gatewayTransportSend(buildGw(_msg, I_VERSION).set(MYSENSORS_LIBRARY_VERSION));
-				#ifdef MY_INCLUSION_MODE_FEATURE
-				} else if (_msg.type == I_INCLUSION_MODE) {
-					// Request to change inclusion mode
-					inclusionModeSet(atoi(_msg.data) == 1);
-				#endif
-				} else {
-					_processInternalMessages();
+			if (slot->stamp) {
+				// evicted: the node is no longer complete, drop its node presentation (see gatewayTransportCacheComplete())
+				const uint8_t node = slot->message.sender;
+				for (uint8_t i = 0; i < MY_GATEWAY_CACHE_SIZE; i++) {
+					MyMessage &cached = _gatewayCache[i].message;
+					if (_gatewayCache[i].stamp && cached.sender == node && mGetCommand(cached) == C_PRESENTATION &&
+						cached.sensor == NODE_SENSOR_ID) _gatewayCache[i].stamp = 0;
 				}
-			} else {
-				// Call incoming message callback if available
-				if (receive) {
-					receive(_msg);
+			}
+		}
+		slot->message = message;
+		slot->stamp = ++_gatewayCacheStamp;
+	}
+
+	bool gatewayTransportCacheReplay(uint8_t node) {
+		bool found = false;
+		// presentation first, controllers create the children before values arrive
+		for (uint8_t pass = 0; pass < 2; pass++) {
+			for (uint8_t i = 0; i < MY_GATEWAY_CACHE_SIZE; i++) {
+				gatewayCacheEntry &entry = _gatewayCache[i];
+				if (!entry.stamp || (node != BROADCAST_ADDRESS && entry.message.sender != node)) continue;
+				if ((mGetCommand(entry.message) == C_SET) != (pass == 1)) continue;
+				_msgTmp = entry.message;
+				(void)gatewayTransportSend(_msgTmp);
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	// a node presents itself (NODE_SENSOR_ID) before sketch info and children, if that presentation
+	// is cached and none of the node's entries was evicted since, the whole presentation is
+	static bool gatewayTransportCacheComplete(uint8_t node) {
+		for (uint8_t i = 0; i < MY_GATEWAY_CACHE_SIZE; i++) {
+			MyMessage &cached = _gatewayCache[i].message;
+			if (_gatewayCache[i].stamp && cached.sender == node && mGetCommand(cached) == C_PRESENTATION &&
+				cached.sensor == NODE_SENSOR_ID) return true;
+		}
+		return false;
+	}
+
+	// answer presentation (and with MY_GATEWAY_CACHE_ANSWER_REQ value) requests of the controller for cached
+	// nodes, returns true if the request is not forwarded
+	static bool gatewayTransportCacheAnswer(MyMessage &request) {
+		if (mGetCommand(request) == C_INTERNAL && request.type == I_PRESENTATION) {
+			if (request.destination == BROADCAST_ADDRESS) {
+				// sleeping nodes from the cache, the others present themselves
+				(void)gatewayTransportCacheReplay(BROADCAST_ADDRESS);
+				return false;
+			}
+			return gatewayTransportCacheComplete(request.destination) && gatewayTransportCacheReplay(request.destination);
+		}
+		#if defined(MY_GATEWAY_CACHE_ANSWER_REQ)
+			if (mGetCommand(request) != C_REQ) return false;
+			for (uint8_t i = 0; i < MY_GATEWAY_CACHE_SIZE; i++) {
+				MyMessage &cached = _gatewayCache[i].message;
+				if (_gatewayCache[i].stamp && mGetCommand(cached) == C_SET && cached.sender == request.destination &&
+					cached.sensor == request.sensor && cached.type == request.type) {
+					_msgTmp = cached;
+					(void)gatewayTransportSend(_msgTmp);
+					return true;
 				}
 			}
+		#endif
+		// otherwise the controller reads the live value from the node
+		return false;
+	}
+#endif
+
+bool gatewayTransportQueue(MyMessage &message) {
+#if defined(MY_GATEWAY_CACHE_SIZE)
+	gatewayTransportCacheStore(message);
+#endif
+#if defined(MY_GATEWAY_TX_QUEUE_SIZE)
+	const uint8_t head = _gatewayTxHead;
+	const uint8_t next = (head + 1) % MY_GATEWAY_TX_QUEUE_SIZE;
+	if (next == _gatewayTxTail) {
+		// full, the producer decides, see transportGatewayHandOver()
+		return false;
+	}
+	_gatewayTxQueue[head] = message;
+	GATEWAY_QUEUE_BARRIER();
+	_gatewayTxHead = next;
+	return true;
+#else
+	return gatewayTransportSend(message);
+#endif
+}
+
+// returns false if message could not be handled yet
+bool gatewayTransportHandleMessage();
+
+// common to both RX paths before a controller message is forwarded,
+// returns true if the gateway answered it and it must not be forwarded
+static bool gatewayTransportForwardPrepare(MyMessage &message) {
+#if defined(MY_GATEWAY_CACHE_SIZE)
+	if (gatewayTransportCacheAnswer(message)) return true;
+#endif
+#if defined(MY_RADIO_FEATURE) && defined(MY_TRANSPORT_FW_CACHE_SIZE)
+	// keep FW blocks for other nodes requesting them
+	(void)transportFWCacheProcess(message);
+#endif
+	(void)message;
+	return false;
+}
+
+#if defined(MY_GATEWAY_RX_QUEUE_SIZE) && defined(MY_MESSAGE_POOL_SIZE)
+// returns false if command could not be handled yet, the caller keeps the handle then
+static bool gatewayTransportHandleCommand(msgPoolHandle handle) {
+	MyMessage &command = msgPoolGet(handle);
+	#if defined(MY_RADIO_FEATURE) && defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+		if (command.destination != GATEWAY_ADDRESS) {
+			if (gatewayTransportForwardPrepare(command)) {
+				msgPoolRelease(handle);
+				return true;
+			}
+			// the buffer moves on to the TX queue
+			if (transportQueueHandle(handle)) return true;
+			if (isTransportReady()) return false;
+			msgPoolRelease(handle);
+			return true;
+		}
+	#endif
+	_msg = command;
+	msgPoolRelease(handle);
+	return gatewayTransportHandleMessage();
+}
+#endif
+
+bool gatewayTransportHandleMessage() {
+	if (_msg.destination == GATEWAY_ADDRESS) {
+
+		// Check if sender requests an ack back.
+		if (mGetRequestAck(_msg)) {
+			// Copy message
+			_msgTmp = _msg;
+			mSetRequestAck(_msgTmp, false); // Reply without ack flag (otherwise we would end up in an eternal loop)
+			mSetAck(_msgTmp, true);
+			_msgTmp.sender = _nc.nodeId;
+			_msgTmp.destination = _msg.sender;
+			gatewayTransportSend(_msgTmp);
+		}
+		if (mGetCommand(_msg) == C_INTERNAL) {
+			if (_msg.type == I_VERSION) {
+				// Request for version. Create the response
+				gatewayTransportSend(buildGw(_msg, I_VERSION).set(MYSENSORS_LIBRARY_VERSION));
+			#ifdef MY_INCLUSION_MODE_FEATURE
+			} else if (_msg.type == I_INCLUSION_MODE) {
+				// Request to change inclusion mode
+				inclusionModeSet(atoi(_msg.data) == 1);
+			#endif
+			} else {
+				_processInternalMessages();
+			}
 		} else {
-			#if defined(MY_RADIO_FEATURE)
+			// Call incoming message callback if available
+			if (receive) {
+				receive(_msg);
+			}
+		}
+	} else {
+		if (gatewayTransportForwardPrepare(_msg)) return true;
+		#if defined(MY_RADIO_FEATURE)
+			#if defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+				// controller commands are queued and fanned out from transportProcess()
+				return transportQueueMessage(_msg) || !isTransportReady();
+			#else
 				transportSendRoute(_msg);
 			#endif
+		#endif
+	}
+	return true;
+}
+
+inline void gatewayTransportProcess() {
+#if defined(MY_GATEWAY_TX_QUEUE_SIZE)
+	// network writes of radio messages received since the last call
+	gatewayTransportSendQueued();
+#endif
+#if defined(MY_GATEWAY_RX_QUEUE_SIZE)
+	// read link as long as there is room
+	#if defined(MY_MESSAGE_POOL_SIZE)
+		// a free pool buffer is also room
+		while (_gatewayRxCount < MY_GATEWAY_RX_QUEUE_SIZE && msgPoolQueueAvailable() && gatewayTransportAvailable()) {
+			_gatewayRxQueue[(_gatewayRxHead + _gatewayRxCount) % MY_GATEWAY_RX_QUEUE_SIZE] = msgPoolAllocQueued(gatewayTransportReceive());
+			_gatewayRxCount++;
+		}
+	#else
+		while (_gatewayRxCount < MY_GATEWAY_RX_QUEUE_SIZE && gatewayTransportAvailable()) {
+			_gatewayRxQueue[(_gatewayRxHead + _gatewayRxCount) % MY_GATEWAY_RX_QUEUE_SIZE] = gatewayTransportReceive();
+			_gatewayRxCount++;
+		}
+	#endif
+	gatewayTransportUpdateBusy();
+	if (!_gatewayRxCount) {
+		return;
+	}
+	// one command per call
+	#if defined(MY_MESSAGE_POOL_SIZE)
+		if (!gatewayTransportHandleCommand(_gatewayRxQueue[_gatewayRxHead])) {
+			// radio queue full, keep command until there is room
+			return;
 		}
+	#else
+		_msg = _gatewayRxQueue[_gatewayRxHead];
+		if (!gatewayTransportHandleMessage()) {
+			// radio queue full, keep command until there is room
+			return;
+		}
+	#endif
+	_gatewayRxHead = (_gatewayRxHead + 1) % MY_GATEWAY_RX_QUEUE_SIZE;
+	_gatewayRxCount--;
+	gatewayTransportUpdateBusy();
+#else
+	if (gatewayTransportAvailable()) {
+		_msg = gatewayTransportReceive();
+		(void)gatewayTransportHandleMessage();
 	}
+#endif
 }
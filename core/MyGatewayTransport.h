@@ -39,6 +39,34 @@ bool gatewayTransportInit();
  */
 bool gatewayTransportSend(MyMessage &message);
 
+/**
+ * Write out messages buffered by gatewayTransportSend() (MY_GATEWAY_TX_BUFFER_SIZE)
+ * @return false if the buffered messages could not be written
+ */
+bool gatewayTransportFlush();
+
+/**
+ * Hand over a radio message to the controller, queued until the next gatewayTransportProcess() with
+ * MY_GATEWAY_TX_QUEUE_SIZE, sent right away otherwise
+ * @return false if the queue is full (message not taken) or the message could not be sent
+ */
+bool gatewayTransportQueue(MyMessage &message);
+
+/**
+ * Write the radio messages queued by gatewayTransportQueue(), called before the gateway sends own
+ * messages to the controller so they are not overtaken. No-op without MY_GATEWAY_TX_QUEUE_SIZE
+ */
+void gatewayTransportSendQueued();
+
+#if defined(MY_GATEWAY_CACHE_SIZE)
+/**
+ * Send the cached presentation, sketch info and values of a node (BROADCAST_ADDRESS: all nodes) to the controller,
+ * presentation first (MY_GATEWAY_CACHE_SIZE)
+ * @return false if nothing is cached for the node
+ */
+bool gatewayTransportCacheReplay(uint8_t node);
+#endif
+
 /*
  * Check if a new message is available from controller
  */
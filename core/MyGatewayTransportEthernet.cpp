@@ -28,18 +28,11 @@
 #endif
 byte _ethernetGatewayMAC[] = { MY_MAC_ADDRESS };
 uint16_t _ethernetGatewayPort = MY_PORT;
-MyMessage _ethernetMsg;
 
 #define ARRAY_SIZE(x)  (sizeof(x)/sizeof(x[0]))
 
 // gatewayTransportSend(buildGw(_msg, I_GATEWAY_READY).set("Gateway startup complete."));
 
-typedef struct
-{
-  char string[MY_GATEWAY_MAX_RECEIVE_LENGTH];
-  uint8_t idx;
-} inputBuffer;
-
 #if defined(MY_GATEWAY_ESP8266)
 	// Some re-defines to make code more readable below
 	#define EthernetServer WiFiServer
@@ -60,12 +53,42 @@ typedef struct
 #endif
 
 
+#if !defined(MY_USE_UDP)
+	// client bytes are read in bulk (one SPI transaction / pbuf copy per chunk) and parsed up to the end of the next message
+	#define ETHERNET_RX_CHUNK_SIZE 32
+	typedef struct {
+		uint8_t data[ETHERNET_RX_CHUNK_SIZE];
+		uint8_t pos;
+		uint8_t len;
+	} ethernetRxChunk;
+#endif
+
 #if defined(MY_GATEWAY_ESP8266)
 	static EthernetClient clients[MY_GATEWAY_MAX_CLIENTS];
-	static inputBuffer inputString[MY_GATEWAY_MAX_CLIENTS];
+	// messages are parsed per client as characters arrive
+	static protocolGatewayParser inputParser[MY_GATEWAY_MAX_CLIENTS];
+	static MyMessage inputMsg[MY_GATEWAY_MAX_CLIENTS];
+	static uint8_t inputMsgClient = 0;	// client of last parsed message
+	#if !defined(MY_USE_UDP)
+		static ethernetRxChunk inputChunk[MY_GATEWAY_MAX_CLIENTS];
+	#endif
+	#if defined(MY_GATEWAY_CLIENT_BUFFER_SIZE)
+		// per client output, chunks of formatted messages prefixed by 16 bit length
+		typedef struct {
+			uint8_t data[MY_GATEWAY_CLIENT_BUFFER_SIZE];
+			uint16_t head;		// start of oldest chunk
+			uint16_t count;		// bytes buffered, including length prefixes
+			uint16_t sent;		// bytes of oldest chunk already written
+		} clientBuffer;
+		static clientBuffer clientBuffers[MY_GATEWAY_MAX_CLIENTS];
+	#endif
 #else
 	static EthernetClient client = EthernetClient();
-	static inputBuffer inputString;
+	static protocolGatewayParser inputParser;
+	MyMessage _ethernetMsg;
+	#if !defined(MY_USE_UDP)
+		static ethernetRxChunk inputChunk;
+	#endif
 #endif
 
 
@@ -73,6 +96,23 @@ typedef struct
 	void gatewayTransportRenewIP();
 #endif
 
+#if defined(MY_CONTROLLER_IP_ADDRESS) && !defined(MY_USE_UDP)
+	// persistent connection to controller, messages are held while it is down
+	static EthernetClient _ethernetControllerClient;
+	static unsigned long _ethernetConnectTime;			// time of last failed connect
+	static uint32_t _ethernetConnectBackoff = 0;		// 0 = connect right away
+	static MyMessage _ethernetPending[MY_GATEWAY_PENDING_QUEUE_SIZE];
+	static uint8_t _ethernetPendingHead = 0;
+	static uint8_t _ethernetPendingCount = 0;
+#endif
+
+#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+	// outbound messages are packed into one write/datagram
+	static uint8_t _ethernetTxBuffer[MY_GATEWAY_TX_BUFFER_SIZE];
+	static uint16_t _ethernetTxLength = 0;
+	static unsigned long _ethernetTxTime;	// time first message was buffered
+#endif
+
 // On W5100 boards with SPI_EN exposed we can use the real SPI bus together with radio
 // (if we enable it during usage)
 #ifdef MY_W5100_SPI_EN
@@ -147,33 +187,135 @@ bool gatewayTransportInit() {
 	return true;
 }
 
-bool gatewayTransportSend(MyMessage &message)
-{
-	bool ret = true;
-	char *_ethernetMsg = protocolFormat(message);
+#if defined(MY_CONTROLLER_IP_ADDRESS) && !defined(MY_USE_UDP)
+	// (re)connect to controller, SPI has to be enabled
+	bool _ethernetControllerConnect()
+	{
+		if (_ethernetControllerClient.connected()) {
+			return true;
+		}
+		if (_ethernetConnectBackoff && hwMillis() - _ethernetConnectTime < _ethernetConnectBackoff) {
+			// wait before next attempt
+			return false;
+		}
+		_ethernetControllerClient.stop();
+		#if defined(MY_CONTROLLER_URL_ADDRESS)
+			const bool ok = _ethernetControllerClient.connect(MY_CONTROLLER_URL_ADDRESS, MY_PORT);
+		#else
+			const bool ok = _ethernetControllerClient.connect(_ethernetControllerIP, MY_PORT);
+		#endif
+		if (ok) {
+			debug(PSTR("Eth: controller connected\n"));
+			_ethernetConnectBackoff = 0;
+			// new stream, drop a partial command of the previous connection
+			#if defined(MY_GATEWAY_ESP8266)
+				protocolParseReset(inputParser[0]);
+				inputChunk[0].pos = inputChunk[0].len = 0;
+			#else
+				protocolParseReset(inputParser);
+				inputChunk.pos = inputChunk.len = 0;
+			#endif
+		} else {
+			// exponential backoff
+			_ethernetConnectTime = hwMillis();
+			_ethernetConnectBackoff = _ethernetConnectBackoff ? min(_ethernetConnectBackoff * 2, (uint32_t)MY_GATEWAY_RECONNECT_BACKOFF_MAX_MS) : MY_GATEWAY_RECONNECT_BACKOFF_MS;
+			debug(PSTR("Eth: controller connect failed, retry in %lu ms\n"), _ethernetConnectBackoff);
+		}
+		return ok;
+	}
+#endif
 
-    setIndication(INDICATION_GW_TX);
+#if defined(MY_GATEWAY_ESP8266) && defined(MY_GATEWAY_CLIENT_BUFFER_SIZE)
+	uint16_t _clientBufferChunkLength(clientBuffer &buf)
+	{
+		return buf.data[buf.head] | (buf.data[(buf.head + 1) % MY_GATEWAY_CLIENT_BUFFER_SIZE] << 8);
+	}
 
+	void _clientBufferPop(clientBuffer &buf)
+	{
+		const uint16_t length = _clientBufferChunkLength(buf) + 2;
+		buf.head = (buf.head + length) % MY_GATEWAY_CLIENT_BUFFER_SIZE;
+		buf.count -= length;
+		buf.sent = 0;
+	}
+
+	// queue chunk for client, returns false if client has to be disconnected
+	bool _clientBufferWrite(uint8_t i, const uint8_t *data, uint16_t length)
+	{
+		clientBuffer &buf = clientBuffers[i];
+		const uint16_t needed = length + 2;
+		while (MY_GATEWAY_CLIENT_BUFFER_SIZE - buf.count < needed) {
+			#if defined(MY_GATEWAY_CLIENT_DISCONNECT_SLOW)
+				return false;
+			#else
+				if (!buf.count || buf.sent || needed > MY_GATEWAY_CLIENT_BUFFER_SIZE) {
+					// oldest chunk partially written, drop new one
+					debug(PSTR("Client %d overflow, drop\n"), i);
+					return true;
+				}
+				debug(PSTR("Client %d overflow, drop oldest\n"), i);
+				_clientBufferPop(buf);
+			#endif
+		}
+		uint16_t pos = (buf.head + buf.count) % MY_GATEWAY_CLIENT_BUFFER_SIZE;
+		buf.data[pos] = length & 0xFF;
+		pos = (pos + 1) % MY_GATEWAY_CLIENT_BUFFER_SIZE;
+		buf.data[pos] = length >> 8;
+		for (uint16_t j = 0; j < length; j++) {
+			pos = (pos + 1) % MY_GATEWAY_CLIENT_BUFFER_SIZE;
+			buf.data[pos] = data[j];
+		}
+		buf.count += needed;
+		return true;
+	}
+
+	// write buffered output as far as the client accepts it without blocking
+	void _clientBufferDrain(uint8_t i)
+	{
+		clientBuffer &buf = clientBuffers[i];
+		while (buf.count) {
+			const size_t room = clients[i].availableForWrite();
+			if (!room) {
+				return;
+			}
+			const uint16_t length = _clientBufferChunkLength(buf);
+			const uint16_t start = (buf.head + 2 + buf.sent) % MY_GATEWAY_CLIENT_BUFFER_SIZE;
+			// contiguous part of chunk
+			uint16_t n = length - buf.sent;
+			if (n > MY_GATEWAY_CLIENT_BUFFER_SIZE - start) {
+				n = MY_GATEWAY_CLIENT_BUFFER_SIZE - start;
+			}
+			if (n > room) {
+				n = room;
+			}
+			const size_t written = clients[i].write(buf.data + start, n);
+			buf.sent += written;
+			if (buf.sent == length) {
+				_clientBufferPop(buf);
+			} else if (written < n) {
+				return;
+			}
+		}
+	}
+#endif
+
+bool _ethernetWrite(const uint8_t *data, uint16_t length)
+{
+	bool ret = true;
 	_w5100_spi_en(true);
 	#if defined(MY_CONTROLLER_IP_ADDRESS)
 		#if defined(MY_USE_UDP)
 			_ethernetServer.beginPacket(_ethernetControllerIP, MY_PORT);
-			_ethernetServer.write(_ethernetMsg, strlen(_ethernetMsg));
+			_ethernetServer.write(data, length);
 			// returns 1 if the packet was sent successfully
 			ret = _ethernetServer.endPacket();
 		#else
-			EthernetClient client;
-			#if defined(MY_CONTROLLER_URL_ADDRESS)
-	                	if (client.connected() || client.connect(MY_CONTROLLER_URL_ADDRESS, MY_PORT)) {
-	        	#else
-	                	if (client.connected() || client.connect(_ethernetControllerIP, MY_PORT)) {
-	        	#endif
-	                	client.write(_ethernetMsg, strlen(_ethernetMsg));
-	                }
-	                else {
-	                	// connecting to the server failed!
-	                	ret = false;
-	                }
+			if (_ethernetControllerConnect()) {
+				ret = _ethernetControllerClient.write(data, length) == length;
+			} else {
+				// connecting to the server failed!
+				ret = false;
+			}
 		#endif
 	#else
 		// Send message to connected clients
@@ -182,82 +324,180 @@ bool gatewayTransportSend(MyMessage &message)
 			{
 				if (clients[i] && clients[i].connected())
 				{
-					clients[i].write((uint8_t*)_ethernetMsg, strlen(_ethernetMsg));
+					#if defined(MY_GATEWAY_CLIENT_BUFFER_SIZE)
+						// formatted once, queued for every client
+						if (_clientBufferWrite(i, data, length)) {
+							_clientBufferDrain(i);
+						} else {
+							debug(PSTR("Client %d too slow, disconnect\n"), i);
+							clients[i].stop();
+						}
+					#else
+						clients[i].write(data, length);
+					#endif
 				}
 			}
 		#else
-			_ethernetServer.write(_ethernetMsg);
+			_ethernetServer.write(data, length);
 		#endif
 	#endif
 	_w5100_spi_en(false);
 	return ret;
+}
 
+bool gatewayTransportFlush()
+{
+	bool ok = true;
+	#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+		if (_ethernetTxLength) {
+			ok = _ethernetWrite(_ethernetTxBuffer, _ethernetTxLength);
+			_ethernetTxLength = 0;
+		}
+	#endif
+	return ok;
 }
 
+bool _ethernetSend(MyMessage &message)
+{
+	uint8_t length;
+	uint8_t *_ethernetMsg = protocolFormatGateway(message, length);
 
-#if defined(MY_GATEWAY_ESP8266)
-	bool _readFromClient(uint8_t i) {
-		while (clients[i].connected() && clients[i].available()) {
-			char inChar = clients[i].read();
-			if (inputString[i].idx < MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
-				// if newline then command is complete
-				if (inChar == '\n' || inChar == '\r') {
-					// Add string terminator and prepare for the next message
-					inputString[i].string[inputString[i].idx] = 0;
-					debug(PSTR("Client %d: %s\n"), i, inputString[i].string);
-					inputString[i].idx = 0;
-					if (protocolParse(_ethernetMsg, inputString[i].string)) {
-						return true;
-					}
+	#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+		if (_ethernetTxLength + length > MY_GATEWAY_TX_BUFFER_SIZE && !gatewayTransportFlush()) {
+			// link down, the caller holds the message
+			return false;
+		}
+		if (length > MY_GATEWAY_TX_BUFFER_SIZE) {
+			return _ethernetWrite(_ethernetMsg, length);
+		}
+		if (!_ethernetTxLength) {
+			_ethernetTxTime = hwMillis();
+		}
+		memcpy(_ethernetTxBuffer + _ethernetTxLength, _ethernetMsg, length);
+		_ethernetTxLength += length;
+		// delivery is reported when written
+		return true;
+	#else
+		return _ethernetWrite(_ethernetMsg, length);
+	#endif
+}
 
-				} else {
-					// add it to the inputString:
-					inputString[i].string[inputString[i].idx++] = inChar;
-				}
-			} else {
-				// Incoming message too long. Throw away
-				debug(PSTR("Client %d: Message too long\n"), i);
-				inputString[i].idx = 0;
-				// Finished with this client's message. Next loop() we'll see if there's more to read.
-				break;
+#if defined(MY_CONTROLLER_IP_ADDRESS) && !defined(MY_USE_UDP)
+	// send held messages, returns true if controller is connected
+	bool _ethernetSendPending()
+	{
+		_w5100_spi_en(true);
+		bool connected = _ethernetControllerConnect();
+		_w5100_spi_en(false);
+		while (connected && _ethernetPendingCount) {
+			connected = _ethernetSend(_ethernetPending[_ethernetPendingHead]);
+			if (connected) {
+				_ethernetPendingHead = (_ethernetPendingHead + 1) % MY_GATEWAY_PENDING_QUEUE_SIZE;
+				_ethernetPendingCount--;
 			}
 		}
-		return false;
+		return connected;
 	}
-#else
-	bool _readFromClient() {
-		while (client.connected() && client.available()) {
-			char inChar = client.read();
-			if (inputString.idx < MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
-				// if newline then command is complete
-				if (inChar == '\n' || inChar == '\r') {
-					// Add string terminator and prepare for the next message
-					inputString.string[inputString.idx] = 0;
-					debug(PSTR("Eth: %s\n"), inputString.string);
-					inputString.idx = 0;
-					if (protocolParse(_ethernetMsg, inputString.string)) {
-						return true;
-					}
+#endif
 
-				} else {
-					// add it to the inputString:
-					inputString.string[inputString.idx++] = inChar;
+bool gatewayTransportSend(MyMessage &message)
+{
+    setIndication(INDICATION_GW_TX);
+	#if defined(MY_CONTROLLER_IP_ADDRESS) && !defined(MY_USE_UDP)
+		if (!_ethernetSendPending()) {
+			// controller not reachable, hold message
+			if (_ethernetPendingCount == MY_GATEWAY_PENDING_QUEUE_SIZE) {
+				return false;
+			}
+			_ethernetPending[(_ethernetPendingHead + _ethernetPendingCount) % MY_GATEWAY_PENDING_QUEUE_SIZE] = message;
+			_ethernetPendingCount++;
+			return true;
+		}
+	#endif
+	return _ethernetSend(message);
+}
+
+
+#if !defined(MY_USE_UDP)
+	// true once a message is complete, the rest of the chunk is kept for the next call
+	static bool _readFromChunk(EthernetClient &c, ethernetRxChunk &chunk, protocolGatewayParser &parser, MyMessage &message) {
+		for (;;) {
+			while (chunk.pos < chunk.len) {
+				if (protocolParseChar(parser, message, chunk.data[chunk.pos++])) return true;
+			}
+			if (!c.connected() || !c.available()) return false;
+			const int len = c.read(chunk.data, sizeof(chunk.data));
+			if (len <= 0) return false;
+			chunk.pos = 0;
+			chunk.len = len;
+		}
+	}
+
+	#if defined(MY_CONTROLLER_IP_ADDRESS)
+		// commands from the controller arrive on the persistent connection
+		bool _readFromController() {
+			#if defined(MY_GATEWAY_ESP8266)
+				inputMsgClient = 0;
+				return _readFromChunk(_ethernetControllerClient, inputChunk[0], inputParser[0], inputMsg[0]);
+			#else
+				return _readFromChunk(_ethernetControllerClient, inputChunk, inputParser, _ethernetMsg);
+			#endif
+		}
+	#elif defined(MY_GATEWAY_ESP8266)
+		bool _readFromClient(uint8_t i) {
+			if (_readFromChunk(clients[i], inputChunk[i], inputParser[i], inputMsg[i])) {
+				debug(PSTR("Client %d: message\n"), i);
+				inputMsgClient = i;
+				return true;
+			}
+			return false;
+		}
+	#else
+		bool _readFromClient() {
+			if (_readFromChunk(client, inputChunk, inputParser, _ethernetMsg)) {
+				debug(PSTR("Eth: message\n"));
+				return true;
+			}
+			return false;
+		}
+	#endif
+#endif
+
+#if defined(MY_USE_UDP)
+	// datagram carries one message, read in chunks
+	bool _readFromPacket(protocolGatewayParser &parser, MyMessage &message) {
+		char chunk[16];
+		int len;
+		protocolParseReset(parser);
+		while ((len = _ethernetServer.read(chunk, sizeof(chunk))) > 0) {
+			for (int i = 0; i < len; i++) {
+				if (protocolParseChar(parser, message, chunk[i])) {
+					return true;
 				}
-			} else {
-				// Incoming message too long. Throw away
-				debug(PSTR("Eth: Message too long\n"));
-				inputString.idx = 0;
-				// Finished with this client's message. Next loop() we'll see if there's more to read.
-				break;
 			}
 		}
-		return false;
+		#if defined(MY_GATEWAY_BINARY_PROTOCOL)
+			return false;
+		#else
+			// datagram without line terminator
+			return protocolParseChar(parser, message, '\n');
+		#endif
 	}
 #endif
 
 
 bool gatewayTransportAvailable()
 {
+	#if defined(MY_CONTROLLER_IP_ADDRESS) && !defined(MY_USE_UDP)
+		if (_ethernetPendingCount) {
+			(void)_ethernetSendPending();
+		}
+	#endif
+	#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+		if (_ethernetTxLength && hwMillis() - _ethernetTxTime >= MY_GATEWAY_TX_BUFFER_TIMEOUT_MS && !gatewayTransportFlush()) {
+			debug(PSTR("Eth: write failed\n"));
+		}
+	#endif
 	_w5100_spi_en(true);
 	#if !defined(MY_IP_ADDRESS) && defined(MY_GATEWAY_W5100)
 		// renew IP address using DHCP
@@ -266,26 +506,31 @@ bool gatewayTransportAvailable()
 
 	#ifdef MY_USE_UDP
 
-		int packet_size = _ethernetServer.parsePacket();
-
-		if (packet_size) {
-			//debug(PSTR("UDP packet available. Size:%d\n"), packet_size);
+		// datagrams without a valid message do not end the call, the next one queued is read
+		int packet_size;
+		while ((packet_size = _ethernetServer.parsePacket()) > 0) {
             setIndication(INDICATION_GW_RX);
+			debug(PSTR("UDP packet received, size=%d\n"), packet_size);
 			#if defined(MY_GATEWAY_ESP8266)
-				_ethernetServer.read(inputString[0].string, MY_GATEWAY_MAX_RECEIVE_LENGTH);
-				inputString[0].string[packet_size] = 0;
-				debug(PSTR("UDP packet received: %s\n"), inputString[0].string);
-				return protocolParse(_ethernetMsg, inputString[0].string);
+				inputMsgClient = 0;
+				if (_readFromPacket(inputParser[0], inputMsg[0])) return true;
 			#else
-				_ethernetServer.read(inputString.string, MY_GATEWAY_MAX_RECEIVE_LENGTH);
-				inputString.string[packet_size] = 0;
-				debug(PSTR("UDP packet received: %s\n"), inputString.string);
-				_w5100_spi_en(false);
-				return protocolParse(_ethernetMsg, inputString.string);
+				if (_readFromPacket(inputParser, _ethernetMsg)) {
+					_w5100_spi_en(false);
+					return true;
+				}
 			#endif
 		}
 	#else
-		#if defined(MY_GATEWAY_ESP8266)
+		#if defined(MY_CONTROLLER_IP_ADDRESS)
+			// client mode, output only goes to the controller connection, see _ethernetWrite()
+			if (_ethernetControllerConnect() && _readFromController()) {
+				debug(PSTR("Eth: message\n"));
+				setIndication(INDICATION_GW_RX);
+				_w5100_spi_en(false);
+				return true;
+			}
+		#elif defined(MY_GATEWAY_ESP8266)
 			// ESP8266: Go over list of clients and stop any that are no longer connected.
 			// If the server has a new client connection it will be assigned to a free slot.
 			bool allSlotsOccupied = true;
@@ -298,16 +543,28 @@ bool gatewayTransportAvailable()
 					//check if there are any new clients
 					if (_ethernetServer.hasClient()) {
 						clients[i] = _ethernetServer.available();
-						inputString[i].idx = 0;
+						protocolParseReset(inputParser[i]);
+						inputChunk[i].pos = inputChunk[i].len = 0;
+						#if defined(MY_GATEWAY_CLIENT_BUFFER_SIZE)
+							memset(&clientBuffers[i], 0, sizeof(clientBuffer));
+						#endif
 						debug(PSTR("Client %d connected\n"), i);
 						gatewayTransportSend(buildGw(_msg, I_GATEWAY_READY).set("Gateway startup complete."));
 						if (presentation)
 							presentation();
+						#if defined(MY_GATEWAY_CACHE_SIZE)
+							(void)gatewayTransportCacheReplay(BROADCAST_ADDRESS);
+						#endif
 					}
 				}
 				bool connected = clients[i].connected();
 				clientsConnected[i] = connected;
 				allSlotsOccupied &= connected;
+				#if defined(MY_GATEWAY_CLIENT_BUFFER_SIZE)
+					if (connected) {
+						_clientBufferDrain(i);
+					}
+				#endif
 			}
 			if (allSlotsOccupied && _ethernetServer.hasClient()) {
 				//no free/disconnected spot so reject
@@ -331,12 +588,17 @@ bool gatewayTransportAvailable()
 				if (client != newclient) {
 					client.stop();
 					client = newclient;
+					protocolParseReset(inputParser);
+					inputChunk.pos = inputChunk.len = 0;
 					debug(PSTR("Eth: connect\n"));
 					_w5100_spi_en(false);
 					gatewayTransportSend(buildGw(_msg, I_GATEWAY_READY).set("Gateway startup complete."));
 					_w5100_spi_en(true);
 					if (presentation)
 						presentation();
+					#if defined(MY_GATEWAY_CACHE_SIZE)
+						(void)gatewayTransportCacheReplay(BROADCAST_ADDRESS);
+					#endif
 				}
 			}
 			if (client) {
@@ -360,7 +622,11 @@ bool gatewayTransportAvailable()
 MyMessage& gatewayTransportReceive()
 {
 	// Return the last parsed message
-	return _ethernetMsg;
+	#if defined(MY_GATEWAY_ESP8266)
+		return inputMsg[inputMsgClient];
+	#else
+		return _ethernetMsg;
+	#endif
 }
 
 
@@ -19,6 +19,8 @@
 
 
 // Topic structure: MY_MQTT_PUBLISH_TOPIC_PREFIX/NODE-ID/SENSOR-ID/CMD-TYPE/ACK-FLAG/SUB-TYPE
+// With MY_GATEWAY_BINARY_PROTOCOL binary frames are published to MY_MQTT_PUBLISH_TOPIC_PREFIX
+// and received on MY_MQTT_SUBSCRIBE_TOPIC_PREFIX
 
 
 #if defined MY_CONTROLLER_IP_ADDRESS
@@ -45,96 +47,221 @@ static bool _MQTT_connecting = true;
 static bool _MQTT_available = false;
 static MyMessage _MQTT_msg;
 
-uint8_t protocolH2i(char c) {
-	uint8_t i = 0;
-	if (c <= '9')
-		i += c - '0';
-	else if (c >= 'a')
-		i += c - 'a' + 10;
-	else
-		i += c - 'A' + 10;
-	return i;
+#if defined(MY_MQTT_QOS1)
+	#define MQTT_SUBSCRIBE_QOS 1
+#else
+	#define MQTT_SUBSCRIBE_QOS 0
+#endif
+
+// length of subscribe prefix, known at compile time
+#define MQTT_SUBSCRIBE_PREFIX_LENGTH (sizeof(MY_MQTT_SUBSCRIBE_TOPIC_PREFIX) - 1)
+
+
+#if !defined(MY_GATEWAY_BINARY_PROTOCOL)
+	// prefix is kept in buffer, only the fields are formatted
+	static char _MQTT_topic[MY_GATEWAY_MAX_SEND_LENGTH] = MY_MQTT_PUBLISH_TOPIC_PREFIX;
+	#define MQTT_TOPIC_PREFIX_LENGTH (sizeof(MY_MQTT_PUBLISH_TOPIC_PREFIX) - 1)
+
+	char *_MQTT_topicField(char *pos, uint8_t value) {
+		*pos++ = '/';
+		if (value >= 100)
+			*pos++ = '0' + value / 100;
+		if (value >= 10)
+			*pos++ = '0' + (value / 10) % 10;
+		*pos++ = '0' + value % 10;
+		return pos;
+	}
+
+	// topic level "n", 0..255
+	bool _MQTT_topicNumber(const MQTTSegment &segment, uint8_t &value) {
+		if (!segment.length) {
+			return false;
+		}
+		// wider than the field, "/300" must not wrap to node 44
+		uint16_t number = 0;
+		for (uint16_t i = 0; i < segment.length; i++) {
+			if (segment.str[i] < '0' || segment.str[i] > '9') {
+				return false;
+			}
+			number = number * 10 + (segment.str[i] - '0');
+			if (number > 0xFF) {
+				return false;
+			}
+		}
+		value = (uint8_t)number;
+		return true;
+	}
+#endif
+
+#if defined(MY_MQTT_SUBSCRIBE_PER_NODE) && !defined(MY_GATEWAY_BINARY_PROTOCOL)
+	// broker only forwards topics of nodes we know
+	static uint8_t _MQTT_subscribed[32];		// bit per node
+
+	#if defined(MY_RADIO_FEATURE)
+		extern uint8_t transportGetRoutingTable(uint8_t node);
+	#endif
+
+	void _MQTT_subscribeNode(uint8_t node) {
+		char topic[MQTT_SUBSCRIBE_PREFIX_LENGTH + 13] = MY_MQTT_SUBSCRIBE_TOPIC_PREFIX;
+		char *pos = _MQTT_topicField(topic + MQTT_SUBSCRIBE_PREFIX_LENGTH, node);
+		memcpy(pos, "/+/+/+/+", 9);
+		if (_MQTT_client.subscribe(topic, MQTT_SUBSCRIBE_QOS)) {
+			_MQTT_subscribed[node >> 3] |= 1 << (node & 7);
+		}
+	}
+#endif
+
+#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+	static bool _MQTT_txPending = false;
+	static unsigned long _MQTT_txTime;		// time of first buffered publish
+#endif
+
+#if defined(MY_MQTT_QOS1)
+	// published messages waiting for PUBACK
+	typedef struct {
+		MyMessage message;
+		unsigned long sent;
+		uint16_t msgId;		// 0 = free slot
+	} MQTTInflight;
+	static MQTTInflight _MQTT_inflight[MY_MQTT_INFLIGHT_WINDOW];
+#endif
+
+// msgId 0 publishes with QoS 0
+bool _MQTT_publish(MyMessage &message, uint16_t msgId, bool dup) {
+	#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+		if (!_MQTT_txPending) {
+			_MQTT_txPending = true;
+			_MQTT_txTime = hwMillis();
+		}
+	#endif
+#if defined(MY_GATEWAY_BINARY_PROTOCOL)
+	uint8_t length;
+	uint8_t *frame = protocolFormatGateway(message, length);
+	return _MQTT_client.publish(MY_MQTT_PUBLISH_TOPIC_PREFIX, frame, length, false, msgId ? 1 : 0, msgId, dup);
+#else
+	char *pos = _MQTT_topic + MQTT_TOPIC_PREFIX_LENGTH;
+	pos = _MQTT_topicField(pos, message.sender);
+	pos = _MQTT_topicField(pos, message.sensor);
+	pos = _MQTT_topicField(pos, mGetCommand(message));
+	pos = _MQTT_topicField(pos, mGetAck(message));
+	pos = _MQTT_topicField(pos, message.type);
+	*pos = 0;
+	debug(PSTR("Sending message on topic: %s\n"), _MQTT_topic);
+	const char *payload = message.getString(_convBuffer);
+	return _MQTT_client.publish(_MQTT_topic, (const uint8_t *)payload, strlen(payload), false, msgId ? 1 : 0, msgId, dup);
+#endif
 }
 
+#if defined(MY_MQTT_QOS1)
+	void _MQTT_ack(uint16_t msgId) {
+		for (uint8_t i = 0; i < MY_MQTT_INFLIGHT_WINDOW; i++) {
+			if (_MQTT_inflight[i].msgId == msgId) {
+				_MQTT_inflight[i].msgId = 0;
+			}
+		}
+	}
+
+	// republish messages not acknowledged in time, all of them after reconnect
+	void _MQTT_retry(bool reconnected) {
+		const unsigned long now = hwMillis();
+		for (uint8_t i = 0; i < MY_MQTT_INFLIGHT_WINDOW; i++) {
+			MQTTInflight &slot = _MQTT_inflight[i];
+			if (!slot.msgId) {
+				continue;
+			}
+			if (reconnected) {
+				// ids restart with a new session
+				slot.msgId = _MQTT_client.newMessageId();
+			} else if (now - slot.sent < MY_MQTT_RETRY_TIMEOUT_MS) {
+				continue;
+			}
+			if (_MQTT_publish(slot.message, slot.msgId, !reconnected)) {
+				slot.sent = now;
+			}
+		}
+	}
+#endif
 
 bool gatewayTransportSend(MyMessage &message) {
 	if (!_MQTT_client.connected())
 		return false;
 	setIndication(INDICATION_GW_TX);
-	char _fmtBuffer[MY_GATEWAY_MAX_SEND_LENGTH];
-	char _convBuffer[MAX_PAYLOAD * 2 + 1];
-	snprintf_P(_fmtBuffer, MY_GATEWAY_MAX_SEND_LENGTH, PSTR(MY_MQTT_PUBLISH_TOPIC_PREFIX "/%d/%d/%d/%d/%d"), message.sender, message.sensor, mGetCommand(message), mGetAck(message), message.type);
-	debug(PSTR("Sending message on topic: %s\n"), _fmtBuffer);
-	return _MQTT_client.publish(_fmtBuffer, message.getString(_convBuffer));
+#if defined(MY_MQTT_SUBSCRIBE_PER_NODE) && !defined(MY_GATEWAY_BINARY_PROTOCOL)
+	if (!(_MQTT_subscribed[message.sender >> 3] & (1 << (message.sender & 7)))) {
+		// first message of a new node
+		_MQTT_subscribeNode(message.sender);
+	}
+#endif
+#if defined(MY_MQTT_QOS1)
+	for (uint8_t i = 0; i < MY_MQTT_INFLIGHT_WINDOW; i++) {
+		MQTTInflight &slot = _MQTT_inflight[i];
+		if (!slot.msgId) {
+			slot.message = message;
+			slot.msgId = _MQTT_client.newMessageId();
+			slot.sent = hwMillis();
+			if (!_MQTT_publish(slot.message, slot.msgId, false)) {
+				slot.msgId = 0;
+				return false;
+			}
+			return true;
+		}
+	}
+	debug(PSTR("MQTT in-flight window full\n"));
+	return false;
+#else
+	return _MQTT_publish(message, 0, false);
+#endif
 }
 
+bool gatewayTransportFlush() {
+	#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+		_MQTT_txPending = false;
+		return _MQTT_client.flush();
+	#else
+		return true;
+	#endif
+}
+
+#if defined(MY_GATEWAY_BINARY_PROTOCOL)
 void incomingMQTT(char* topic, byte* payload, unsigned int length) {
 	debug(PSTR("Message arrived on topic: %s\n"), topic);
-	char *str, *p;
-	uint8_t i = 0;
-	uint8_t bvalue[MAX_PAYLOAD];
-	uint8_t blen = 0;
-	uint8_t command = 0;
-	for (str = strtok_r(topic, "/", &p); str && i <= 5;
-		str = strtok_r(NULL, "/", &p)) {
-		switch (i) {
-		case 0: {
-			// Topic prefix
-			if (strcmp(str, MY_MQTT_SUBSCRIBE_TOPIC_PREFIX) != 0) {
-				// Message not for us or malformed!
-				return;
-			}
-			break;
-		}
-		case 1: {
-			// Node id
-			_MQTT_msg.destination = atoi(str);
-			break;
-		}
-		case 2: {
-			// Sensor id
-			_MQTT_msg.sensor = atoi(str);
-			break;
-		}
-		case 3: {
-			// Command type
-			command = atoi(str);
-			mSetCommand(_MQTT_msg, command);
-			break;
-		}
-		case 4: {
-			// Ack flag
-			mSetRequestAck(_MQTT_msg, atoi(str) ? 1 : 0);
-			break;
-		}
-		case 5: {
-			// Sub type
-			_MQTT_msg.type = atoi(str);
-			// Add payload
-			if (command == C_STREAM) {
-				blen = 0;
-				uint8_t val;
-				while (*payload) {
-					val = protocolH2i(*payload++) << 4;
-					val += protocolH2i(*payload++);
-					bvalue[blen] = val;
-					blen++;
-				}
-				_MQTT_msg.set(bvalue, blen);
-			}
-			else {
-				char* ca;
-				ca = (char *)payload;
-				ca += length;
-				*ca = '\0';
-				_MQTT_msg.set((const char*)payload);
-			}
+	if (strcmp(topic, MY_MQTT_SUBSCRIBE_TOPIC_PREFIX) != 0) {
+		return;
+	}
+	// payload carries one frame
+	protocolBinaryParser parser;
+	protocolParseReset(parser);
+	for (unsigned int i = 0; i < length; i++) {
+		if (protocolParseChar(parser, _MQTT_msg, (char)payload[i])) {
 			_MQTT_available = true;
+			return;
 		}
+	}
+}
+#else
+void incomingMQTT(char* topic, const MQTTSegment* segment, uint8_t count, byte* payload, unsigned int length) {
+	debug(PSTR("Message arrived on topic: %s\n"), topic);
+	// Topic prefix, the last five levels are the fields
+	if (count < 6 || memcmp(topic, MY_MQTT_SUBSCRIBE_TOPIC_PREFIX, MQTT_SUBSCRIBE_PREFIX_LENGTH) != 0 ||
+		segment[count - 5].str != topic + MQTT_SUBSCRIBE_PREFIX_LENGTH + 1) {
+		// Message not for us or malformed!
+		return;
+	}
+	segment += count - 5;
+	uint8_t field[5];
+	for (uint8_t i = 0; i < 5; i++) {
+		if (!_MQTT_topicNumber(segment[i], field[i])) {
+			return;
 		}
-		i++;
 	}
+	_MQTT_msg.destination = field[0];
+	_MQTT_msg.sensor = field[1];
+	mSetCommand(_MQTT_msg, field[2]);
+	mSetRequestAck(_MQTT_msg, field[3]?1:0);
+	_MQTT_msg.type = field[4];
+	_MQTT_available = protocolParsePayload(_MQTT_msg, (char *)payload, length);
 }
+#endif
 
 
 bool reconnectMQTT() {
@@ -149,7 +276,28 @@ bool reconnectMQTT() {
 		// Once connected, publish an announcement...
 		//_MQTT_client.publish("outTopic","hello world");
 		// ... and resubscribe
-		_MQTT_client.subscribe(MY_MQTT_SUBSCRIBE_TOPIC_PREFIX "/+/+/+/+/+");
+		#if defined(MY_GATEWAY_BINARY_PROTOCOL)
+			_MQTT_client.subscribe(MY_MQTT_SUBSCRIBE_TOPIC_PREFIX, MQTT_SUBSCRIBE_QOS);
+		#elif defined(MY_MQTT_SUBSCRIBE_PER_NODE)
+			memset(_MQTT_subscribed, 0, sizeof(_MQTT_subscribed));
+			_MQTT_subscribeNode(GATEWAY_ADDRESS);
+			_MQTT_subscribeNode(BROADCAST_ADDRESS);
+			#if defined(MY_RADIO_FEATURE)
+				for (uint16_t node = 1; node < BROADCAST_ADDRESS; node++) {
+					if (transportGetRoutingTable(node) != BROADCAST_ADDRESS) {
+						_MQTT_subscribeNode(node);
+					}
+				}
+			#endif
+		#else
+			_MQTT_client.subscribe(MY_MQTT_SUBSCRIBE_TOPIC_PREFIX "/+/+/+/+/+", MQTT_SUBSCRIBE_QOS);
+		#endif
+		#if defined(MY_MQTT_QOS1)
+			_MQTT_retry(true);
+		#endif
+		#if defined(MY_GATEWAY_CACHE_SIZE)
+			(void)gatewayTransportCacheReplay(BROADCAST_ADDRESS);
+		#endif
 		return true;
 	}
 	return false;
@@ -190,7 +338,14 @@ bool gatewayTransportInit() {
 		_MQTT_client.setServer(MY_CONTROLLER_URL_ADDRESS, MY_PORT);
 	#endif
 
+	#if defined(MY_GATEWAY_BINARY_PROTOCOL)
 		_MQTT_client.setCallback(incomingMQTT);
+	#else
+		_MQTT_client.setSegmentCallback(incomingMQTT);
+	#endif
+	#if defined(MY_MQTT_QOS1)
+		_MQTT_client.setAckCallback(_MQTT_ack);
+	#endif
 
 	#if defined(MY_GATEWAY_ESP8266)
 		// Turn off access point
@@ -226,6 +381,14 @@ bool gatewayTransportAvailable() {
 		return false;
 	}
 	_MQTT_client.loop();
+	#if defined(MY_MQTT_QOS1)
+		_MQTT_retry(false);
+	#endif
+	#if defined(MY_GATEWAY_TX_BUFFER_SIZE)
+		if (_MQTT_txPending && hwMillis() - _MQTT_txTime >= MY_GATEWAY_TX_BUFFER_TIMEOUT_MS) {
+			gatewayTransportFlush();
+		}
+	#endif
 	return _MQTT_available;
 }
 
@@ -25,18 +25,75 @@
 #include "MyProtocol.h"
 
 
-char _serialInputString[MY_GATEWAY_MAX_RECEIVE_LENGTH];    // A buffer for incoming commands from serial interface
-int _serialInputPos;
+protocolGatewayParser _serialParser;
 MyMessage _serialMsg;
 
+#if defined(MY_GATEWAY_SERIAL_TX_BUFFER_SIZE)
+	#if MY_GATEWAY_SERIAL_TX_BUFFER_SIZE < MY_GATEWAY_MAX_SEND_LENGTH
+		#error MY_GATEWAY_SERIAL_TX_BUFFER_SIZE must hold a message of MY_GATEWAY_MAX_SEND_LENGTH
+	#endif
+	// output waiting for room in the transmit buffer of the serial device
+	static uint8_t _serialTxBuffer[MY_GATEWAY_SERIAL_TX_BUFFER_SIZE];
+	static uint16_t _serialTxHead = 0;		// next byte to write
+	static uint16_t _serialTxCount = 0;
+
+	// write without blocking as much as the device takes, everything if wait is set
+	static void _serialTxDrain(bool wait) {
+		while (_serialTxCount) {
+			// contiguous part, one bulk write (USB packet) each
+			uint16_t len = min(_serialTxCount, (uint16_t)(MY_GATEWAY_SERIAL_TX_BUFFER_SIZE - _serialTxHead));
+			if (!wait) {
+				const int room = MY_SERIALDEVICE.availableForWrite();
+				if (room <= 0) return;
+				len = min(len, (uint16_t)room);
+			}
+			len = MY_SERIALDEVICE.write(&_serialTxBuffer[_serialTxHead], len);
+			if (!len) return;
+			_serialTxHead = (_serialTxHead + len) % MY_GATEWAY_SERIAL_TX_BUFFER_SIZE;
+			_serialTxCount -= len;
+		}
+	}
+#endif
+
 
 bool gatewayTransportSend(MyMessage &message) {
     setIndication(INDICATION_GW_TX);
-	MY_SERIALDEVICE.print(protocolFormat(message));
+	uint8_t length;
+	uint8_t *data = protocolFormatGateway(message, length);
+#if defined(MY_GATEWAY_SERIAL_TX_BUFFER_SIZE)
+	if (length > MY_GATEWAY_SERIAL_TX_BUFFER_SIZE - _serialTxCount) {
+		#if defined(MY_GATEWAY_SERIAL_TX_DROP)
+			// messages are never cut
+			return false;
+		#else
+			_serialTxDrain(true);
+			if (_serialTxCount) return false;
+		#endif
+	}
+	uint16_t tail = (_serialTxHead + _serialTxCount) % MY_GATEWAY_SERIAL_TX_BUFFER_SIZE;
+	for (uint8_t i = 0; i < length; i++) {
+		_serialTxBuffer[tail] = data[i];
+		tail = (tail + 1) % MY_GATEWAY_SERIAL_TX_BUFFER_SIZE;
+	}
+	_serialTxCount += length;
+	_serialTxDrain(false);
+#else
+	MY_SERIALDEVICE.write(data, length);
+#endif
 	// Serial print is always successful
 	return true;
 }
 
+bool gatewayTransportFlush() {
+#if defined(MY_GATEWAY_SERIAL_TX_BUFFER_SIZE)
+	_serialTxDrain(true);
+	return !_serialTxCount;
+#else
+	// Serial is not buffered
+	return true;
+#endif
+}
+
 bool gatewayTransportInit() {
 	gatewayTransportSend(buildGw(_msg, I_GATEWAY_READY).set("Gateway startup complete."));
 	return true;
@@ -44,25 +101,14 @@ bool gatewayTransportInit() {
 
 
 bool gatewayTransportAvailable() {
+#if defined(MY_GATEWAY_SERIAL_TX_BUFFER_SIZE)
+	// called from every _process()
+	_serialTxDrain(false);
+#endif
 	while (MY_SERIALDEVICE.available()) {
-		// get the new byte:
-		char inChar = (char) MY_SERIALDEVICE.read();
-		// if the incoming character is a newline, set a flag
-		// so the main loop can do something about it:
-		if (_serialInputPos < MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
-			if (inChar == '\n') {
-				_serialInputString[_serialInputPos] = 0;
-				bool ok = protocolParse(_serialMsg, _serialInputString);
-				_serialInputPos = 0;
-				return ok;
-			} else {
-				// add it to the inputString:
-				_serialInputString[_serialInputPos] = inChar;
-				_serialInputPos++;
-			}
-		} else {
-			// Incoming message too long. Throw away
-			_serialInputPos = 0;
+		// message is built as characters arrive
+		if (protocolParseChar(_serialParser, _serialMsg, (char) MY_SERIALDEVICE.read())) {
+			return true;
 		}
 	}
 	return false;
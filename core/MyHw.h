@@ -35,16 +35,25 @@
 #define hwWatchdogReset() wdt_reset()
 #define hwReboot() wdt_enable(WDTO_15MS); while (1)
 #define hwMillis() millis()
+#define hwMicros() micros()
 
 void hwReadConfigBlock(void* buf, void* adr, size_t length);
 void hwWriteConfigBlock(void* buf, void* adr, size_t length);
 void hwWriteConfig(int adr, uint8_t value);
 uint8_t hwReadConfig(int adr);
+void hwConfigFlush();	// commit deferred config writes, no-op where writes are immediate
 */
 
 int8_t hwSleep(unsigned long ms);
 int8_t hwSleep(uint8_t interrupt, uint8_t mode, unsigned long ms);
 int8_t hwSleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mode2, unsigned long ms);
+uint32_t hwSleptMillis();	// total ms spent in hwSleep() that hwMillis() did not count
+void hwRandomInit();	// start the hardware entropy source
+bool hwRandomBytes(uint8_t *buffer, uint8_t length);	// fill buffer with hardware entropy, false (nothing taken) if there is none (yet)
+#define HW_ADC_VCC 0xFF		// hwAdcStart() pin to measure the supply voltage, see hwCPUVoltage()
+bool hwAdcStart(uint8_t pin, uint8_t samples);	// average 1-64 conversions of an analog pin in the background, false if a sampling is running
+bool hwAdcReady();	// sampling started by hwAdcStart() has finished
+uint16_t hwAdcRead();	// result of the last sampling, like analogRead() (HW_ADC_VCC: in mV)
 #ifdef MY_DEBUG
 	void hwDebugPrint(const char *fmt, ... );
 #endif
@@ -43,10 +43,58 @@ bool interruptWakeUp()
     return _wokeUpByInterrupt != INVALID_INTERRUPT_NUM;
 }
 
+#if defined(MY_SIGNING_SOFT)
+// entropy pool: jitter of the WDT oscillator against timer1 (system clock), see hwRandomInit()
+static volatile uint8_t _entropyPool[32];
+static volatile uint8_t _entropyCount = 0;	// bytes ready in the pool
+static uint32_t _entropyHash = 0;
+static uint8_t _entropySamples = 0;
+
+static void hwEntropySample() {
+	// Jenkins one-at-a-time hash over 8 timer samples per 4 pool bytes
+	_entropyHash += (uint8_t)TCNT1;
+	_entropyHash += (_entropyHash << 10);
+	_entropyHash ^= (_entropyHash >> 6);
+	if (++_entropySamples < 8) return;
+	_entropySamples = 0;
+	uint32_t value = _entropyHash;
+	value += (value << 3);
+	value ^= (value >> 11);
+	value += (value << 15);
+	for (uint8_t i = 0; i < 4 && _entropyCount < sizeof(_entropyPool); i++) {
+		_entropyPool[_entropyCount++] = value;
+		value >>= 8;
+	}
+}
+#endif
+
+// ADC sampling service: free running conversions, summed in the ADC interrupt, see hwAdcStart()
+static volatile uint16_t _adcSum = 0;
+static volatile uint16_t _adcDiscard = 0;	// conversions left to settle the input
+static volatile uint8_t _adcSamples = 0;	// conversions left to sum, 0: idle
+static uint16_t _adcSettle = 0;		// conversions to discard after a power down
+static uint8_t _adcCount = 0;		// conversions summed, 0: no result
+static uint8_t _adcPin = 0;
+static bool _adcSettled = false;	// sampled since the last power down
+extern uint8_t analog_reference;	// Arduino core, set by analogReference()
+
+ISR (ADC_vect)
+{
+	if (_adcDiscard) {
+		_adcDiscard--;
+		return;
+	}
+	_adcSum += ADC;
+	if (!--_adcSamples) ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+}
+
 // Watchdog Timer interrupt service routine. This routine is required
 // to allow automatic WDIF and WDIE bit clearance in hardware.
 ISR (WDT_vect)
 {
+#if defined(MY_SIGNING_SOFT)
+	hwEntropySample();
+#endif
 }
 
 void hwPowerDown(period_t period) {
@@ -84,23 +132,83 @@ void hwPowerDown(period_t period) {
 	sei();
 	// enable ADC
 	ADCSRA |= (1 << ADEN);
+	// an internal reference was off, settle again and resume a running sampling
+	_adcSettled = false;
+	if (_adcSamples) {
+		_adcDiscard = _adcSettle;
+		ADCSRA |= _BV(ADSC);
+	}
+}
+
+// nominal WDT timeouts in ms (128kHz oscillator), indexed by period_t
+static const uint16_t _wdtPeriodMs[] PROGMEM = { 16, 32, 64, 125, 250, 500, 1000, 2000, 4000, 8000 };
+// real duration of 1024 nominal WDT ms
+static uint16_t _wdtCalibration = 1024;
+// ms spent in power down, millis() does not advance while sleeping
+static uint32_t _sleptMillis = 0;
+
+#if defined(MY_SLEEP_CALIBRATE_WDT)
+static uint8_t _wdtCalibrationCountdown = 0;
+
+static void hwCalibrateWDT() {
+	// time one nominal 64ms WDT period against hwMicros() (system clock), see hwCPUFrequency().
+	// Interrupts stay enabled, timer0 keeps micros() running and the radio IRQ is served
+	uint8_t WDTsave = WDTCSR;
+	cli();
+	wdt_enable(WDTO_60MS);
+	// interrupt before system reset, WDT_vect clears WDIE
+	WDTCSR |= (1 << WDCE) | (1 << WDIE);
+	wdt_reset();
+	sei();
+	const unsigned long start = hwMicros();
+	while (bit_is_set(WDTCSR, WDIE));
+	const unsigned long elapsed = hwMicros() - start;
+	// restore previous WDT settings
+	cli();
+	wdt_reset();
+	WDTCSR |= (1 << WDCE) | (1 << WDE);
+	WDTCSR = WDTsave;
+	sei();
+	// real ms per 1024 nominal ms = elapsed us * 1024 / 64000us
+	const uint16_t calibration = elapsed * 2 / 125;
+	// discard implausible results (oscillator spec is +-10%, allow for temperature)
+	if (calibration > 768 && calibration < 1280) _wdtCalibration = calibration;
 }
+#endif
 
 void hwInternalSleep(unsigned long ms) {
 	// Let serial prints finish (debug, log etc)
     #ifndef MY_DISABLED_SERIAL
         MY_SERIALDEVICE.flush();
     #endif
-	while (!interruptWakeUp() && ms >= 8000) { hwPowerDown(SLEEP_8S); ms -= 8000; }
-	if (!interruptWakeUp() && ms >= 4000)    { hwPowerDown(SLEEP_4S); ms -= 4000; }
-	if (!interruptWakeUp() && ms >= 2000)    { hwPowerDown(SLEEP_2S); ms -= 2000; }
-	if (!interruptWakeUp() && ms >= 1000)    { hwPowerDown(SLEEP_1S); ms -= 1000; }
-	if (!interruptWakeUp() && ms >= 500)     { hwPowerDown(SLEEP_500MS); ms -= 500; }
-	if (!interruptWakeUp() && ms >= 250)     { hwPowerDown(SLEEP_250MS); ms -= 250; }
-	if (!interruptWakeUp() && ms >= 125)     { hwPowerDown(SLEEP_120MS); ms -= 120; }
-	if (!interruptWakeUp() && ms >= 64)      { hwPowerDown(SLEEP_60MS); ms -= 60; }
-	if (!interruptWakeUp() && ms >= 32)      { hwPowerDown(SLEEP_30MS); ms -= 30; }
-	if (!interruptWakeUp() && ms >= 16)      { hwPowerDown(SLEEP_15MS); ms -= 15; }
+	#if defined(MY_SLEEP_CALIBRATE_WDT)
+		if (!_wdtCalibrationCountdown--) {
+			hwCalibrateWDT();
+			_wdtCalibrationCountdown = MY_SLEEP_CALIBRATE_WDT;
+		}
+	#endif
+	// use the longest WDT periods that fit, rounded to real (calibrated) durations
+	for (int8_t period = SLEEP_8S; period >= SLEEP_15MS; period--) {
+		const uint32_t step = ((uint32_t)pgm_read_word(&_wdtPeriodMs[period]) * _wdtCalibration) >> 10;
+		while (!interruptWakeUp() && ms >= step) {
+			hwPowerDown((period_t)period);
+			if (interruptWakeUp()) {
+				// woken somewhere within this period
+				_sleptMillis += step >> 1;
+				return;
+			}
+			_sleptMillis += step;
+			ms -= step;
+		}
+	}
+}
+
+uint32_t hwSleptMillis() {
+	uint32_t ms;
+	cli();
+	ms = _sleptMillis;
+	sei();
+	return ms;
 }
 
 int8_t hwSleep(unsigned long ms) {
@@ -140,24 +248,72 @@ int8_t hwSleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mo
 	return ret;
 }
 
+bool hwAdcStart(uint8_t pin, uint8_t samples) {
+	if (_adcSamples || !samples || samples > 64) return false;
+	uint8_t mux;
+	if (pin == HW_ADC_VCC) {
+		// Vcc against 1.1V Vref
+		#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+			mux = (_BV(REFS0) | _BV(MUX4) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1));
+		#elif defined (__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__)
+			mux = (_BV(MUX5) | _BV(MUX0));
+		#elif defined (__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
+			mux = (_BV(MUX3) | _BV(MUX2));
+		#else
+			mux = (_BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1));
+		#endif
+	} else {
+		// pin and reference as analogRead() / analogReference()
+		#if defined(A0)
+			if (pin >= A0) pin -= A0;
+		#endif
+		#if defined(MUX5) && defined(ADCSRB) && !defined(__AVR_ATtiny24__) && !defined(__AVR_ATtiny44__) && !defined(__AVR_ATtiny84__)
+			ADCSRB = (ADCSRB & ~_BV(MUX5)) | (((pin >> 3) & 0x01) << MUX5);
+		#endif
+		mux = (analog_reference << 6) | (pin & 0x07);
+	}
+	// the bandgap input, a new reference and an internal reference after power down need the settle time,
+	// otherwise one conversion (AVcc reference is always on)
+	const uint8_t refs = _BV(REFS1) | _BV(REFS0);
+	const uint8_t prescaler = ADCSRA & (_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0));
+	_adcSettle = (uint32_t)MY_ADC_VCC_SETTLE_MS * (F_CPU / 1000UL) / (13UL << (prescaler ? prescaler : 1));
+	const bool settle = pin == HW_ADC_VCC || ((ADMUX ^ mux) & refs) || (!_adcSettled && (mux & refs) != _BV(REFS0));
+	ADMUX = mux;
+	_adcPin = pin;
+	_adcCount = samples;
+	_adcSum = 0;
+	_adcDiscard = settle ? _adcSettle : 1;
+	_adcSamples = samples;
+	_adcSettled = true;
+	// free running, clear a pending ADIF
+	ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+	ADCSRA |= _BV(ADEN) | _BV(ADIF) | _BV(ADATE) | _BV(ADIE) | _BV(ADSC);
+	return true;
+}
+
+bool hwAdcReady() {
+	return !_adcSamples;
+}
+
+uint16_t hwAdcRead() {
+	if (!hwAdcReady() || !_adcCount) return 0;
+	if (_adcPin == HW_ADC_VCC) return _adcSum ? (1125300UL * _adcCount) / _adcSum : 0;
+	return (_adcSum + (_adcCount >> 1)) / _adcCount;
+}
+
 uint16_t hwCPUVoltage() {
-	// Measure Vcc against 1.1V Vref 
-	#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-		ADMUX = (_BV(REFS0) | _BV(MUX4) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1));
-	#elif defined (__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__)
-		ADMUX = (_BV(MUX5) | _BV(MUX0));
-	#elif defined (__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
-		ADMUX = (_BV(MUX3) | _BV(MUX2));
-	#else
-		ADMUX = (_BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1));
-	#endif 
-	// Vref settle
-	delay(70); 
-	// Do conversion
-	ADCSRA |= _BV(ADSC);
-	while (bit_is_set(ADCSRA,ADSC));
+	// take a measurement started by hwAdcStart(HW_ADC_VCC, ...), else measure now
+	if (_adcPin != HW_ADC_VCC || !_adcCount) {
+		while (!hwAdcReady());
+		(void)hwAdcStart(HW_ADC_VCC, 1);
+	}
+	// idle (timers and ADC keep running) until done
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	while (!hwAdcReady()) sleep_mode();
 	// return Vcc in mV
-	return (1125300UL) / ADC;
+	const uint16_t result = hwAdcRead();
+	_adcCount = 0;
+	return result;
 }
 
 uint16_t hwCPUFrequency() {
@@ -194,6 +350,37 @@ uint16_t hwFreeMem() {
 	return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval); 
 }
 
+void hwRandomInit() {
+#if defined(MY_SIGNING_SOFT)
+	// watchdog not used by the sketch: WDT interrupt every 16ms fills the pool in the background,
+	// hwPowerDown() restores this mode after sleeping
+	if (WDTCSR & (1 << WDE)) return;
+	cli();
+	wdt_reset();
+	WDTCSR |= (1 << WDCE) | (1 << WDE);
+	WDTCSR = (1 << WDIE);
+	sei();
+#endif
+}
+
+bool hwRandomBytes(uint8_t *buffer, uint8_t length) {
+#if defined(MY_SIGNING_SOFT)
+	bool result = false;
+	cli();
+	if (_entropyCount >= length) {
+		_entropyCount -= length;
+		memcpy(buffer, (const uint8_t*)&_entropyPool[_entropyCount], length);
+		result = true;
+	}
+	sei();
+	return result;
+#else
+	(void)buffer;
+	(void)length;
+	return false;
+#endif
+}
+
 
 
 #ifdef MY_DEBUG
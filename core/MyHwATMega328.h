@@ -56,11 +56,19 @@ do { 																\
 
 // Define these as macros to save valuable space
 
-#define hwDigitalWrite(__pin, __value) (digitalWrite(__pin, __value))
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__) || defined(__AVR_ATmega328P__) || \
+	defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__) || defined(__AVR_ATmega32U4__)
+	// constant pins (CE/CS, RS485 DE, LEDs) compile to a single sbi/cbi, others use digitalWrite()
+	#include "../drivers/AVR/DigitalIO/DigitalPin.h"
+	#define hwDigitalWrite(__pin, __value) (__builtin_constant_p(__pin) ? fastDigitalWrite(__pin, __value) : digitalWrite(__pin, __value))
+#else
+	#define hwDigitalWrite(__pin, __value) (digitalWrite(__pin, __value))
+#endif
 #define hwInit() MY_SERIALDEVICE.begin(MY_BAUD_RATE)
 #define hwWatchdogReset() wdt_reset()
 #define hwReboot() wdt_enable(WDTO_15MS); while (1)
 #define hwMillis() millis()
+#define hwMicros() micros()
 #define hwReadConfig(__pos) (eeprom_read_byte((uint8_t*)(__pos)))
 
 #ifndef eeprom_update_byte
@@ -72,6 +80,8 @@ do { 																\
 //
 #define hwReadConfigBlock(__buf, __pos, __length) (eeprom_read_block((__buf), (void*)(__pos), (__length)))
 #define hwWriteConfigBlock(__pos, __buf, __length) (eeprom_write_block((void*)(__pos), (void*)__buf, (__length)))
+// EEPROM writes are immediate
+#define hwConfigFlush()
 
 
 
@@ -40,7 +40,12 @@ ISR (WDT_vect)
 }
 */
 
-static void hwInitConfigBlock( size_t length = 1024 /*ATMega328 has 1024 bytes*/ )
+// emulated EEPROM changed since last commit
+static bool _configDirty = false;
+
+#define ESP8266_CONFIG_SIZE 1024 // ATMega328 has 1024 bytes
+
+static void hwInitConfigBlock( size_t length = ESP8266_CONFIG_SIZE )
 {
   static bool initDone = false;
   if (!initDone)
@@ -53,24 +58,35 @@ static void hwInitConfigBlock( size_t length = 1024 /*ATMega328 has 1024 bytes*/
 void hwReadConfigBlock(void* buf, void* adr, size_t length)
 {
   hwInitConfigBlock();
-  uint8_t* dst = static_cast<uint8_t*>(buf);
-  int offs = reinterpret_cast<int>(adr);
-  while (length-- > 0)
+  // the EEPROM emulation is a RAM copy of the flash sector, access beyond it would hit other RAM
+  if (reinterpret_cast<size_t>(adr) + length > ESP8266_CONFIG_SIZE)
   {
-    *dst++ = EEPROM.read(offs++); 
+    memset(buf, 0xFF, length);
+    return;
   }
+  memcpy(buf, EEPROM.getDataPtr() + reinterpret_cast<int>(adr), length);
 }
 
 void hwWriteConfigBlock(void* buf, void* adr, size_t length)
 {
   hwInitConfigBlock();
-  uint8_t* src = static_cast<uint8_t*>(buf);
-  int offs = reinterpret_cast<int>(adr);
-  while (length-- > 0)
+  if (reinterpret_cast<size_t>(adr) + length > ESP8266_CONFIG_SIZE) return;
+  uint8_t* dst = EEPROM.getDataPtr() + reinterpret_cast<int>(adr);
+  if (memcmp(dst, buf, length))
+  {
+    memcpy(dst, buf, length);
+    // commit is deferred, rewriting the flash sector per write is slow
+    _configDirty = true;
+  }
+}
+
+void hwConfigFlush()
+{
+  if (_configDirty)
   {
-    EEPROM.write(offs++, *src++);
+    EEPROM.commit();
+    _configDirty = false;
   }
-  EEPROM.commit();
 }
 
 uint8_t hwReadConfig(int adr)
@@ -114,6 +130,11 @@ int8_t hwSleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mo
 	return -2;
 }
 
+uint32_t hwSleptMillis() {
+	// sleep not supported, millis() covers all time
+	return 0;
+}
+
 ADC_MODE(ADC_VCC);
 
 uint16_t hwCPUVoltage() {
@@ -121,6 +142,25 @@ uint16_t hwCPUVoltage() {
 	return ESP.getVcc();
 }
 
+static uint16_t _adcResult = 0;
+
+bool hwAdcStart(uint8_t pin, uint8_t samples) {
+	// conversions take microseconds, sample right away (analog pins read 0 in ADC_VCC mode)
+	if (!samples || samples > 64) return false;
+	uint32_t sum = 0;
+	for (uint8_t i = 0; i < samples; i++) sum += pin == HW_ADC_VCC ? hwCPUVoltage() : analogRead(pin);
+	_adcResult = (sum + (samples >> 1)) / samples;
+	return true;
+}
+
+bool hwAdcReady() {
+	return true;
+}
+
+uint16_t hwAdcRead() {
+	return _adcResult;
+}
+
 uint16_t hwCPUFrequency() {
 	// in 1/10Mhz
 	return ESP.getCpuFreqMHz()*10;
@@ -130,6 +170,21 @@ uint16_t hwFreeMem() {
 	return ESP.getFreeHeap();
 }
 
+void hwRandomInit() {
+	// hardware RNG runs all the time
+}
+
+bool hwRandomBytes(uint8_t *buffer, uint8_t length) {
+	while (length) {
+		uint32_t value = RANDOM_REG32;
+		for (uint8_t i = 0; i < 4 && length; i++, length--) {
+			*buffer++ = value;
+			value >>= 8;
+		}
+	}
+	return true;
+}
+
 #ifdef MY_DEBUG
 void hwDebugPrint(const char *fmt, ... ) {
 	char fmtBuffer[300];
@@ -35,13 +35,15 @@
 #define hwDigitalWrite(__pin, __value) (digitalWrite(__pin, __value))
 #define hwInit() MY_SERIALDEVICE.begin(MY_BAUD_RATE); MY_SERIALDEVICE.setDebugOutput(true)
 #define hwWatchdogReset() wdt_reset()
-#define hwReboot() ESP.restart();
+#define hwReboot() do { hwConfigFlush(); ESP.restart(); } while (0)
 #define hwMillis() millis()
+#define hwMicros() micros()
 
 void hwReadConfigBlock(void* buf, void* adr, size_t length);
 void hwWriteConfigBlock(void* buf, void* adr, size_t length);
 void hwWriteConfig(int adr, uint8_t value);
 uint8_t hwReadConfig(int adr);
+void hwConfigFlush();
 
 
 #endif // #ifdef ARDUINO_ARCH_ESP8266
@@ -0,0 +1,178 @@
+/**
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "MyHwNative.h"
+
+NativeSerial Serial;
+
+// emulated EEPROM, loaded from MY_NATIVE_EEPROM_FILE on first access
+static uint8_t _config[MY_NATIVE_EEPROM_SIZE];
+static bool _configLoaded = false;
+static bool _configDirty = false;
+
+// MY_NATIVE_EEPROM in the environment overrides the file, e.g. one per simulated node
+static const char *hwConfigFile() {
+	const char *file = getenv("MY_NATIVE_EEPROM");
+	return file ? file : MY_NATIVE_EEPROM_FILE;
+}
+
+static void hwInitConfigBlock() {
+	if (_configLoaded) return;
+	// erased EEPROM reads 0xFF
+	memset(_config, 0xFF, sizeof(_config));
+	FILE *file = fopen(hwConfigFile(), "rb");
+	if (file) {
+		(void)fread(_config, 1, sizeof(_config), file);
+		fclose(file);
+	}
+	_configLoaded = true;
+}
+
+void hwReadConfigBlock(void* buf, void* adr, size_t length) {
+	hwInitConfigBlock();
+	const size_t offs = reinterpret_cast<size_t>(adr);
+	if (offs >= sizeof(_config)) return;
+	memcpy(buf, &_config[offs], min(length, sizeof(_config) - offs));
+}
+
+void hwWriteConfigBlock(void* buf, void* adr, size_t length) {
+	hwInitConfigBlock();
+	const size_t offs = reinterpret_cast<size_t>(adr);
+	if (offs >= sizeof(_config)) return;
+	memcpy(&_config[offs], buf, min(length, sizeof(_config) - offs));
+	// written back by hwConfigFlush(), called from _process()
+	_configDirty = true;
+}
+
+void hwConfigFlush() {
+	if (!_configDirty) return;
+	FILE *file = fopen(hwConfigFile(), "wb");
+	if (file) {
+		(void)fwrite(_config, 1, sizeof(_config), file);
+		fclose(file);
+	}
+	_configDirty = false;
+}
+
+uint8_t hwReadConfig(int adr) {
+	uint8_t value = 0xFF;
+	hwReadConfigBlock(&value, reinterpret_cast<void*>(adr), 1);
+	return value;
+}
+
+void hwWriteConfig(int adr, uint8_t value) {
+	if (hwReadConfig(adr) != value) {
+		hwWriteConfigBlock(&value, reinterpret_cast<void*>(adr), 1);
+	}
+}
+
+int8_t hwSleep(unsigned long ms) {
+	// host does not sleep, millis() keeps counting
+	delay(ms);
+	return -1;
+}
+
+int8_t hwSleep(uint8_t interrupt, uint8_t mode, unsigned long ms) {
+	// no interrupt pins, wake up by timer only
+	(void)interrupt;
+	(void)mode;
+	return hwSleep(ms);
+}
+
+int8_t hwSleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mode2, unsigned long ms) {
+	(void)interrupt1;
+	(void)mode1;
+	(void)interrupt2;
+	(void)mode2;
+	return hwSleep(ms);
+}
+
+uint32_t hwSleptMillis() {
+	// sleep is a delay, millis() covers all time
+	return 0;
+}
+
+uint16_t hwCPUVoltage() {
+	// in mV
+	return 3300;
+}
+
+static uint16_t _adcResult = 0;
+
+bool hwAdcStart(uint8_t pin, uint8_t samples) {
+	// no ADC, sample right away
+	if (!samples || samples > 64) return false;
+	uint32_t sum = 0;
+	for (uint8_t i = 0; i < samples; i++) sum += pin == HW_ADC_VCC ? hwCPUVoltage() : analogRead(pin);
+	_adcResult = (sum + (samples >> 1)) / samples;
+	return true;
+}
+
+bool hwAdcReady() {
+	return true;
+}
+
+uint16_t hwAdcRead() {
+	return _adcResult;
+}
+
+uint16_t hwCPUFrequency() {
+	// in 1/10Mhz, not measured
+	return 0;
+}
+
+uint16_t hwFreeMem() {
+	// not meaningful on the host
+	return 0xFFFF;
+}
+
+void hwRandomInit() {
+}
+
+bool hwRandomBytes(uint8_t *buffer, uint8_t length) {
+	FILE *f = fopen("/dev/urandom", "rb");
+	if (!f) return false;
+	const bool result = fread(buffer, 1, length, f) == length;
+	fclose(f);
+	return result;
+}
+
+#ifdef MY_DEBUG
+void hwDebugPrint(const char *fmt, ... ) {
+	char fmtBuffer[300];
+	#ifdef MY_GATEWAY_FEATURE
+		// prepend debug message to be handled correctly by controller (C_INTERNAL, I_LOG_MESSAGE)
+		snprintf_P(fmtBuffer, 299, PSTR("0;255;%d;0;%d;"), C_INTERNAL, I_LOG_MESSAGE);
+		MY_SERIALDEVICE.print(fmtBuffer);
+	#endif
+	va_list args;
+	va_start (args, fmt );
+	#ifdef MY_GATEWAY_FEATURE
+		// Truncate message if this is gateway node
+		vsnprintf_P(fmtBuffer, MY_GATEWAY_MAX_SEND_LENGTH, fmt, args);
+		fmtBuffer[MY_GATEWAY_MAX_SEND_LENGTH-1] = '\n';
+		fmtBuffer[MY_GATEWAY_MAX_SEND_LENGTH] = '\0';
+	#else
+		vsnprintf_P(fmtBuffer, 299, fmt, args);
+	#endif
+	va_end (args);
+	MY_SERIALDEVICE.print(fmtBuffer);
+	MY_SERIALDEVICE.flush();
+}
+#endif
@@ -0,0 +1,65 @@
+/**
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+#ifndef MyHwNative_h
+#define MyHwNative_h
+
+#include "MyHw.h"
+
+#ifdef __cplusplus
+#include <Arduino.h>
+#endif
+
+#define MY_SERIALDEVICE Serial
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+/**
+ * @def MY_NATIVE_EEPROM_FILE
+ * @brief File backing the emulated EEPROM of host builds, created on first write.
+ * The environment variable MY_NATIVE_EEPROM overrides it at runtime.
+ */
+#ifndef MY_NATIVE_EEPROM_FILE
+#define MY_NATIVE_EEPROM_FILE "mysensors.eeprom"
+#endif
+/**
+ * @def MY_NATIVE_EEPROM_SIZE
+ * @brief Size of the emulated EEPROM (ATMega328 has 1024 bytes)
+ */
+#ifndef MY_NATIVE_EEPROM_SIZE
+#define MY_NATIVE_EEPROM_SIZE 1024
+#endif
+
+
+// Define these as macros to save valuable space
+
+#define hwDigitalWrite(__pin, __value) (digitalWrite(__pin, __value))
+#define hwInit() MY_SERIALDEVICE.begin(MY_BAUD_RATE)
+#define hwWatchdogReset()
+#define hwReboot() do { hwConfigFlush(); exit(0); } while (0)
+#define hwMillis() millis()
+#define hwMicros() micros()
+
+void hwReadConfigBlock(void* buf, void* adr, size_t length);
+void hwWriteConfigBlock(void* buf, void* adr, size_t length);
+void hwWriteConfig(int adr, uint8_t value);
+uint8_t hwReadConfig(int adr);
+void hwConfigFlush();
+
+
+#endif // #ifdef MyHwNative_h
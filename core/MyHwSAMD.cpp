@@ -62,24 +62,61 @@ byte i2c_eeprom_read_byte(unsigned int eeaddress ) {
   return rdata;
 }
 
-void hwReadConfigBlock(void* buf, void* adr, size_t length)
+// configBlock caches the I2C EEPROM, writes are deferred until hwConfigFlush()
+static bool _configLoaded = false;
+static bool _configDirty = false;
+static uint8_t _configDirtyMap[sizeof(configBlock) / 8];
+
+static void hwLoadConfigBlock()
 {
-  uint8_t* dst = static_cast<uint8_t*>(buf);
-  int offs = reinterpret_cast<int>(adr);
-  while (length-- > 0)
+  if (!_configLoaded)
   {
-    *dst++ = i2c_eeprom_read_byte(offs++);
+    for (unsigned int i = 0; i < sizeof(configBlock); i++)
+    {
+      configBlock[i] = i2c_eeprom_read_byte(i);
+    }
+    _configLoaded = true;
   }
 }
 
+void hwReadConfigBlock(void* buf, void* adr, size_t length)
+{
+  hwLoadConfigBlock();
+  int offs = reinterpret_cast<int>(adr);
+  memcpy(buf, &configBlock[offs], length);
+}
+
 void hwWriteConfigBlock(void* buf, void* adr, size_t length)
 {
+  hwLoadConfigBlock();
   uint8_t* src = static_cast<uint8_t*>(buf);
   int offs = reinterpret_cast<int>(adr);
   while (length-- > 0)
   {
-     i2c_eeprom_write_byte(offs++, *src++);
+    if (configBlock[offs] != *src)
+    {
+      configBlock[offs] = *src;
+      _configDirtyMap[offs >> 3] |= _BV(offs & 0x07);
+      _configDirty = true;
+    }
+    offs++;
+    src++;
+  }
+}
+
+void hwConfigFlush()
+{
+  if (!_configDirty) return;
+  // only write changed bytes
+  for (unsigned int i = 0; i < sizeof(configBlock); i++)
+  {
+    if (_configDirtyMap[i >> 3] & _BV(i & 0x07))
+    {
+      i2c_eeprom_write_byte(i, configBlock[i]);
+    }
   }
+  memset(_configDirtyMap, 0, sizeof(_configDirtyMap));
+  _configDirty = false;
 }
 
 uint8_t hwReadConfig(int adr)
@@ -111,6 +148,7 @@ void hwWatchdogReset() {
 }
 
 void hwReboot() {
+ hwConfigFlush();
  // TODO: Not supported!
 }
 
@@ -138,11 +176,35 @@ int8_t hwSleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mo
   return -2;
 }
 
+uint32_t hwSleptMillis() {
+	// sleep not supported, millis() covers all time
+	return 0;
+}
+
 uint16_t hwCPUVoltage() {
 	// TODO: Not supported!
 	return 0;
 }
 
+static uint16_t _adcResult = 0;
+
+bool hwAdcStart(uint8_t pin, uint8_t samples) {
+	// conversions take microseconds, sample right away
+	if (!samples || samples > 64) return false;
+	uint32_t sum = 0;
+	for (uint8_t i = 0; i < samples; i++) sum += pin == HW_ADC_VCC ? hwCPUVoltage() : analogRead(pin);
+	_adcResult = (sum + (samples >> 1)) / samples;
+	return true;
+}
+
+bool hwAdcReady() {
+	return true;
+}
+
+uint16_t hwAdcRead() {
+	return _adcResult;
+}
+
 uint16_t hwCPUFrequency() {
 	// TODO: Not supported!
 	return 0;
@@ -153,6 +215,33 @@ uint16_t hwFreeMem() {
 	return 0;
 }
 
+void hwRandomInit() {
+#if defined(TRNG)
+	// SAMD51/SAML21 true RNG
+	MCLK->APBCMASK.bit.TRNG_ = 1;
+	TRNG->CTRLA.bit.ENABLE = 1;
+#endif
+}
+
+bool hwRandomBytes(uint8_t *buffer, uint8_t length) {
+#if defined(TRNG)
+	while (length) {
+		while (!TRNG->INTFLAG.bit.DATARDY) {}
+		uint32_t value = TRNG->DATA.reg;
+		for (uint8_t i = 0; i < 4 && length; i++, length--) {
+			*buffer++ = value;
+			value >>= 8;
+		}
+	}
+	return true;
+#else
+	// SAMD21 has no TRNG
+	(void)buffer;
+	(void)length;
+	return false;
+#endif
+}
+
 #ifdef MY_DEBUG
 void hwDebugPrint(const char *fmt, ... ) {
   if (MY_SERIALDEVICE) {
@@ -43,11 +43,13 @@ void hwInit();
 void hwWatchdogReset();
 void hwReboot();
 #define hwMillis() millis()
+#define hwMicros() micros()
 
 void hwReadConfigBlock(void* buf, void* adr, size_t length);
 void hwWriteConfigBlock(void* buf, void* adr, size_t length);
 void hwWriteConfig(int adr, uint8_t value);
 uint8_t hwReadConfig(int adr);
+void hwConfigFlush();
 
 #define MY_SERIALDEVICE SerialUSB
 
@@ -24,6 +24,7 @@
 
 
 extern bool gatewayTransportSend(MyMessage &message);
+extern void gatewayTransportSendQueued();
 
 void inclusionInit();
 void inclusionModeSet(bool newMode);
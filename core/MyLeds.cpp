@@ -22,11 +22,57 @@
 #define LED_ON_OFF_RATIO        (4)       // Power of 2 please
 #define LED_PROCESS_INTERVAL_MS (MY_DEFAULT_LED_BLINK_PERIOD/LED_ON_OFF_RATIO)
 
+#if defined(MY_LEDS_TIMER)
+// decremented in the timer interrupt, set from the main loop only when 0
+static volatile uint8_t countRx;
+static volatile uint8_t countTx;
+static volatile uint8_t countErr;
+// timer0 overflows (1.024ms) per LED_PROCESS_INTERVAL_MS
+#define LED_PROCESS_TICKS       ((uint32_t)LED_PROCESS_INTERVAL_MS * 1000 / 1024)
+#if MY_DEFAULT_LED_BLINK_PERIOD / LED_ON_OFF_RATIO * 1000L / 1024 > 0xFFFF
+	#error MY_DEFAULT_LED_BLINK_PERIOD too long for MY_LEDS_TIMER
+#endif
+static uint16_t ledTicks = 0;
+// port and mask of the pins for fast writes in the interrupt
+static volatile uint8_t *portRx, *portTx, *portErr;
+static uint8_t maskRx, maskTx, maskErr;
+#define ledWrite(__pin, __port, __mask, __state) do { if (__state) *__port |= __mask; else *__port &= ~__mask; } while (0)
+#else
 // these variables don't need to be volatile, since we are not using interrupts
 static uint8_t countRx;
 static uint8_t countTx;
 static uint8_t countErr;
 static unsigned long prevTime = hwMillis() - LED_PROCESS_INTERVAL_MS;     // Substract some, to make sure leds gets updated on first run.
+#define ledWrite(__pin, __port, __mask, __state) hwDigitalWrite(__pin, __state)
+#endif
+
+static void ledsUpdate() {
+    uint8_t state;
+
+    // For an On/Off ratio of 4, the pattern repeated will be [on, on, on, off]
+    // until the counter becomes 0.
+    state = (countRx & (LED_ON_OFF_RATIO-1)) ? LED_ON : LED_OFF;
+    ledWrite(MY_DEFAULT_RX_LED_PIN, portRx, maskRx, state);
+    if (countRx)  --countRx;
+
+    state = (countTx & (LED_ON_OFF_RATIO-1)) ? LED_ON : LED_OFF;
+    ledWrite(MY_DEFAULT_TX_LED_PIN, portTx, maskTx, state);
+    if (countTx)  --countTx;
+
+    state = (countErr & (LED_ON_OFF_RATIO-1)) ? LED_ON : LED_OFF;
+    ledWrite(MY_DEFAULT_ERR_LED_PIN, portErr, maskErr, state);
+    if (countErr) --countErr;
+}
+
+#if defined(MY_LEDS_TIMER)
+ISR (TIMER0_COMPB_vect)
+{
+	// one compare match per timer0 overflow (1.024ms), whatever OCR0B is set to
+	if (++ledTicks < LED_PROCESS_TICKS) return;
+	ledTicks = 0;
+	ledsUpdate();
+}
+#endif
 
 
 inline void ledsInit()
@@ -41,32 +87,31 @@ inline void ledsInit()
 	pinMode(MY_DEFAULT_TX_LED_PIN,  OUTPUT);
 	pinMode(MY_DEFAULT_ERR_LED_PIN, OUTPUT);
 
+#if defined(MY_LEDS_TIMER)
+	portRx = portOutputRegister(digitalPinToPort(MY_DEFAULT_RX_LED_PIN));
+	maskRx = digitalPinToBitMask(MY_DEFAULT_RX_LED_PIN);
+	portTx = portOutputRegister(digitalPinToPort(MY_DEFAULT_TX_LED_PIN));
+	maskTx = digitalPinToBitMask(MY_DEFAULT_TX_LED_PIN);
+	portErr = portOutputRegister(digitalPinToPort(MY_DEFAULT_ERR_LED_PIN));
+	maskErr = digitalPinToBitMask(MY_DEFAULT_ERR_LED_PIN);
+	ledsUpdate();
+	// timer0 keeps running for millis(), add the compare B interrupt
+	TIMSK0 |= _BV(OCIE0B);
+#else
     ledsProcess();
+#endif
 }
 
+#if !defined(MY_LEDS_TIMER)
 void ledsProcess() {
 	// Just return if it is not the time...
 	if ((hwMillis() - prevTime) < LED_PROCESS_INTERVAL_MS)
 		return;
 
 	prevTime += LED_PROCESS_INTERVAL_MS;
-
-    uint8_t state;
-
-    // For an On/Off ratio of 4, the pattern repeated will be [on, on, on, off]
-    // until the counter becomes 0.
-    state = (countRx & (LED_ON_OFF_RATIO-1)) ? LED_ON : LED_OFF;
-    hwDigitalWrite(MY_DEFAULT_RX_LED_PIN, state);
-    if (countRx)  --countRx;
-
-    state = (countTx & (LED_ON_OFF_RATIO-1)) ? LED_ON : LED_OFF;
-    hwDigitalWrite(MY_DEFAULT_TX_LED_PIN, state);
-    if (countTx)  --countTx;
-
-    state = (countErr & (LED_ON_OFF_RATIO-1)) ? LED_ON : LED_OFF;
-    hwDigitalWrite(MY_DEFAULT_ERR_LED_PIN, state);
-    if (countErr) --countErr;
+	ledsUpdate();
 }
+#endif
 
 void ledsBlinkRx(uint8_t cnt) {
   if (!countRx) { countRx = cnt*LED_ON_OFF_RATIO; }
@@ -42,7 +42,11 @@
 	void ledsBlinkRx(uint8_t cnt);
 	void ledsBlinkTx(uint8_t cnt);
 	void ledsBlinkErr(uint8_t cnt);
-	void ledsProcess(); // do the actual blinking
+	#if defined(MY_LEDS_TIMER)
+		#define ledsProcess() // blinking is done in the timer interrupt
+	#else
+		void ledsProcess(); // do the actual blinking
+	#endif
 
 #else
 	// Remove led functions if feature is disabled
@@ -41,6 +41,18 @@ uint8_t MyMessage::getCommand() const {
 	return miGetCommand();
 }
 
+uint8_t MyMessage::getPayloadType() const {
+	return miGetPayloadType();
+}
+
+uint8_t MyMessage::getLength() const {
+	return miGetLength();
+}
+
+uint8_t MyMessage::getFloatPrecision() const {
+	return fPrecision;
+}
+
 /* Getters for payload converted to desired form */
 void* MyMessage::getCustom() const {
 	return (void *)data;
@@ -55,22 +67,64 @@ const char* MyMessage::getString() const {
 	}
 }
 
+static const char _hexDigits[16] PROGMEM = {
+	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
+// powers of ten for fixed point float formatting, up to 8 decimals
+static const uint32_t _decimalScale[9] PROGMEM = {
+	1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL
+};
+
 // handles single character hex (0 - 15)
 char MyMessage::i2h(uint8_t i) const {
-	uint8_t k = i & 0x0F;
-	if (k <= 9)
-		return '0' + k;
-	else
-		return 'A' + k - 10;
+	return pgm_read_byte(&_hexDigits[i & 0x0F]);
 }
 
 char* MyMessage::getCustomString(char *buffer) const {
-	for (uint8_t i = 0; i < miGetLength(); i++)
+	const uint8_t length = miGetLength();
+	char *p = buffer;
+	for (uint8_t i = 0; i < length; i++)
 	{
-		buffer[i * 2] = i2h(data[i] >> 4);
-		buffer[(i * 2) + 1] = i2h(data[i]);
+		*p++ = pgm_read_byte(&_hexDigits[(uint8_t)data[i] >> 4]);
+		*p++ = pgm_read_byte(&_hexDigits[data[i] & 0x0F]);
+	}
+	*p = '\0';
+	return buffer;
+}
+
+// Same output as dtostrf(value, 2, decimals, buffer), but one float multiply
+// and integer math only. Values not fitting 32 bit fixed point fall back to dtostrf.
+static char* floatToString(float value, uint8_t decimals, char *buffer) {
+	const uint32_t scale = pgm_read_dword(&_decimalScale[decimals]);
+	// sign bit, -0.0 is printed as "-0.00" like dtostrf() does
+	const bool negative = signbit(value);
+	const float scaled = (negative ? -value : value) * scale + 0.5f;
+	if (!(scaled < 4294967040.0f)) {
+		// too large, inf or nan
+		return dtostrf(value, 2, decimals, buffer);
+	}
+	const uint32_t fixed = (uint32_t)scaled;
+	char *p = buffer;
+	if (negative) *p++ = '-';
+	ultoa(fixed / scale, p, 10);
+	p += strlen(p);
+	if (decimals) {
+		uint32_t fraction = fixed % scale;
+		*p = '.';
+		for (uint8_t i = decimals; i > 0; i--) {
+			p[i] = '0' + fraction % 10;
+			fraction /= 10;
+		}
+		p += decimals + 1;
+	}
+	*p = '\0';
+	if (p - buffer < 2) {
+		// minimum width 2, right aligned
+		buffer[2] = '\0';
+		buffer[1] = buffer[0];
+		buffer[0] = ' ';
 	}
-	buffer[miGetLength() * 2] = '\0';
 	return buffer;
 }
 
@@ -100,7 +154,7 @@ char* MyMessage::getString(char *buffer) const {
 		} else if (payloadType == P_ULONG32) {
 			ultoa(ulValue, buffer, 10);
 		} else if (payloadType == P_FLOAT32) {
-			dtostrf(fValue,2,min(fPrecision, 8),buffer);
+			floatToString(fValue, min(fPrecision, 8), buffer);
 		} else if (payloadType == P_CUSTOM) {
 			return getCustomString(buffer);
 		}
@@ -260,3 +314,99 @@ MyMessage& MyMessage::set(int16_t value) {
 	iValue = value;
 	return *this;
 }
+
+
+MyMessageBatch::MyMessageBatch(uint8_t destination) {
+	message.destination = destination;
+	message.sensor = 0xFF;
+	message.type = I_BATCH;
+	clear();
+}
+
+MyMessageBatch& MyMessageBatch::setDestination(uint8_t destination) {
+	message.destination = destination;
+	return *this;
+}
+
+void MyMessageBatch::clear() {
+	mSetLength(message, 0);
+	mSetPayloadType(message, P_CUSTOM);
+	_count = 0;
+}
+
+uint8_t MyMessageBatch::count() const {
+	return _count;
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, const MyMessage &value) {
+	const uint8_t pos = mGetLength(message);
+	const uint8_t length = mGetLength(value);
+	if (pos + BATCH_TUPLE_HEADER_SIZE + length > MAX_PAYLOAD || length > 31) return false;
+	uint8_t *tuple = (uint8_t *)&message.data[pos];
+	tuple[0] = sensor;
+	tuple[1] = type;
+	tuple[2] = mGetPayloadType(value) << 5 | length;
+	memcpy(&tuple[BATCH_TUPLE_HEADER_SIZE], value.data, length);
+	mSetLength(message, pos + BATCH_TUPLE_HEADER_SIZE + length);
+	_count++;
+	return true;
+}
+
+// zeroed message to format a value in, set() only updates length and payload type of the header
+static MyMessage _batchValue() {
+	MyMessage item;
+	memset((void*)&item, 0, sizeof(item));
+	return item;
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, const char* value) {
+	return add(sensor, type, _batchValue().set(value));
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, float value, uint8_t decimals) {
+	return add(sensor, type, _batchValue().set(value, decimals));
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, bool value) {
+	return add(sensor, type, _batchValue().set(value));
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, uint8_t value) {
+	return add(sensor, type, _batchValue().set(value));
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, uint32_t value) {
+	return add(sensor, type, _batchValue().set(value));
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, int32_t value) {
+	return add(sensor, type, _batchValue().set(value));
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, uint16_t value) {
+	return add(sensor, type, _batchValue().set(value));
+}
+
+bool MyMessageBatch::add(uint8_t sensor, uint8_t type, int16_t value) {
+	return add(sensor, type, _batchValue().set(value));
+}
+
+bool MyMessageBatch::get(const MyMessage &batch, uint8_t &pos, MyMessage &item) {
+	const uint8_t length = min(mGetLength(batch), MAX_PAYLOAD);
+	if (pos + BATCH_TUPLE_HEADER_SIZE > length) return false;
+	const uint8_t *tuple = (const uint8_t *)&batch.data[pos];
+	const uint8_t valueLength = tuple[2] & 0x1F;
+	if (pos + BATCH_TUPLE_HEADER_SIZE + valueLength > length) return false;
+	item = batch;
+	item.sensor = tuple[0];
+	item.type = tuple[1];
+	mSetCommand(item, C_SET);
+	mSetRequestAck(item, false);
+	mSetSigned(item, false);
+	mSetPayloadType(item, tuple[2] >> 5);
+	mSetLength(item, valueLength);
+	memmove(item.data, &tuple[BATCH_TUPLE_HEADER_SIZE], valueLength);
+	item.data[valueLength] = 0;
+	pos += BATCH_TUPLE_HEADER_SIZE + valueLength;
+	return true;
+}
@@ -37,7 +37,11 @@
 #endif
 
 #define PROTOCOL_VERSION 2    //!< The version of the protocol
+#if defined(MY_RADIO_RFM69) && defined(MY_RFM69_MAX_MESSAGE_LENGTH)
+#define MAX_MESSAGE_LENGTH MY_RFM69_MAX_MESSAGE_LENGTH //!< The maximum size of a message (including header), set by the transport
+#else
 #define MAX_MESSAGE_LENGTH 32 //!< The maximum size of a message (including header)
+#endif
 #define HEADER_SIZE 7         //!< The size of the header
 #define MAX_PAYLOAD (MAX_MESSAGE_LENGTH - HEADER_SIZE) //!< The maximum size of a payload depends on #MAX_MESSAGE_LENGTH and #HEADER_SIZE
 
@@ -190,7 +194,16 @@ typedef enum {
 	I_PONG					= 25,	//!< In return to ping, sent back to sender, payload incremental hop counter
 	I_REGISTRATION_REQUEST	= 26,	//!< Register request to GW
 	I_REGISTRATION_RESPONSE	= 27,	//!< Register response from GW
-	I_DEBUG					= 28	//!< Debug message
+	I_DEBUG					= 28,	//!< Debug message
+	I_GATEWAY_BUSY			= 29,	//!< Gateway inbound queue full (payload 1), ready again (payload 0)
+	I_FRAGMENT				= 30,	//!< Fragment of a payload larger than MAX_PAYLOAD, see sendFragmented()
+	I_BATCH					= 31,	//!< Several (sensor, type, value) tuples, see MyMessageBatch
+	I_PENDING				= 32,	//!< Controller answer to a smartSleep() heartbeat: number of messages queued for the node (0 = none)
+	I_STATS					= 33,	//!< Request performance counters ("R" also resets them), answered with NodeStats as custom payload
+	I_PROFILE				= 34,	//!< Request _process() stage timing ("R" also resets it), answered with one ProfileReport per stage
+	I_LOADTEST				= 35,	//!< Load test probe (LoadTestProbe, echoed by the gateway), controller request for LoadTestReport ("R" also resets)
+	I_GATEWAY_BEACON		= 36,	//!< Broadcast by a (re)started gateway and relayed by repeaters, children searching a parent rebind to their previous one
+	I_ENERGY				= 37	//!< Request energy accounting ("R" also resets it), answered with NodeEnergy as custom payload
 } mysensor_internal;
 
 
@@ -229,14 +242,26 @@ typedef enum {
 #define BF_SET(y, x, start, len)    ( y= ((y) &~ BF_MASK(start, len)) | BF_PREP(x, start, len) ) //!< Insert a new bitfield value 'x' into 'y'
 
 // Getters/setters for special bit fields in header
+#if MAX_PAYLOAD > 31
+// Payloads above 31 bytes need a 6th length bit, it is taken from the low version bit (PROTOCOL_VERSION is 2).
+// Nodes built for 32 byte frames read such messages as version 3 and reject them.
+#define mSetVersion(_msg,_version) BF_SET(_msg.version_length, (_version) >> 1, 1, 1) //!< Set version field
+#define mGetVersion(_msg) ((uint8_t)(BF_GET(_msg.version_length, 1, 1) << 1)) //!< Get version field
+#else
 #define mSetVersion(_msg,_version) BF_SET(_msg.version_length, _version, 0, 2) //!< Set version field
 #define mGetVersion(_msg) ((uint8_t)BF_GET(_msg.version_length, 0, 2)) //!< Get version field
+#endif
 
 #define mSetSigned(_msg,_signed) BF_SET(_msg.version_length, _signed, 2, 1) //!< Set signed field
 #define mGetSigned(_msg) ((bool)BF_GET(_msg.version_length, 2, 1)) //!< Get versignedsion field
 
+#if MAX_PAYLOAD > 31
+#define mSetLength(_msg,_length) (BF_SET(_msg.version_length, _length, 3, 5), BF_SET(_msg.version_length, (_length) >> 5, 0, 1)) //!< Set length field
+#define mGetLength(_msg) ((uint8_t)(BF_GET(_msg.version_length, 3, 5) | (BF_GET(_msg.version_length, 0, 1) << 5))) //!< Get length field
+#else
 #define mSetLength(_msg,_length) BF_SET(_msg.version_length, _length, 3, 5) //!< Set length field
 #define mGetLength(_msg) ((uint8_t)BF_GET(_msg.version_length, 3, 5)) //!< Get length field
+#endif
 
 #define mSetCommand(_msg,_command) BF_SET(_msg.command_ack_payload, _command, 0, 3) //!< Set command field
 #define mGetCommand(_msg) ((uint8_t)BF_GET(_msg.command_ack_payload, 0, 3)) //!< Get command field
@@ -254,8 +279,13 @@ typedef enum {
 // internal access for special fields
 #define miGetCommand() ((uint8_t)BF_GET(command_ack_payload, 0, 3)) //!< Internal getter for command field
 
+#if MAX_PAYLOAD > 31
+#define miSetLength(_length) (BF_SET(version_length, _length, 3, 5), BF_SET(version_length, (_length) >> 5, 0, 1)) //!< Internal setter for length field
+#define miGetLength() ((uint8_t)(BF_GET(version_length, 3, 5) | (BF_GET(version_length, 0, 1) << 5))) //!< Internal getter for length field
+#else
 #define miSetLength(_length) BF_SET(version_length, _length, 3, 5) //!< Internal setter for length field
 #define miGetLength() ((uint8_t)BF_GET(version_length, 3, 5)) //!< Internal getter for length field
+#endif
 
 #define miSetRequestAck(_rack) BF_SET(command_ack_payload, _rack, 3, 1) //!< Internal setter for ack-request field
 #define miGetRequestAck() ((bool)BF_GET(command_ack_payload, 3, 1)) //!< Internal getter for ack-request field
@@ -302,6 +332,16 @@ public:
 	// Getter for command type
 	uint8_t getCommand() const;
 
+	/**
+	 * Typed access without formatting: check the payload type (P_BYTE, P_FLOAT32, ...)
+	 * and use the matching getter, e.g. getFloat() with getFloatPrecision().
+	 */
+	uint8_t getPayloadType() const;
+	// Getter for payload length
+	uint8_t getLength() const;
+	// Getter for the number of decimals a P_FLOAT32 payload is formatted with
+	uint8_t getFloatPrecision() const;
+
 	// Getter for ack-flag. True if this is an ack message.
 	bool isAck() const;
 
@@ -368,6 +408,48 @@ struct
 uint8_t array[HEADER_SIZE + MAX_PAYLOAD + 1];	
 } __attribute__((packed)) MyMessage;
 #endif
+
+#ifdef __cplusplus
+#define BATCH_TUPLE_HEADER_SIZE 3	//!< sensor, type, payload type << 5 | length
+
+/**
+ * Builder for I_BATCH messages: several values, each with its own child sensor and type,
+ * sent in one frame with sendBatch(). The recipient hands them to receive() (and the gateway
+ * to the controller) as individual C_SET messages.
+ */
+class MyMessageBatch
+{
+public:
+	MyMessageBatch(uint8_t destination = 0);	// Gateway is default destination
+
+	MyMessageBatch& setDestination(uint8_t destination);
+	// Remove all values
+	void clear();
+	// Number of values in batch
+	uint8_t count() const;
+
+	// Append a value, return false if it does not fit, i.e. send the batch and clear() it
+	bool add(uint8_t sensor, uint8_t type, const MyMessage &value);
+	bool add(uint8_t sensor, uint8_t type, const char* value);
+	bool add(uint8_t sensor, uint8_t type, float value, uint8_t decimals);
+	bool add(uint8_t sensor, uint8_t type, bool value);
+	bool add(uint8_t sensor, uint8_t type, uint8_t value);
+	bool add(uint8_t sensor, uint8_t type, uint32_t value);
+	bool add(uint8_t sensor, uint8_t type, int32_t value);
+	bool add(uint8_t sensor, uint8_t type, uint16_t value);
+	bool add(uint8_t sensor, uint8_t type, int16_t value);
+
+	/**
+	 * Unpack the value at pos of a received I_BATCH message into item (header copied from batch,
+	 * command C_SET) and advance pos. Returns false when there are no more (valid) values.
+	 */
+	static bool get(const MyMessage &batch, uint8_t &pos, MyMessage &item);
+
+	MyMessage message;	//!< I_BATCH message, sent by sendBatch()
+private:
+	uint8_t _count;
+};
+#endif
 #endif
 
 #endif
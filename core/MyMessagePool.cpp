@@ -0,0 +1,72 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "MyMessagePool.h"
+
+static MyMessage _msgPool[MY_MESSAGE_POOL_SIZE];
+static uint8_t _msgPoolUsed[(MY_MESSAGE_POOL_SIZE + 7) / 8];	// bit per buffer
+static uint8_t _msgPoolFree = MY_MESSAGE_POOL_SIZE;
+
+msgPoolHandle msgPoolAlloc() {
+	if (!_msgPoolFree) {
+		return MSG_POOL_NONE;
+	}
+	for (uint8_t i = 0; i < MY_MESSAGE_POOL_SIZE; i++) {
+		if (!(_msgPoolUsed[i >> 3] & (1 << (i & 7)))) {
+			_msgPoolUsed[i >> 3] |= 1 << (i & 7);
+			_msgPoolFree--;
+			return i;
+		}
+	}
+	return MSG_POOL_NONE;
+}
+
+msgPoolHandle msgPoolAlloc(const MyMessage &message) {
+	const msgPoolHandle handle = msgPoolAlloc();
+	if (handle != MSG_POOL_NONE) {
+		_msgPool[handle] = message;
+	}
+	return handle;
+}
+
+void msgPoolRelease(msgPoolHandle handle) {
+	// a handle released twice is ignored, the free count stays correct
+	if (handle >= MY_MESSAGE_POOL_SIZE || !(_msgPoolUsed[handle >> 3] & (1 << (handle & 7)))) {
+		return;
+	}
+	_msgPoolUsed[handle >> 3] &= ~(1 << (handle & 7));
+	_msgPoolFree++;
+}
+
+MyMessage &msgPoolGet(msgPoolHandle handle) {
+	return _msgPool[handle];
+}
+
+uint8_t msgPoolAvailable() {
+	return _msgPoolFree;
+}
+
+uint8_t msgPoolQueueAvailable() {
+	return _msgPoolFree > MSG_POOL_SIGNING_RESERVE ? _msgPoolFree - MSG_POOL_SIGNING_RESERVE : 0;
+}
+
+msgPoolHandle msgPoolAllocQueued(const MyMessage &message) {
+	// a full queue must not starve signing of the messages it holds
+	return msgPoolQueueAvailable() ? msgPoolAlloc(message) : MSG_POOL_NONE;
+}
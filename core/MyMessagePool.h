@@ -0,0 +1,100 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * Fixed capacity pool of message buffers (MY_MESSAGE_POOL_SIZE) shared by the
+ * transport TX queue, the gateway RX queue and signing handshakes. A stage owns
+ * a message through its handle and hands the handle on, the message is not copied.
+ */
+
+#ifndef MyMessagePool_h
+#define MyMessagePool_h
+
+#define MSG_POOL_NONE			0xFF		//!< invalid handle, pool exhausted
+
+#if defined(MY_MESSAGE_POOL_SIZE)
+#if MY_MESSAGE_POOL_SIZE > 254
+	#error MY_MESSAGE_POOL_SIZE must not exceed 254
+#endif
+
+#if defined(MY_SIGNING_ATSHA204) || defined(MY_SIGNING_SOFT)
+	#define MSG_POOL_SIGNING_RESERVE	1	//!< buffers kept for signing, queued messages are signed when they are sent
+#else
+	#define MSG_POOL_SIGNING_RESERVE	0	//!< buffers kept for signing
+#endif
+#if MY_MESSAGE_POOL_SIZE <= MSG_POOL_SIGNING_RESERVE
+	#error MY_MESSAGE_POOL_SIZE must leave buffers for the queues besides the one kept for signing
+#endif
+
+typedef uint8_t msgPoolHandle;		//!< index of a pool buffer
+
+/**
+* @brief Take a free buffer from the pool, the caller owns it until msgPoolRelease()
+* @return handle or MSG_POOL_NONE if all buffers are in use
+*/
+msgPoolHandle msgPoolAlloc();
+/**
+* @brief Take a free buffer and copy message into it
+* @param message
+* @return handle or MSG_POOL_NONE if all buffers are in use
+*/
+msgPoolHandle msgPoolAlloc(const MyMessage &message);
+/**
+* @brief Return a buffer to the pool, MSG_POOL_NONE is ignored
+* @param handle
+*/
+void msgPoolRelease(msgPoolHandle handle);
+/**
+* @brief Access the message of a handle
+* @param handle allocated handle
+* @return message buffer
+*/
+MyMessage &msgPoolGet(msgPoolHandle handle);
+/**
+* @brief Number of free buffers
+* @return free buffers
+*/
+uint8_t msgPoolAvailable();
+/**
+* @brief Number of free buffers the queues may take, #MSG_POOL_SIGNING_RESERVE are left for signing
+* @return free buffers for queued messages
+*/
+uint8_t msgPoolQueueAvailable();
+/**
+* @brief Take a free buffer for a queue and copy message into it, the signing reserve is not touched
+* @param message
+* @return handle or MSG_POOL_NONE if no buffer is available for queues
+*/
+msgPoolHandle msgPoolAllocQueued(const MyMessage &message);
+
+/**
+* @brief Pool buffer owned by a scope, released when it is left
+*/
+class MyPooledMessage {
+public:
+	MyPooledMessage() : handle(msgPoolAlloc()) {}		//!< takes a buffer if one is free
+	~MyPooledMessage() { msgPoolRelease(handle); }		//!< gives it back
+	bool valid() const { return handle != MSG_POOL_NONE; }	//!< false if the pool was exhausted
+	MyMessage &get() { return msgPoolGet(handle); }		//!< message, valid() must be true
+private:
+	MyPooledMessage(const MyPooledMessage &);
+	MyPooledMessage &operator=(const MyPooledMessage &);
+	msgPoolHandle handle;
+};
+#endif
+
+#endif
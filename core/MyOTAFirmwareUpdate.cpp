@@ -25,14 +25,127 @@ bool _fwUpdateOngoing;
 unsigned long _fwLastRequestTime;
 uint16_t _fwBlock;
 uint8_t _fwRetry;
+// Request window covers blocks _fwBlock-1 down to _fwBlock-MY_OTA_WINDOW_SIZE, bit i = block _fwBlock-1-i
+uint16_t _fwWindowReceived;
+uint16_t _fwWindowRequested;
+// Blocks received but not yet written, flash is erased from _fwErasedFrom upwards
+FirmwareQueueItem _fwQueue[MY_OTA_WRITE_QUEUE_SIZE];
+uint8_t _fwQueueHead;
+uint8_t _fwQueueCount;
+uint32_t _fwErasedFrom;
+#ifdef MY_OTA_BROADCAST
+// Update announced by broadcast, received blocks are tracked in the flash bitmap
+bool _fwBroadcast;
+// Still listening to the broadcast stream, no requests sent
+bool _fwBroadcastListen;
+#endif
 
 inline void readFirmwareSettings() {
 	hwReadConfigBlock((void*)&_fc, (void*)EEPROM_FIRMWARE_TYPE_ADDRESS, sizeof(NodeFirmwareConfig));
 }
 
+inline uint8_t firmwareOTAWindow() {
+	return _fwBlock < MY_OTA_WINDOW_SIZE ? (uint8_t)_fwBlock : MY_OTA_WINDOW_SIZE;
+}
+
+inline bool firmwareOTAHaveBlock(uint16_t block) {
+#ifdef MY_OTA_BROADCAST
+	if (_fwBroadcast) {
+		for (uint8_t i = 0; i < _fwQueueCount; i++) {
+			if (_fwQueue[(_fwQueueHead + i) % MY_OTA_WRITE_QUEUE_SIZE].block == block) {
+				return true;
+			}
+		}
+		// erased bitmap bits are 1, cleared once the block is written
+		return !(_flash.readByte(FIRMWARE_BITMAP_OFFSET + (block >> 3)) & (1 << (block & 7)));
+	}
+#else
+	(void)block;
+#endif
+	return false;
+}
+
+inline void firmwareOTAFlushQueue() {
+	while (_fwQueueCount && !_flash.busy()) {
+		FirmwareQueueItem *item = &_fwQueue[_fwQueueHead];
+		const uint32_t address = ((uint32_t)item->block * FIRMWARE_BLOCK_SIZE) + FIRMWARE_DOWNLOAD_OFFSET;
+		if (address < _fwErasedFrom) {
+			// blocks are written top down, erase the next sector below and come back when done
+			_fwErasedFrom -= FIRMWARE_SECTOR_SIZE;
+			_flash.blockErase4K(_fwErasedFrom);
+			continue;
+		}
+		// page program runs in the background, busy() tells when the next one can go
+		_flash.writeBytes(address, item->data, FIRMWARE_BLOCK_SIZE);
+#ifdef MY_OTA_BROADCAST
+		if (_fwBroadcast) {
+			_flash.writeByte(FIRMWARE_BITMAP_OFFSET + (item->block >> 3), ~(1 << (item->block & 7)));
+		}
+#endif
+		_fwQueueHead = (_fwQueueHead + 1) % MY_OTA_WRITE_QUEUE_SIZE;
+		_fwQueueCount--;
+	}
+}
+
+inline void firmwareOTAFinish() {
+	// We're finished! Write what is left, do a checksum and reboot.
+	_fwUpdateOngoing = false;
+	while (_fwQueueCount) {
+		firmwareOTAFlushQueue();
+	}
+	uint16_t fwsize = FIRMWARE_BLOCK_SIZE * _fc.blocks;
+	bool valid = transportIsValidFirmware();
+#ifdef MY_OTA_COMPRESSED
+	valid = valid && firmwareOTADecompress(&fwsize);
+#endif
+	if (valid) {
+		debug(PSTR("fw checksum ok\n"));
+		// All seems ok, write size and signature to flash (DualOptiboot will pick this up and flash it)
+		uint8_t OTAbuffer[10] = {'F','L','X','I','M','G',':',(uint8_t)(fwsize >> 8),(uint8_t)(fwsize & 0xff),':'};
+		_flash.writeBytes(0, OTAbuffer, 10);
+		// Write the new firmware config to eeprom
+		hwWriteConfigBlock((void*)&_fc, (void*)EEPROM_FIRMWARE_TYPE_ADDRESS, sizeof(NodeFirmwareConfig));
+		hwReboot();
+	} else {
+        setIndication(INDICATION_ERR_FW_CHECKSUM);
+		debug(PSTR("fw checksum fail\n"));
+	}
+}
+
+inline void firmwareOTASlideWindow() {
+	// slide window over received blocks
+	while (_fwBlock && ((_fwWindowReceived & 1) || firmwareOTAHaveBlock(_fwBlock - 1))) {
+		_fwWindowReceived >>= 1;
+		_fwWindowRequested >>= 1;
+		_fwBlock--;
+	}
+	if (!_fwBlock) {
+		firmwareOTAFinish();
+	}
+}
+
 inline void firmwareOTAUpdateRequest() {
+	if (!_fwUpdateOngoing) {
+		return;
+	}
+	firmwareOTAFlushQueue();
 	unsigned long enter = hwMillis();
-	if (_fwUpdateOngoing && (enter - _fwLastRequestTime > MY_OTA_RETRY_DELAY)) {
+#ifdef MY_OTA_BROADCAST
+	if (_fwBroadcastListen) {
+		if (enter - _fwLastRequestTime <= MY_OTA_BROADCAST_TIMEOUT) {
+			return;
+		}
+		// broadcast stream ended, request the gaps
+		debug(PSTR("fw bc gaps\n"));
+		_fwBroadcastListen = false;
+		_fwLastRequestTime = enter;
+		firmwareOTASlideWindow();
+		if (!_fwUpdateOngoing) {
+			return;
+		}
+	}
+#endif
+	if (enter - _fwLastRequestTime > MY_OTA_RETRY_DELAY) {
 		if (!_fwRetry) {
             setIndication(INDICATION_ERR_FW_TIMEOUT);
 			debug(PSTR("fw upd fail\n"));
@@ -42,19 +155,44 @@ inline void firmwareOTAUpdateRequest() {
 		}
 		_fwRetry--;
 		_fwLastRequestTime = enter;
-		// Time to (re-)request firmware block from controller
+		// Timeout, re-request all blocks of the window still missing
+		_fwWindowRequested = _fwWindowReceived;
+	}
+	// Request blocks of the window not requested yet (new after sliding, or gaps after timeout)
+	const uint8_t window = firmwareOTAWindow();
+	for (uint8_t i = 0; i < window; i++) {
+		const uint16_t bit = (uint16_t)1 << i;
+		if (_fwWindowRequested & bit) {
+			continue;
+		}
+		_fwWindowRequested |= bit;
 		RequestFWBlock firmwareRequest;
 		firmwareRequest.type = _fc.type;
 		firmwareRequest.version = _fc.version;
-		firmwareRequest.block = (_fwBlock - 1);
-		debug(PSTR("req FW: T=%02X, V=%02X, B=%04X\n"),_fc.type,_fc.version,_fwBlock - 1);
+		firmwareRequest.block = (_fwBlock - 1 - i);
+		if (firmwareOTAHaveBlock(firmwareRequest.block)) {
+			// already received by broadcast
+			_fwWindowReceived |= bit;
+			continue;
+		}
+		debug(PSTR("req FW: T=%02X, V=%02X, B=%04X\n"),_fc.type,_fc.version,firmwareRequest.block);
 		_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_REQUEST, false).set(&firmwareRequest,sizeof(RequestFWBlock)));
 	}
+	if (_fwWindowReceived & 1) {
+		firmwareOTASlideWindow();
+	}
 }
 
 inline bool firmwareOTAUpdateProcess() {
 	if (_msg.type == ST_FIRMWARE_CONFIG_RESPONSE) {
 		NodeFirmwareConfig *firmwareConfigResponse = (NodeFirmwareConfig *)_msg.data;
+#ifdef MY_OTA_BROADCAST
+		// broadcast sessions are for all nodes, only join those for our firmware type
+		const bool broadcast = _msg.destination == BROADCAST_ADDRESS;
+		if (broadcast && firmwareConfigResponse->type != _fc.type) {
+			return true;
+		}
+#endif
 		// compare with current node configuration, if they differ, start fw fetch process
 		if (memcmp(&_fc,firmwareConfigResponse,sizeof(NodeFirmwareConfig))) {
             setIndication(INDICATION_FW_UPDATE_START);
@@ -67,51 +205,83 @@ inline bool firmwareOTAUpdateProcess() {
 				debug(PSTR("flash init fail\n"));
 				_fwUpdateOngoing = false;
 			} else {
-				// erase lower 32K -> max flash size for ATMEGA328
-				_flash.blockErase32K(0);
-				// wait until flash erased
-				while ( _flash.busy() );
+				// sectors are erased lazily just below the image top as blocks come in
+				_fwErasedFrom = (((uint32_t)_fc.blocks * FIRMWARE_BLOCK_SIZE + FIRMWARE_DOWNLOAD_OFFSET +
+				                  FIRMWARE_SECTOR_SIZE - 1) / FIRMWARE_SECTOR_SIZE) * FIRMWARE_SECTOR_SIZE;
+#ifdef MY_OTA_BROADCAST
+				_fwBroadcast = broadcast;
+				_fwBroadcastListen = broadcast;
+				if (broadcast) {
+					// broadcast blocks come in any order, erase download area and bitmap up front
+					_flash.blockErase4K(FIRMWARE_BITMAP_OFFSET);
+					while (_fwErasedFrom > (FIRMWARE_DOWNLOAD_OFFSET / FIRMWARE_SECTOR_SIZE) * FIRMWARE_SECTOR_SIZE) {
+						_fwErasedFrom -= FIRMWARE_SECTOR_SIZE;
+						_flash.blockErase4K(_fwErasedFrom);
+					}
+					while ( _flash.busy() );
+				}
+#endif
+				_fwQueueHead = 0;
+				_fwQueueCount = 0;
 				_fwBlock = _fc.blocks;
 				_fwUpdateOngoing = true;
-				// reset flags
+				// reset flags, the first request goes out on the next call and takes the extra retry
 				_fwRetry = MY_OTA_RETRY+1;
-				_fwLastRequestTime = 0;
+				_fwLastRequestTime = hwMillis() - MY_OTA_RETRY_DELAY - 1;
+#ifdef MY_OTA_BROADCAST
+				if (broadcast) {
+					// listen timeout starts now
+					_fwLastRequestTime = hwMillis();
+				}
+#endif
+				_fwWindowReceived = 0;
+				_fwWindowRequested = 0;
 			}
 			return true;
 		}
 		debug(PSTR("fw update skipped\n"));
 	} else if (_msg.type == ST_FIRMWARE_RESPONSE) {
 		if (_fwUpdateOngoing) {
-			// Save block to flash
-            setIndication(INDICATION_FW_UPDATE_RX);
-			debug(PSTR("fw block %d\n"), _fwBlock);
 			// extract FW block
 			ReplyFWBlock *firmwareResponse = (ReplyFWBlock *)_msg.data;
-			// write to flash
-			_flash.writeBytes( ((_fwBlock - 1) * FIRMWARE_BLOCK_SIZE) + FIRMWARE_START_OFFSET, firmwareResponse->data, FIRMWARE_BLOCK_SIZE);
-			// wait until flash written
-			while ( _flash.busy() );
-			_fwBlock--;
-			if (!_fwBlock) {
-				// We're finished! Do a checksum and reboot.
-				_fwUpdateOngoing = false;
-				if (transportIsValidFirmware()) {
-					debug(PSTR("fw checksum ok\n"));
-					// All seems ok, write size and signature to flash (DualOptiboot will pick this up and flash it)
-					uint16_t fwsize = FIRMWARE_BLOCK_SIZE * _fc.blocks;
-					uint8_t OTAbuffer[10] = {'F','L','X','I','M','G',':',(uint8_t)(fwsize >> 8),(uint8_t)(fwsize & 0xff),':'};
-					_flash.writeBytes(0, OTAbuffer, 10);
-					// Write the new firmware config to eeprom
-					hwWriteConfigBlock((void*)&_fc, (void*)EEPROM_FIRMWARE_TYPE_ADDRESS, sizeof(NodeFirmwareConfig));
-					hwReboot();
-				} else {
-                    setIndication(INDICATION_ERR_FW_CHECKSUM);
-					debug(PSTR("fw checksum fail\n"));
+			if (firmwareResponse->type != _fc.type || firmwareResponse->version != _fc.version) {
+				// block of another firmware (broadcast)
+				return true;
+			}
+			// position of the block in the request window
+			const uint16_t slot = _fwBlock - 1 - firmwareResponse->block;
+			const bool inWindow = firmwareResponse->block < _fwBlock && slot < firmwareOTAWindow();
+			const uint16_t bit = inWindow ? (uint16_t)1 << slot : 0;
+			bool keep = inWindow && !(_fwWindowReceived & bit);
+#ifdef MY_OTA_BROADCAST
+			// broadcast sessions take any block below the window
+			keep = keep || (_fwBroadcast && firmwareResponse->block < _fwBlock && !inWindow);
+#endif
+			if (!keep) {
+				// stale duplicate or outside window
+				debug(PSTR("fw block %d skipped\n"), firmwareResponse->block);
+				return true;
+			}
+			if (!firmwareOTAHaveBlock(firmwareResponse->block)) {
+				if (_fwQueueCount == MY_OTA_WRITE_QUEUE_SIZE) {
+					// flash still busy, block is re-requested on timeout
+					debug(PSTR("fw block %d dropped\n"), firmwareResponse->block);
+					return true;
 				}
+				// Queue block for flash
+				setIndication(INDICATION_FW_UPDATE_RX);
+				debug(PSTR("fw block %d\n"), firmwareResponse->block);
+				FirmwareQueueItem *item = &_fwQueue[(_fwQueueHead + _fwQueueCount) % MY_OTA_WRITE_QUEUE_SIZE];
+				item->block = firmwareResponse->block;
+				memcpy(item->data, firmwareResponse->data, FIRMWARE_BLOCK_SIZE);
+				_fwQueueCount++;
+				firmwareOTAFlushQueue();
 			}
-			// reset flags
+			_fwWindowReceived |= bit;
+			firmwareOTASlideWindow();
+			// reset flags, progress restarts the timeout
 			_fwRetry = MY_OTA_RETRY+1;
-			_fwLastRequestTime = 0;
+			_fwLastRequestTime = hwMillis();
 		} else {
 			debug(PSTR("No fw update ongoing\n"));
 		}
@@ -132,18 +302,119 @@ inline void presentBootloaderInformation(){
 	_fwUpdateOngoing = false;
 	_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_CONFIG_REQUEST, false));	
 }
-// do a crc16 on the whole received firmware
-inline bool transportIsValidFirmware() {
+// crc16 (0xA001) nibble table, two lookups per byte instead of eight shift/xor rounds
+static const uint16_t _fwCrcTable[16] PROGMEM = {
+	0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+	0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+// crc16 over flash content
+inline uint16_t firmwareOTACrc(uint32_t address, uint16_t size) {
 	// init crc
 	uint16_t crc = ~0;
-	for (uint16_t i = 0; i < _fc.blocks * FIRMWARE_BLOCK_SIZE; ++i) {
-		crc ^= _flash.readByte(i + FIRMWARE_START_OFFSET);
-	    for (int8_t j = 0; j < 8; ++j) {
-	        if (crc & 1)
-	            crc = (crc >> 1) ^ 0xA001;
-	        else
-	            crc = (crc >> 1);
-	    }
-	}
-	return crc == _fc.crc;
+	// blocks arrive from the top of the image down (and out of order with a request window)
+	// while the crc runs upwards, so verify after download but read flash in chunks
+	uint8_t buffer[FIRMWARE_BLOCK_SIZE * 2];
+	for (uint16_t pos = 0; pos < size; pos += sizeof(buffer)) {
+		const uint16_t len = (size - pos) < sizeof(buffer) ? (size - pos) : sizeof(buffer);
+		_flash.readBytes(address + pos, buffer, len);
+		for (uint16_t i = 0; i < len; ++i) {
+			crc ^= buffer[i];
+			crc = (crc >> 4) ^ pgm_read_word(&_fwCrcTable[crc & 0x0F]);
+			crc = (crc >> 4) ^ pgm_read_word(&_fwCrcTable[crc & 0x0F]);
+		}
+	}
+	return crc;
+}
+
+// do a crc16 on the whole received firmware
+inline bool transportIsValidFirmware() {
+	return firmwareOTACrc(FIRMWARE_DOWNLOAD_OFFSET, _fc.blocks * FIRMWARE_BLOCK_SIZE) == _fc.crc;
+}
+
+#ifdef MY_OTA_COMPRESSED
+inline bool firmwareOTADecompress(uint16_t *fwsize) {
+	CompressedFWHeader header;
+	uint32_t in = FIRMWARE_COMPRESSED_OFFSET;
+	const uint32_t inEnd = in + (uint32_t)_fc.blocks * FIRMWARE_BLOCK_SIZE;
+	_flash.readBytes(in, &header, sizeof(CompressedFWHeader));
+	in += sizeof(CompressedFWHeader);
+	const uint32_t decodedSize = (uint32_t)header.blocks * FIRMWARE_BLOCK_SIZE;
+	if (decodedSize > 0xFFFF || decodedSize + FIRMWARE_START_OFFSET > FIRMWARE_COMPRESSED_OFFSET) {
+		debug(PSTR("fw decompress size\n"));
+		return false;
+	}
+	const uint16_t size = (uint16_t)decodedSize;
+	// decoded bytes [flushed, out) are still in buffer, below flushed they are in flash
+	uint8_t buffer[FIRMWARE_BLOCK_SIZE];
+	uint16_t out = 0;
+	uint16_t flushed = 0;
+	uint32_t erasedTo = 0;
+	while (out < size) {
+		if (in >= inEnd) {
+			debug(PSTR("fw decompress truncated\n"));
+			return false;
+		}
+		const uint8_t token = _flash.readByte(in++);
+		uint16_t len;
+		uint16_t from = 0;
+		if (token < 0x80) {
+			len = token + 1;
+			if (len > inEnd - in) {
+				debug(PSTR("fw decompress truncated\n"));
+				return false;
+			}
+		} else {
+			len = (token & 0x3F) + 3;
+			if (inEnd - in < 2) {
+				debug(PSTR("fw decompress truncated\n"));
+				return false;
+			}
+			from = _flash.readByte(in) | (_flash.readByte(in + 1) << 8);
+			in += 2;
+			if (!(token & 0x40)) {
+				// distance back into decoded output
+				if (!from || from > out) {
+					debug(PSTR("fw decompress distance\n"));
+					return false;
+				}
+				from = out - from;
+			}
+		}
+		if (len > size - out) {
+			debug(PSTR("fw decompress overrun\n"));
+			return false;
+		}
+		while (len--) {
+			uint8_t value;
+			if (token < 0x80) {
+				value = _flash.readByte(in++);
+			} else if (token & 0x40) {
+				value = pgm_read_byte((const uint8_t *)(uintptr_t)from);
+				from++;
+			} else {
+				value = from >= flushed ? buffer[from - flushed] : _flash.readByte(from + FIRMWARE_START_OFFSET);
+				from++;
+			}
+			buffer[out - flushed] = value;
+			out++;
+			if (out - flushed == sizeof(buffer) || out == size) {
+				// image area is erased just ahead of the output
+				const uint32_t address = flushed + FIRMWARE_START_OFFSET;
+				while (erasedTo < address + (out - flushed)) {
+					_flash.blockErase4K(erasedTo);
+					erasedTo += FIRMWARE_SECTOR_SIZE;
+				}
+				_flash.writeBytes(address, buffer, out - flushed);
+				flushed = out;
+			}
+		}
+	}
+	if (firmwareOTACrc(FIRMWARE_START_OFFSET, size) != header.crc) {
+		debug(PSTR("fw decompress crc\n"));
+		return false;
+	}
+	*fwsize = size;
+	return true;
 }
+#endif
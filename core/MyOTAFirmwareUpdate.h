@@ -21,6 +21,7 @@
 #define MyOTAFirmwareUpdate_h
 
 #include "MySensorsCore.h"
+#include "MyTransport.h"
 
 // Size of each firmware block
 #define FIRMWARE_BLOCK_SIZE	16
@@ -30,6 +31,23 @@
 #define MY_OTA_RETRY 5
 // Number of millisecons before re-request a fw block
 #define MY_OTA_RETRY_DELAY 500
+#if MY_OTA_WINDOW_SIZE < 1 || MY_OTA_WINDOW_SIZE > 16
+#error MY_OTA_WINDOW_SIZE must be between 1 and 16
+#endif
+#if MY_OTA_WRITE_QUEUE_SIZE < 1
+#error MY_OTA_WRITE_QUEUE_SIZE must be at least 1
+#endif
+// Start offset for compressed firmware download in flash, decoded image has to fit below
+#define FIRMWARE_COMPRESSED_OFFSET 0x10000
+#ifdef MY_OTA_COMPRESSED
+	#define FIRMWARE_DOWNLOAD_OFFSET FIRMWARE_COMPRESSED_OFFSET
+#else
+	#define FIRMWARE_DOWNLOAD_OFFSET FIRMWARE_START_OFFSET
+#endif
+// Start offset of the received block bitmap in flash (broadcast sessions)
+#define FIRMWARE_BITMAP_OFFSET 0x20000
+// Flash erase granularity
+#define FIRMWARE_SECTOR_SIZE 4096
 // Start offset for firmware in flash (DualOptiboot wants to keeps a signature first)
 #define FIRMWARE_START_OFFSET 10
 // Bootloader version
@@ -70,6 +88,24 @@ typedef struct {
 	uint8_t data[FIRMWARE_BLOCK_SIZE]; //!< Block data
 } __attribute__((packed)) ReplyFWBlock;
 
+/// @brief Header of a compressed FW image, see @ref MY_OTA_COMPRESSED
+typedef struct {
+	uint16_t blocks; //!< Number of blocks of the decoded image
+	uint16_t crc; //!< CRC of the decoded image
+} __attribute__((packed)) CompressedFWHeader;
+
+/// @brief FW block waiting to be written to flash
+typedef struct {
+	uint16_t block; //!< Block index
+	uint8_t data[FIRMWARE_BLOCK_SIZE]; //!< Block data
+} __attribute__((packed)) FirmwareQueueItem;
+
+/// @brief FW block cached by repeaters and GW, see MY_TRANSPORT_FW_CACHE_SIZE
+typedef struct {
+	ReplyFWBlock reply; //!< Forwarded reply
+	uint8_t servedTo; //!< Node last answered from cache, BROADCAST_ADDRESS if none
+} __attribute__((packed)) FirmwareCacheItem;
+
 
 /**
  * @brief Read firmware settings from EEPROM
@@ -77,6 +113,22 @@ typedef struct {
  * Current firmware settings (type, version, crc, blocks) are read into _fc
  */
 void readFirmwareSettings();
+/**
+ * @brief Check if a FW block of a broadcast session is already queued or in flash
+ */
+bool firmwareOTAHaveBlock(uint16_t block);
+/**
+ * @brief Erase flash ahead of and write queued FW blocks, without waiting for the flash
+ */
+void firmwareOTAFlushQueue();
+/**
+ * @brief Verify and hand over received FW to the bootloader
+ */
+void firmwareOTAFinish();
+/**
+ * @brief Move request window down over received blocks, finish when all are in
+ */
+void firmwareOTASlideWindow();
 /**
  * @brief Handle OTA FW update requests
  */
@@ -93,6 +145,13 @@ bool firmwareOTAUpdateProcess();
  * This function verifies if uploaded FW CRC is valid
  */
 bool transportIsValidFirmware();
+/**
+ * @brief Decode compressed FW from flash into the DualOptiboot image area
+ *
+ * @param fwsize Returns size of the decoded image
+ * @return true if decoded image is complete and its CRC is valid
+ */
+bool firmwareOTADecompress(uint16_t *fwsize);
 /**
  * @brief Present bootloader/FW information upon startup 
  */
@@ -23,12 +23,66 @@
 #include "MySensorsCore.h"
 
 
+// state of incremental parser, one per input stream
+typedef struct {
+	uint8_t field : 3;		// current field, 0=destination ... 5=payload
+	bool started : 1;		// current field has content
+	bool skip : 1;			// non-digit in numeric field, ignore rest of field
+	bool lowNibble : 1;		// C_STREAM payload: next hex digit is low nibble
+	uint8_t value;			// numeric field accumulator
+	uint8_t length;			// payload length
+} protocolParser;
+
+// binary frame: sync, length, raw message (header + payload), crc8 over length and message
+#define PROTOCOL_BINARY_SYNC 0xA5
+#define PROTOCOL_BINARY_OVERHEAD 3
+
+// state of binary frame parser, one per input stream
+typedef struct {
+	uint8_t pos;			// bytes of current frame received, 0=waiting for sync
+	uint8_t length;			// frame length (header + payload)
+	uint8_t crc;			// running crc8
+} protocolBinaryParser;
+
+// parser type used by gateway transports
+#if defined(MY_GATEWAY_BINARY_PROTOCOL)
+	typedef protocolBinaryParser protocolGatewayParser;
+#else
+	typedef protocolParser protocolGatewayParser;
+#endif
+
 // parse(message, inputString)
 // parse a string into a message element
 // returns true if successfully parsed the input string
 bool protocolParse(MyMessage &message, char *inputString);
 
+// protocolParseChar(parser, message, c)
+// feed one character of a line into parser, message fields are set as they arrive
+// returns true if c completed a valid message
+bool protocolParseChar(protocolParser &parser, MyMessage &message, char c);
+
+// reset parser to start of line
+void protocolParseReset(protocolParser &parser);
+
+// protocolParsePayload(message, payload, length)
+// set payload of a message whose header fields are already set, as last field of a line
+// returns true if message is valid
+bool protocolParsePayload(MyMessage &message, const char *payload, unsigned int length);
+
 // Format MyMessage to the protocol represenataion
 char *protocolFormat(MyMessage &message);
 
+// protocolParseChar(parser, message, c)
+// feed one byte of a binary frame into parser, message is written as frame arrives
+// returns true if c completed a frame with valid length and crc
+bool protocolParseChar(protocolBinaryParser &parser, MyMessage &message, char c);
+
+// reset binary parser, wait for next sync byte
+void protocolParseReset(protocolBinaryParser &parser);
+
+// protocolFormatGateway(message, length)
+// format message for the gateway link, ASCII line or binary frame if MY_GATEWAY_BINARY_PROTOCOL
+// returns formatted data, length is set to number of bytes
+uint8_t *protocolFormatGateway(MyMessage &message, uint8_t &length);
+
 #endif
@@ -22,77 +22,114 @@
 #include "MyProtocol.h"
 
 uint8_t protocolH2i(char c);
+void protocolParseField(protocolParser &parser, MyMessage &message);
+uint8_t protocolCrc8(uint8_t crc, uint8_t data);
 
 char _fmtBuffer[MY_GATEWAY_MAX_SEND_LENGTH];
 char _convBuffer[MAX_PAYLOAD*2+1];
 
 bool protocolParse(MyMessage &message, char *inputString) {
-	char *str, *p, *value=NULL;
-	uint8_t bvalue[MAX_PAYLOAD];
-	uint8_t blen = 0;
-	int i = 0;
-	uint8_t command = 0;
-	uint8_t ack = 0;
-
-	// Extract command data coming on serial line
-	for (str = strtok_r(inputString, ";", &p); // split using semicolon
-		str && i < 6; // loop while str is not null an max 5 times
-		str = strtok_r(NULL, ";", &p) // get subsequent tokens
-			) {
-		switch (i) {
-			case 0: // Radioid (destination)
-				message.destination = atoi(str);
-				break;
-			case 1: // Childid
-				message.sensor = atoi(str);
-				break;
-			case 2: // Message type
-				command = atoi(str);
-				mSetCommand(message, command);
-				break;
-			case 3: // Should we request ack from destination?
-				ack = atoi(str);
-				break;
-			case 4: // Data type
-				message.type = atoi(str);
-				break;
-			case 5: // Variable value
-				if (command == C_STREAM) {
-					blen = 0;
-					uint8_t val;
-					while (*str) {
-						val = protocolH2i(*str++) << 4;
-						val += protocolH2i(*str++);
-						bvalue[blen] = val;
-						blen++;
-					}
-				} else {
-					value = str;
-					// Remove trailing carriage return and newline character (if it exists)
-					uint8_t lastCharacter = strlen(value)-1;
-					if (value[lastCharacter] == '\r')
-						value[lastCharacter] = 0;
-					if (value[lastCharacter] == '\n')
-						value[lastCharacter] = 0;
-				}
-				break;
-		}
-		i++;
+	protocolParser parser;
+	protocolParseReset(parser);
+	while (*inputString) {
+		if (protocolParseChar(parser, message, *inputString++)) return true;
 	}
-	//debug(PSTR("Received %d"), i);
-	// Check for invalid input
-	if (i < 5)
-		return false;
+	// line without terminator
+	return protocolParseChar(parser, message, '\n');
+}
 
-	message.sender = GATEWAY_ADDRESS;
-	message.last = GATEWAY_ADDRESS;
-    mSetRequestAck(message, ack?1:0);
-    mSetAck(message, false);
-	if (command == C_STREAM)
-		message.set(bvalue, blen);
-	else
-		message.set(value);
-	return true;
+void protocolParseReset(protocolParser &parser) {
+	memset(&parser, 0, sizeof(protocolParser));
+}
+
+bool protocolParsePayload(MyMessage &message, const char *payload, unsigned int length) {
+	protocolParser parser;
+	protocolParseReset(parser);
+	// destination to data type are known
+	parser.field = 5;
+	while (length--) {
+		(void)protocolParseChar(parser, message, *payload++);
+	}
+	return protocolParseChar(parser, message, '\n');
+}
+
+// store numeric field
+void protocolParseField(protocolParser &parser, MyMessage &message) {
+	switch (parser.field) {
+		case 0: // Radioid (destination)
+			message.destination = parser.value;
+			break;
+		case 1: // Childid
+			message.sensor = parser.value;
+			break;
+		case 2: // Message type
+			mSetCommand(message, parser.value);
+			break;
+		case 3: // Should we request ack from destination?
+			mSetRequestAck(message, parser.value?1:0);
+			break;
+		case 4: // Data type
+			message.type = parser.value;
+			break;
+	}
+}
+
+bool protocolParseChar(protocolParser &parser, MyMessage &message, char c) {
+	if (c == '\n' || c == '\r') {
+		// end of line, at least destination to data type are required
+		const bool ok = parser.field == 5 || (parser.field == 4 && parser.started);
+		if (ok) {
+			if (parser.field == 4) {
+				protocolParseField(parser, message);
+			}
+			message.sender = GATEWAY_ADDRESS;
+			message.last = GATEWAY_ADDRESS;
+			mSetAck(message, false);
+			mSetLength(message, parser.length);
+			if (mGetCommand(message) == C_STREAM) {
+				mSetPayloadType(message, P_CUSTOM);
+			} else {
+				mSetPayloadType(message, P_STRING);
+				// null terminate string
+				message.data[parser.length] = 0;
+			}
+		}
+		protocolParseReset(parser);
+		return ok;
+	}
+	if (parser.field < 5) {
+		if (c == ';') {
+			// empty fields are skipped
+			if (parser.started) {
+				protocolParseField(parser, message);
+				parser.field++;
+				parser.started = false;
+				parser.skip = false;
+				parser.value = 0;
+			}
+		} else {
+			parser.started = true;
+			if (c < '0' || c > '9') {
+				parser.skip = true;
+			} else if (!parser.skip) {
+				parser.value = parser.value * 10 + (c - '0');
+			}
+		}
+	}
+	else if (parser.length < MAX_PAYLOAD && c) {
+		// Variable value, written to payload directly
+		if (mGetCommand(message) == C_STREAM) {
+			if (parser.lowNibble) {
+				message.data[parser.length++] += protocolH2i(c);
+			} else {
+				message.data[parser.length] = protocolH2i(c) << 4;
+			}
+			parser.lowNibble = !parser.lowNibble;
+		} else {
+			message.data[parser.length++] = c;
+		}
+	}
+	return false;
 }
 
 char * protocolFormat(MyMessage &message) {
@@ -100,6 +137,81 @@ char * protocolFormat(MyMessage &message) {
 	return _fmtBuffer;
 }
 
+void protocolParseReset(protocolBinaryParser &parser) {
+	memset(&parser, 0, sizeof(protocolBinaryParser));
+}
+
+bool protocolParseChar(protocolBinaryParser &parser, MyMessage &message, char c) {
+	const uint8_t b = (uint8_t)c;
+	if (parser.pos == 0) {
+		// skip anything until sync, i.e. debug output
+		parser.pos = b == PROTOCOL_BINARY_SYNC;
+		return false;
+	}
+	if (parser.pos == 1) {
+		if (b < HEADER_SIZE || b > HEADER_SIZE + MAX_PAYLOAD) {
+			// invalid length, resync (length could be sync)
+			parser.pos = b == PROTOCOL_BINARY_SYNC;
+			return false;
+		}
+		parser.length = b;
+		parser.crc = protocolCrc8(0, b);
+		parser.pos++;
+		return false;
+	}
+	if (parser.pos < parser.length + 2) {
+		// header and payload are written to message directly
+		((uint8_t *)&message)[parser.pos - 2] = b;
+		parser.crc = protocolCrc8(parser.crc, b);
+		parser.pos++;
+		return false;
+	}
+	// crc byte, frame length has to match payload length in header
+	const bool ok = b == parser.crc && parser.length == HEADER_SIZE + mGetLength(message);
+	protocolParseReset(parser);
+	if (ok) {
+		message.sender = GATEWAY_ADDRESS;
+		message.last = GATEWAY_ADDRESS;
+		mSetAck(message, false);
+		// null terminate string
+		message.data[mGetLength(message)] = 0;
+	}
+	return ok;
+}
+
+uint8_t *protocolFormatGateway(MyMessage &message, uint8_t &length) {
+	#if defined(MY_GATEWAY_BINARY_PROTOCOL)
+		uint8_t *frame = (uint8_t *)_fmtBuffer;
+		const uint8_t frameLength = HEADER_SIZE + mGetLength(message);
+		uint8_t crc = protocolCrc8(0, frameLength);
+		frame[0] = PROTOCOL_BINARY_SYNC;
+		frame[1] = frameLength;
+		for (uint8_t i = 0; i < frameLength; i++) {
+			frame[i + 2] = ((uint8_t *)&message)[i];
+			crc = protocolCrc8(crc, frame[i + 2]);
+		}
+		frame[frameLength + 2] = crc;
+		length = frameLength + PROTOCOL_BINARY_OVERHEAD;
+		return frame;
+	#else
+		char *line = protocolFormat(message);
+		length = strlen(line);
+		return (uint8_t *)line;
+	#endif
+}
+
+// crc8, polynomial 0x31 reflected (Dallas/Maxim)
+uint8_t protocolCrc8(uint8_t crc, uint8_t data) {
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++) {
+		if (crc & 1)
+			crc = (crc >> 1) ^ 0x8C;
+		else
+			crc >>= 1;
+	}
+	return crc;
+}
+
 uint8_t protocolH2i(char c) {
 	uint8_t i = 0;
 	if (c <= '9')
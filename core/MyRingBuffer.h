@@ -0,0 +1,74 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * Lock-free single producer/single consumer ring, e.g. for frames passed from an
+ * ISR to the main loop.
+ */
+
+#ifndef MyRingBuffer_h
+#define MyRingBuffer_h
+
+// slot content is written before the index that hands it over
+#define RING_BUFFER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/**
+* @brief Ring of CAPACITY slots (power of two, max 128) for one producer and one consumer
+*
+* The producer only writes the head index, the consumer only the tail index. Both are
+* single bytes, i.e. updated atomically on AVR, and run freely, the fill level is head - tail.
+* Slots are filled and read in place: back() / push() on the producer side, front() / pop()
+* on the consumer side.
+*/
+template <typename T, uint8_t CAPACITY>
+class MyRingBuffer {
+public:
+	MyRingBuffer() : _head(0), _tail(0) {}
+	bool empty() const { return _head == _tail; }						//!< no slot filled
+	bool full() const { return (uint8_t)(_head - _tail) == CAPACITY; }	//!< no slot free
+	uint8_t count() const { return _head - _tail; }						//!< filled slots
+	/**
+	* @brief Producer: free slot to fill
+	* @return slot or NULL if full
+	*/
+	T *back() { return full() ? NULL : &_data[_head & (CAPACITY - 1)]; }
+	/**
+	* @brief Producer: hand the slot returned by back() to the consumer
+	*/
+	void push() { RING_BUFFER_BARRIER(); _head = _head + 1; }
+	/**
+	* @brief Consumer: oldest filled slot
+	* @return slot or NULL if empty
+	*/
+	T *front() { return empty() ? NULL : &_data[_tail & (CAPACITY - 1)]; }
+	/**
+	* @brief Consumer: release the slot returned by front() to the producer
+	*/
+	void pop() { RING_BUFFER_BARRIER(); _tail = _tail + 1; }
+	/**
+	* @brief Consumer: release all filled slots
+	*/
+	void clear() { RING_BUFFER_BARRIER(); _tail = _head; }
+private:
+	// compile error here: CAPACITY must be a power of two, max 128
+	typedef char capacityCheck[(CAPACITY && CAPACITY <= 128 && !(CAPACITY & (CAPACITY - 1))) ? 1 : -1];
+	T _data[CAPACITY];
+	volatile uint8_t _head;
+	volatile uint8_t _tail;
+};
+
+#endif
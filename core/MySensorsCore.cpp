@@ -32,25 +32,455 @@ bool _nodeRegistered = false;
 
 void (*_timeCallback)(unsigned long); // Callback for requested time messages
 
+#if defined(MY_WARM_BOOT)
+	static bool _presentationHashing = false;	// presentNode() dry run, messages are hashed instead of sent
+	static uint16_t _presentationHash;
+	static bool _presentationConfirmed = false;	// controller answered the I_CONFIG request
+#endif
+
+#if defined(MY_SMART_SLEEP_PENDING)
+	uint8_t _smartSleepPending = SMART_SLEEP_PENDING_UNKNOWN;	// messages announced by I_PENDING, not yet received
+#endif
+
+#if defined(MY_STATS_FEATURE)
+	NodeStats _stats;
+	static uint32_t _statsSleepBase = 0;	// hwSleptMillis() at last reset
+#endif
+
+#if defined(MY_TIME_SERVICE)
+	static unsigned long _timeSyncSeconds = 0;	// controller time at last sync, 0: not synchronised
+	static uint32_t _timeSyncMillis = 0;	// local time at last sync
+	static uint32_t _timeRequestMillis = 0;	// local time of the last request
+	static bool _timeRequested = false;
+	static float _timeDrift = 0;		// local clock error (local - controller) / controller
+	static float _timeUncertainty = MY_TIME_DRIFT_PPM * 1e-6f;	// rate the error bound grows at
+	#define TIME_REQUEST_RETRY_MS 60000	// unanswered request
+
+	static uint32_t _timeMillis() {
+		// hwMillis() stops during sleep on AVR
+		return hwMillis() + hwSleptMillis();
+	}
+
+	unsigned long timeNow() {
+		if (!_timeSyncSeconds) return 0;
+		const uint32_t elapsed = _timeMillis() - _timeSyncMillis;
+		return _timeSyncSeconds + (elapsed - (long)(elapsed * _timeDrift)) / 1000;
+	}
+
+	unsigned long timeError() {
+		if (!_timeSyncSeconds) return 0xFFFFFFFF;
+		// resolution of controller time plus the uncorrected drift
+		return 1000 + (unsigned long)((_timeMillis() - _timeSyncMillis) * _timeUncertainty);
+	}
+
+	static void _timeSync(unsigned long seconds) {
+		const uint32_t now = _timeMillis();
+		_timeRequested = false;
+		if (!seconds) return;
+		const uint32_t elapsed = now - _timeSyncMillis;
+		// take the drift from intervals long compared to the 1s resolution
+		if (_timeSyncSeconds && elapsed >= 60000UL && elapsed < 0x7FFFFFFFUL) {
+			// ms local (corrected) time ran ahead
+			const long error = (long)(elapsed - (long)(elapsed * _timeDrift)) - (long)(seconds - _timeSyncSeconds) * 1000L;
+			// a step of the controller clock is no drift
+			if (labs(error) < (long)(elapsed / 4)) {
+				_timeDrift += (float)error / elapsed / 2;
+				// what is left beyond the resolution could not be corrected
+				const float residual = (labs(error) > 1000 ? labs(error) - 1000 : 0) / (float)elapsed;
+				_timeUncertainty = (_timeUncertainty + residual) / 2;
+				// crystal tolerance
+				if (_timeUncertainty < 20e-6f) _timeUncertainty = 20e-6f;
+			}
+		}
+		debug(PSTR("MCO:TIM:SYNC,T=%lu,D=%ld\n"), seconds, (long)(_timeDrift * 1e6f));	// drift in ppm
+		_timeSyncSeconds = seconds;
+		_timeSyncMillis = now;
+	}
+
+	static void _timeProcess() {
+		#if !defined(MY_GATEWAY_FEATURE)
+			if (!isTransportReady()) return;
+		#endif
+		if (_timeSyncSeconds && timeError() <= MY_TIME_MAX_ERROR_MS) return;
+		if (_timeRequested && _timeMillis() - _timeRequestMillis < TIME_REQUEST_RETRY_MS) return;
+		_timeRequested = true;
+		_timeRequestMillis = _timeMillis();
+		(void)_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_TIME, false).set(""));
+	}
+
+	bool _timeAnswer(const MyMessage &request) {
+		// only with half the error budget left, the child's own bound starts at the resolution again
+		if (!_timeSyncSeconds || timeError() > MY_TIME_MAX_ERROR_MS / 2) return false;
+		return _sendRoute(build(_msgTmp, _nc.nodeId, request.sender, NODE_SENSOR_ID, C_INTERNAL, I_TIME, false).set((uint32_t)timeNow()));
+	}
+#endif
+
+#if defined(MY_ENERGY_FEATURE)
+	static NodeEnergy _energy;
+	static uint32_t _energyMillis = 0;	// hwMillis() at last update
+	static uint32_t _energySleptMillis = 0;	// hwSleptMillis() at last update
+	static uint32_t _energyRadioSince = 0;	// hwMillis() when the radio was powered up, or counted up to
+	static uint32_t _energySignerSince = 0;
+	static uint32_t _energyTxStart = 0;	// hwMicros()
+	static uint16_t _energyTxRest = 0;	// us of TX not yet taken off rxMs
+	static bool _energyRadioOn = false;
+	static bool _energySignerAwake = false;
+
+	void _energyRadio(bool on) {
+		if (on == _energyRadioOn) return;
+		const uint32_t now = hwMillis();
+		if (!on) _energy.rxMs += now - _energyRadioSince;
+		_energyRadioSince = now;
+		_energyRadioOn = on;
+	}
+
+	void _energyTxBegin() {
+		_energyRadio(true);
+		_energyTxStart = hwMicros();
+	}
+
+	void _energyTxEnd() {
+		const uint32_t us = hwMicros() - _energyTxStart;
+		_energy.txUs += us;
+		_energy.txCount++;
+		// the radio interval includes the transmission, take whole ms off the listen time
+		_energyTxRest += us % 1000;
+		_energy.rxMs -= us / 1000 + _energyTxRest / 1000;
+		_energyTxRest %= 1000;
+	}
+
+	void _energySigner(bool awake) {
+		if (awake == _energySignerAwake) return;
+		const uint32_t now = hwMillis();
+		if (!awake) _energy.signingMs += now - _energySignerSince;
+		_energySignerSince = now;
+		_energySignerAwake = awake;
+	}
+
+	void _energySlept(uint32_t ms) {
+		// sleep counted by hwMillis() (delay based HALs) is no awake time
+		_energy.sleepMs += ms;
+		_energy.awakeMs -= ms;
+	}
+
+	static void _energyUpdate() {
+		const uint32_t now = hwMillis();
+		const uint32_t slept = hwSleptMillis();
+		_energy.awakeMs += now - _energyMillis;
+		_energy.sleepMs += slept - _energySleptMillis;
+		_energyMillis = now;
+		_energySleptMillis = slept;
+		if (_energyRadioOn) {
+			_energy.rxMs += now - _energyRadioSince;
+			_energyRadioSince = now;
+		}
+		if (_energySignerAwake) {
+			_energy.signingMs += now - _energySignerSince;
+			_energySignerSince = now;
+		}
+	}
+#endif
+
+#if defined(MY_PROFILE_FEATURE)
+	struct profileStage {
+		uint32_t sum;
+		uint16_t count;
+		uint16_t min;
+		uint16_t max;
+		uint8_t histogram[PROFILE_BUCKETS];
+	};
+	static profileStage _profile[PROFILE_STAGES];
+	static unsigned long _profileLast = 0;	// hwMicros() when _process() returned
+
+	static void _profileAdd(uint8_t stage, unsigned long duration) {
+		profileStage &p = _profile[stage];
+		const uint16_t us = min(duration, 0xFFFF);
+		if (p.count == 0xFFFF) {
+			// keep average, make room
+			p.count >>= 1;
+			p.sum >>= 1;
+		}
+		if (!p.count || us < p.min) p.min = us;
+		p.count++;
+		p.sum += us;
+		if (us > p.max) p.max = us;
+		uint8_t bucket = 0;
+		// unsaturated, the last bucket holds durations of 65ms and more
+		for (unsigned long d = duration >> 4; d && bucket < PROFILE_BUCKETS - 1; d >>= 2) bucket++;
+		if (p.histogram[bucket] == 0xFF) {
+			for (uint8_t i = 0; i < PROFILE_BUCKETS; i++) p.histogram[i] >>= 1;
+		}
+		p.histogram[bucket]++;
+	}
+
+	static void _profileReport() {
+		for (uint8_t i = 0; i < PROFILE_STAGES; i++) {
+			const profileStage &p = _profile[i];
+			if (!p.count) continue;
+			ProfileReport report;
+			report.stage = i;
+			report.count = p.count;
+			report.min = p.min;
+			report.avg = p.sum / p.count;
+			report.max = p.max;
+			memcpy(report.histogram, p.histogram, PROFILE_BUCKETS);
+			debug(PSTR("PRF:%d,n=%u,min=%u,avg=%u,max=%u\n"), i, report.count, report.min, report.avg, report.max);
+			_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_PROFILE, false).set(&report, sizeof(ProfileReport)));
+		}
+	}
+
+	#define PROFILE_STAGE(__stage) { const unsigned long __now = hwMicros(); _profileAdd(__stage, __now - _profileStart); _profileStart = __now; }	//!< close stage
+#else
+	#define PROFILE_STAGE(__stage)
+#endif
+
+#if defined(MY_LOADTEST_FEATURE) && defined(MY_GATEWAY_FEATURE)
+	struct loadTestNode {
+		uint8_t nodeId;
+		uint32_t base;		// first sequence number accounted, earlier ones were never counted as lost
+		uint32_t highest;	// highest sequence number received
+		uint32_t window;	// bit n: sequence number highest - n received
+		uint16_t received;
+		uint16_t lost;
+		uint16_t reordered;
+		uint16_t duplicates;
+		uint16_t rtts;
+		uint16_t rttMin;
+		uint16_t rttMax;
+		uint16_t histogram[LOADTEST_BUCKETS];
+	};
+	static loadTestNode _loadTest[MY_LOADTEST_NODES];
+
+	static void _loadTestAccount(uint8_t sender, const LoadTestProbe &probe) {
+		loadTestNode *node = NULL;
+		for (uint8_t i = 0; i < MY_LOADTEST_NODES && !node; i++) {
+			if (_loadTest[i].received && _loadTest[i].nodeId == sender) node = &_loadTest[i];
+		}
+		for (uint8_t i = 0; i < MY_LOADTEST_NODES && !node; i++) {
+			if (!_loadTest[i].received) node = &_loadTest[i];
+		}
+		if (!node) return;	// table full
+		if (!node->received || !probe.seq) {
+			// first probe or node restarted, earlier sequence numbers are unknown
+			memset(node, 0, sizeof(loadTestNode));
+			node->nodeId = sender;
+			node->base = probe.seq;
+			node->highest = probe.seq;
+			node->window = 1;
+		}
+		else if (probe.seq < node->base) {
+			// sent before the first probe accounted, late or reordered
+			return;
+		}
+		else if (probe.seq > node->highest) {
+			const uint32_t gap = probe.seq - node->highest;
+			node->lost += gap - 1;
+			node->window = gap < 32 ? node->window << gap | 1 : 1;
+			node->highest = probe.seq;
+		}
+		else {
+			const uint32_t age = node->highest - probe.seq;
+			if (age < 32) {
+				if (node->window & (1UL << age)) {
+					node->duplicates++;
+					return;
+				}
+				node->window |= 1UL << age;
+				node->lost--;
+			}
+			node->reordered++;
+		}
+		node->received++;
+		if (probe.rtt == LOADTEST_NO_RTT) return;
+		if (!node->rtts || probe.rtt < node->rttMin) node->rttMin = probe.rtt;
+		if (probe.rtt > node->rttMax) node->rttMax = probe.rtt;
+		node->rtts++;
+		uint8_t bucket = 0;
+		for (uint16_t d = probe.rtt >> 3; d && bucket < LOADTEST_BUCKETS - 1; d >>= 1) bucket++;
+		if (node->histogram[bucket] == 0xFFFF) {
+			for (uint8_t i = 0; i < LOADTEST_BUCKETS; i++) node->histogram[i] >>= 1;
+		}
+		node->histogram[bucket]++;
+	}
+
+	// upper bound of the bucket holding the percentile
+	static uint16_t _loadTestPercentile(const loadTestNode &node, uint8_t percent) {
+		uint32_t total = 0;
+		for (uint8_t i = 0; i < LOADTEST_BUCKETS; i++) total += node.histogram[i];
+		if (!total) return LOADTEST_NO_RTT;
+		uint32_t count = 0;
+		for (uint8_t i = 0; i < LOADTEST_BUCKETS - 1; i++) {
+			count += node.histogram[i];
+			const uint16_t bound = 8 << i;
+			if (count * 100 >= total * percent) return bound < node.rttMax ? bound : node.rttMax;
+		}
+		return node.rttMax;
+	}
+
+	static void _loadTestReport() {
+		for (uint8_t i = 0; i < MY_LOADTEST_NODES; i++) {
+			const loadTestNode &node = _loadTest[i];
+			if (!node.received) continue;
+			LoadTestReport report;
+			report.nodeId = node.nodeId;
+			report.received = node.received;
+			report.lost = node.lost;
+			report.reordered = node.reordered;
+			report.duplicates = node.duplicates;
+			report.rttMin = node.rtts ? node.rttMin : LOADTEST_NO_RTT;
+			report.rttP50 = _loadTestPercentile(node, 50);
+			report.rttP90 = _loadTestPercentile(node, 90);
+			report.rttP99 = _loadTestPercentile(node, 99);
+			report.rttMax = node.rtts ? node.rttMax : LOADTEST_NO_RTT;
+			debug(PSTR("LDT:%d,rx=%u,lost=%u,reord=%u,dup=%u,rtt=%u/%u/%u/%u/%u\n"), report.nodeId, report.received, report.lost,
+				report.reordered, report.duplicates, report.rttMin, report.rttP50, report.rttP90, report.rttP99, report.rttMax);
+			_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_LOADTEST, false).set(&report, sizeof(LoadTestReport)));
+		}
+	}
+#elif defined(MY_LOADTEST_FEATURE)
+	static uint32_t _loadTestSeq = 0;
+	static uint16_t _loadTestRtt = LOADTEST_NO_RTT;	// of the last probe sent
+
+	bool sendLoadTestProbe(void) {
+		LoadTestProbe probe;
+		probe.seq = _loadTestSeq++;
+		probe.timestamp = hwMillis();
+		probe.rtt = _loadTestRtt;
+		_loadTestRtt = LOADTEST_NO_RTT;
+		return _sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_LOADTEST, false).set(&probe, sizeof(LoadTestProbe)));
+	}
+#endif
+
+#if defined(MY_TASKS)
+	typedef struct {
+		void (*task)(void);
+		unsigned long period;	// 0: run once
+		unsigned long due;
+	} coopTask;
+
+	static coopTask _tasks[MY_TASKS];
+	static bool _tasksRunning = false;
+
+	static bool _schedule(void (*task)(void), unsigned long period, unsigned long delay) {
+		coopTask *slot = NULL;
+		for (uint8_t i = 0; i < MY_TASKS; i++) {
+			if (_tasks[i].task == task) {
+				slot = &_tasks[i];
+				break;
+			}
+			if (!_tasks[i].task && !slot) slot = &_tasks[i];
+		}
+		if (!slot) return false;
+		slot->task = task;
+		slot->period = period;
+		slot->due = hwMillis() + delay;
+		return true;
+	}
+
+	bool scheduleEvery(void (*task)(void), unsigned long period, unsigned long delay) {
+		return _schedule(task, period ? period : 1, delay);
+	}
+
+	bool scheduleAfter(void (*task)(void), unsigned long delay) {
+		return _schedule(task, 0, delay);
+	}
+
+	void unschedule(void (*task)(void)) {
+		for (uint8_t i = 0; i < MY_TASKS; i++) {
+			if (_tasks[i].task == task) _tasks[i].task = NULL;
+		}
+	}
+
+	// run the due task with the earliest deadline, one per call keeps the radio serviced in between
+	static void _tasksProcess() {
+		if (_tasksRunning) return;	// task called wait()
+		const unsigned long now = hwMillis();
+		coopTask *next = NULL;
+		for (uint8_t i = 0; i < MY_TASKS; i++) {
+			coopTask &t = _tasks[i];
+			if (t.task && (long)(now - t.due) >= 0 && (!next || (long)(t.due - next->due) < 0)) next = &t;
+		}
+		if (!next) return;
+		void (*task)(void) = next->task;
+		if (next->period) {
+			next->due += next->period;
+			// overrun, missed periods are not caught up
+			if ((long)(now - next->due) >= 0) next->due = now + next->period;
+		}
+		else {
+			// before running, the task may schedule itself again
+			next->task = NULL;
+		}
+		_tasksRunning = true;
+		task();
+		_tasksRunning = false;
+	}
+#endif
+
+#if defined(MY_REPORT_POLICIES)
+	static void _reportProcess();
+#endif
+
 void _process() {
 	hwWatchdogReset();
 
+	#if defined(MY_PROFILE_FEATURE)
+		unsigned long _profileStart = hwMicros();
+		if (_profileLast) _profileAdd(PROFILE_LOOP, _profileStart - _profileLast);
+	#endif
+
+	#if defined(MY_STATS_FEATURE)
+		static unsigned long lastProcess = 0;
+		const unsigned long now = hwMillis();
+		if (lastProcess && now - lastProcess > _stats.maxLoopMs) _stats.maxLoopMs = min(now - lastProcess, 0xFFFF);
+		lastProcess = now;
+	#endif
+
 	#if defined (MY_LEDS_BLINKING_FEATURE)
 		ledsProcess();
+		PROFILE_STAGE(PROFILE_LEDS);
 	#endif
 
 	#if defined(MY_INCLUSION_MODE_FEATURE)
 		inclusionProcess();
+		PROFILE_STAGE(PROFILE_INCLUSION);
 	#endif
 
 	#if defined(MY_GATEWAY_FEATURE)
 		gatewayTransportProcess();
+		PROFILE_STAGE(PROFILE_GATEWAY);
 	#endif
 
 	#if defined(MY_RADIO_FEATURE)
 		transportProcess();
+		PROFILE_STAGE(PROFILE_TRANSPORT);
+	#endif
+
+	#if defined(MY_TASKS)
+		_tasksProcess();
+		PROFILE_STAGE(PROFILE_TASKS);
+	#endif
+
+	#if defined(MY_TIME_SERVICE)
+		_timeProcess();
+	#endif
+
+	#if defined(MY_REPORT_POLICIES)
+		_reportProcess();
 	#endif
 
+	#if !defined(ARDUINO_ARCH_AVR)
+		// commit deferred config writes
+		static uint32_t lastConfigFlush = 0;
+		if (hwMillis() - lastConfigFlush > MY_CONFIG_FLUSH_INTERVAL_MS) {
+			hwConfigFlush();
+			lastConfigFlush = hwMillis();
+		}
+	#endif
+
+	#if defined(MY_PROFILE_FEATURE)
+		_profileLast = hwMicros();
+	#endif
 }
 
 void _infiniteLoop() {
@@ -79,10 +509,19 @@ void _begin() {
 		ledsInit();
 	#endif
 
+	#if defined(MY_CONFIG_IMAGE)
+		// core EEPROM fields in one read, restored if they do not match
+		(void)_configImageLoad();
+	#endif
+
 	signerInit();
 
 	// Read latest received controller configuration from EEPROM
-	hwReadConfigBlock((void*)&_cc, (void*)EEPROM_CONTROLLER_CONFIG_ADDRESS, sizeof(ControllerConfig));
+	#if defined(MY_CONFIG_IMAGE)
+		_cc = _configImage.controller;
+	#else
+		hwReadConfigBlock((void*)&_cc, (void*)EEPROM_CONTROLLER_CONFIG_ADDRESS, sizeof(ControllerConfig));
+	#endif
 	// isMetric is bool, hence empty EEPROM (=0xFF) evaluates to true
 	
 	#if defined(MY_OTA_FIRMWARE_FEATURE)
@@ -93,6 +532,7 @@ void _begin() {
 	#if defined(MY_RADIO_FEATURE)
 		// Save static parent id in eeprom (used by bootloader)
 		hwWriteConfig(EEPROM_PARENT_NODE_ID_ADDRESS, MY_PARENT_NODE_ID);
+		CONFIG_IMAGE_SAVE();
 		transportInitialize();
 		while (!isTransportReady()) {
 			hwWatchdogReset();
@@ -106,8 +546,13 @@ void _begin() {
 	
 
 	#ifdef MY_NODE_LOCK_FEATURE
+		#if defined(MY_CONFIG_IMAGE)
+			const uint8_t lockCounter = _configImage.lockCounter;
+		#else
+			const uint8_t lockCounter = hwReadConfig(EEPROM_NODE_LOCK_COUNTER);
+		#endif
 		// Check if node has been locked down
-		if (hwReadConfig(EEPROM_NODE_LOCK_COUNTER) == 0) {
+		if (lockCounter == 0) {
 			// Node is locked, check if unlock pin is asserted, else hang the node
 			pinMode(MY_NODE_UNLOCK_PIN, INPUT_PULLUP);
 			// Make a short delay so we are sure any large external nets are fully pulled
@@ -116,6 +561,7 @@ void _begin() {
 			if (digitalRead(MY_NODE_UNLOCK_PIN) == 0) {
 				// Pin is grounded, reset lock counter
 				hwWriteConfig(EEPROM_NODE_LOCK_COUNTER, MY_NODE_LOCK_COUNTER_MAX);
+				CONFIG_IMAGE_SAVE();
 				// Disable pullup
 				pinMode(MY_NODE_UNLOCK_PIN, INPUT);
 				setIndication(INDICATION_ERR_LOCKED);
@@ -125,9 +571,10 @@ void _begin() {
 				pinMode(MY_NODE_UNLOCK_PIN, INPUT);
 				nodeLock("LDB"); //Locked during boot
 			}
-		} else if (hwReadConfig(EEPROM_NODE_LOCK_COUNTER) == 0xFF) {
+		} else if (lockCounter == 0xFF) {
 			// Reset walue
 			hwWriteConfig(EEPROM_NODE_LOCK_COUNTER, MY_NODE_LOCK_COUNTER_MAX);
+			CONFIG_IMAGE_SAVE();
 		}
 	#endif
 	
@@ -145,12 +592,21 @@ void _begin() {
 		}
 	#endif	
 	
-	#if defined(MY_RADIO_FEATURE)
-		presentNode();
+	#if defined(MY_WARM_BOOT)
+		if (_warmBoot()) {
+			debug(PSTR("Warm boot, presentation deferred\n"));
+		} else
 	#endif
-	
-	// register node
-	_registerNode();
+	{
+		#if defined(MY_RADIO_FEATURE)
+			presentNode();
+		#endif
+		// register node
+		_registerNode();
+		#if defined(MY_WARM_BOOT)
+			_warmBootStore();
+		#endif
+	}
 
 	// Call sketch setup
 	if (setup) {
@@ -161,6 +617,153 @@ void _begin() {
 }
 
 
+#if defined(MY_CONFIG_IMAGE)
+ConfigImage _configImage;
+static uint8_t _configImageSlot = 0;	// slot holding _configImage
+
+static uint16_t _configImageCrc(const ConfigImage &image) {
+	const uint8_t *data = (const uint8_t*)&image;
+	uint16_t crc = ~0;
+	for (uint8_t i = 0; i < offsetof(ConfigImage, crc); i++) {
+		crc ^= data[i];
+		for (uint8_t j = 0; j < 8; j++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	}
+	return crc;
+}
+
+// fields from their EEPROM locations
+static void _configImageRead(ConfigImage &image) {
+	hwReadConfigBlock((void*)&image.node, (void*)EEPROM_NODE_ID_ADDRESS, sizeof(NodeConfig));
+	hwReadConfigBlock((void*)&image.controller, (void*)EEPROM_CONTROLLER_CONFIG_ADDRESS, sizeof(ControllerConfig));
+	hwReadConfigBlock((void*)image.doSign, (void*)EEPROM_SIGNING_REQUIREMENT_TABLE_ADDRESS, sizeof(image.doSign));
+	hwReadConfigBlock((void*)image.doWhitelist, (void*)EEPROM_WHITELIST_REQUIREMENT_TABLE_ADDRESS, sizeof(image.doWhitelist));
+	image.lockCounter = hwReadConfig(EEPROM_NODE_LOCK_COUNTER);
+}
+
+static bool _configImageMatch(const ConfigImage &a, const ConfigImage &b) {
+	return !memcmp(&a.node, &b.node, offsetof(ConfigImage, crc) - offsetof(ConfigImage, node));
+}
+
+static void _configImageWrite() {
+	_configImage.version = CONFIG_IMAGE_VERSION;
+	_configImage.sequence++;
+	_configImage.crc = _configImageCrc(_configImage);
+	// next slot, wear is spread and the previous slot stays valid if this write is interrupted
+	_configImageSlot = (_configImageSlot + 1) % MY_CONFIG_IMAGE_SLOTS;
+	hwWriteConfigBlock((void*)&_configImage, (void*)(EEPROM_CONFIG_IMAGE_ADDRESS + _configImageSlot * sizeof(ConfigImage)),
+		sizeof(ConfigImage));
+}
+
+bool _configImageLoad() {
+	ConfigImage image;
+	bool found = false;
+	for (uint8_t slot = 0; slot < MY_CONFIG_IMAGE_SLOTS; slot++) {
+		hwReadConfigBlock((void*)&image, (void*)(EEPROM_CONFIG_IMAGE_ADDRESS + slot * sizeof(ConfigImage)), sizeof(ConfigImage));
+		if (image.version != CONFIG_IMAGE_VERSION || image.crc != _configImageCrc(image)) continue;
+		if (!found || (int8_t)(image.sequence - _configImage.sequence) > 0) {
+			_configImage = image;
+			_configImageSlot = slot;
+			found = true;
+		}
+	}
+	if (!found) {
+		// first boot with the image or all slots corrupt
+		debug(PSTR("MCO:BGN:CFG NEW\n"));
+		_configImageRead(_configImage);
+		_configImage.sequence = 0;
+		_configImageSlot = MY_CONFIG_IMAGE_SLOTS - 1;
+		_configImageWrite();
+		return false;
+	}
+	_configImageRead(image);
+	// erased (ClearEepromConfig), a deliberate reset and not corruption
+	bool erased = true;
+	for (uint8_t i = offsetof(ConfigImage, node); i < offsetof(ConfigImage, crc) && erased; i++) {
+		erased = ((const uint8_t*)&image)[i] == 0xFF;
+	}
+	if (erased) {
+		debug(PSTR("MCO:BGN:CFG RESET\n"));
+		memcpy(&_configImage.node, &image.node, offsetof(ConfigImage, crc) - offsetof(ConfigImage, node));
+		_configImageWrite();
+		return false;
+	}
+	if (!_configImageMatch(image, _configImage)) {
+		debug(PSTR("MCO:BGN:CFG RESTORE\n"));
+		// only changed bytes are written
+		for (uint8_t i = 0; i < sizeof(NodeConfig); i++) {
+			hwWriteConfig(EEPROM_NODE_ID_ADDRESS + i, ((uint8_t*)&_configImage.node)[i]);
+		}
+		for (uint8_t i = 0; i < sizeof(ControllerConfig); i++) {
+			hwWriteConfig(EEPROM_CONTROLLER_CONFIG_ADDRESS + i, ((uint8_t*)&_configImage.controller)[i]);
+		}
+		for (uint8_t i = 0; i < sizeof(_configImage.doSign); i++) {
+			hwWriteConfig(EEPROM_SIGNING_REQUIREMENT_TABLE_ADDRESS + i, _configImage.doSign[i]);
+			hwWriteConfig(EEPROM_WHITELIST_REQUIREMENT_TABLE_ADDRESS + i, _configImage.doWhitelist[i]);
+		}
+		hwWriteConfig(EEPROM_NODE_LOCK_COUNTER, _configImage.lockCounter);
+	}
+	return true;
+}
+
+void _configImageSave() {
+	ConfigImage image;
+	_configImageRead(image);
+	if (_configImageMatch(image, _configImage)) return;
+	memcpy(&_configImage.node, &image.node, offsetof(ConfigImage, crc) - offsetof(ConfigImage, node));
+	_configImageWrite();
+}
+#endif
+
+#if defined(MY_WARM_BOOT)
+static uint8_t _warmBootCheck(const WarmBootRecord &record) {
+	const uint8_t *data = (const uint8_t*)&record;
+	uint8_t check = 0xA5;
+	for (uint8_t i = 0; i < offsetof(WarmBootRecord, check); i++) check += data[i];
+	return check;
+}
+
+bool _warmBootLoad(WarmBootRecord &record) {
+	hwReadConfigBlock((void*)&record, (void*)EEPROM_WARM_BOOT_ADDRESS, sizeof(WarmBootRecord));
+	return record.check == _warmBootCheck(record);
+}
+
+void _warmBootSave(WarmBootRecord &record) {
+	record.check = _warmBootCheck(record);
+	// bytewise, only changed bytes are written
+	const uint8_t *data = (const uint8_t*)&record;
+	for (uint8_t i = 0; i < sizeof(WarmBootRecord); i++) hwWriteConfig(EEPROM_WARM_BOOT_ADDRESS + i, data[i]);
+}
+
+static uint16_t _presentationDigest() {
+	_presentationHash = 5381;
+	_presentationHashing = true;
+	presentNode();
+	_presentationHashing = false;
+	return _presentationHash;
+}
+
+// Skip presentation and registration if the last boot completed with the same presentation
+bool _warmBoot() {
+	WarmBootRecord record;
+	if (!_warmBootLoad(record) || !record.registered) return false;
+	if (record.presentationHash != _presentationDigest()) return false;
+	_nodeRegistered = true;
+	return true;
+}
+
+void _warmBootStore() {
+	WarmBootRecord record;
+	if (!_warmBootLoad(record)) {
+		record.parentNodeId = _nc.parentNodeId;
+		record.distance = _nc.distance;
+	}
+	// an unanswered presentation is repeated on the next boot
+	record.presentationHash = _presentationConfirmed ? _presentationDigest() : 0;
+	record.registered = _nodeRegistered;
+	_warmBootSave(record);
+}
+#endif
+
 void _registerNode() {
 	#if defined (MY_REGISTRATION_FEATURE) && !defined(MY_GATEWAY_FEATURE)
 		debug(PSTR("Request registration...\n"));	// registration request
@@ -209,7 +812,11 @@ void presentNode() {
 		_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_CONFIG, false).set(_nc.parentNodeId));
 
 		// Wait configuration reply.
-		wait(2000, C_INTERNAL, I_CONFIG);
+		#if defined(MY_WARM_BOOT)
+			_presentationConfirmed = wait(2000, C_INTERNAL, I_CONFIG);
+		#else
+			wait(2000, C_INTERNAL, I_CONFIG);
+		#endif
 	
 	#endif
 	
@@ -236,10 +843,20 @@ bool _sendRoute(MyMessage &message) {
 	#if defined(MY_CORE_ONLY)
 		(void)message;
 	#endif
+	#if defined(MY_WARM_BOOT)
+		if (_presentationHashing) {
+			// skip last hop, it is not set yet
+			const uint8_t *data = (const uint8_t*)&message + 1;
+			const uint8_t len = HEADER_SIZE - 1 + min(mGetLength(message), MAX_PAYLOAD);
+			for (uint8_t i = 0; i < len; i++) _presentationHash = (_presentationHash << 5) + _presentationHash + data[i];
+			return true;
+		}
+	#endif
 	#if defined(MY_GATEWAY_FEATURE)
 		if (message.destination == _nc.nodeId) {
 			// This is a message sent from a sensor attached on the gateway node.
-			// Pass it directly to the gateway transport layer.
+			// Pass it directly to the gateway transport layer, after the queued radio messages.
+			gatewayTransportSendQueued();
 			return gatewayTransportSend(message);
 		}
 	#endif
@@ -250,6 +867,152 @@ bool _sendRoute(MyMessage &message) {
 	#endif
 }
 
+#if defined(MY_REPORT_POLICIES)
+	// value in the payload type, 32 bit integers do not fit a float exactly
+	typedef union {
+		float f;
+		int32_t l;
+		uint32_t ul;
+	} reportValue;
+
+	typedef struct {
+		uint8_t sensor;
+		uint8_t type;
+		bool active;
+		bool sent;			// last holds the last value sent
+		float minChange;
+		unsigned long maxSilent;
+		unsigned long minInterval;
+		uint8_t lastType;	// payload type of last
+		reportValue last;
+		unsigned long lastSent;
+		bool pending;		// change suppressed by minInterval, sent once it has passed
+		uint8_t pendingType;
+		uint8_t pendingPrecision;
+		uint8_t pendingDestination;
+		reportValue pendingValue;
+	} reportPolicy;
+
+	static reportPolicy _reportPolicies[MY_REPORT_POLICIES];
+
+	static reportPolicy* _reportPolicyFind(uint8_t sensor, uint8_t type) {
+		for (uint8_t i = 0; i < MY_REPORT_POLICIES; i++) {
+			reportPolicy &policy = _reportPolicies[i];
+			if (policy.active && policy.sensor == sensor && policy.type == type) return &policy;
+		}
+		return NULL;
+	}
+
+	bool setReportPolicy(uint8_t sensor, uint8_t type, float minChange, unsigned long maxSilent, unsigned long minInterval) {
+		reportPolicy *policy = _reportPolicyFind(sensor, type);
+		for (uint8_t i = 0; i < MY_REPORT_POLICIES && !policy; i++) {
+			if (!_reportPolicies[i].active) policy = &_reportPolicies[i];
+		}
+		if (!policy) return false;
+		policy->sensor = sensor;
+		policy->type = type;
+		policy->active = true;
+		policy->sent = false;
+		policy->pending = false;
+		policy->minChange = minChange;
+		policy->maxSilent = maxSilent;
+		policy->minInterval = minInterval;
+		return true;
+	}
+
+	void clearReportPolicy(uint8_t sensor, uint8_t type) {
+		reportPolicy *policy = _reportPolicyFind(sensor, type);
+		if (policy) policy->active = false;
+	}
+
+	// numeric payloads only, strings and custom payloads are always sent
+	static bool _reportValue(MyMessage &message, reportValue &value) {
+		switch (mGetPayloadType(message)) {
+			case P_BYTE: value.f = message.getByte(); return true;
+			case P_INT16: value.f = message.getInt(); return true;
+			case P_UINT16: value.f = message.getUInt(); return true;
+			case P_LONG32: value.l = message.getLong(); return true;
+			case P_ULONG32: value.ul = message.getULong(); return true;
+			case P_FLOAT32: value.f = message.getFloat(); return true;
+			default: return false;
+		}
+	}
+
+	// within the deadband of the last value sent, integers are compared exactly
+	static bool _reportUnchanged(const reportPolicy &policy, uint8_t payloadType, const reportValue &value) {
+		if (payloadType != policy.lastType || policy.minChange < 0) return false;
+		uint32_t delta;
+		if (payloadType == P_LONG32) {
+			delta = value.l > policy.last.l ? (uint32_t)value.l - (uint32_t)policy.last.l : (uint32_t)policy.last.l - (uint32_t)value.l;
+		} else if (payloadType == P_ULONG32) {
+			delta = value.ul > policy.last.ul ? value.ul - policy.last.ul : policy.last.ul - value.ul;
+		} else {
+			return fabs(value.f - policy.last.f) <= policy.minChange;
+		}
+		return policy.minChange >= 4294967295.0f || delta <= (uint32_t)policy.minChange;
+	}
+
+	// acknowledged sends are not filtered, the caller waits for the echo
+	static bool _sendReport(MyMessage &message, bool enableAck) {
+		reportValue value;
+		reportPolicy *policy = enableAck ? NULL : _reportPolicyFind(message.sensor, message.type);
+		if (!policy || !_reportValue(message, value)) return _sendRoute(message);
+		// sleeping nodes: the time spent in sleep counts
+		const unsigned long now = hwMillis() + hwSleptMillis();
+		if (policy->sent) {
+			const unsigned long silent = now - policy->lastSent;
+			const bool unchanged = _reportUnchanged(*policy, mGetPayloadType(message), value);
+			if (silent < policy->minInterval || ((!policy->maxSilent || silent < policy->maxSilent) && unchanged)) {
+				// the latest value counts: a change is sent by _reportProcess(), a return into the deadband is not
+				policy->pending = silent < policy->minInterval && !unchanged;
+				policy->pendingType = mGetPayloadType(message);
+				policy->pendingPrecision = message.getFloatPrecision();
+				policy->pendingDestination = message.destination;
+				policy->pendingValue = value;
+				debug(PSTR("MCO:SND:SUP,c=%d,t=%d\n"), message.sensor, message.type);
+				return true;
+			}
+		}
+		if (!_sendRoute(message)) return false;
+		policy->sent = true;
+		policy->pending = false;
+		policy->lastType = mGetPayloadType(message);
+		policy->last = value;
+		policy->lastSent = now;
+		return true;
+	}
+
+	// send the last change suppressed by minInterval once it has passed
+	static void _reportProcess() {
+		const unsigned long now = hwMillis() + hwSleptMillis();
+		for (uint8_t i = 0; i < MY_REPORT_POLICIES; i++) {
+			reportPolicy &policy = _reportPolicies[i];
+			if (!policy.active || !policy.pending || now - policy.lastSent < policy.minInterval) continue;
+			build(_msgTmp, _nc.nodeId, policy.pendingDestination, policy.sensor, C_SET, policy.type, false);
+			const reportValue &value = policy.pendingValue;
+			switch (policy.pendingType) {
+				case P_BYTE: _msgTmp.set((uint8_t)value.f); break;
+				case P_INT16: _msgTmp.set((int16_t)value.f); break;
+				case P_UINT16: _msgTmp.set((uint16_t)value.f); break;
+				case P_LONG32: _msgTmp.set(value.l); break;
+				case P_ULONG32: _msgTmp.set(value.ul); break;
+				default: _msgTmp.set(value.f, policy.pendingPrecision); break;
+			}
+			// failed: retried after another minInterval
+			policy.lastSent = now;
+			if (!_sendRoute(_msgTmp)) continue;
+			policy.pending = false;
+			policy.lastType = policy.pendingType;
+			policy.last = value;
+		}
+	}
+#else
+	static inline bool _sendReport(MyMessage &message, bool enableAck) {
+		(void)enableAck;
+		return _sendRoute(message);
+	}
+#endif
+
 bool send(MyMessage &message, bool enableAck) {
 	message.sender = _nc.nodeId;
 	mSetCommand(message, C_SET);
@@ -257,23 +1020,75 @@ bool send(MyMessage &message, bool enableAck) {
 
 	#if defined(MY_REGISTRATION_FEATURE) && !defined(MY_GATEWAY_FEATURE)
 		if (_nodeRegistered) {	
-			return _sendRoute(message);
+			return _sendReport(message, enableAck);
 		}
 		else {
 			debug(PSTR("NODE:!REG\n"));
 			return false;
 		}
 	#else
-		return _sendRoute(message);
+		return _sendReport(message, enableAck);
 	#endif
 	}
 
+bool sendBatch(MyMessageBatch &batch, bool enableAck) {
+	if (!batch.count()) return true;
+	MyMessage &message = batch.message;
+	message.sender = _nc.nodeId;
+	message.sensor = NODE_SENSOR_ID;
+	message.type = I_BATCH;
+	mSetCommand(message, C_INTERNAL);
+	mSetRequestAck(message, enableAck);
+	mSetAck(message, false);
+
+	#if defined(MY_REGISTRATION_FEATURE) && !defined(MY_GATEWAY_FEATURE)
+		if (!_nodeRegistered) {
+			debug(PSTR("NODE:!REG\n"));
+			return false;
+		}
+	#endif
+	return _sendRoute(message);
+}
+
+#if defined(MY_TRANSPORT_FRAGMENTATION)
+bool sendFragmented(MyMessage &message, const void* data, uint16_t length, bool enableAck) {
+	static uint8_t transferId = 0;
+	if (length > FRAGMENT_MAX_SIZE) {
+		return false;
+	}
+	#if defined(MY_REGISTRATION_FEATURE) && !defined(MY_GATEWAY_FEATURE)
+		if (!_nodeRegistered) {
+			debug(PSTR("NODE:!REG\n"));
+			return false;
+		}
+	#endif
+	const uint8_t *source = (const uint8_t*)data;
+	uint8_t count = 1;
+	while (FRAGMENT_OFFSET(count) < length) count++;
+	transferId++;
+	bool ok = true;
+	for (uint8_t index = 0; index < count && ok; index++) {
+		const uint8_t header = index ? FRAGMENT_HEADER_SIZE : FRAGMENT_FIRST_HEADER_SIZE;
+		const uint16_t offset = FRAGMENT_OFFSET(index);
+		const uint8_t chunk = min(length - offset, MAX_PAYLOAD - header);
+		uint8_t payload[MAX_PAYLOAD];
+		payload[0] = transferId;
+		payload[1] = index << 4 | (count - 1);
+		payload[2] = message.type;	// first fragment only, overwritten otherwise
+		memcpy(&payload[header], &source[offset], chunk);
+		// only the last fragment requests the ACK, sent once the payload is complete
+		ok = _sendRoute(build(_msgTmp, _nc.nodeId, message.destination, message.sensor, C_INTERNAL, I_FRAGMENT, enableAck && index == count - 1).set(payload, header + chunk));
+	}
+	return ok;
+}
+#endif
+
 void sendBatteryLevel(uint8_t value, bool enableAck) {
 	_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_BATTERY_LEVEL, enableAck).set(value));
 }
 
 void sendHeartbeat(void) {
-	#if defined(MY_RADIO_NRF24) || defined(MY_RADIO_RFM69) || defined(MY_RS485)
+	#if defined(MY_RADIO_FEATURE)
 		uint32_t heartbeat = transportGetHeartbeat();
 	#else
 		uint32_t heartbeat = hwMillis();
@@ -295,6 +1110,15 @@ void request(uint8_t childSensorId, uint8_t variableType, uint8_t destination) {
 }
 
 void requestTime() {
+	#if defined(MY_TIME_SERVICE)
+		// no round trip while the local clock is good enough
+		if (_timeSyncSeconds && timeError() <= MY_TIME_MAX_ERROR_MS) {
+			if (receiveTime) receiveTime(timeNow());
+			return;
+		}
+		_timeRequested = true;
+		_timeRequestMillis = _timeMillis();
+	#endif
 	_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_TIME, false).set(""));
 }
 
@@ -307,6 +1131,10 @@ bool _processInternalMessages() {
 			#if !defined(MY_DISABLE_REMOTE_RESET)
 				// Requires MySensors or other bootloader with watchdogs enabled
 				setIndication(INDICATION_REBOOT);
+				#if defined(MY_RADIO_FEATURE)
+					// keep learned routes
+					transportSaveRoutingTable();
+				#endif
 				hwReboot();
 			#endif
 		}
@@ -321,6 +1149,7 @@ bool _processInternalMessages() {
 			// Pick up configuration from controller (currently only metric/imperial) and store it in eeprom if changed
 			_cc.isMetric = _msg.data[0] == 0x00 || _msg.data[0] == 'M'; // metric if null terminated or M
 			hwWriteConfig(EEPROM_CONTROLLER_CONFIG_ADDRESS, _cc.isMetric);
+			CONFIG_IMAGE_SAVE();
 		}
 		else if (type == I_PRESENTATION) {
 			// Re-send node presentation to controller
@@ -331,7 +1160,63 @@ bool _processInternalMessages() {
 		else if (type == I_HEARTBEAT) {
 			sendHeartbeat();
 		}
+		else if (type == I_STATS) {
+			#if defined(MY_STATS_FEATURE)
+				_stats.sleepMs = hwSleptMillis() - _statsSleepBase;
+				const bool reset = _msg.data[0] == 'R';
+				_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_STATS, false).set(&_stats, sizeof(NodeStats)));
+				if (reset) {
+					memset(&_stats, 0, sizeof(NodeStats));
+					_statsSleepBase = hwSleptMillis();
+				}
+			#endif
+		}
+		else if (type == I_ENERGY) {
+			#if defined(MY_ENERGY_FEATURE)
+				_energyUpdate();
+				const bool reset = _msg.data[0] == 'R';
+				_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_ENERGY, false).set(&_energy, sizeof(NodeEnergy)));
+				if (reset) memset(&_energy, 0, sizeof(NodeEnergy));
+			#endif
+		}
+		else if (type == I_PROFILE) {
+			#if defined(MY_PROFILE_FEATURE)
+				const bool reset = _msg.data[0] == 'R';
+				_profileReport();
+				if (reset) {
+					memset(_profile, 0, sizeof(_profile));
+				}
+				// reporting is not a loop stage
+				_profileLast = 0;
+			#endif
+		}
+		else if (type == I_LOADTEST) {
+			#if defined(MY_LOADTEST_FEATURE) && defined(MY_GATEWAY_FEATURE)
+				// controller request
+				const bool reset = _msg.data[0] == 'R';
+				_loadTestReport();
+				if (reset) {
+					memset(_loadTest, 0, sizeof(_loadTest));
+				}
+			#elif defined(MY_LOADTEST_FEATURE)
+				// echo of a probe, late echoes are ignored
+				LoadTestProbe probe;
+				memcpy(&probe, _msg.data, sizeof(LoadTestProbe));
+				if (mGetLength(_msg) == sizeof(LoadTestProbe) && probe.seq == _loadTestSeq - 1) {
+					const unsigned long rtt = hwMillis() - probe.timestamp;
+					_loadTestRtt = rtt < LOADTEST_NO_RTT ? rtt : LOADTEST_NO_RTT - 1;
+				}
+			#endif
+		}
+		else if (type == I_PENDING) {
+			#if defined(MY_SMART_SLEEP_PENDING)
+				_smartSleepPending = _msg.getByte();
+			#endif
+		}
 		else if (type == I_TIME) {
+			#if defined(MY_TIME_SERVICE)
+				_timeSync(_msg.getULong());
+			#endif
 			// Deliver time to callback
 			if (receiveTime)
 				receiveTime(_msg.getULong());
@@ -347,12 +1232,17 @@ bool _processInternalMessages() {
 			#endif
 		}
 		else if (type == I_DEBUG) {
+			#if defined(MY_TRANSPORT_TRACE) && defined(MY_RADIO_FEATURE)
+				if (_msg.data[0] == 'T') {	// transport trace
+					transportTraceSend();
+				}
+			#endif
 			#if defined(MY_DEBUG) || defined(MY_SPECIAL_DEBUG)
 				char debug_msg = _msg.data[0];
 				if (debug_msg == 'R') {		// routing table
 				#if defined(MY_REPEATER_FEATURE)
 					for (uint8_t cnt = 0; cnt != 255; cnt++) {
-						uint8_t route = hwReadConfig(EEPROM_ROUTES_ADDRESS + cnt);
+						uint8_t route = transportGetRoutingTable(cnt);
 						if (route != BROADCAST_ADDRESS) {
 							debug(PSTR("ID: %d via %d\n"), cnt, route);
 							uint8_t OutBuf[2] = { cnt,route };
@@ -374,6 +1264,9 @@ bool _processInternalMessages() {
 				else if (debug_msg == 'E') {	// clear MySensors eeprom area and reboot
 					_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_DEBUG, false).set("ok"));
 					for (int i = EEPROM_START; i<EEPROM_LOCAL_CONFIG_ADDRESS; i++) hwWriteConfig(i, 0xFF);
+					#if defined(MY_CONFIG_IMAGE)
+						for (int i = 0; i < MY_CONFIG_IMAGE_SLOTS * (int)sizeof(ConfigImage); i++) hwWriteConfig(EEPROM_CONFIG_IMAGE_ADDRESS + i, 0xFF);
+					#endif
 					setIndication(INDICATION_REBOOT);
 					hwReboot();
 				}
@@ -400,6 +1293,30 @@ bool _processInternalMessages() {
 				#endif
 			#endif	
 		}
+		else if (type == I_TIME) {
+			#if defined(MY_TIME_SERVICE)
+				// request of a child: handed to the controller if not answered locally
+				if (!mGetLength(_msg)) return _timeAnswer(_msg);
+				// answer of a repeater on the path, unsolicited ones are ignored
+				if (!_timeRequested) return true;
+				_timeSync(_msg.getULong());
+				if (receiveTime) receiveTime(_msg.getULong());
+			#else
+				return false;
+			#endif
+		}
+		else if (type == I_LOADTEST) {
+			#if defined(MY_LOADTEST_FEATURE) && defined(MY_GATEWAY_FEATURE)
+				// account and echo, probes are not handed to the controller
+				if (mGetLength(_msg) != sizeof(LoadTestProbe)) return true;
+				LoadTestProbe probe;
+				memcpy(&probe, _msg.data, sizeof(LoadTestProbe));
+				_loadTestAccount(_msg.sender, probe);
+				_sendRoute(build(_msgTmp, _nc.nodeId, _msg.sender, NODE_SENSOR_ID, C_INTERNAL, I_LOADTEST, false).set(&probe, sizeof(LoadTestProbe)));
+			#else
+				return false;
+			#endif
+		}
 		else return false;
 	}
 	return true;
@@ -415,6 +1332,9 @@ uint8_t loadState(uint8_t pos) {
 
 
 void wait(unsigned long ms) {
+	#if defined(MY_WARM_BOOT)
+		if (_presentationHashing) return;
+	#endif
 	unsigned long enter = hwMillis();
 	while (hwMillis() - enter < ms) {
 		_process();
@@ -425,6 +1345,9 @@ void wait(unsigned long ms) {
 }
 
 bool wait(unsigned long ms, uint8_t cmd, uint8_t msgtype) {
+	#if defined(MY_WARM_BOOT)
+		if (_presentationHashing) return false;
+	#endif
 	unsigned long enter = hwMillis();
 	// invalidate msg type
 	_msg.type = !msgtype;
@@ -440,6 +1363,27 @@ bool wait(unsigned long ms, uint8_t cmd, uint8_t msgtype) {
 }
 
 
+// Heartbeat and listen for messages the controller queued for this node
+static void _smartSleepListen() {
+	#if defined(MY_SMART_SLEEP_PENDING)
+		_smartSleepPending = SMART_SLEEP_PENDING_UNKNOWN;
+		sendHeartbeat();
+		// controllers without I_PENDING support never answer, the full window is used then
+		const unsigned long enter = hwMillis();
+		while (_smartSleepPending && hwMillis() - enter < MY_SMART_SLEEP_WAIT_DURATION) {
+			_process();
+			#if defined(ARDUINO_ARCH_ESP8266)
+				yield();
+			#endif
+		}
+	#else
+		// notifiy controller about wake up
+		sendHeartbeat();
+		// listen for incoming messages
+		wait(MY_SMART_SLEEP_WAIT_DURATION);
+	#endif
+}
+
 int8_t sleep(unsigned long ms) {
 	#if defined(MY_OTA_FIRMWARE_FEATURE)
 	if (_fwUpdateOngoing) {
@@ -453,11 +1397,19 @@ int8_t sleep(unsigned long ms) {
 		wait(ms);
 		return -1;
 	#else
+		hwConfigFlush();
 		#if defined(MY_RADIO_FEATURE)
+			#if defined(MY_RF24_ACK_PAYLOAD)
+				// a downlink message may have arrived as ACK payload of the last uplink frame
+				transportProcess();
+			#endif
 			transportPowerDown();
+			ENERGY_RADIO_OFF();
 		#endif
 		setIndication(INDICATION_SLEEP);
+		ENERGY_SLEEP_BEGIN();
 		const int8_t res = hwSleep(ms);
+		ENERGY_SLEEP_END();
 		setIndication(INDICATION_WAKEUP);
 		return res;
 	#endif
@@ -465,10 +1417,7 @@ int8_t sleep(unsigned long ms) {
 
 int8_t smartSleep(unsigned long ms) {
 	int8_t ret = sleep(ms);
-	// notifiy controller about wake up
-	sendHeartbeat();
-	// listen for incoming messages
-	wait(MY_SMART_SLEEP_WAIT_DURATION);
+	_smartSleepListen();
 	return ret;
 }
 
@@ -486,11 +1435,19 @@ int8_t sleep(uint8_t interrupt, uint8_t mode, unsigned long ms) {
 		(void)ms;
 		return -2;
 	#else
+		hwConfigFlush();
 		#if defined(MY_RADIO_FEATURE)
+			#if defined(MY_RF24_ACK_PAYLOAD)
+				// a downlink message may have arrived as ACK payload of the last uplink frame
+				transportProcess();
+			#endif
 			transportPowerDown();
+			ENERGY_RADIO_OFF();
 		#endif
 		setIndication(INDICATION_SLEEP);
+		ENERGY_SLEEP_BEGIN();
 		const int8_t res = hwSleep(interrupt, mode, ms);
+		ENERGY_SLEEP_END();
 		setIndication(INDICATION_WAKEUP);
 		return res;
 	#endif
@@ -498,10 +1455,7 @@ int8_t sleep(uint8_t interrupt, uint8_t mode, unsigned long ms) {
 
 int8_t smartSleep(uint8_t interrupt, uint8_t mode, unsigned long ms) {
 	int8_t ret = sleep(interrupt, mode, ms);
-	// notifiy controller about wake up
-	sendHeartbeat();
-	// listen for incoming messages
-	wait(MY_SMART_SLEEP_WAIT_DURATION);
+	_smartSleepListen();
 	return ret;
 }
 
@@ -521,11 +1475,19 @@ int8_t sleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mode
 		(void)ms;
 		return -2;
 	#else
+		hwConfigFlush();
 		#if defined(MY_RADIO_FEATURE)
+			#if defined(MY_RF24_ACK_PAYLOAD)
+				// a downlink message may have arrived as ACK payload of the last uplink frame
+				transportProcess();
+			#endif
 			transportPowerDown();
+			ENERGY_RADIO_OFF();
 		#endif
 		setIndication(INDICATION_SLEEP);
+		ENERGY_SLEEP_BEGIN();
 		const int8_t res = hwSleep(interrupt1, mode1, interrupt2, mode2, ms);
+		ENERGY_SLEEP_END();
 		setIndication(INDICATION_WAKEUP);
 		return res;
 	#endif
@@ -533,17 +1495,85 @@ int8_t sleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mode
 
 int8_t smartSleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mode2, unsigned long ms) {
 	int8_t ret = sleep(interrupt1, mode1, interrupt2, mode2, ms);
-	// notifiy controller about wake up
-	sendHeartbeat();
-	// listen for incoming messages
-	wait(MY_SMART_SLEEP_WAIT_DURATION);
+	_smartSleepListen();
 	return ret;
 }
 
+#if defined(MY_SLEEP_TASKS)
+typedef struct {
+	void (*task)(void);
+	unsigned long period;
+	unsigned long due;
+} sleepTask;
+
+static sleepTask _sleepTasks[MY_SLEEP_TASKS];
+
+unsigned long schedulerMillis() {
+	return hwMillis() + hwSleptMillis();
+}
+
+bool scheduleTask(void (*task)(void), unsigned long period) {
+	for (uint8_t i = 0; i < MY_SLEEP_TASKS; i++) {
+		if (!_sleepTasks[i].task || _sleepTasks[i].task == task) {
+			_sleepTasks[i].task = task;
+			_sleepTasks[i].period = period;
+			_sleepTasks[i].due = schedulerMillis();
+			return true;
+		}
+	}
+	return false;
+}
+
+void unscheduleTask(void (*task)(void)) {
+	for (uint8_t i = 0; i < MY_SLEEP_TASKS; i++) {
+		if (_sleepTasks[i].task == task) _sleepTasks[i].task = NULL;
+	}
+}
+
+int8_t sleepTasks(bool smart) {
+	bool scheduled = false;
+	unsigned long next = 0xFFFFFFFF;
+	const unsigned long now = schedulerMillis();
+	for (uint8_t i = 0; i < MY_SLEEP_TASKS; i++) {
+		sleepTask &t = _sleepTasks[i];
+		if (!t.task) continue;
+		// coalesce: run early if due within the window, the radio is up anyway
+		if ((long)(t.due - now) <= (long)MY_SLEEP_COALESCE_MS) {
+			t.due += t.period;
+			// missed periods (e.g. long interrupt handling) are not caught up
+			if ((long)(t.due - now) <= 0) t.due = now + t.period;
+			t.task();
+		}
+	}
+	// tasks may have taken a while, take a fresh timestamp
+	const unsigned long done = schedulerMillis();
+	for (uint8_t i = 0; i < MY_SLEEP_TASKS; i++) {
+		const sleepTask &t = _sleepTasks[i];
+		if (!t.task) continue;
+		scheduled = true;
+		const long remaining = (long)(t.due - done);
+		if (remaining <= 0) {
+			next = 0;
+		} else if ((unsigned long)remaining < next) {
+			next = remaining;
+		}
+	}
+	if (!scheduled) return -2;
+	if (smart) {
+		// smartSleep() stays awake for MY_SMART_SLEEP_WAIT_DURATION after wake up
+		next = next > MY_SMART_SLEEP_WAIT_DURATION ? next - MY_SMART_SLEEP_WAIT_DURATION : 0;
+	}
+	// too short to power down, tasks run on the next call
+	if (next < 16) return -1;
+	return smart ? smartSleep(next) : sleep(next);
+}
+#endif
+
 #ifdef MY_NODE_LOCK_FEATURE
 void nodeLock(const char* str) {
 	// Make sure EEPROM is updated to locked status
 	hwWriteConfig(EEPROM_NODE_LOCK_COUNTER, 0);
+	CONFIG_IMAGE_SAVE();
 	while (1) {
 		setIndication(INDICATION_ERR_LOCKED);
 		debug(PSTR("Node is locked. Ground pin %d and reset to unlock.\n"), MY_NODE_UNLOCK_PIN);
@@ -551,11 +1581,15 @@ void nodeLock(const char* str) {
 			yield();
 		#endif
 		_sendRoute(build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID,C_INTERNAL, I_LOCKED, false).set(str));
+		hwConfigFlush();
 		#if defined(MY_RADIO_FEATURE)
 			transportPowerDown();
+			ENERGY_RADIO_OFF();
 		#endif
 		setIndication(INDICATION_SLEEP);
+		ENERGY_SLEEP_BEGIN();
 		(void)hwSleep((unsigned long)1000*60*30); // Sleep for 30 min before resending LOCKED message
+		ENERGY_SLEEP_END();
 		setIndication(INDICATION_WAKEUP);
 	}
 }
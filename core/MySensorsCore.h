@@ -25,10 +25,16 @@
 #include "MyConfig.h"
 #include "MyEepromAddresses.h"
 #include "MyMessage.h"
+#include "MyMessagePool.h"
+#include "MyRingBuffer.h"
 #include <stddef.h>
 #include <stdarg.h>
 
-#ifdef MY_DEBUG
+#if defined(MY_DEBUG) && defined(MY_GATEWAY_SERIAL) && defined(MY_GATEWAY_SERIAL_TX_BUFFER_SIZE)
+	// buffered gateway output goes first, debug prints must not cut into a message
+	bool gatewayTransportFlush();
+	#define debug(x,...) do { gatewayTransportFlush(); hwDebugPrint(x, ##__VA_ARGS__); } while (0)
+#elif defined(MY_DEBUG)
 	#define debug(x,...) hwDebugPrint(x, ##__VA_ARGS__)
 #else
 	#define debug(x,...)
@@ -60,6 +66,187 @@ struct ControllerConfig {
 	uint8_t isMetric; //!< Flag indicating if metric or imperial measurements are used
 };
 
+/**
+ * @brief Warm boot record
+ *
+ * This structure stores the state of the last complete boot, restored by @ref MY_WARM_BOOT
+ */
+struct WarmBootRecord {
+	uint8_t parentNodeId; //!< Parent node at last boot
+	uint8_t distance; //!< Distance to gateway at last boot
+	uint16_t presentationHash; //!< Hash of all messages presentNode() sent
+	uint8_t registered; //!< Registration result
+	uint8_t check; //!< Checksum of the fields above
+};
+
+/**
+ * @brief Configuration image
+ *
+ * Copy of the core EEPROM fields kept in slots by @ref MY_CONFIG_IMAGE
+ */
+struct ConfigImage {
+	uint8_t version; //!< Layout version
+	uint8_t sequence; //!< Incremented with every write, the newest valid slot is loaded
+	NodeConfig node; //!< Node ID, parent and distance
+	ControllerConfig controller; //!< Controller configuration
+	uint8_t lockCounter; //!< Node lock counter
+	uint8_t doSign[32]; //!< Signing requirement table
+	uint8_t doWhitelist[32]; //!< Whitelisting requirement table
+	uint16_t crc; //!< CRC16 of the fields above
+} __attribute__((packed));
+
+#define CONFIG_IMAGE_VERSION 1	//!< ConfigImage layout version
+
+#if defined(MY_CONFIG_IMAGE)
+	// 73 bytes per slot, see ConfigImage; 1024 bytes is the smallest EEPROM (ATMega328) and the ESP8266 emulation
+	#if EEPROM_CONFIG_IMAGE_ADDRESS + MY_CONFIG_IMAGE_SLOTS*73 > 1024
+		#error MY_CONFIG_IMAGE_SLOTS do not fit into EEPROM
+	#endif
+	extern ConfigImage _configImage;
+	#define CONFIG_IMAGE_SAVE() _configImageSave()	//!< update the image after core EEPROM fields were written
+#else
+	#define CONFIG_IMAGE_SAVE() ((void)0)
+#endif
+
+/**
+ * @brief Performance counters
+ *
+ * This structure is sent as I_STATS payload if @ref MY_STATS_FEATURE is set (22 bytes, little endian).
+ * Counters wrap around, rates are computed from the difference of two reports.
+ */
+struct NodeStats {
+	uint16_t txOk; //!< Transmissions ACKed by the next hop (broadcasts always count)
+	uint16_t txNack; //!< Transmissions not ACKed
+	uint16_t txRetries; //!< Radio retransmissions (NRF24 only)
+	uint16_t rxFrames; //!< Received frames
+	uint16_t rxDropped; //!< Frames lost in full driver buffers
+	uint16_t routed; //!< Own messages routed
+	uint16_t forwarded; //!< Messages relayed for other nodes
+	uint16_t signingMs; //!< Time spent signing and verifying
+	uint16_t maxLoopMs; //!< Longest time between two _process() calls
+	uint32_t sleepMs; //!< Time spent in sleep
+} __attribute__((packed));
+
+#if defined(MY_STATS_FEATURE)
+	extern NodeStats _stats;
+	#define STATS_INC(__field) (_stats.__field++)	//!< count event
+	#define STATS_ADD(__field, __value) (_stats.__field += (__value))	//!< add to counter
+#else
+	#define STATS_INC(__field) ((void)0)
+	#define STATS_ADD(__field, __value) ((void)0)
+#endif
+
+/**
+ * @brief Energy accounting
+ *
+ * This structure is sent as I_ENERGY payload if @ref MY_ENERGY_FEATURE is set (22 bytes, little endian).
+ * Multiplied with the currents of the data sheets it tells which subsystem drains the battery.
+ * Counters wrap around, rates are computed from the difference of two reports.
+ */
+struct NodeEnergy {
+	uint32_t awakeMs; //!< MCU awake
+	uint32_t sleepMs; //!< MCU in hwSleep()
+	uint32_t rxMs; //!< Radio listening: powered up and not transmitting (includes smartSleep() windows and transportWait())
+	uint32_t txUs; //!< Radio transmitting, including waiting for the ACK and retries
+	uint16_t txCount; //!< Transmissions
+	uint32_t signingMs; //!< ATSHA204 awake
+} __attribute__((packed));
+
+#if defined(MY_TIME_SERVICE)
+	bool _timeAnswer(const MyMessage &request);	// answer the I_TIME request of a child from the local clock
+#endif
+
+#if defined(MY_ENERGY_FEATURE)
+	void _energyRadio(bool on);
+	void _energyTxBegin();
+	void _energyTxEnd();
+	void _energySigner(bool awake);
+	void _energySlept(uint32_t ms);
+	#define ENERGY_RADIO_ON() _energyRadio(true)	//!< radio powered up
+	#define ENERGY_RADIO_OFF() _energyRadio(false)	//!< radio powered down
+	#define ENERGY_TX_BEGIN() _energyTxBegin()	//!< transmission started (powers up the radio)
+	#define ENERGY_TX_END() _energyTxEnd()	//!< transmission completed
+	#define ENERGY_SIGNER_WAKE() _energySigner(true)	//!< signing chip woken
+	#define ENERGY_SIGNER_SLEEP() _energySigner(false)	//!< signing chip idle or asleep
+	#define ENERGY_SLEEP_BEGIN() const uint32_t _energySleepStart = hwMillis()	//!< before hwSleep()
+	#define ENERGY_SLEEP_END() _energySlept(hwMillis() - _energySleepStart)	//!< after hwSleep()
+#else
+	#define ENERGY_RADIO_ON() ((void)0)
+	#define ENERGY_RADIO_OFF() ((void)0)
+	#define ENERGY_TX_BEGIN() ((void)0)
+	#define ENERGY_TX_END() ((void)0)
+	#define ENERGY_SIGNER_WAKE() ((void)0)
+	#define ENERGY_SIGNER_SLEEP() ((void)0)
+	#define ENERGY_SLEEP_BEGIN() ((void)0)
+	#define ENERGY_SLEEP_END() ((void)0)
+#endif
+
+// _process() stages timed by MY_PROFILE_FEATURE
+#define PROFILE_LOOP		0	//!< Time between two _process() calls, radio not serviced (sketch loop())
+#define PROFILE_LEDS		1	//!< ledsProcess()
+#define PROFILE_INCLUSION	2	//!< inclusionProcess()
+#define PROFILE_GATEWAY		3	//!< gatewayTransportProcess()
+#define PROFILE_TRANSPORT	4	//!< transportProcess()
+#define PROFILE_TASKS		5	//!< Tasks run by @ref MY_TASKS
+#define PROFILE_STAGES		6	//!< Number of stages
+#define PROFILE_BUCKETS		8	//!< Histogram buckets: <16us, <64us, <256us, <1ms, <4ms, <16ms, <65ms, >=65ms
+
+/**
+ * @brief Timing of one _process() stage
+ *
+ * Sent as I_PROFILE payload if @ref MY_PROFILE_FEATURE is set (17 bytes, little endian), one message per stage.
+ * Durations are in microseconds and saturate at 65535.
+ */
+struct ProfileReport {
+	uint8_t stage; //!< PROFILE_*
+	uint16_t count; //!< Samples
+	uint16_t min; //!< Shortest duration
+	uint16_t avg; //!< Average duration
+	uint16_t max; //!< Longest duration
+	uint8_t histogram[PROFILE_BUCKETS]; //!< Samples per bucket, halved when one bucket saturates
+} __attribute__((packed));
+
+#define LOADTEST_BUCKETS	8		//!< RTT histogram buckets: <8ms, <16ms, <32ms, ... <512ms, >=512ms
+#define LOADTEST_NO_RTT		0xFFFF	//!< No round trip time measured
+
+/**
+ * @brief Load test probe
+ *
+ * Sent by sendLoadTestProbe() as I_LOADTEST payload if @ref MY_LOADTEST_FEATURE is set (10 bytes, little endian).
+ * The gateway echoes it back unchanged, the sender measures the round trip time on its own clock.
+ */
+struct LoadTestProbe {
+	uint32_t seq; //!< Sequence number, 0 (node restart) restarts the accounting on the gateway
+	uint32_t timestamp; //!< hwMillis() of the sender
+	uint16_t rtt; //!< Round trip time of the previous probe in ms, LOADTEST_NO_RTT if its echo did not arrive in time
+} __attribute__((packed));
+
+/**
+ * @brief Load test accounting of one node
+ *
+ * Sent by the gateway as I_LOADTEST payload if @ref MY_LOADTEST_FEATURE is set (19 bytes, little endian), one
+ * message per node. Counters wrap around, RTT percentiles are the upper bound of their histogram bucket
+ * (LOADTEST_NO_RTT without samples).
+ */
+struct LoadTestReport {
+	uint8_t nodeId; //!< Sender of the probes
+	uint16_t received; //!< Probes received, duplicates not counted
+	uint16_t lost; //!< Missing sequence numbers, probes arriving late are taken back
+	uint16_t reordered; //!< Probes arriving after a higher sequence number
+	uint16_t duplicates; //!< Probes received more than once (within the last 32 sequence numbers)
+	uint16_t rttMin; //!< Shortest round trip time in ms
+	uint16_t rttP50; //!< Median round trip time
+	uint16_t rttP90; //!< 90th percentile
+	uint16_t rttP99; //!< 99th percentile
+	uint16_t rttMax; //!< Longest round trip time
+} __attribute__((packed));
+
+#define SMART_SLEEP_PENDING_UNKNOWN 0xFF	//!< No I_PENDING received since the smartSleep() heartbeat
+
+#if defined(MY_SMART_SLEEP_PENDING)
+extern uint8_t _smartSleepPending;
+#endif
+
 
 
 /**
@@ -107,6 +294,30 @@ void sendSketchInfo(const char *name, const char *version, bool ack=false);
 */
 bool send(MyMessage &msg, bool ack=false);
 
+/**
+* Sends all values of a batch in one message, see MyMessageBatch
+*
+* @param batch Values to send, not cleared
+* @param ack Set this to true if you want destination node to send ack back to this node. Default is not to request any ack.
+* @return true Returns true if message reached the first stop on its way to destination.
+*/
+bool sendBatch(MyMessageBatch &batch, bool ack=false);
+
+#if defined(MY_TRANSPORT_FRAGMENTATION)
+/**
+* Sends a payload larger than MAX_PAYLOAD as a series of I_FRAGMENT messages (max. 16, 22 + 15 * 23 bytes).
+* The recipient needs MY_TRANSPORT_FRAGMENTATION and gets the payload in receiveFragmented(), a gateway also
+* hands it over to the controller in C_SET messages of up to MAX_PAYLOAD bytes.
+*
+* @param msg Destination, sensor and type of the payload, the payload of msg itself is not sent
+* @param data Payload
+* @param length Payload length, max. MY_TRANSPORT_FRAGMENT_MAX_SIZE of the recipient
+* @param ack Set this to true to get a single ACK (with the header of msg) once the recipient has the complete payload
+* @return true Returns true if all fragments reached the first stop on their way to destination, false if length exceeds 16 fragments.
+*/
+bool sendFragmented(MyMessage &msg, const void* data, uint16_t length, bool ack=false);
+#endif
+
 
 /**
  * Send this nodes battery level to gateway.
@@ -122,6 +333,15 @@ void sendBatteryLevel(uint8_t level, bool ack=false);
  */
 void sendHeartbeat(void);
 
+#if defined(MY_LOADTEST_FEATURE) && !defined(MY_GATEWAY_FEATURE)
+/**
+ * Send the next load test probe (sequence number, timestamp and the round trip time of the previous probe) to the
+ * gateway. Call it at the rate under test, the gateway accounts loss, reordering, duplicates and RTT per node.
+ * @return true if the first hop ACKed the probe
+ */
+bool sendLoadTestProbe(void);
+#endif
+
 /**
 * Requests a value from gateway or some other sensor in the radio network.
 * Make sure to add callback-method in begin-method to handle request responses.
@@ -138,6 +358,23 @@ void request(uint8_t childSensorId, uint8_t variableType, uint8_t destination=GA
  */
 void requestTime();
 
+#if defined(MY_TIME_SERVICE)
+/**
+ * Controller time kept by the time service, corrected for the measured drift of the local clock.
+ * Sleep time is included.
+ *
+ * @return seconds as delivered by the controller (I_TIME), 0 until the first synchronisation
+ */
+unsigned long timeNow();
+
+/**
+ * Error bound of timeNow(). It grows with the time since the last synchronisation at the rate the clock
+ * could not be corrected to.
+ *
+ * @return ms, 0xFFFFFFFF until the first synchronisation
+ */
+unsigned long timeError();
+#endif
 
 
 /**
@@ -220,6 +457,88 @@ int8_t smartSleep(uint8_t interrupt, uint8_t mode, unsigned long ms=0);
 int8_t sleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mode2, unsigned long ms=0);
 int8_t smartSleep(uint8_t interrupt1, uint8_t mode1, uint8_t interrupt2, uint8_t mode2, unsigned long ms=0);
 
+#if defined(MY_SLEEP_TASKS)
+/**
+ * Register a periodic task for sleepTasks(). The task first runs on the next call to sleepTasks().
+ * @param task Function to call, e.g. reading and sending one child sensor.
+ * @param period Interval in milliseconds.
+ * @return False if all MY_SLEEP_TASKS slots are in use.
+ */
+bool scheduleTask(void (*task)(void), unsigned long period);
+
+/**
+ * Remove a task registered with scheduleTask().
+ * @param task Function to remove.
+ */
+void unscheduleTask(void (*task)(void));
+
+/**
+ * Run all due tasks, plus those due within MY_SLEEP_COALESCE_MS so that their
+ * sends share one radio power-up, then sleep until the next task is due.
+ * Call this from loop() instead of sleep().
+ * @param smart Use smartSleep() instead of sleep().
+ * @return see sleep(), -2 if no task is registered
+ */
+int8_t sleepTasks(bool smart=false);
+
+/**
+ * Scheduler clock: hwMillis() plus the time spent in sleep.
+ * @return Milliseconds since start.
+ */
+unsigned long schedulerMillis();
+#endif
+
+#if defined(MY_TASKS)
+/**
+ * Run a task every period milliseconds. Tasks run from _process(), i.e. while the sketch is in wait() or
+ * between two loop() calls, one task per call and the earliest deadline first. Tasks should return quickly,
+ * split long jobs into steps with scheduleAfter(). Scheduling a registered task again updates it.
+ * @param task Function to call.
+ * @param period Interval in milliseconds.
+ * @param delay First run in this many milliseconds.
+ * @return False if all MY_TASKS slots are in use.
+ */
+bool scheduleEvery(void (*task)(void), unsigned long period, unsigned long delay=0);
+
+/**
+ * Run a task once, see scheduleEvery().
+ * @param task Function to call, may schedule itself again.
+ * @param delay Run in this many milliseconds.
+ * @return False if all MY_TASKS slots are in use.
+ */
+bool scheduleAfter(void (*task)(void), unsigned long delay);
+
+/**
+ * Remove a task registered with scheduleEvery() or scheduleAfter().
+ * @param task Function to remove.
+ */
+void unschedule(void (*task)(void));
+#endif
+
+#if defined(MY_REPORT_POLICIES)
+/**
+ * Report by exception: send() skips values of (sensor, type) that did not change by more than minChange
+ * since the last value sent, unless maxSilent has elapsed, and defers values sent less than minInterval after it.
+ * The last change deferred by minInterval is sent from _process() once minInterval has passed.
+ * Only numeric payloads of unacknowledged send() calls are filtered, skipped values return true.
+ * Time spent in sleep counts. Setting the policy of a registered (sensor, type) again updates it.
+ * @param sensor Child sensor ID.
+ * @param type Variable type (V_*).
+ * @param minChange Deadband, values within +-minChange of the last one sent are skipped (0: skip unchanged values). 32 bit integer payloads are compared exactly.
+ * @param maxSilent Send anyway if nothing was sent for this many milliseconds (0: never).
+ * @param minInterval Rate limit, values are deferred for this many milliseconds after a send.
+ * @return False if all MY_REPORT_POLICIES slots are in use.
+ */
+bool setReportPolicy(uint8_t sensor, uint8_t type, float minChange, unsigned long maxSilent=0, unsigned long minInterval=0);
+
+/**
+ * Remove the report policy of (sensor, type), all values are sent again.
+ * @param sensor Child sensor ID.
+ * @param type Variable type (V_*).
+ */
+void clearReportPolicy(uint8_t sensor, uint8_t type);
+#endif
+
 #ifdef MY_NODE_LOCK_FEATURE
 /**
  * @ingroup MyLockgrp
@@ -243,6 +562,18 @@ void _process(void);
 
 bool _processInternalMessages();
 
+#if defined(MY_CONFIG_IMAGE)
+bool _configImageLoad();
+void _configImageSave();
+#endif
+
+#if defined(MY_WARM_BOOT)
+bool _warmBootLoad(WarmBootRecord &record);
+void _warmBootSave(WarmBootRecord &record);
+bool _warmBoot();
+void _warmBootStore();
+#endif
+
 void _infiniteLoop();
 
 void _registerNode();
@@ -257,6 +588,9 @@ extern MyMessage _msgTmp;  // Buffer for temporary messages (acks and nonces amo
 #endif
 void receive(const MyMessage &message)  __attribute__((weak));
 void receiveTime(unsigned long)  __attribute__((weak));
+#if defined(MY_TRANSPORT_FRAGMENTATION)
+void receiveFragmented(const MyMessage &message, const uint8_t* data, uint16_t length)  __attribute__((weak));
+#endif
 void presentation()  __attribute__((weak));
 void before() __attribute__((weak));
 void setup() __attribute__((weak));
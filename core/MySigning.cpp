@@ -36,17 +36,21 @@
 #ifdef MY_SIGNING_FEATURE
 uint8_t _doSign[32];      // Bitfield indicating which sensors require signed communication
 uint8_t _doWhitelist[32]; // Bitfield indicating which sensors require serial salted signatures
-MyMessage _msgSign;       // Buffer for message to sign.
-uint8_t _signingNonceStatus;
+// Nonce handshakes with the destinations of messages to sign
+static signing_session_t _signingSessions[MY_SIGNING_SESSIONS];
 
 #ifdef MY_NODE_LOCK_FEATURE
 static uint8_t nof_nonce_requests = 0;
 static uint8_t nof_failed_verifications = 0;
 #endif
 
-// Status when waiting for signing nonce in signerProcessInternal
+// State of a session in _signingSessions
 enum { SIGN_WAITING_FOR_NONCE = 0, SIGN_OK = 1 };
 
+#if defined(MY_SIGNING_FEATURE) && defined(MY_SIGNING_NONCE_PREFETCH)
+static void signerPrefetchPush(uint8_t destination);
+#endif
+
 // Macros for manipulating signing requirement table
 #define DO_SIGN(node) (~_doSign[node>>3]&(1<<node%8))
 #define SET_SIGN(node) (_doSign[node>>3]&=~(1<<node%8))
@@ -115,6 +119,11 @@ static void prepareSigningPresentation(MyMessage &msg, uint8_t destination) {
 
 void signerInit(void) {
 #if defined(MY_SIGNING_FEATURE)
+#if defined(MY_CONFIG_IMAGE)
+	// Signing and whitelist requirements were read with the configuration image
+	memcpy(_doSign, _configImage.doSign, sizeof(_doSign));
+	memcpy(_doWhitelist, _configImage.doWhitelist, sizeof(_doWhitelist));
+#else
 	// Read out the signing requirements from EEPROM
 	hwReadConfigBlock((void*)_doSign, (void*)EEPROM_SIGNING_REQUIREMENT_TABLE_ADDRESS,
 		sizeof(_doSign));
@@ -122,6 +131,7 @@ void signerInit(void) {
 	// Read out the whitelist requirements from EEPROM
 	hwReadConfigBlock((void*)_doWhitelist, (void*)EEPROM_WHITELIST_REQUIREMENT_TABLE_ADDRESS,
 		sizeof(_doWhitelist));
+#endif
 
 #if defined(MY_SIGNING_SOFT)
 	signerAtsha204SoftInit();
@@ -129,6 +139,9 @@ void signerInit(void) {
 #if defined(MY_SIGNING_ATSHA204)
 	signerAtsha204Init();
 #endif
+	for (uint8_t i = 0; i < MY_SIGNING_SESSIONS; i++) {
+		_signingSessions[i].node = SIGNING_SESSION_FREE;
+	}
 #endif
 }
 
@@ -230,6 +243,7 @@ bool signerProcessInternal(MyMessage &msg) {
 				sizeof(_doSign));
 			hwWriteConfigBlock((void*)_doWhitelist, (void*)EEPROM_WHITELIST_REQUIREMENT_TABLE_ADDRESS,
 				sizeof(_doWhitelist));
+			CONFIG_IMAGE_SAVE();
 
 			// Inform sender about our preference if we are a gateway, but only require signing if the sender
 			// required signing
@@ -263,31 +277,23 @@ bool signerProcessInternal(MyMessage &msg) {
 #endif // MY_GATEWAY_FEATURE
 			return true; // No need to further process I_SIGNING_PRESENTATION
 		} else if (msg.type == I_NONCE_RESPONSE) {
-			// Proceed with signing if nonce has been received
-			SIGN_DEBUG(PSTR("Nonce received from %d. Proceeding with signing...\n"), sender);
-			if (sender != _msgSign.destination) {
-				SIGN_DEBUG(PSTR("Nonce did not come from the destination (%d) of the message to be signed! "
-					"It came from %d.\n"), _msgSign.destination, sender);
-				SIGN_DEBUG(PSTR("Silently discarding this nonce\n"));
+			// Hand the nonce to the signerSignMsg() waiting for it
+			signing_session_t *session = signerSession(_signingSessions, sender, false);
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+			if (session == NULL) {
+				// Nonce pushed after verification, keep it for the next message
+				session = signerSession(_signingSessions, sender, true);
+			}
+#else
+			if (session == NULL || session->state != SIGN_WAITING_FOR_NONCE) {
+				SIGN_DEBUG(PSTR("Nonce from %d was not requested! Silently discarding this nonce\n"), sender);
 				return true; // No need to further process I_NONCE_RESPONSE
 			}
-#if defined(MY_SIGNING_SOFT)
-			signerAtsha204SoftPutNonce(msg);
 #endif
-#if defined(MY_SIGNING_ATSHA204)
-			signerAtsha204PutNonce(msg);
-#endif
-#if defined(MY_SIGNING_SOFT)
-			if (!signerAtsha204SoftSignMsg(_msgSign)) {
-#endif
-#if defined(MY_SIGNING_ATSHA204)
-			if (!signerAtsha204SignMsg(_msgSign)) {
-#endif
-				SIGN_DEBUG(PSTR("Failed to sign message!\n"));
-			} else {
-				SIGN_DEBUG(PSTR("Message signed\n"));
-				_signingNonceStatus = SIGN_OK; // _msgSign now contains the signed message pending transmission
-			}
+			SIGN_DEBUG(PSTR("Nonce received from %d\n"), sender);
+			memcpy(session->nonce, (uint8_t*)msg.getCustom(), MAX_PAYLOAD);
+			session->state = SIGN_OK;
+			session->timestamp = hwMillis();
 			return true; // No need to further process I_NONCE_RESPONSE
 		}
 #endif // MY_SIGNING_FEATURE
@@ -313,33 +319,73 @@ bool signerSignMsg(MyMessage &msg) {
 		if (skipSign(msg)) {
 			return true;
 		} else {
-			// Send nonce-request
-			_signingNonceStatus=SIGN_WAITING_FOR_NONCE;
-			if (!_sendRoute(build(_msgSign, _nc.nodeId, msg.destination, msg.sensor,
-				C_INTERNAL, I_NONCE_REQUEST, false).set(""))) {
-				SIGN_DEBUG(PSTR("Failed to transmit nonce request!\n"));
+#if defined(MY_MESSAGE_POOL_SIZE)
+			// Pool buffer, nesting of handshakes in _process() ends when the pool is exhausted
+			MyPooledMessage pooled;
+			if (!pooled.valid()) {
+				SIGN_DEBUG(PSTR("No buffer to sign message!\n"));
 				return false;
 			}
-			SIGN_DEBUG(PSTR("Nonce requested from %d. Waiting...\n"), msg.destination);
-			// We have to wait for the nonce to arrive before we can sign our original message
-			// Other messages could come in-between. We trust _process() takes care of them
-			unsigned long enter = hwMillis();
-			_msgSign = msg; // Copy the message to sign since message buffer might be touched in _process()
-			while (hwMillis() - enter < MY_VERIFICATION_TIMEOUT_MS && _signingNonceStatus==SIGN_WAITING_FOR_NONCE) {
-				_process();
-			}
-			if (hwMillis() - enter > MY_VERIFICATION_TIMEOUT_MS) {
-				SIGN_DEBUG(PSTR("Timeout waiting for nonce!\n"));
-				return false;
+			MyMessage &msgSign = pooled.get();
+#else
+			MyMessage msgSign; // Local buffer, so handshakes with other destinations can nest in _process()
+#endif
+			signing_session_t *session = signerSession(_signingSessions, msg.destination, false);
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+			// Prefetched nonce has to leave the verifier time to receive the signed message
+			if (session != NULL && session->state == SIGN_OK &&
+				hwMillis() - session->timestamp > MY_SIGNING_NONCE_LIFETIME_MS - MY_VERIFICATION_TIMEOUT_MS) {
+				SIGN_DEBUG(PSTR("Prefetched nonce from %d expired\n"), msg.destination);
+				session = NULL;
 			}
-			if (_signingNonceStatus == SIGN_OK) {
-				// process() received a nonce and signerProcessInternal successfully signed the message
-				msg = _msgSign; // Write the signed message back
-				SIGN_DEBUG(PSTR("Message to send has been signed\n"));
+#endif
+			if (session == NULL || session->state != SIGN_OK) {
+				// Send nonce-request
+				session = signerSession(_signingSessions, msg.destination, true);
+				session->state = SIGN_WAITING_FOR_NONCE;
+				if (!_sendRoute(build(msgSign, _nc.nodeId, msg.destination, msg.sensor,
+					C_INTERNAL, I_NONCE_REQUEST, false).set(""))) {
+					SIGN_DEBUG(PSTR("Failed to transmit nonce request!\n"));
+					session->node = SIGNING_SESSION_FREE;
+					return false;
+				}
+				SIGN_DEBUG(PSTR("Nonce requested from %d. Waiting...\n"), msg.destination);
+				// We have to wait for the nonce to arrive before we can sign our original message
+				// Other messages could come in-between. We trust _process() takes care of them
+				unsigned long enter = hwMillis();
+				msgSign = msg; // Copy the message to sign since message buffer might be touched in _process()
+				while (hwMillis() - enter < MY_VERIFICATION_TIMEOUT_MS && session->node == msgSign.destination &&
+					session->state == SIGN_WAITING_FOR_NONCE) {
+					_process();
+				}
+				if (session->node != msgSign.destination || session->state != SIGN_OK) {
+					SIGN_DEBUG(PSTR("Timeout waiting for nonce!\n"));
+					if (session->node == msgSign.destination) {
+						session->node = SIGNING_SESSION_FREE;
+					}
+					return false;
+				}
 			} else {
+				msgSign = msg;
+				SIGN_DEBUG(PSTR("Using prefetched nonce from %d\n"), msg.destination);
+			}
+			// Nonce is used once
+			MyMessage nonce;
+			nonce.set(session->nonce, MAX_PAYLOAD);
+			session->node = SIGNING_SESSION_FREE;
+#if defined(MY_SIGNING_SOFT)
+			signerAtsha204SoftPutNonce(nonce);
+			if (!signerAtsha204SoftSignMsg(msgSign)) {
+#endif
+#if defined(MY_SIGNING_ATSHA204)
+			signerAtsha204PutNonce(nonce);
+			if (!signerAtsha204SignMsg(msgSign)) {
+#endif
 				SIGN_DEBUG(PSTR("Message to send could not be signed!\n"));
 				return false;
 			}
+			msg = msgSign; // Write the signed message back
+			SIGN_DEBUG(PSTR("Message to send has been signed\n"));
 			// After this point, only the 'last' member of the message structure is allowed to be altered if the
 			// message has been signed, or signature will become invalid and the message rejected by the receiver
 		}
@@ -379,6 +425,12 @@ bool signerVerifyMsg(MyMessage &msg) {
 			if (!verificationResult) {
 				SIGN_DEBUG(PSTR("Signature verification failed!\n"));
 			}
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+			else {
+				// Give sender the nonce for its next message
+				signerPrefetchPush(msg.sender);
+			}
+#endif
 #if defined(MY_NODE_LOCK_FEATURE)
 			if (verificationResult) {
 				// On successful verification, clear lock counters
@@ -410,9 +462,7 @@ void signerSha256Init(void) {
 }
 
 void signerSha256Update(const uint8_t* data, size_t sz) {
-	for (size_t i = 0; i < sz; i++) {
-		_soft_sha256.write(data[i]);
-	}
+	_soft_sha256.write(data, sz);
 }
 
 uint8_t* signerSha256Final(void) {
@@ -420,6 +470,26 @@ uint8_t* signerSha256Final(void) {
 	return sha256_hash;
 }
 
+#if defined(MY_SIGNING_FEATURE) && defined(MY_SIGNING_NONCE_PREFETCH)
+static void signerPrefetchPush(uint8_t destination) {
+	MyMessage nonce;
+	nonce.sender = destination; // Verification session is kept for the requester
+#if defined(MY_SIGNING_SOFT)
+	if (!signerAtsha204SoftGetNonce(nonce)) {
+#endif
+#if defined(MY_SIGNING_ATSHA204)
+	if (!signerAtsha204GetNonce(nonce)) {
+#endif
+		SIGN_DEBUG(PSTR("Failed to generate nonce!\n"));
+		return;
+	}
+	if (!_sendRoute(build(nonce, _nc.nodeId, destination, NODE_SENSOR_ID,
+		C_INTERNAL, I_NONCE_RESPONSE, false))) {
+		SIGN_DEBUG(PSTR("Failed to transmit nonce!\n"));
+	}
+}
+#endif // MY_SIGNING_NONCE_PREFETCH
+
 int signerMemcmp(const void* a, const void* b, size_t sz) {
 	int retVal;
 	size_t i;
@@ -448,3 +518,70 @@ int signerMemcmp(const void* a, const void* b, size_t sz) {
 	}
 	return retVal;
 }
+
+#if defined(MY_SIGNING_FEATURE) && defined(MY_SIGNING_NODE_WHITELISTING)
+bool signerWhitelistSorted(const whitelist_entry_t *whitelist, size_t size) {
+	for (size_t i = 1; i < size; i++) {
+		if (whitelist[i].nodeId <= whitelist[i-1].nodeId) {
+			return false;
+		}
+	}
+	return true;
+}
+
+const whitelist_entry_t* signerWhitelistEntry(const whitelist_entry_t *whitelist, size_t size, bool sorted, uint8_t node) {
+	if (!sorted) {
+		for (size_t i = 0; i < size; i++) {
+			if (whitelist[i].nodeId == node) {
+				return &whitelist[i];
+			}
+		}
+		return NULL;
+	}
+	size_t low = 0;
+	size_t high = size;
+	while (low < high) {
+		const size_t mid = (low + high) / 2;
+		if (whitelist[mid].nodeId < node) {
+			low = mid + 1;
+		} else if (whitelist[mid].nodeId > node) {
+			high = mid;
+		} else {
+			return &whitelist[mid];
+		}
+	}
+	return NULL;
+}
+#endif
+
+#if defined(MY_SIGNING_FEATURE)
+signing_session_t* signerSession(signing_session_t *sessions, uint8_t node, bool create) {
+	signing_session_t *oldest = NULL;
+	signing_session_t *free = NULL;
+	bool oldestWaiting = false;
+	for (uint8_t i = 0; i < MY_SIGNING_SESSIONS; i++) {
+		if (sessions[i].node == node) {
+			return &sessions[i];
+		}
+		if (sessions[i].node == SIGNING_SESSION_FREE) {
+			free = &sessions[i];
+			continue;
+		}
+		// Sessions waiting for a nonce are only replaced when all sessions are waiting
+		const bool waiting = sessions[i].state == SIGN_WAITING_FOR_NONCE;
+		if (oldest == NULL || (oldestWaiting && !waiting) ||
+			(oldestWaiting == waiting && (long)(sessions[i].timestamp - oldest->timestamp) < 0)) {
+			oldest = &sessions[i];
+			oldestWaiting = waiting;
+		}
+	}
+	if (!create) {
+		return NULL;
+	}
+	signing_session_t *session = free ? free : oldest;
+	session->node = node;
+	session->state = SIGN_OK;
+	session->timestamp = hwMillis();
+	return session;
+}
+#endif
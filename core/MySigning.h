@@ -485,6 +485,24 @@ typedef struct {
 } whitelist_entry_t;
 #endif
 
+/** @brief Node ID marking an unused entry in a session table */
+#define SIGNING_SESSION_FREE 0xFF
+
+/** @brief Nonce exchanged with a peer, one entry per node in a session table */
+typedef struct {
+	uint8_t node;               /**< @brief The ID of the peer, @ref SIGNING_SESSION_FREE if unused */
+	uint8_t state;              /**< @brief State of the session */
+	uint8_t nonce[MAX_PAYLOAD]; /**< @brief The nonce issued to or received from the peer */
+	unsigned long timestamp;    /**< @brief Time the nonce was issued or received */
+} signing_session_t;
+
+/** @brief Lifetime of an issued nonce, verifiers keep prefetched nonces valid longer */
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+#define SIGNING_NONCE_TIMEOUT_MS MY_SIGNING_NONCE_LIFETIME_MS
+#else
+#define SIGNING_NONCE_TIMEOUT_MS MY_VERIFICATION_TIMEOUT_MS
+#endif
+
 /** @brief Helper macro to determine the number of elements in a array */
 #define NUM_OF(x) (sizeof(x)/sizeof(x[0]))
 
@@ -636,6 +654,43 @@ uint8_t* signerSha256Final(void);
  */
 int signerMemcmp(const void* a, const void* b, size_t sz);
 
+/**
+ * @brief Look up the session of a peer in a session table.
+ *
+ * If @p create is set and the peer has no session, a free entry is taken. Without a free entry
+ * the oldest session not waiting for a nonce is replaced, or the oldest one if all are waiting.
+ *
+ * @param sessions Session table with @ref MY_SIGNING_SESSIONS entries.
+ * @param node The ID of the peer.
+ * @param create Allocate a session if the peer has none.
+ * @returns The session, or @c NULL if the peer has none and @p create is not set.
+ */
+signing_session_t* signerSession(signing_session_t *sessions, uint8_t node, bool create);
+
+#ifdef MY_SIGNING_NODE_WHITELISTING
+/**
+ * @brief Check if a whitelist is sorted by node ID (no duplicates).
+ *
+ * @param whitelist The whitelist.
+ * @param size The number of entries.
+ * @returns @c true if the entries are in ascending nodeId order.
+ */
+bool signerWhitelistSorted(const whitelist_entry_t *whitelist, size_t size);
+
+/**
+ * @brief Look up a node in a whitelist.
+ *
+ * Sorted lists are searched binary, others linearly.
+ *
+ * @param whitelist The whitelist.
+ * @param size The number of entries.
+ * @param sorted Result of @ref signerWhitelistSorted for the list.
+ * @param node The ID of the node.
+ * @returns The entry of the node, or @c NULL if it is not whitelisted.
+ */
+const whitelist_entry_t* signerWhitelistEntry(const whitelist_entry_t *whitelist, size_t size, bool sorted, uint8_t node);
+#endif
+
 #endif
 /** @}*/
 /**
@@ -26,13 +26,13 @@
  */
 
 #include "MySigning.h"
+#include "MyTransport.h"
 
 #define SIGNING_IDENTIFIER (1)
 
 // Define MY_DEBUG_VERBOSE_SIGNING in your sketch to enable signing backend debugprints
 
-unsigned long _signing_timestamp;
-bool _signing_verification_ongoing = false;
+static signing_session_t _signing_sessions[MY_SIGNING_SESSIONS]; // Nonces issued to peers
 uint8_t _signing_verifying_nonce[NONCE_NUMIN_SIZE_PASSTHROUGH+SHA204_SERIAL_SZ+1];
 uint8_t _signing_signing_nonce[NONCE_NUMIN_SIZE_PASSTHROUGH+SHA204_SERIAL_SZ+1];
 uint8_t _signing_temp_message[SHA_MSG_SIZE];
@@ -42,10 +42,13 @@ extern uint8_t _doWhitelist[32];
 
 #ifdef MY_SIGNING_NODE_WHITELISTING
 	const whitelist_entry_t _signing_whitelist[] = MY_SIGNING_NODE_WHITELISTING;
+	static bool _signing_whitelist_sorted;
 #endif
 
 static void signerCalculateSignature(MyMessage &msg, bool signing);
 static uint8_t* signerSha256(const uint8_t* data, size_t sz);
+static uint8_t signerAtsha204Execute(uint8_t op_code, uint8_t param1, uint16_t param2,
+	uint8_t datalen1, uint8_t *data1, uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer);
 
 
 #ifdef MY_DEBUG_VERBOSE_SIGNING
@@ -88,20 +91,30 @@ static void DEBUG_SIGNING_PRINTBUF(const __FlashStringHelper* str, uint8_t* buf,
 
 void signerAtsha204Init(void) {
 	atsha204_init(MY_SIGNING_ATSHA204_PIN);
+	for (uint8_t i = 0; i < MY_SIGNING_SESSIONS; i++) {
+		_signing_sessions[i].node = SIGNING_SESSION_FREE;
+	}
+#ifdef MY_SIGNING_NODE_WHITELISTING
+	_signing_whitelist_sorted = signerWhitelistSorted(_signing_whitelist, NUM_OF(_signing_whitelist));
+	if (!_signing_whitelist_sorted) {
+		DEBUG_SIGNING_PRINTBUF(F("Whitelist not sorted by nodeId, linear lookup"), NULL, 0);
+	}
+#endif
 }
 
 bool signerAtsha204CheckTimer(void) {
-	if (_signing_verification_ongoing) {
-		if (hwMillis() < _signing_timestamp || hwMillis() > _signing_timestamp + MY_VERIFICATION_TIMEOUT_MS) {
+	bool valid = true;
+	for (uint8_t i = 0; i < MY_SIGNING_SESSIONS; i++) {
+		if (_signing_sessions[i].node != SIGNING_SESSION_FREE &&
+			hwMillis() - _signing_sessions[i].timestamp > SIGNING_NONCE_TIMEOUT_MS) {
 			DEBUG_SIGNING_PRINTBUF(F("Verification timeout"), NULL, 0);
 			// Purge nonce
-			memset(_signing_signing_nonce, 0x00, NONCE_NUMIN_SIZE_PASSTHROUGH);
-			memset(_signing_verifying_nonce, 0x00, NONCE_NUMIN_SIZE_PASSTHROUGH);
-			_signing_verification_ongoing = false;
-			return false; 
+			memset(_signing_sessions[i].nonce, 0x00, MAX_PAYLOAD);
+			_signing_sessions[i].node = SIGNING_SESSION_FREE;
+			valid = false;
 		}
 	}
-	return true;
+	return valid;
 }
 
 bool signerAtsha204GetNonce(MyMessage &msg) {
@@ -110,7 +123,8 @@ bool signerAtsha204GetNonce(MyMessage &msg) {
 	// We used a basic whitening technique that XORs each byte in a 32byte random value with current hwMillis() counter
 	// This 32-byte random value is then hashed (SHA256) to produce the resulting nonce
 	(void)atsha204_wakeup(_signing_temp_message);
-	if (atsha204_execute(SHA204_RANDOM, RANDOM_SEED_UPDATE, 0, 0, NULL,
+	ENERGY_SIGNER_WAKE();
+	if (signerAtsha204Execute(SHA204_RANDOM, RANDOM_SEED_UPDATE, 0, 0, NULL,
 								RANDOM_COUNT, _signing_tx_buffer, RANDOM_RSP_SIZE, _signing_rx_buffer) != SHA204_SUCCESS) {
 		DEBUG_SIGNING_PRINTBUF(F("Failed to generate nonce"), NULL, 0);
 		return false;
@@ -121,18 +135,17 @@ bool signerAtsha204GetNonce(MyMessage &msg) {
 	memcpy(_signing_verifying_nonce, signerSha256(_signing_verifying_nonce, 32), MAX_PAYLOAD);
 
 	atsha204_idle(); // We just idle the chip now since we expect to use it soon when the signed message arrives
+	ENERGY_SIGNER_SLEEP();
 
 	// We set the part of the 32-byte nonce that does not fit into a message to 0xAA
 	memset(&_signing_verifying_nonce[MAX_PAYLOAD], 0xAA, sizeof(_signing_verifying_nonce)-MAX_PAYLOAD);
 
 	// Transfer the first part of the nonce to the message
 	msg.set(_signing_verifying_nonce, MAX_PAYLOAD);
-	_signing_verification_ongoing = true;
-	_signing_timestamp = hwMillis(); // Set timestamp to determine when to purge nonce
-	// Be a little fancy to handle turnover (prolong the time allowed to timeout after turnover)
-	// Note that if message is "too" quick, and arrives before turnover, it will be rejected
-	// but this is consider such a rare case that it is accepted and rejects are 'safe'
-	if (_signing_timestamp + MY_VERIFICATION_TIMEOUT_MS < hwMillis()) _signing_timestamp = 0;
+	// Keep the nonce in the session of the requester, the session timestamp determines when to purge it
+	signing_session_t *session = signerSession(_signing_sessions, msg.sender, true);
+	memcpy(session->nonce, _signing_verifying_nonce, MAX_PAYLOAD);
+	session->timestamp = hwMillis();
 	return true;
 }
 
@@ -166,6 +179,7 @@ bool signerAtsha204SignMsg(MyMessage &msg) {
 
 	// Put device back to sleep
 	atsha204_sleep();
+	ENERGY_SIGNER_SLEEP();
 
 	// Overwrite the first byte in the signature with the signing identifier
 	_signing_rx_buffer[SHA204_BUFFER_POS_DATA] = SIGNING_IDENTIFIER;
@@ -178,16 +192,22 @@ bool signerAtsha204SignMsg(MyMessage &msg) {
 }
 
 bool signerAtsha204VerifyMsg(MyMessage &msg) {
-	if (!_signing_verification_ongoing) {
+	signing_session_t *session = signerSession(_signing_sessions, msg.sender, false);
+	if (session == NULL) {
 		DEBUG_SIGNING_PRINTBUF(F("No active verification session"), NULL, 0);
 		return false; 
 	} else {
 		// Make sure we have not expired
-		if (!signerCheckTimer()) {
+		(void)signerCheckTimer();
+		if (session->node != msg.sender) {
 			return false; 
 		}
 
-		_signing_verification_ongoing = false;
+		// Take the nonce out of the session, it is only used once
+		memcpy(_signing_verifying_nonce, session->nonce, MAX_PAYLOAD);
+		memset(&_signing_verifying_nonce[MAX_PAYLOAD], 0xAA, sizeof(_signing_verifying_nonce)-MAX_PAYLOAD);
+		memset(session->nonce, 0x00, MAX_PAYLOAD);
+		session->node = SIGNING_SESSION_FREE;
 
 		if (msg.data[mGetLength(msg)] != SIGNING_IDENTIFIER) {
 			DEBUG_SIGNING_PRINTBUF(F("Incorrect signing identifier"), NULL, 0);
@@ -199,27 +219,25 @@ bool signerAtsha204VerifyMsg(MyMessage &msg) {
 
 #ifdef MY_SIGNING_NODE_WHITELISTING
 		// Look up the senders nodeId in our whitelist and salt the signature with that data
-		size_t j;
-		for (j=0; j < NUM_OF(_signing_whitelist); j++) {
-			if (_signing_whitelist[j].nodeId == msg.sender) {
-				DEBUG_SIGNING_PRINTBUF(F("Sender found in whitelist"), NULL, 0);
-				memcpy(_signing_verifying_nonce, &_signing_rx_buffer[SHA204_BUFFER_POS_DATA], 32); // We can reuse the nonce buffer now since it is no longer needed
-				_signing_verifying_nonce[32] = msg.sender;
-				memcpy(&_signing_verifying_nonce[33], _signing_whitelist[j].serial, SHA204_SERIAL_SZ);
-				(void)signerSha256(_signing_verifying_nonce, 32+1+SHA204_SERIAL_SZ); // we can 'void' sha256 because the hash is already put in the correct place
-				break;
-			}
-		}
-		if (j == NUM_OF(_signing_whitelist)) {
+		const whitelist_entry_t *entry = signerWhitelistEntry(_signing_whitelist, NUM_OF(_signing_whitelist), _signing_whitelist_sorted, msg.sender);
+		if (entry) {
+			DEBUG_SIGNING_PRINTBUF(F("Sender found in whitelist"), NULL, 0);
+			memcpy(_signing_verifying_nonce, &_signing_rx_buffer[SHA204_BUFFER_POS_DATA], 32); // We can reuse the nonce buffer now since it is no longer needed
+			_signing_verifying_nonce[32] = msg.sender;
+			memcpy(&_signing_verifying_nonce[33], entry->serial, SHA204_SERIAL_SZ);
+			(void)signerSha256(_signing_verifying_nonce, 32+1+SHA204_SERIAL_SZ); // we can 'void' sha256 because the hash is already put in the correct place
+		} else {
 			DEBUG_SIGNING_PRINTBUF(F("Sender not found in whitelist, message rejected!"), NULL, 0);
 			// Put device back to sleep
 			atsha204_sleep();
+			ENERGY_SIGNER_SLEEP();
 			return false;
 		}
 #endif
 
 		// Put device back to sleep
 		atsha204_sleep();
+		ENERGY_SIGNER_SLEEP();
 
 		// Overwrite the first byte in the signature with the signing identifier
 		_signing_rx_buffer[SHA204_BUFFER_POS_DATA] = SIGNING_IDENTIFIER;
@@ -241,17 +259,20 @@ bool signerAtsha204VerifyMsg(MyMessage &msg) {
 // Helper to calculate signature of msg (returned in _signing_rx_buffer[SHA204_BUFFER_POS_DATA])
 static void signerCalculateSignature(MyMessage &msg, bool signing) {
 	(void)atsha204_wakeup(_signing_temp_message);
+	ENERGY_SIGNER_WAKE();
 	memset(_signing_temp_message, 0, 32);
-	memcpy(_signing_temp_message, (uint8_t*)&msg.data[1-HEADER_SIZE], MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
+	// header without last, which changes on every hop
+	uint8_t *header = (uint8_t*)&msg + offsetof(MyMessage, last) + 1;
+	memcpy(_signing_temp_message, header, MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
 
 	// Program the data to sign into the ATSHA204
-	DEBUG_SIGNING_PRINTBUF(F("Message to process: "), (uint8_t*)&msg.data[1-HEADER_SIZE], MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
+	DEBUG_SIGNING_PRINTBUF(F("Message to process: "), header, MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
 	DEBUG_SIGNING_PRINTBUF(F("Current nonce: "), signing ? _signing_signing_nonce : _signing_verifying_nonce, 32);
-	(void)atsha204_execute(SHA204_WRITE, SHA204_ZONE_DATA | SHA204_ZONE_COUNT_FLAG, 8 << 3, 32, _signing_temp_message,
+	(void)signerAtsha204Execute(SHA204_WRITE, SHA204_ZONE_DATA | SHA204_ZONE_COUNT_FLAG, 8 << 3, 32, _signing_temp_message,
 									WRITE_COUNT_LONG, _signing_tx_buffer, WRITE_RSP_SIZE, _signing_rx_buffer);
 
 	// Program the nonce to use for the signature (has to be done just before GENDIG due to chip limitations)
-	(void)atsha204_execute(SHA204_NONCE, NONCE_MODE_PASSTHROUGH, 0, NONCE_NUMIN_SIZE_PASSTHROUGH,
+	(void)signerAtsha204Execute(SHA204_NONCE, NONCE_MODE_PASSTHROUGH, 0, NONCE_NUMIN_SIZE_PASSTHROUGH,
 									signing ? _signing_signing_nonce : _signing_verifying_nonce,
 									NONCE_COUNT_LONG, _signing_tx_buffer, NONCE_RSP_SIZE_SHORT, _signing_rx_buffer);
 
@@ -259,11 +280,11 @@ static void signerCalculateSignature(MyMessage &msg, bool signing) {
 	memset(signing ? _signing_signing_nonce : _signing_verifying_nonce, 0x00, NONCE_NUMIN_SIZE_PASSTHROUGH);
 
 	// Generate digest of data and nonce
-	(void)atsha204_execute(SHA204_GENDIG, GENDIG_ZONE_DATA, 8, 0, NULL,
+	(void)signerAtsha204Execute(SHA204_GENDIG, GENDIG_ZONE_DATA, 8, 0, NULL,
 									GENDIG_COUNT_DATA, _signing_tx_buffer, GENDIG_RSP_SIZE, _signing_rx_buffer);
 
 	// Calculate HMAC of message+nonce digest and secret key
-	(void)atsha204_execute(SHA204_HMAC, HMAC_MODE_SOURCE_FLAG_MATCH, 0, 0, NULL,
+	(void)signerAtsha204Execute(SHA204_HMAC, HMAC_MODE_SOURCE_FLAG_MATCH, 0, 0, NULL,
 									HMAC_COUNT, _signing_tx_buffer, HMAC_RSP_SIZE, _signing_rx_buffer);
 
 	DEBUG_SIGNING_PRINTBUF(F("HMAC: "), &_signing_rx_buffer[SHA204_BUFFER_POS_DATA], 32);
@@ -273,7 +294,7 @@ static void signerCalculateSignature(MyMessage &msg, bool signing) {
 // The pointer to the hash is returned, but the hash is also stored in _signing_rx_buffer[SHA204_BUFFER_POS_DATA])
 static uint8_t* signerSha256(const uint8_t* data, size_t sz) {
 	// Initiate SHA256 calculator
-	(void)atsha204_execute(SHA204_SHA, SHA_INIT, 0, 0, NULL,
+	(void)signerAtsha204Execute(SHA204_SHA, SHA_INIT, 0, 0, NULL,
 									SHA_COUNT_SHORT, _signing_tx_buffer, SHA_RSP_SIZE_SHORT, _signing_rx_buffer);
 
 	// Calculate a hash
@@ -283,9 +304,24 @@ static uint8_t* signerSha256(const uint8_t* data, size_t sz) {
 	// Write length data to the last bytes
 	_signing_temp_message[SHA_MSG_SIZE-2] = (sz >> 5);
 	_signing_temp_message[SHA_MSG_SIZE-1] = (sz << 3);
-	(void)atsha204_execute(SHA204_SHA, SHA_CALC, 0, SHA_MSG_SIZE, _signing_temp_message,
+	(void)signerAtsha204Execute(SHA204_SHA, SHA_CALC, 0, SHA_MSG_SIZE, _signing_temp_message,
 									SHA_COUNT_LONG, _signing_tx_buffer, SHA_RSP_SIZE_LONG, _signing_rx_buffer);
 
 	DEBUG_SIGNING_PRINTBUF(F("SHA256: "), &_signing_rx_buffer[SHA204_BUFFER_POS_DATA], 32);
 	return &_signing_rx_buffer[SHA204_BUFFER_POS_DATA];
 }
+
+// Helper to run a device command without blocking for its execution time
+static uint8_t signerAtsha204Execute(uint8_t op_code, uint8_t param1, uint16_t param2,
+	uint8_t datalen1, uint8_t *data1, uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer) {
+	uint8_t ret_code = atsha204_execute_start(op_code, param1, param2, datalen1, data1,
+		tx_size, tx_buffer, rx_size, rx_buffer);
+	while (ret_code == SHA204_EXECUTING) {
+#if defined(MY_RADIO_FEATURE)
+		// Keep the radio going, but do not process messages as they might need the device
+		transportUpdateAsyncSend();
+#endif
+		ret_code = atsha204_execute_poll();
+	}
+	return ret_code;
+}
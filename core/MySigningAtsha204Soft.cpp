@@ -36,18 +36,17 @@
 // Define MY_DEBUG_VERBOSE_SIGNING in your sketch to enable signing backend debugprints
 
 Sha256Class _signing_sha256;
-unsigned long _signing_timestamp;
-bool _signing_verification_ongoing = false;
+static signing_session_t _signing_sessions[MY_SIGNING_SESSIONS]; // Nonces issued to peers
 uint8_t _signing_verifying_nonce[32];
 uint8_t _signing_signing_nonce[32];
 uint8_t _signing_temp_message[32];
-static uint8_t _signing_hmac_key[32];
 uint8_t _signing_hmac[32];
 extern uint8_t _doWhitelist[32];
 
 static uint8_t _signing_node_serial_info[9];
 #ifdef MY_SIGNING_NODE_WHITELISTING
 	const whitelist_entry_t _signing_whitelist[] = MY_SIGNING_NODE_WHITELISTING;
+	static bool _signing_whitelist_sorted;
 #endif
 
 static void signerCalculateSignature(MyMessage &msg, bool signing);
@@ -91,50 +90,71 @@ static void DEBUG_SIGNING_PRINTBUF(const __FlashStringHelper* str, uint8_t* buf,
 #endif
 
 void signerAtsha204SoftInit(void) {
-	// initialize pseudo-RNG
-	randomSeed(analogRead(MY_SIGNING_SOFT_RANDOMSEED_PIN));
-	// Set secrets
-	hwReadConfigBlock((void*)_signing_hmac_key, (void*)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS, 32);
+	// hardware entropy for nonces, the pseudo-RNG is used when it is not available
+	hwRandomInit();
+	uint32_t seed;
+	if (!hwRandomBytes((uint8_t*)&seed, sizeof(seed))) {
+		seed = analogRead(MY_SIGNING_SOFT_RANDOMSEED_PIN);
+	}
+	randomSeed(seed);
+	// Set secrets, only the HMAC pad states derived from the key are kept
+	uint8_t hmacKey[32];
+	hwReadConfigBlock((void*)hmacKey, (void*)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS, 32);
+	_signing_sha256.initHmac(hmacKey, 32);
+	memset(hmacKey, 0, 32);
 	hwReadConfigBlock((void*)_signing_node_serial_info, (void*)EEPROM_SIGNING_SOFT_SERIAL_ADDRESS, 9);
+	for (uint8_t i = 0; i < MY_SIGNING_SESSIONS; i++) {
+		_signing_sessions[i].node = SIGNING_SESSION_FREE;
+	}
+#ifdef MY_SIGNING_NODE_WHITELISTING
+	_signing_whitelist_sorted = signerWhitelistSorted(_signing_whitelist, NUM_OF(_signing_whitelist));
+	if (!_signing_whitelist_sorted) {
+		DEBUG_SIGNING_PRINTBUF(F("Whitelist not sorted by nodeId, linear lookup"), NULL, 0);
+	}
+#endif
 }
 
 bool signerAtsha204SoftCheckTimer(void) {
-	if (_signing_verification_ongoing) {
-		if (hwMillis() < _signing_timestamp || hwMillis() > _signing_timestamp + MY_VERIFICATION_TIMEOUT_MS) {
+	bool valid = true;
+	for (uint8_t i = 0; i < MY_SIGNING_SESSIONS; i++) {
+		if (_signing_sessions[i].node != SIGNING_SESSION_FREE &&
+			hwMillis() - _signing_sessions[i].timestamp > SIGNING_NONCE_TIMEOUT_MS) {
 			DEBUG_SIGNING_PRINTBUF(F("Verification timeout"), NULL, 0);
 			// Purge nonce
-			memset(_signing_signing_nonce, 0xAA, 32);
-			memset(_signing_verifying_nonce, 0xAA, 32);
-			_signing_verification_ongoing = false;
-			return false; 
+			memset(_signing_sessions[i].nonce, 0xAA, MAX_PAYLOAD);
+			_signing_sessions[i].node = SIGNING_SESSION_FREE;
+			valid = false;
 		}
 	}
-	return true;
+	return valid;
 }
 
 bool signerAtsha204SoftGetNonce(MyMessage &msg) {
 	DEBUG_SIGNING_PRINTBUF(F("Signing backend: ATSHA204Soft"), NULL, 0);
 
-	// We used a basic whitening technique that XORs a random byte with the current hwMillis() counter and then the byte is 
-	// hashed (SHA256) to produce the resulting nonce
-	_signing_sha256.init();
-	for (int i = 0; i < 32; i++) {
-		_signing_sha256.write(random(256) ^ (hwMillis()&0xFF));
+	// Nonce is drawn from the hardware entropy source (TRNG, ESP8266 RNG, AVR WDT jitter pool)
+	if (hwRandomBytes(_signing_verifying_nonce, MAX_PAYLOAD)) {
+		DEBUG_SIGNING_PRINTBUF(F("HWRNG: "), _signing_verifying_nonce, MAX_PAYLOAD);
+	} else {
+		// We used a basic whitening technique that XORs a random byte with the current hwMillis() counter and then the byte is 
+		// hashed (SHA256) to produce the resulting nonce
+		_signing_sha256.init();
+		for (int i = 0; i < 32; i++) {
+			_signing_sha256.write(random(256) ^ (hwMillis()&0xFF));
+		}
+		memcpy(_signing_verifying_nonce, _signing_sha256.result(), MAX_PAYLOAD);
+		DEBUG_SIGNING_PRINTBUF(F("SHA256: "), _signing_verifying_nonce, 32);
 	}
-	memcpy(_signing_verifying_nonce, _signing_sha256.result(), MAX_PAYLOAD);
-	DEBUG_SIGNING_PRINTBUF(F("SHA256: "), _signing_verifying_nonce, 32);
 
 	// We set the part of the 32-byte nonce that does not fit into a message to 0xAA
 	memset(&_signing_verifying_nonce[MAX_PAYLOAD], 0xAA, sizeof(_signing_verifying_nonce)-MAX_PAYLOAD);
 
 	// Transfer the first part of the nonce to the message
 	msg.set(_signing_verifying_nonce, MAX_PAYLOAD);
-	_signing_verification_ongoing = true;
-	_signing_timestamp = hwMillis(); // Set timestamp to determine when to purge nonce
-	// Be a little fancy to handle turnover (prolong the time allowed to timeout after turnover)
-	// Note that if message is "too" quick, and arrives before turnover, it will be rejected
-	// but this is consider such a rare case that it is accepted and rejects are 'safe'
-	if (_signing_timestamp + MY_VERIFICATION_TIMEOUT_MS < hwMillis()) _signing_timestamp = 0;
+	// Keep the nonce in the session of the requester, the session timestamp determines when to purge it
+	signing_session_t *session = signerSession(_signing_sessions, msg.sender, true);
+	memcpy(session->nonce, _signing_verifying_nonce, MAX_PAYLOAD);
+	session->timestamp = hwMillis();
 	return true;
 }
 
@@ -160,9 +180,9 @@ bool signerAtsha204SoftSignMsg(MyMessage &msg) {
 	if (DO_WHITELIST(msg.destination)) {
 		// Salt the signature with the senders nodeId and the (hopefully) unique serial The Creator has provided
 		_signing_sha256.init();
-		for (int i=0; i<32; i++) _signing_sha256.write(_signing_hmac[i]);
+		_signing_sha256.write(_signing_hmac, 32);
 		_signing_sha256.write(msg.sender);
-		for (int i=0; i<SHA204_SERIAL_SZ; i++) _signing_sha256.write(_signing_node_serial_info[i]);
+		_signing_sha256.write(_signing_node_serial_info, SHA204_SERIAL_SZ);
 		memcpy(_signing_hmac, _signing_sha256.result(), 32);
 		DEBUG_SIGNING_PRINTBUF(F("SHA256: "), _signing_hmac, 32);
 		DEBUG_SIGNING_PRINTBUF(F("Signature salted with serial"), NULL, 0);
@@ -179,16 +199,22 @@ bool signerAtsha204SoftSignMsg(MyMessage &msg) {
 }
 
 bool signerAtsha204SoftVerifyMsg(MyMessage &msg) {
-	if (!_signing_verification_ongoing) {
+	signing_session_t *session = signerSession(_signing_sessions, msg.sender, false);
+	if (session == NULL) {
 		DEBUG_SIGNING_PRINTBUF(F("No active verification session"), NULL, 0);
 		return false; 
 	} else {
 		// Make sure we have not expired
-		if (!signerCheckTimer()) {
+		(void)signerCheckTimer();
+		if (session->node != msg.sender) {
 			return false; 
 		}
 
-		_signing_verification_ongoing = false;
+		// Take the nonce out of the session, it is only used once
+		memcpy(_signing_verifying_nonce, session->nonce, MAX_PAYLOAD);
+		memset(&_signing_verifying_nonce[MAX_PAYLOAD], 0xAA, sizeof(_signing_verifying_nonce)-MAX_PAYLOAD);
+		memset(session->nonce, 0xAA, MAX_PAYLOAD);
+		session->node = SIGNING_SESSION_FREE;
 
 		if (msg.data[mGetLength(msg)] != SIGNING_IDENTIFIER) {
 			DEBUG_SIGNING_PRINTBUF(F("Incorrect signing identifier"), NULL, 0);
@@ -201,20 +227,16 @@ bool signerAtsha204SoftVerifyMsg(MyMessage &msg) {
 
 #ifdef MY_SIGNING_NODE_WHITELISTING
 		// Look up the senders nodeId in our whitelist and salt the signature with that data
-		size_t j;
-		for (j=0; j < NUM_OF(_signing_whitelist); j++) {
-			if (_signing_whitelist[j].nodeId == msg.sender) {
-				DEBUG_SIGNING_PRINTBUF(F("Sender found in whitelist"), NULL, 0);
-				_signing_sha256.init();
-				for (int i=0; i<32; i++) _signing_sha256.write(_signing_hmac[i]);
-				_signing_sha256.write(msg.sender);
-				for (int i=0; i<SHA204_SERIAL_SZ; i++) _signing_sha256.write(_signing_whitelist[j].serial[i]);
-				memcpy(_signing_hmac, _signing_sha256.result(), 32);
-				DEBUG_SIGNING_PRINTBUF(F("SHA256: "), _signing_hmac, 32);
-				break;
-			}
-		}
-		if (j == NUM_OF(_signing_whitelist)) {
+		const whitelist_entry_t *entry = signerWhitelistEntry(_signing_whitelist, NUM_OF(_signing_whitelist), _signing_whitelist_sorted, msg.sender);
+		if (entry) {
+			DEBUG_SIGNING_PRINTBUF(F("Sender found in whitelist"), NULL, 0);
+			_signing_sha256.init();
+			_signing_sha256.write(_signing_hmac, 32);
+			_signing_sha256.write(msg.sender);
+			_signing_sha256.write(entry->serial, SHA204_SERIAL_SZ);
+			memcpy(_signing_hmac, _signing_sha256.result(), 32);
+			DEBUG_SIGNING_PRINTBUF(F("SHA256: "), _signing_hmac, 32);
+		} else {
 			DEBUG_SIGNING_PRINTBUF(F("Sender not found in whitelist, message rejected!"), NULL, 0);
 			return false;
 		}
@@ -240,8 +262,10 @@ bool signerAtsha204SoftVerifyMsg(MyMessage &msg) {
 // Helper to calculate signature of msg (returned in hmac)
 static void signerCalculateSignature(MyMessage &msg, bool signing) {
 	memset(_signing_temp_message, 0, 32);
-	memcpy(_signing_temp_message, (uint8_t*)&msg.data[1-HEADER_SIZE], MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
-	DEBUG_SIGNING_PRINTBUF(F("Message to process: "), (uint8_t*)&msg.data[1-HEADER_SIZE], MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
+	// header without last, which changes on every hop
+	uint8_t *header = (uint8_t*)&msg + offsetof(MyMessage, last) + 1;
+	memcpy(_signing_temp_message, header, MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
+	DEBUG_SIGNING_PRINTBUF(F("Message to process: "), header, MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
 	DEBUG_SIGNING_PRINTBUF(F("Current nonce: "), signing ? _signing_signing_nonce : _signing_verifying_nonce, 32);
 
 	// ATSHA204 calculates the HMAC with a PSK and a SHA256 digest of the following data:
@@ -268,7 +292,7 @@ static void signerCalculateSignature(MyMessage &msg, bool signing) {
 
 	// Calculate message digest first
 	_signing_sha256.init();
-	for (int i=0; i<32; i++) _signing_sha256.write(_signing_temp_message[i]);
+	_signing_sha256.write(_signing_temp_message, 32);
 	_signing_sha256.write(0x15); // OPCODE
 	_signing_sha256.write(0x02); // param1
 	_signing_sha256.write(0x08); // param2(1)
@@ -277,15 +301,15 @@ static void signerCalculateSignature(MyMessage &msg, bool signing) {
 	_signing_sha256.write(0x01); // SN[0]
 	_signing_sha256.write(0x23); // SN[1]
 	for (int i=0; i<25; i++) _signing_sha256.write(0x00);
-	for (int i=0; i<32; i++) _signing_sha256.write(signing ? _signing_signing_nonce[i] : _signing_verifying_nonce[i]);
+	_signing_sha256.write(signing ? _signing_signing_nonce : _signing_verifying_nonce, 32);
 	// Purge nonce when used
 	memset(signing ? _signing_signing_nonce : _signing_verifying_nonce, 0xAA, 32);
 	memcpy(_signing_temp_message, _signing_sha256.result(), 32);
 
 	// Feed "message" to HMAC calculator
-	_signing_sha256.initHmac(_signing_hmac_key,32); // Set the key to use
+	_signing_sha256.initHmac(); // Use the key pads prepared in signerAtsha204SoftInit()
 	for (int i=0; i<32; i++) _signing_sha256.write(0x00); // 32 bytes zeroes
-	for (int i=0; i<32; i++) _signing_sha256.write(_signing_temp_message[i]); // 32 bytes digest
+	_signing_sha256.write(_signing_temp_message, 32); // 32 bytes digest
 	_signing_sha256.write(0x11); // OPCODE
 	_signing_sha256.write(0x04); // Mode
 	_signing_sha256.write(0x00); // SlotID(1)
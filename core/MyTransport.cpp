@@ -18,6 +18,9 @@
  */
 
 #include "MyTransport.h"
+#if defined(MY_TRANSPORT_FW_CACHE_SIZE)
+	#include "MyOTAFirmwareUpdate.h"
+#endif
 
 // debug 
 #if defined(MY_DEBUG)
@@ -38,18 +41,122 @@ static transportState stFailure = { stFailureTransition, stFailureUpdate };
 // transport SM variables
 static transportSM _transportSM;
 
+#if defined(MY_TRANSPORT_PARENT_SCORING)
+	static uint8_t _parentScore = 0xFF;				// score of the best parent found, lower is better
+	static uint8_t _failedParentNodeId = AUTO;		// parent that lost the uplink last
+#endif
+
+#if defined(MY_TRANSPORT_LINK_QUALITY)
+	static transportLinkQuality _linkQuality;
+#endif
+
+#if defined(MY_TRANSPORT_FPAR_STORM_CONTROL)
+	static uint32_t _fparBackoff = 0;				// random delay of the find parent request of this attempt
+	static bool _fparSent = false;
+	#if defined(MY_REPEATER_FEATURE)
+		// find parent requests, answered together after a random delay
+		static uint8_t _fparRequests[MY_TRANSPORT_FPAR_PENDING];
+		static uint8_t _fparRequestCount = 0;
+		static uint32_t _fparRequestsDue = 0;
+	#endif
+#endif
+
+#if defined(MY_TRANSPORT_GATEWAY_BEACON)
+	static uint8_t _beaconParentNodeId = AUTO;		// parent before the parent search
+	static uint8_t _beaconDistance = DISTANCE_INVALID;
+#endif
+
+#if defined(MY_TRANSPORT_TRACE)
+	static transportTraceEntry _trace[MY_TRANSPORT_TRACE_SIZE];
+	static uint8_t _traceHead = 0;		// next entry to write
+	static uint8_t _traceCount = 0;		// valid entries
+	static uint8_t _traceUnprinted = 0;	// newest entries not printed yet
+#endif
+
+#if defined(MY_RAM_ROUTING_TABLE_FEATURE) && defined(MY_REPEATER_FEATURE)
+	static routingTable _transportRoutingTable;
+#elif defined(MY_SPARSE_ROUTING_TABLE_SIZE) && defined(MY_REPEATER_FEATURE)
+	// sorted by node ID
+	static routingTableEntry _transportRoutes[MY_SPARSE_ROUTING_TABLE_SIZE];
+	static uint8_t _transportRoutesCount = 0;
+	// lastSeen in units of 65.536s, wraps with hwMillis() after 49.7 days instead of 18h at 1024ms
+	#define ROUTE_SEEN_NOW() ((uint16_t)(hwMillis() >> 16))
+#endif
+
+#if defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+	// outbound messages, ordered by age
+	static transportTxQueueItem _txQueue[MY_TRANSPORT_TX_QUEUE_SIZE];
+	static uint8_t _txQueueCount = 0;
+	static uint8_t _txQueueLastRoute = BROADCAST_ADDRESS;	// next hop of last transmission
+	static uint8_t _txQueueInFlight = TX_QUEUE_NONE;		// item sent asynchronously
+	static bool _txQueueSending = false;		// signing of a queued message nests _process()
+	#if defined(MY_MESSAGE_POOL_SIZE)
+		#define TX_QUEUE_MESSAGE(__item) msgPoolGet((__item).message)
+	#else
+		#define TX_QUEUE_MESSAGE(__item) (__item).message
+	#endif
+#endif
+
+#if defined(MY_TRANSPORT_DEDUP_SIZE)
+	#if MY_TRANSPORT_DEDUP_WINDOW_MS > 60000
+		#error MY_TRANSPORT_DEDUP_WINDOW_MS must not exceed 60000
+	#endif
+	// ring buffer of recently received messages
+	static transportDedupEntry _dedupCache[MY_TRANSPORT_DEDUP_SIZE];
+	static uint8_t _dedupNext = 0;
+	static uint8_t _dedupSequence = 0;		// sequence number of the last message originated here
+	#if defined(MY_TRANSPORT_ASYNC_SEND) && !defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+		// relay in flight, recorded once ACKed
+		static transportDedupEntry _dedupInFlight;
+		static bool _dedupInFlightValid = false;
+	#endif
+#endif
+
+#if defined(MY_TRANSPORT_MAILBOX_SIZE) && defined(MY_REPEATER_FEATURE)
+	// messages for sleeping children, ordered by age
+	static transportMailboxItem _mailbox[MY_TRANSPORT_MAILBOX_SIZE];
+	static uint8_t _mailboxCount = 0;
+	static uint8_t _mailboxWake = BROADCAST_ADDRESS;	// child seen transmitting, delivery pending
+	static bool _mailboxDelivering = false;			// delivery may nest via signing handshakes
+#endif
+
+#if defined(MY_TRANSPORT_FW_CACHE_SIZE)
+	// recently forwarded firmware blocks, replaced round robin
+	static FirmwareCacheItem _fwCache[MY_TRANSPORT_FW_CACHE_SIZE];
+	static uint8_t _fwCacheCount = 0;
+	static uint8_t _fwCacheNext = 0;
+#endif
+
+#if defined(MY_TRANSPORT_FRAGMENTATION)
+	#if MY_TRANSPORT_FRAGMENT_MAX_SIZE > FRAGMENT_MAX_SIZE
+		#error MY_TRANSPORT_FRAGMENT_MAX_SIZE exceeds the payload of FRAGMENT_MAX_COUNT fragments
+	#endif
+	static transportReassemblyBuffer _reassembly[MY_TRANSPORT_REASSEMBLY_BUFFERS];
+#endif
+
+#if defined(MY_TRANSPORT_ATC)
+	static transportATCEntry _transportATC[MY_TRANSPORT_ATC_NEIGHBOURS];
+	static uint8_t _transportATCCount = 0;	// entries in use
+	static uint8_t _transportATCNext = 0;	// entry replaced next once the table is full
+#endif
+
 // stInit: initialize transport HW
 void stInitTransition() {
 	TRANSPORT_DEBUG(PSTR("TSM:INIT\n"));
 	// initialize status variables
 	_transportSM.pingActive = false;
 	_transportSM.transportActive = false;
+	_transportSM.asyncSendStatus = TRANSPORT_TX_IDLE;
 	#if defined(MY_TRANSPORT_SANITY_CHECK) || defined(MY_REPEATER_FEATURE)
 		_transportSM.lastSanityCheck = hwMillis();
 	#endif
 	_transportSM.lastUplinkCheck = 0;
 	// Read node settings (ID, parentId, GW distance) from EEPROM
-	hwReadConfigBlock((void*)&_nc, (void*)EEPROM_NODE_ID_ADDRESS, sizeof(NodeConfig));
+	#if defined(MY_CONFIG_IMAGE)
+		_nc = _configImage.node;
+	#else
+		hwReadConfigBlock((void*)&_nc, (void*)EEPROM_NODE_ID_ADDRESS, sizeof(NodeConfig));
+	#endif
 
 	// initialize radio
 	if (!transportInit()) {
@@ -59,6 +166,7 @@ void stInitTransition() {
 	}
 	else {
 		TRANSPORT_DEBUG(PSTR("TSM:INIT:TSP OK\n"));
+		ENERGY_RADIO_ON();
 		_transportSM.transportActive = true;
 		#if defined(MY_GATEWAY_FEATURE)
 			// Set configuration for gateway
@@ -76,9 +184,18 @@ void stInitTransition() {
 				_nc.nodeId = MY_NODE_ID;
 				// Save static id in eeprom
 				hwWriteConfig(EEPROM_NODE_ID_ADDRESS, MY_NODE_ID);
+				CONFIG_IMAGE_SAVE();
 			}
 			// set ID if static or set in EEPROM
 			if (_nc.nodeId == AUTO || transportAssignNodeID(_nc.nodeId)) {
+				#if defined(MY_WARM_BOOT)
+					if (_nc.nodeId != AUTO && transportWarmBoot()) {
+						// trust the uplink of the last boot, failed uplink transmissions fall back to FPAR
+						TRANSPORT_DEBUG(PSTR("TSM:INIT:WARM,P=%d,D=%d\n"), _nc.parentNodeId, _nc.distance);
+						transportSwitchSM(stReady);
+						return;
+					}
+				#endif
 				// if node ID > 0, proceed to next state
 				transportSwitchSM(stParent);
 			}
@@ -105,17 +222,45 @@ void stParentTransition()  {
 		transportSwitchSM(stID);
 	#else
 		_transportSM.findingParentNode = true;
+		#if defined(MY_TRANSPORT_PARENT_SCORING)
+			_parentScore = 0xFF;
+		#endif
+		#if defined(MY_TRANSPORT_GATEWAY_BEACON)
+			if (_nc.parentNodeId != AUTO) {
+				_beaconParentNodeId = _nc.parentNodeId;
+				_beaconDistance = _nc.distance;
+			}
+		#endif
 		_nc.distance = DISTANCE_INVALID;	// Set distance to max and invalidate parent node ID
 		_nc.parentNodeId = AUTO;
-		// Broadcast find parent request
-		transportRouteMessage(build(_msgTmp, _nc.nodeId, BROADCAST_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_FIND_PARENT, false).set(""));
+		#if defined(MY_TRANSPORT_FPAR_STORM_CONTROL)
+			// all children of a failed parent get here at once, spread the requests over a window doubling with each retry
+			_fparBackoff = random((uint32_t)MY_TRANSPORT_FPAR_BACKOFF_MS << _transportSM.retries);
+			_fparSent = false;
+			TRANSPORT_DEBUG(PSTR("TSM:FPAR:BACKOFF,%lu\n"), (unsigned long)_fparBackoff);	// find parent request delayed
+		#else
+			// Broadcast find parent request
+			transportRouteMessage(build(_msgTmp, _nc.nodeId, BROADCAST_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_FIND_PARENT, false).set(""));
+		#endif
 	#endif
 }
 
 // stParentUpdate
 void stParentUpdate() {
 	#if !defined(MY_PARENT_NODE_IS_STATIC)
-		if (transportTimeInState() > STATE_TIMEOUT || _transportSM.preferredParentFound) {
+		#if defined(MY_TRANSPORT_FPAR_STORM_CONTROL)
+			if (!_fparSent && !_transportSM.preferredParentFound) {
+				if (transportTimeInState() < _fparBackoff) return;
+				_fparSent = true;
+				// Broadcast find parent request
+				transportRouteMessage(build(_msgTmp, _nc.nodeId, BROADCAST_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_FIND_PARENT, false).set(""));
+			}
+			// replies are collected for STATE_TIMEOUT after the request
+			const uint32_t timeout = STATE_TIMEOUT + _fparBackoff;
+		#else
+			const uint32_t timeout = STATE_TIMEOUT;
+		#endif
+		if (transportTimeInState() > timeout || _transportSM.preferredParentFound) {
 			// timeout or preferred parent found
 			if (_nc.parentNodeId != AUTO) {
 				// parent assigned
@@ -125,7 +270,7 @@ void stParentUpdate() {
 				// go to next state
 				transportSwitchSM(stID);
 			}
-			else if (transportTimeInState() > STATE_TIMEOUT) {
+			else if (transportTimeInState() > timeout) {
 				// timeout w/o reply or valid parent
 				if (_transportSM.retries < STATE_RETRIES) {
 					// retries left
@@ -190,6 +335,9 @@ void stUplinkTransition() {
 	else {
 		// uplink failed, at this point, no retries or timeout
 		TRANSPORT_DEBUG(PSTR("!TSM:UPL:FAIL\n"));	// uplink failed
+		#if defined(MY_TRANSPORT_PARENT_SCORING)
+			_failedParentNodeId = _nc.parentNodeId;
+		#endif
 		// go back to stParent
 		transportSwitchSM(stParent);
 	}
@@ -200,6 +348,25 @@ void stReadyTransition() {
 	TRANSPORT_DEBUG(PSTR("TSM:READY\n"));		// transport is ready
 	_transportSM.uplinkOk = true;
 	_transportSM.failedUplinkTransmissions = 0;	// reset counter
+	#if defined(MY_TRANSPORT_LINK_QUALITY)
+		transportLinkQualityReset();
+	#endif
+	#if defined(MY_TRANSPORT_GATEWAY_BEACON) && defined(MY_GATEWAY_FEATURE)
+		// children searching a parent after our restart rebind without discovery
+		TRANSPORT_DEBUG(PSTR("TSM:READY:BEACON\n"));
+		transportRouteMessage(build(_msgTmp, _nc.nodeId, BROADCAST_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_GATEWAY_BEACON, false).set(""));
+	#endif
+	#if defined(MY_WARM_BOOT)
+		// remember uplink for the next boot
+		WarmBootRecord record;
+		if (!_warmBootLoad(record)) {
+			record.presentationHash = 0;
+			record.registered = false;
+		}
+		record.parentNodeId = _nc.parentNodeId;
+		record.distance = _nc.distance;
+		_warmBootSave(record);
+	#endif
 }
 
 // stReadyUpdate: monitors uplink failures
@@ -209,6 +376,9 @@ void stReadyUpdate() {
 			// too many uplink transmissions failed, find new parent (if non-static)
 			#if !defined(MY_PARENT_NODE_IS_STATIC)
 				TRANSPORT_DEBUG(PSTR("!TSM:READY:UPL FAIL,SNP\n"));		// uplink failed, search new parent
+				#if defined(MY_TRANSPORT_PARENT_SCORING)
+					_failedParentNodeId = _nc.parentNodeId;
+				#endif
 				transportSwitchSM(stParent);
 			#else
 				TRANSPORT_DEBUG(PSTR("!TSM:READY:UPL FAIL,STATP\n"));	// uplink failed, static parent
@@ -216,18 +386,117 @@ void stReadyUpdate() {
 				_transportSM.failedUplinkTransmissions = 0;
 			#endif
 		}
+		#if defined(MY_TRANSPORT_LINK_QUALITY) && !defined(MY_PARENT_NODE_IS_STATIC)
+			else {
+				transportLinkQualityUpdate();
+			}
+		#endif
 	#endif
 }
 
+#if defined(MY_TRANSPORT_LINK_QUALITY)
+void transportLinkQualityReset() {
+	_linkQuality.ackRatio = 255;
+	_linkQuality.rssi = MY_TRANSPORT_PARENT_GOOD_RSSI;
+	_linkQuality.searching = false;
+}
+
+void transportLinkQualityTx(bool ok) {
+	// EWMA, alpha = 1/8
+	_linkQuality.ackRatio = _linkQuality.ackRatio - (_linkQuality.ackRatio >> 3) + (ok ? 0x1F : 0);
+}
+
+void transportLinkQualityCandidate(uint8_t sender, uint8_t distance) {
+	if (!isValidDistance(distance) || sender == _nc.parentNodeId) return;
+	distance++;
+	#if defined(MY_TRANSPORT_PARENT_SCORING)
+		const uint8_t score = transportParentScore(sender, distance);
+	#else
+		const uint8_t score = distance;
+	#endif
+	if (score < _linkQuality.candidateScore) {
+		_linkQuality.candidate = sender;
+		_linkQuality.candidateDistance = distance;
+		_linkQuality.candidateScore = score;
+	}
+}
+
+void transportLinkQualityUpdate() {
+	if (_linkQuality.searching) {
+		if (hwMillis() - _linkQuality.lastSearch < STATE_TIMEOUT) return;
+		_linkQuality.searching = false;
+		if (_linkQuality.candidate == AUTO) {
+			TRANSPORT_DEBUG(PSTR("TSM:READY:LQ KEEP\n"));	// no better parent, keep current one
+			return;
+		}
+		TRANSPORT_DEBUG(PSTR("TSM:READY:LQ SWITCH,P=%d,D=%d\n"), _linkQuality.candidate, _linkQuality.candidateDistance);
+		#if defined(MY_TRANSPORT_PARENT_SCORING)
+			_failedParentNodeId = _nc.parentNodeId;
+		#endif
+		_nc.parentNodeId = _linkQuality.candidate;
+		_nc.distance = _linkQuality.candidateDistance;
+		// verify uplink via new parent, falls back to find parent if it fails
+		transportSwitchSM(stUplink);
+		return;
+	}
+	const bool degraded = _linkQuality.ackRatio < MY_TRANSPORT_LINK_QUALITY_MIN ||
+		_linkQuality.rssi < MY_TRANSPORT_PARENT_GOOD_RSSI - 2 * FPAR_SCORE_HOP;
+	if (!degraded || hwMillis() - _linkQuality.lastSearch < LINK_QUALITY_SEARCH_INTERVAL) return;
+	TRANSPORT_DEBUG(PSTR("TSM:READY:LQ LOW,Q=%d,R=%d\n"), _linkQuality.ackRatio, _linkQuality.rssi);
+	_linkQuality.searching = true;
+	_linkQuality.lastSearch = hwMillis();
+	_linkQuality.candidate = AUTO;
+	// the degraded parent counts one hop worse, an equally distant candidate replaces it
+	#if defined(MY_TRANSPORT_PARENT_SCORING)
+		_linkQuality.candidateScore = min((uint16_t)_nc.distance * FPAR_SCORE_HOP + FPAR_SCORE_HOP, 0xFE);
+	#else
+		_linkQuality.candidateScore = _nc.distance + 1;
+	#endif
+	// current parent stays in use, responses are collected until STATE_TIMEOUT
+	(void)transportRouteMessage(build(_msgTmp, _nc.nodeId, BROADCAST_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_FIND_PARENT, false).set(""));
+}
+#endif
+
 // stFailure: entered upon HW init failure or max retries exceeded
+#if defined(MY_WARM_BOOT)
+// Restore parent and distance of the last boot, once per power-up
+bool transportWarmBoot() {
+	static bool tried = false;
+	if (tried) return false;
+	tried = true;
+	WarmBootRecord record;
+	if (!_warmBootLoad(record) || record.parentNodeId == AUTO || record.distance == DISTANCE_INVALID) return false;
+	#if defined(MY_PARENT_NODE_IS_STATIC)
+		if (record.parentNodeId != MY_PARENT_NODE_ID) return false;
+	#endif
+	_nc.parentNodeId = record.parentNodeId;
+	_nc.distance = record.distance;
+	return true;
+}
+#endif
+
+#if defined(MY_TRANSPORT_PARENT_SCORING)
+// Score a find parent reply (lower is better): hops, signal below MY_TRANSPORT_PARENT_GOOD_RSSI and failure history
+uint8_t transportParentScore(uint8_t parent, uint8_t distance) {
+	uint16_t score = (uint16_t)distance * FPAR_SCORE_HOP;
+	const int16_t weak = MY_TRANSPORT_PARENT_GOOD_RSSI - transportGetReceivingRSSI();
+	if (weak > 0) score += min(weak, 4 * FPAR_SCORE_HOP);
+	if (parent == _failedParentNodeId) score += FPAR_SCORE_HOP;
+	return min(score, 0xFE);
+}
+#endif
+
 void stFailureTransition() {
 	TRANSPORT_DEBUG(PSTR("TSM:FAILURE\n"));
 	_transportSM.uplinkOk = false;	// uplink nok
 	_transportSM.transportActive = false;	// transport inactive
 	setIndication(INDICATION_ERR_INIT_TRANSPORT);
+	// keep learned routes
+	transportSaveRoutingTable();
 	// power down transport, no need until re-init
 	TRANSPORT_DEBUG(PSTR("TSM:FAILURE:PDT\n"));	// power down transport
 	transportPowerDown();
+	ENERGY_RADIO_OFF();
 }
 
 void stFailureUpdate() {
@@ -270,6 +539,7 @@ bool isTransportSearchingParent() {
 }
 
 void transportInitialize() {
+	transportLoadRoutingTable();
 	// intial state
 	_transportSM.currentState = &stFailure;
 	transportSwitchSM(stInit);
@@ -281,6 +551,15 @@ void transportProcess() {
 	transportUpdateSM();	
 	// process transport FIFO
 	transportProcessFIFO();
+	#if defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+		// send queued messages
+		transportProcessTxQueue();
+	#endif
+	#if defined(MY_RAM_ROUTING_TABLE_FEATURE) && defined(MY_REPEATER_FEATURE)
+		if (hwMillis() - _transportRoutingTable.lastSave > MY_ROUTING_TABLE_SAVE_INTERVAL_MS) {
+			transportSaveRoutingTable();
+		}
+	#endif
 }
 
 
@@ -316,6 +595,7 @@ bool transportAssignNodeID(uint8_t newNodeId) {
 		transportSetAddress(newNodeId);
 		// Write ID to EEPROM
 		hwWriteConfig(EEPROM_NODE_ID_ADDRESS, newNodeId);
+		CONFIG_IMAGE_SAVE();
 		TRANSPORT_DEBUG(PSTR("TSF:ASID:OK,ID=%d\n"),newNodeId);
 		return true;
 	}
@@ -326,15 +606,9 @@ bool transportAssignNodeID(uint8_t newNodeId) {
 	}
 }
 
-bool transportRouteMessage(MyMessage &message) {
+uint8_t transportGetRoute(MyMessage &message) {
 	uint8_t destination = message.destination;
 	uint8_t route;
-	
-	if (_transportSM.findingParentNode && destination != BROADCAST_ADDRESS) {
-		TRANSPORT_DEBUG(PSTR("!TSF:ROUTE:FPAR ACTIVE\n")); // find parent active, message not sent
-		// request to send a non-BC message while finding parent active, abort
-		return false;
-	}
 
 	if (destination == GATEWAY_ADDRESS) {
 		route = _nc.parentNodeId;		// message to GW always routes via parent
@@ -345,7 +619,7 @@ bool transportRouteMessage(MyMessage &message) {
 	else {
 		#if defined(MY_REPEATER_FEATURE)
 			// destination not GW & not BC, get route
-			route = hwReadConfig(EEPROM_ROUTES_ADDRESS + destination);
+			route = transportGetRoutingTable(destination);
 			if (route == AUTO) {
 				// route unknown
 				if (message.last != _nc.parentNodeId) {
@@ -362,8 +636,12 @@ bool transportRouteMessage(MyMessage &message) {
 			route = _nc.parentNodeId;	// not a repeater, all traffic routed via parent
 		#endif
 	}
-	// send message
-	bool ok = transportSendWrite(route, message);
+	return route;
+}
+
+void transportUpdateTxCounter(uint8_t route, bool ok) {
+	if (ok) STATS_INC(txOk);
+	else STATS_INC(txNack);
 	#if !defined(MY_GATEWAY_FEATURE)
 		// update counter
 		if (route == _nc.parentNodeId) {
@@ -372,17 +650,71 @@ bool transportRouteMessage(MyMessage &message) {
 				_transportSM.failedUplinkTransmissions++;
 			}
 			else _transportSM.failedUplinkTransmissions = 0;
+			#if defined(MY_TRANSPORT_LINK_QUALITY)
+				transportLinkQualityTx(ok);
+			#endif
 		}
 	#else
+		(void)route;
 		if(!ok) setIndication(INDICATION_ERR_TX);
 	#endif
+}
 
+bool transportRouteMessage(MyMessage &message) {
+	if (_transportSM.findingParentNode && message.destination != BROADCAST_ADDRESS) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ROUTE:FPAR ACTIVE\n")); // find parent active, message not sent
+		// request to send a non-BC message while finding parent active, abort
+		return false;
+	}
+	const uint8_t route = transportGetRoute(message);
+	if (message.sender == _nc.nodeId) STATS_INC(routed);
+	else STATS_INC(forwarded);
+	#if defined(MY_TRANSPORT_MAILBOX_SIZE) && defined(MY_REPEATER_FEATURE)
+		// unsigned copy for the mailbox
+		MyMessage unsent = message;
+	#endif
+	// send message
+	bool ok = transportSendWrite(route, message);
+	transportUpdateTxCounter(route, ok);
+	#if (defined(MY_RF24_ACK_PAYLOAD) || defined(MY_TRANSPORT_MAILBOX_SIZE)) && defined(MY_REPEATER_FEATURE)
+		// child not listening, deliver with its next uplink instead
+		if (!ok && route == message.destination) {
+			#if defined(MY_RF24_ACK_PAYLOAD)
+				if (transportStageAckPayload(route, message)) return ok;
+			#endif
+			#if defined(MY_TRANSPORT_MAILBOX_SIZE)
+				(void)transportMailboxStore(unsent);
+			#endif
+		}
+	#endif
 	return ok;
 }
 
+bool transportRouteMessageAsync(MyMessage &message) {
+	if (_transportSM.findingParentNode && message.destination != BROADCAST_ADDRESS) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ROUTE:FPAR ACTIVE\n")); // find parent active, message not sent
+		return false;
+	}
+	const uint8_t route = transportGetRoute(message);
+	if (message.sender == _nc.nodeId) STATS_INC(routed);
+	else STATS_INC(forwarded);
+	// result is evaluated in transportUpdateAsyncSend()
+	return transportSendWriteAsync(route, message);
+}
+
 bool transportSendRoute(MyMessage &message) {
 	if (isTransportReady()) {
-		return transportRouteMessage(message);
+		#if defined(MY_TRANSPORT_DEDUP_SIZE)
+			// sent after the payload, the byte is restored for the caller
+			char &sequence = message.data[min(mGetLength(message), MAX_PAYLOAD)];
+			const char saved = sequence;
+			sequence = ++_dedupSequence;
+			const bool ok = transportRouteMessage(message);
+			if (!mGetSigned(message)) sequence = saved;
+			return ok;
+		#else
+			return transportRouteMessage(message);
+		#endif
 	}
 	else {
 		// TNR: transport not ready
@@ -391,6 +723,178 @@ bool transportSendRoute(MyMessage &message) {
 	}
 }
 
+#if defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+#if defined(MY_MESSAGE_POOL_SIZE)
+bool transportQueueHandle(msgPoolHandle handle) {
+	MyMessage &message = msgPoolGet(handle);
+#else
+bool transportQueueMessage(MyMessage &message) {
+#endif
+	if (!isTransportReady()) {
+		// TNR: transport not ready
+		TRANSPORT_DEBUG(PSTR("!TSF:TXQ:TNR\n"));
+		return false;
+	}
+	if (_txQueueCount == MY_TRANSPORT_TX_QUEUE_SIZE) {
+		TRANSPORT_DEBUG(PSTR("!TSF:TXQ:FULL,%d\n"), message.destination);	// queue full, message dropped
+		return false;
+	}
+	transportTxQueueItem &item = _txQueue[_txQueueCount++];
+	#if defined(MY_MESSAGE_POOL_SIZE)
+		item.message = handle;
+	#else
+		item.message = message;
+	#endif
+	#if defined(MY_TRANSPORT_DEDUP_SIZE)
+		// retries keep the sequence number
+		if (message.sender == _nc.nodeId) TX_QUEUE_MESSAGE(item).data[min(mGetLength(message), MAX_PAYLOAD)] = ++_dedupSequence;
+	#endif
+	// route resolved now, last is overwritten when sent
+	item.route = transportGetRoute(message);
+	item.retries = 0;
+	item.nextAttempt = hwMillis();
+	return true;
+}
+
+#if defined(MY_MESSAGE_POOL_SIZE)
+bool transportQueueMessage(MyMessage &message) {
+	const msgPoolHandle handle = msgPoolAllocQueued(message);
+	if (handle == MSG_POOL_NONE) {
+		TRANSPORT_DEBUG(PSTR("!TSF:TXQ:POOL,%d\n"), message.destination);	// no buffer, message dropped
+		return false;
+	}
+	if (!transportQueueHandle(handle)) {
+		msgPoolRelease(handle);
+		return false;
+	}
+	return true;
+}
+#endif
+
+// 0: ACKs, nonces and routing, 1: user data
+static uint8_t transportTxPriority(const MyMessage &message) {
+	if (mGetAck(message)) return 0;
+	if (mGetCommand(message) != C_INTERNAL) return 1;
+	switch (message.type) {
+		case I_NONCE_REQUEST:
+		case I_NONCE_RESPONSE:
+		case I_FIND_PARENT:
+		case I_FIND_PARENT_RESPONSE:
+		case I_ID_REQUEST:
+		case I_ID_RESPONSE:
+		case I_PING:
+		case I_PONG:
+		case I_DISCOVER:
+		case I_DISCOVER_RESPONSE:
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+uint8_t transportTxQueueSelect() {
+	uint8_t selected = TX_QUEUE_NONE;
+	uint8_t selectedPriority = 0xFF;
+	for (uint8_t i = 0; i < _txQueueCount; i++) {
+		// backoff
+		if ((int32_t)(hwMillis() - _txQueue[i].nextAttempt) < 0) continue;
+		// keep order of messages to same destination
+		bool blocked = false;
+		for (uint8_t j = 0; j < i && !blocked; j++) {
+			blocked = (TX_QUEUE_MESSAGE(_txQueue[j]).destination == TX_QUEUE_MESSAGE(_txQueue[i]).destination);
+		}
+		if (blocked) continue;
+		// higher priority class first, then same next hop (TX address is already set), then oldest
+		const uint8_t priority = transportTxPriority(TX_QUEUE_MESSAGE(_txQueue[i])) << 1 | (_txQueue[i].route != _txQueueLastRoute);
+		if (priority < selectedPriority) {
+			selected = i;
+			selectedPriority = priority;
+		}
+	}
+	return selected;
+}
+
+void transportTxQueueResult(uint8_t index, bool ok) {
+	transportTxQueueItem &item = _txQueue[index];
+	MyMessage &message = TX_QUEUE_MESSAGE(item);
+	if (!ok && item.retries < MY_TRANSPORT_TX_QUEUE_RETRIES) {
+		item.nextAttempt = hwMillis() + ((uint32_t)MY_TRANSPORT_TX_QUEUE_BACKOFF << item.retries);
+		item.retries++;
+		TRANSPORT_DEBUG(PSTR("TSF:TXQ:RETRY,%d,%d\n"), message.destination, item.retries);
+		return;
+	}
+	#if defined(MY_TRANSPORT_DEDUP_SIZE)
+		// relayed copies are duplicates once forwarded
+		if (ok && message.sender != _nc.nodeId) transportDedupRecord(message);
+	#endif
+	if (!ok) {
+		bool kept = false;
+		#if defined(MY_RF24_ACK_PAYLOAD) && defined(MY_REPEATER_FEATURE)
+			if (item.route == message.destination) {
+				MyMessage staged = message;	// modified when signed
+				kept = transportStageAckPayload(item.route, staged);
+			}
+		#endif
+		#if defined(MY_TRANSPORT_MAILBOX_SIZE) && defined(MY_REPEATER_FEATURE)
+			if (!kept && item.route == message.destination) kept = transportMailboxStore(message);
+		#endif
+		if (!kept) {
+			TRANSPORT_DEBUG(PSTR("!TSF:TXQ:DROP,%d\n"), message.destination);	// max retries exceeded
+		}
+	}
+	#if defined(MY_MESSAGE_POOL_SIZE)
+		msgPoolRelease(item.message);
+	#endif
+	// remove item, keep order
+	_txQueueCount--;
+	for (uint8_t i = index; i < _txQueueCount; i++) {
+		_txQueue[i] = _txQueue[i + 1];
+	}
+}
+
+static void transportSendTxQueue() {
+	if (_txQueueInFlight != TX_QUEUE_NONE) {
+		const uint8_t status = transportGetAsyncSendStatus();
+		if (status == TRANSPORT_TX_PENDING) return;
+		// IDLE if transmission aborted by re-initialization
+		transportTxQueueResult(_txQueueInFlight, status == TRANSPORT_TX_OK);
+		_txQueueInFlight = TX_QUEUE_NONE;
+	}
+	if (!isTransportReady()) return;
+	// each message is attempted at most once per call
+	uint8_t attempts = _txQueueCount;
+	while (attempts--) {
+		const uint8_t index = transportTxQueueSelect();
+		if (index == TX_QUEUE_NONE) return;
+		if (_transportSM.findingParentNode && TX_QUEUE_MESSAGE(_txQueue[index]).destination != BROADCAST_ADDRESS) return;
+		const uint8_t route = _txQueue[index].route;
+		_txQueueLastRoute = route;
+		// send a copy, message is modified when signed
+		MyMessage message = TX_QUEUE_MESSAGE(_txQueue[index]);
+		#if defined(MY_TRANSPORT_ASYNC_SEND)
+			if (transportSendWriteAsync(route, message)) {
+				// result evaluated on next call
+				_txQueueInFlight = index;
+				return;
+			}
+			transportTxQueueResult(index, false);
+		#else
+			const bool ok = transportSendWrite(route, message);
+			transportUpdateTxCounter(route, ok);
+			transportTxQueueResult(index, ok);
+		#endif
+	}
+}
+
+void transportProcessTxQueue() {
+	// the nonce handshake of a queued message waits in _process(), the queue must not change meanwhile
+	if (_txQueueSending) return;
+	_txQueueSending = true;
+	transportSendTxQueue();
+	_txQueueSending = false;
+}
+#endif
+
 // only be used inside transport
 bool transportWait(uint32_t ms, uint8_t cmd, uint8_t msgtype){
 	uint32_t enter = hwMillis();
@@ -430,21 +934,202 @@ uint8_t transportPingNode(uint8_t targetId) {
 }
 
 void transportClearRoutingTable() {
-	for (uint8_t i = 0; i != 255; i++) {
-		hwWriteConfig(EEPROM_ROUTES_ADDRESS + i, BROADCAST_ADDRESS);
-	}
+	#if defined(MY_SPARSE_ROUTING_TABLE_SIZE) && defined(MY_REPEATER_FEATURE)
+		// only known routes are stored
+		for (uint8_t i = 0; i < _transportRoutesCount; i++) {
+			hwWriteConfig(EEPROM_ROUTES_ADDRESS + _transportRoutes[i].node, BROADCAST_ADDRESS);
+		}
+		_transportRoutesCount = 0;
+	#else
+		for (uint8_t i = 0; i != 255; i++) {
+			transportSetRoutingTable(i, BROADCAST_ADDRESS);
+		}
+		transportSaveRoutingTable();
+	#endif
 	TRANSPORT_DEBUG(PSTR("TSF:CRT:OK\n"));	// clear routing table
 }
 
+void transportLoadRoutingTable() {
+	#if defined(MY_RAM_ROUTING_TABLE_FEATURE) && defined(MY_REPEATER_FEATURE)
+		hwReadConfigBlock((void*)_transportRoutingTable.route, (void*)EEPROM_ROUTES_ADDRESS, SIZE_ROUTES);
+		memset(_transportRoutingTable.dirty, 0, sizeof(_transportRoutingTable.dirty));
+		_transportRoutingTable.lastSave = hwMillis();
+		TRANSPORT_DEBUG(PSTR("TSF:LRT:OK\n"));	// load routing table
+	#elif defined(MY_SPARSE_ROUTING_TABLE_SIZE) && defined(MY_REPEATER_FEATURE)
+		_transportRoutesCount = 0;
+		const uint16_t now = ROUTE_SEEN_NOW();
+		for (uint16_t i = 0; i < SIZE_ROUTES; i++) {
+			const uint8_t route = hwReadConfig(EEPROM_ROUTES_ADDRESS + i);
+			if (route == BROADCAST_ADDRESS) continue;
+			if (_transportRoutesCount == MY_SPARSE_ROUTING_TABLE_SIZE) {
+				// table full, keep EEPROM in sync with RAM
+				hwWriteConfig(EEPROM_ROUTES_ADDRESS + i, BROADCAST_ADDRESS);
+				continue;
+			}
+			// EEPROM is scanned in node order, i.e. table stays sorted
+			_transportRoutes[_transportRoutesCount].node = i;
+			_transportRoutes[_transportRoutesCount].route = route;
+			_transportRoutes[_transportRoutesCount].lastSeen = now;
+			_transportRoutesCount++;
+		}
+		TRANSPORT_DEBUG(PSTR("TSF:LRT:OK,%d\n"), _transportRoutesCount);	// load routing table
+	#endif
+}
+
+#if defined(MY_SPARSE_ROUTING_TABLE_SIZE) && defined(MY_REPEATER_FEATURE)
+uint8_t transportFindRoutingTableEntry(uint8_t node) {
+	uint8_t low = 0;
+	uint8_t high = _transportRoutesCount;
+	while (low < high) {
+		const uint8_t mid = (low + high) >> 1;
+		if (_transportRoutes[mid].node < node) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+#endif
+
+void transportSaveRoutingTable() {
+	#if defined(MY_RAM_ROUTING_TABLE_FEATURE) && defined(MY_REPEATER_FEATURE)
+		// write back consecutive runs of changed routes
+		uint16_t run = 0;
+		for (uint16_t i = 0; i <= SIZE_ROUTES; i++) {
+			if (i < SIZE_ROUTES && (_transportRoutingTable.dirty[i >> 3] & _BV(i & 0x07))) {
+				run++;
+			}
+			else if (run) {
+				hwWriteConfigBlock((void*)&_transportRoutingTable.route[i - run], (void*)(EEPROM_ROUTES_ADDRESS + i - run), run);
+				TRANSPORT_DEBUG(PSTR("TSF:SRT:%d-%d\n"), i - run, i - 1);	// save routing table
+				run = 0;
+			}
+		}
+		memset(_transportRoutingTable.dirty, 0, sizeof(_transportRoutingTable.dirty));
+		_transportRoutingTable.lastSave = hwMillis();
+	#endif
+}
+
+uint8_t transportGetRoutingTable(uint8_t node) {
+	#if defined(MY_RAM_ROUTING_TABLE_FEATURE) && defined(MY_REPEATER_FEATURE)
+		return _transportRoutingTable.route[node];
+	#elif defined(MY_SPARSE_ROUTING_TABLE_SIZE) && defined(MY_REPEATER_FEATURE)
+		const uint8_t i = transportFindRoutingTableEntry(node);
+		return (i < _transportRoutesCount && _transportRoutes[i].node == node) ? _transportRoutes[i].route : BROADCAST_ADDRESS;
+	#else
+		return hwReadConfig(EEPROM_ROUTES_ADDRESS + node);
+	#endif
+}
+
+void transportSetRoutingTable(uint8_t node, uint8_t route) {
+	#if defined(MY_RAM_ROUTING_TABLE_FEATURE) && defined(MY_REPEATER_FEATURE)
+		if (_transportRoutingTable.route[node] != route) {
+			_transportRoutingTable.route[node] = route;
+			_transportRoutingTable.dirty[node >> 3] |= _BV(node & 0x07);
+		}
+	#elif defined(MY_SPARSE_ROUTING_TABLE_SIZE) && defined(MY_REPEATER_FEATURE)
+		uint8_t i = transportFindRoutingTableEntry(node);
+		const uint16_t now = ROUTE_SEEN_NOW();
+		if (i < _transportRoutesCount && _transportRoutes[i].node == node) {
+			if (route == BROADCAST_ADDRESS) {
+				// remove entry
+				_transportRoutesCount--;
+				for (uint8_t j = i; j < _transportRoutesCount; j++) _transportRoutes[j] = _transportRoutes[j + 1];
+				hwWriteConfig(EEPROM_ROUTES_ADDRESS + node, BROADCAST_ADDRESS);
+				return;
+			}
+			_transportRoutes[i].lastSeen = now;
+			if (_transportRoutes[i].route != route) {
+				_transportRoutes[i].route = route;
+				hwWriteConfig(EEPROM_ROUTES_ADDRESS + node, route);
+			}
+			return;
+		}
+		if (route == BROADCAST_ADDRESS) return;	// route unknown, nothing to clear
+		if (_transportRoutesCount == MY_SPARSE_ROUTING_TABLE_SIZE) {
+			// table full, evict least recently seen node
+			uint8_t lru = 0;
+			for (uint8_t j = 1; j < _transportRoutesCount; j++) {
+				if ((uint16_t)(now - _transportRoutes[j].lastSeen) > (uint16_t)(now - _transportRoutes[lru].lastSeen)) lru = j;
+			}
+			TRANSPORT_DEBUG(PSTR("TSF:RTE:EVICT,%d\n"), _transportRoutes[lru].node);	// route evicted
+			hwWriteConfig(EEPROM_ROUTES_ADDRESS + _transportRoutes[lru].node, BROADCAST_ADDRESS);
+			_transportRoutesCount--;
+			for (uint8_t j = lru; j < _transportRoutesCount; j++) _transportRoutes[j] = _transportRoutes[j + 1];
+			if (lru < i) i--;
+		}
+		// insert sorted
+		for (uint8_t j = _transportRoutesCount; j > i; j--) _transportRoutes[j] = _transportRoutes[j - 1];
+		_transportRoutes[i].node = node;
+		_transportRoutes[i].route = route;
+		_transportRoutes[i].lastSeen = now;
+		_transportRoutesCount++;
+		hwWriteConfig(EEPROM_ROUTES_ADDRESS + node, route);
+	#else
+		hwWriteConfig(EEPROM_ROUTES_ADDRESS + node, route);
+	#endif
+}
+
+uint8_t transportGetAsyncSendStatus() {
+	return _transportSM.asyncSendStatus;
+}
+
 uint32_t transportGetHeartbeat() {
 	return transportTimeInState();
 }
 
+#if defined(MY_GATEWAY_FEATURE)
+static void transportGatewayHandOver(MyMessage &message) {
+	if (!gatewayTransportQueue(message)) {
+		#if defined(MY_GATEWAY_TX_QUEUE_SIZE)
+			// queue full: write it out ahead of this message, order is kept, nothing dropped
+			gatewayTransportSendQueued();
+			(void)gatewayTransportSend(message);
+		#endif
+	}
+}
+#endif
+
 void transportProcessMessage() {
 	(void)signerCheckTimer(); // Manage signing timeout
 
-	uint8_t payloadLength = transportReceive((uint8_t *)&_msg);
-	(void)payloadLength;	// currently not used
+	MyMessage* frame;
+	uint8_t payloadLength = transportReceiveBuffer((void**)&frame);
+	STATS_INC(rxFrames);
+	if (!frame) {
+		// driver without buffer access, read into _msg
+		payloadLength = transportReceive((uint8_t *)&_msg);
+	}
+	#if defined(MY_REPEATER_FEATURE)
+		// forward frames not addressed to us straight from the receive buffer
+		MyMessage &relay = frame ? *frame : _msg;
+		#if defined(MY_TRANSPORT_MAILBOX_SIZE)
+			_mailboxWake = relay.last;	// children are awake right after transmitting
+		#endif
+		if (relay.destination != _nc.nodeId && relay.destination != BROADCAST_ADDRESS &&
+			mGetVersion(relay) == PROTOCOL_VERSION && isTransportReady()) {
+			setIndication(INDICATION_RX);
+			#if defined(MY_TRANSPORT_TRACE)
+				TRANSPORT_TRACE(TRACE_RELAY, relay.last, relay, TRACE_ST_OK);
+			#else
+				TRANSPORT_DEBUG(PSTR("TSF:MSG:READ,%d-%d-%d,s=%d,c=%d,t=%d,pt=%d,l=%d,sg=%d\n"),
+					relay.sender, relay.last, relay.destination, relay.sensor, mGetCommand(relay), relay.type, mGetPayloadType(relay), mGetLength(relay), mGetSigned(relay));
+			#endif
+			#if defined(MY_TRANSPORT_DEDUP_SIZE)
+				if (transportIsDuplicate(relay, payloadLength)) {
+					TRANSPORT_TRACE(TRACE_DUP, relay.last, relay, TRACE_ST_NACK);
+					TRANSPORT_DEBUG(PSTR("TSF:MSG:DUP\n"));	// duplicate, not relayed again
+					return;
+				}
+			#endif
+			#if defined(MY_TRANSPORT_CUT_THROUGH) && !defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+				transportForwardFrame(relay, payloadLength);
+			#else
+				transportRelayMessage(relay);
+			#endif
+			return;
+		}
+	#endif
+	if (frame) memcpy((void*)&_msg, (void*)frame, payloadLength);
+	(void)payloadLength;	// only used by the cut-through path
 	
 	setIndication(INDICATION_RX);
 
@@ -453,23 +1138,49 @@ void transportProcessMessage() {
 	uint8_t sender = _msg.sender;
 	uint8_t last = _msg.last;
 	uint8_t destination = _msg.destination;
+	#if defined(MY_TRANSPORT_MAILBOX_SIZE) && defined(MY_REPEATER_FEATURE)
+		_mailboxWake = last;	// children are awake right after transmitting
+	#endif
+	#if defined(MY_TRANSPORT_LINK_QUALITY) && !defined(MY_GATEWAY_FEATURE)
+		if (last == _nc.parentNodeId) {
+			// EWMA, alpha = 1/4
+			_linkQuality.rssi += (transportGetReceivingRSSI() - _linkQuality.rssi) / 4;
+		}
+	#endif
 
-	TRANSPORT_DEBUG(PSTR("TSF:MSG:READ,%d-%d-%d,s=%d,c=%d,t=%d,pt=%d,l=%d,sg=%d:%s\n"),
-		sender, last, destination, _msg.sensor, mGetCommand(_msg), type, mGetPayloadType(_msg), mGetLength(_msg), mGetSigned(_msg), _msg.getString(_convBuf));
+	#if defined(MY_TRANSPORT_TRACE)
+		TRANSPORT_TRACE(TRACE_RX, last, _msg, TRACE_ST_OK);
+	#else
+		TRANSPORT_DEBUG(PSTR("TSF:MSG:READ,%d-%d-%d,s=%d,c=%d,t=%d,pt=%d,l=%d,sg=%d:%s\n"),
+			sender, last, destination, _msg.sensor, mGetCommand(_msg), type, mGetPayloadType(_msg), mGetLength(_msg), mGetSigned(_msg), _msg.getString(_convBuf));
+	#endif
 
 	// verify protocol version
 	if(mGetVersion(_msg) != PROTOCOL_VERSION) {
 		setIndication(INDICATION_ERR_VERSION);
+		TRANSPORT_TRACE(TRACE_PVER, last, _msg, TRACE_ST_NACK);
 		TRANSPORT_DEBUG(PSTR("!TSF:MSG:PVER,%d!=%d\n"), mGetVersion(_msg),PROTOCOL_VERSION);	// protocol version mismatch
 		return;
 	}
 		
 	// Reject messages that do not pass verification
-	if (!signerVerifyMsg(_msg)) {
+	if (!transportVerifyMsg(_msg)) {
 		setIndication(INDICATION_ERR_SIGN);
+		TRANSPORT_TRACE(TRACE_VERIFY_FAIL, last, _msg, TRACE_ST_NACK);
 		TRANSPORT_DEBUG(PSTR("!TSF:MSG:SIGN VERIFY FAIL\n"));
 		return;	
 	}
+
+	#if defined(MY_TRANSPORT_DEDUP_SIZE)
+		// only verified messages are recorded, forged copies cannot suppress the original
+		const bool duplicate = transportIsDuplicate(_msg, payloadLength);
+		if (duplicate && destination != _nc.nodeId) {
+			TRANSPORT_DEBUG(PSTR("TSF:MSG:DUP\n"));	// duplicate, not processed or relayed again
+			return;
+		}
+		// delivered here, relayed messages are recorded once forwarded
+		if (!duplicate && (destination == _nc.nodeId || destination == BROADCAST_ADDRESS)) transportDedupRecord(_msg);
+	#endif
 		
 	// Is message addressed to this node?
 	if (destination == _nc.nodeId) {
@@ -482,12 +1193,16 @@ void transportProcessMessage() {
 		#if defined(MY_REPEATER_FEATURE)
 			if (last != _nc.parentNodeId) {
 				// Message is from one of the child nodes. Add it to routing table.
-				hwWriteConfig(EEPROM_ROUTES_ADDRESS+sender, last);
+				transportSetRoutingTable(sender, last);
 			}
 		#endif
 
-		// Check if sender requests an ack back.
+		// Check if sender requests an ack back. Fragmented payloads are ACKed once complete.
+		#if defined(MY_TRANSPORT_FRAGMENTATION)
+		if (mGetRequestAck(_msg) && !(command == C_INTERNAL && type == I_FRAGMENT)) {
+		#else
 		if (mGetRequestAck(_msg)) {
+		#endif
 			_msgTmp = _msg;	// Copy message	
 			mSetRequestAck(_msgTmp, false); // Reply without ack flag (otherwise we would end up in an eternal loop)
 			mSetAck(_msgTmp, true); // set ACK flag
@@ -498,6 +1213,13 @@ void transportProcessMessage() {
 			// use transportSendRoute since ACK reply is not internal, i.e. if !transportOK do not reply
 			transportSendRoute(_msgTmp);
 		} 
+		#if defined(MY_TRANSPORT_DEDUP_SIZE)
+			if (duplicate) {
+				// the ACK reply was lost, it is repeated above but the message is not processed twice
+				TRANSPORT_DEBUG(PSTR("TSF:MSG:DUP\n"));
+				return;
+			}
+		#endif
 		if(!mGetAck(_msg)) {
 			// only process if not ACK
 			if (command == C_INTERNAL) {
@@ -522,19 +1244,40 @@ void transportProcessMessage() {
 								if (isValidDistance(distance)) {
 									// Distance to gateway is one more for us w.r.t. parent
 									distance++;
-									// update settings if distance shorter or preferred parent found
-									if (((isValidDistance(distance) && distance < _nc.distance) || (!_autoFindParent && sender == MY_PARENT_NODE_ID)) && !_transportSM.preferredParentFound) {
+									#if defined(MY_TRANSPORT_PARENT_SCORING)
+										const uint8_t score = transportParentScore(sender, distance);
+										const bool better = score < _parentScore;
+										TRANSPORT_DEBUG(PSTR("TSF:MSG:FPAR SCORE,ID=%d,S=%d\n"), sender, score);	// find parent, score of candidate
+									#else
+										const bool better = distance < _nc.distance;
+									#endif
+									// update settings if better (shorter) or preferred parent found
+									if (((isValidDistance(distance) && better) || (!_autoFindParent && sender == MY_PARENT_NODE_ID)) && !_transportSM.preferredParentFound) {
 										// Found a neighbor closer to GW than previously found
 										if (!_autoFindParent && sender == MY_PARENT_NODE_ID) {
 											_transportSM.preferredParentFound = true;
 											TRANSPORT_DEBUG(PSTR("TSF:MSG:FPAR PREF FOUND\n"));	// find parent, preferred parent found
 										}
+										#if defined(MY_TRANSPORT_PARENT_SCORING)
+											_parentScore = score;
+											if (score == FPAR_SCORE_HOP) {
+												// GW direct, good RSSI and not the parent that failed: nothing better to wait for
+												_transportSM.preferredParentFound = true;
+												TRANSPORT_DEBUG(PSTR("TSF:MSG:FPAR GW GOOD\n"));	// find parent, GW with good link found
+											}
+										#endif
 										_nc.distance = distance;
 										_nc.parentNodeId = sender;
 										TRANSPORT_DEBUG(PSTR("TSF:MSG:FPAR OK,ID=%d,D=%d\n"), _nc.parentNodeId, _nc.distance);
 									}
 								}
 							}
+							#if defined(MY_TRANSPORT_LINK_QUALITY)
+							else if (_linkQuality.searching) {
+								// background search, current parent stays in use until the search ends
+								transportLinkQualityCandidate(sender, _msg.getByte());
+							}
+							#endif
 							else {
 								TRANSPORT_DEBUG(PSTR("TSF:MSG:FPAR INACTIVE\n"));	// find parent response received, but inactive
 							}
@@ -542,6 +1285,16 @@ void transportProcessMessage() {
 						#endif
 					}
 				#endif
+				if (type == I_BATCH) {
+					transportProcessBatch(_msg);
+					return; // values handed over individually
+				}
+				#if defined(MY_TRANSPORT_FRAGMENTATION)
+					if (type == I_FRAGMENT) {
+						transportProcessFragment(_msg);
+						return; // handed over when complete
+					}
+				#endif
 				// general
 				if (type == I_PING) {
 					TRANSPORT_DEBUG(PSTR("TSF:MSG:PINGED,ID=%d,HP=%d\n"), sender, _msg.getByte()); // node pinged
@@ -561,6 +1314,11 @@ void transportProcessMessage() {
 					return; // no further processing required
 				}
 			} else if (command == C_STREAM) {
+				#if defined(MY_TRANSPORT_FW_CACHE_SIZE) && defined(MY_GATEWAY_FEATURE)
+					if (transportFWCacheProcess(_msg)) {
+						return; // FW block served from cache, controller not involved
+					}
+				#endif
 				#if defined(MY_OTA_FIRMWARE_FEATURE)
 					if(firmwareOTAUpdateProcess()){
 						return; // OTA FW update processing indicated no further action needed
@@ -573,7 +1331,11 @@ void transportProcessMessage() {
 		}
 		#if defined(MY_GATEWAY_FEATURE)
 			// Hand over message to controller
-			gatewayTransportSend(_msg);
+			transportGatewayHandOver(_msg);
+		#endif
+		#if defined(MY_SMART_SLEEP_PENDING)
+			// one of the messages announced by I_PENDING, ACKs of own messages are not announced
+			if (!mGetAck(_msg) && _smartSleepPending && _smartSleepPending != SMART_SLEEP_PENDING_UNKNOWN) _smartSleepPending--;
 		#endif
 		// Call incoming message callback if available
 		if (receive) {
@@ -583,6 +1345,21 @@ void transportProcessMessage() {
 	} 
 	else if (destination == BROADCAST_ADDRESS) {
 		TRANSPORT_DEBUG(PSTR("TSF:MSG:BC\n"));	// broadcast msg
+		#if defined(MY_TRANSPORT_GATEWAY_BEACON) && !defined(MY_GATEWAY_FEATURE)
+			if (command == C_INTERNAL && type == I_GATEWAY_BEACON && _transportSM.findingParentNode &&
+				last == _beaconParentNodeId && isValidDistance(_beaconDistance)) {
+				// gateway is back, previous parent relays its beacon: rebind without discovery
+				TRANSPORT_DEBUG(PSTR("TSF:MSG:BEACON,P=%d\n"), last);
+				_nc.parentNodeId = last;
+				_nc.distance = _beaconDistance;
+				_transportSM.preferredParentFound = true;
+				#if defined(MY_REPEATER_FEATURE)
+					// pass it on to our children, not forwarded below until the uplink is up
+					transportRouteMessage(_msg);
+				#endif
+				return;
+			}
+		#endif
 		if (command == C_INTERNAL) {
 			if (isTransportReady()) {
 				// only reply if node is fully operational
@@ -591,7 +1368,12 @@ void transportProcessMessage() {
 						if (sender != _nc.parentNodeId) {	// no circular reference
 							TRANSPORT_DEBUG(PSTR("TSF:MSG:FPAR REQ,ID=%d\n"), sender);	// FPR: find parent request
 							// node is in our range, update routing table - important if node has new repeater as parent
-							hwWriteConfig(EEPROM_ROUTES_ADDRESS + sender, sender);
+							transportSetRoutingTable(sender, sender);
+							#if defined(MY_TRANSPORT_FPAR_STORM_CONTROL)
+								// answered with the other requests of this window, see transportProcessFindParentRequests()
+								transportQueueFindParentRequest(sender);
+								return;
+							#endif
 							// check if uplink functional - node can only be parent node if link to GW functional
 							// this also prevents circular references in case GW ooo
 							if(transportCheckUplink(false)){ 
@@ -627,6 +1409,13 @@ void transportProcessMessage() {
 				transportRouteMessage(_msg);
 			}
 		#endif
+		#if defined(MY_OTA_FIRMWARE_FEATURE) && defined(MY_OTA_BROADCAST)
+			// firmware broadcast session
+			if (command == C_STREAM && last == _nc.parentNodeId) {
+				(void)firmwareOTAUpdateProcess();
+				return;
+			}
+		#endif
 		
 		// Call incoming message callback if available, but only if message received from parent
 		if (command != C_INTERNAL && last == _nc.parentNodeId && receive) {
@@ -638,22 +1427,7 @@ void transportProcessMessage() {
 		// msg not to us and not BC, relay msg 
 		#if defined(MY_REPEATER_FEATURE)
 		if (isTransportReady()) {
-			TRANSPORT_DEBUG(PSTR("TSF:MSG:REL MSG\n"));	// relay msg
-			// update routing table if message not received from parent
-			if (last != _nc.parentNodeId) {
-				hwWriteConfig(EEPROM_ROUTES_ADDRESS + sender, last);
-			}
-			if (command == C_INTERNAL) {
-				if (type == I_PING || type == I_PONG) {
-					uint8_t hopsCnt = _msg.getByte();
-					if (hopsCnt != MAX_HOPS) {
-						TRANSPORT_DEBUG(PSTR("TSF:MSG:REL PxNG,HP=%d\n"), hopsCnt);
-						_msg.set((uint8_t)(hopsCnt + 1));
-					}
-				}
-			}
-			// Relay this message to another node
-			transportRouteMessage(_msg);
+			transportRelayMessage(_msg);
 		}
 		#else
 			TRANSPORT_DEBUG(PSTR("!TSF:MSG:REL MSG,NORP\n"));	// message relaying request, but not a repeater
@@ -661,6 +1435,128 @@ void transportProcessMessage() {
 	}
 }
 
+#if defined(MY_REPEATER_FEATURE)
+void transportRelayMessage(MyMessage &message) {
+	TRANSPORT_DEBUG(PSTR("TSF:MSG:REL MSG\n"));	// relay msg
+	#if defined(MY_TRANSPORT_FW_CACHE_SIZE)
+		if (transportFWCacheProcess(message)) return;
+	#endif
+	// update routing table if message not received from parent
+	if (message.last != _nc.parentNodeId) {
+		transportSetRoutingTable(message.sender, message.last);
+	}
+	if (mGetCommand(message) == C_INTERNAL) {
+		#if defined(MY_TIME_SERVICE)
+			// time request of a child answered from the local clock
+			if (message.type == I_TIME && message.destination == GATEWAY_ADDRESS && !mGetLength(message) &&
+					!mGetAck(message) && _timeAnswer(message)) return;
+		#endif
+		if (message.type == I_PING || message.type == I_PONG) {
+			uint8_t hopsCnt = message.getByte();
+			if (hopsCnt != MAX_HOPS) {
+				TRANSPORT_DEBUG(PSTR("TSF:MSG:REL PxNG,HP=%d\n"), hopsCnt);
+				message.set((uint8_t)(hopsCnt + 1));
+			}
+		}
+	}
+	// Relay this message to another node
+	#if defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+		// retried on failure
+		transportQueueMessage(message);
+	#elif defined(MY_TRANSPORT_ASYNC_SEND)
+		// continue processing while frame is in flight
+		#if defined(MY_TRANSPORT_DEDUP_SIZE)
+			_dedupInFlightValid = transportRouteMessageAsync(message) && transportHasSequence(message);
+			_dedupInFlight.sender = message.sender;
+			_dedupInFlight.hash = transportDedupHash(message);
+		#else
+			transportRouteMessageAsync(message);
+		#endif
+	#else
+		#if defined(MY_TRANSPORT_DEDUP_SIZE)
+			if (transportRouteMessage(message)) transportDedupRecord(message);
+		#else
+			transportRouteMessage(message);
+		#endif
+	#endif
+}
+#endif
+
+#if defined(MY_TRANSPORT_CUT_THROUGH) && defined(MY_REPEATER_FEATURE)
+void transportForwardFrame(MyMessage &frame, uint8_t length) {
+	#if defined(MY_TRANSPORT_FW_CACHE_SIZE)
+		if (transportFWCacheProcess(frame)) return;
+	#endif
+	if (mGetCommand(frame) == C_INTERNAL && (frame.type == I_PING || frame.type == I_PONG || frame.type == I_TIME)) {
+		// hop counter is in the payload, time requests may be answered locally
+		transportRelayMessage(frame);
+		return;
+	}
+	if (_transportSM.findingParentNode) return;
+	// update routing table if message not received from parent
+	if (frame.last != _nc.parentNodeId) {
+		transportSetRoutingTable(frame.sender, frame.last);
+	}
+	const uint8_t route = transportGetRoute(frame);
+	STATS_INC(forwarded);
+	// radio is busy until transmission in flight is completed
+	transportWaitAsyncSend();
+	frame.last = _nc.nodeId;
+	setIndication(INDICATION_TX);
+	ENERGY_TX_BEGIN();
+	const bool ok = transportSend(route, &frame, length);
+	ENERGY_TX_END();
+	transportUpdateTxCounter(route, ok);
+	TRANSPORT_TRACE(TRACE_TX, route, frame, ok ? TRACE_ST_OK : TRACE_ST_NACK);
+	TRANSPORT_DEBUG(PSTR("%sTSF:MSG:FWD,%d-%d-%d,st=%s\n"), (ok ? "" : "!"), frame.sender, route, frame.destination, (ok ? "OK" : "NACK"));
+	#if defined(MY_TRANSPORT_DEDUP_SIZE)
+		if (ok) transportDedupRecord(frame);
+	#endif
+	#if defined(MY_RF24_ACK_PAYLOAD) || defined(MY_TRANSPORT_MAILBOX_SIZE)
+		// child not listening, deliver with its next uplink instead
+		if (!ok && route == frame.destination) {
+			#if defined(MY_RF24_ACK_PAYLOAD)
+				if (transportStageAckPayload(route, frame)) return;
+			#endif
+			#if defined(MY_TRANSPORT_MAILBOX_SIZE)
+				(void)transportMailboxStore(frame);
+			#endif
+		}
+	#endif
+}
+#endif
+
+#if defined(MY_TRANSPORT_FPAR_STORM_CONTROL) && defined(MY_REPEATER_FEATURE)
+void transportQueueFindParentRequest(uint8_t requester) {
+	for (uint8_t i = 0; i < _fparRequestCount; i++) {
+		if (_fparRequests[i] == requester) return;
+	}
+	// full: answered on its retry
+	if (_fparRequestCount == MY_TRANSPORT_FPAR_PENDING) return;
+	if (!_fparRequestCount) _fparRequestsDue = hwMillis() + random(MY_TRANSPORT_FPAR_JITTER_MS);
+	_fparRequests[_fparRequestCount++] = requester;
+}
+
+void transportProcessFindParentRequests() {
+	if (!_fparRequestCount || (int32_t)(hwMillis() - _fparRequestsDue) < 0) return;
+	// take the batch, the uplink check below processes incoming requests
+	uint8_t requests[MY_TRANSPORT_FPAR_PENDING];
+	const uint8_t count = _fparRequestCount;
+	memcpy(requests, _fparRequests, count);
+	_fparRequestCount = 0;
+	// one uplink check for all requests of the window
+	if (!transportCheckUplink(false)) {
+		TRANSPORT_DEBUG(PSTR("!TSF:MSG:GWL FAIL\n")); // GW uplink fail, do not respond to parent request
+		return;
+	}
+	_transportSM.lastUplinkCheck = hwMillis();
+	TRANSPORT_DEBUG(PSTR("TSF:MSG:GWL OK,N=%d\n"), count); // GW uplink ok
+	for (uint8_t i = 0; i < count; i++) {
+		transportRouteMessage(build(_msgTmp, _nc.nodeId, requests[i], NODE_SENSOR_ID, C_INTERNAL, I_FIND_PARENT_RESPONSE, false).set(_nc.distance));
+	}
+}
+#endif
+
 void transportInvokeSanityCheck() {
 	if (!transportSanityCheck()) {
 		TRANSPORT_DEBUG(PSTR("!TSF:SANCHK:FAIL\n"));	// sanity check fail
@@ -685,11 +1581,36 @@ inline void transportProcessFIFO() {
 		// transport not active, nothing to be done
 		return;
 	}
-	uint8_t _processedMessages = MAX_SUBSEQ_MSGS;
-	// process all msgs in FIFO or counter exit
-	while (transportAvailable() && _processedMessages--) {
-		transportProcessMessage();
-	}
+	// evaluate transmission in flight
+	transportUpdateAsyncSend();
+	#if defined(MY_TRANSPORT_FPAR_STORM_CONTROL) && defined(MY_REPEATER_FEATURE)
+		transportProcessFindParentRequests();
+	#endif
+	#if defined(MY_TRANSPORT_FIFO_BUDGET_US)
+		// process msgs in FIFO until the time budget is spent, at least one
+		const unsigned long start = hwMicros();
+		bool idle = true;
+		while (transportAvailable() && (idle || hwMicros() - start < MY_TRANSPORT_FIFO_BUDGET_US)) {
+			transportProcessMessage();
+			idle = false;
+		}
+	#else
+		uint8_t _processedMessages = MAX_SUBSEQ_MSGS;
+		// process all msgs in FIFO or counter exit
+		while (transportAvailable() && _processedMessages--) {
+			transportProcessMessage();
+		}
+		const bool idle = _processedMessages == MAX_SUBSEQ_MSGS;
+	#endif
+	#if defined(MY_TRANSPORT_TRACE) && defined(MY_DEBUG)
+		// idle: decode one trace entry
+		if (idle) transportTracePrint();
+	#else
+		(void)idle;
+	#endif
+	#if defined(MY_TRANSPORT_MAILBOX_SIZE) && defined(MY_REPEATER_FEATURE)
+		if (isTransportReady()) transportMailboxDeliver();
+	#endif
 	#if defined(MY_OTA_FIRMWARE_FEATURE)
 		if (isTransportReady()) {
 			// only process if transport ok
@@ -698,30 +1619,467 @@ inline void transportProcessFIFO() {
 	#endif
 }
 
+#if defined(MY_STATS_FEATURE) && defined(MY_SIGNING_FEATURE)
+bool transportSignMsg(MyMessage &message) {
+	const uint16_t start = hwMillis();
+	const bool ok = signerSignMsg(message);
+	STATS_ADD(signingMs, (uint16_t)hwMillis() - start);
+	return ok;
+}
+
+bool transportVerifyMsg(MyMessage &message) {
+	const uint16_t start = hwMillis();
+	const bool ok = signerVerifyMsg(message);
+	STATS_ADD(signingMs, (uint16_t)hwMillis() - start);
+	return ok;
+}
+#endif
+
+#if defined(MY_TRANSPORT_TRACE)
+void transportTrace(uint8_t event, uint8_t peer, const MyMessage &message, uint8_t status) {
+	transportTraceRecord(event, peer, message.sender, message.destination, mGetCommand(message), message.type, status);
+}
+
+void transportTraceRecord(uint8_t event, uint8_t peer, uint8_t sender, uint8_t destination, uint8_t command, uint8_t type, uint8_t status) {
+	transportTraceEntry &entry = _trace[_traceHead];
+	entry.time = (uint16_t)hwMillis();
+	entry.event = event;
+	entry.peer = peer;
+	entry.sender = sender;
+	entry.destination = destination;
+	entry.type = type;
+	entry.status = command | (status << 4);
+	if (++_traceHead == MY_TRANSPORT_TRACE_SIZE) _traceHead = 0;
+	if (_traceCount < MY_TRANSPORT_TRACE_SIZE) _traceCount++;
+	if (_traceUnprinted < MY_TRANSPORT_TRACE_SIZE) _traceUnprinted++;
+}
+
+void transportTracePrint() {
+	#if defined(MY_DEBUG)
+		if (!_traceUnprinted) return;
+		const uint8_t index = (_traceHead + MY_TRANSPORT_TRACE_SIZE - _traceUnprinted) % MY_TRANSPORT_TRACE_SIZE;
+		_traceUnprinted--;
+		const transportTraceEntry &entry = _trace[index];
+		debug(PSTR("TRC:%u,e=%d,%d-%d-%d,c=%d,t=%d,st=%d\n"), entry.time, entry.event, entry.peer, entry.sender,
+			entry.destination, entry.status & 0x0F, entry.type, entry.status >> 4);
+	#endif
+}
+
+void transportTraceSend() {
+	const uint8_t perMessage = MAX_PAYLOAD / sizeof(transportTraceEntry);
+	// copy, sending records new entries
+	transportTraceEntry trace[MY_TRANSPORT_TRACE_SIZE];
+	const uint8_t count = _traceCount;
+	for (uint8_t i = 0; i < count; i++) {
+		trace[i] = _trace[(_traceHead + MY_TRANSPORT_TRACE_SIZE - count + i) % MY_TRANSPORT_TRACE_SIZE];
+	}
+	for (uint8_t i = 0; i < count; i += perMessage) {
+		const uint8_t entries = min(perMessage, count - i);
+		build(_msgTmp, _nc.nodeId, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_DEBUG, false).set(&trace[i], entries * sizeof(transportTraceEntry));
+		#if defined(MY_GATEWAY_FEATURE)
+			// the gateway is GATEWAY_ADDRESS itself, its trace goes to the controller
+			gatewayTransportSendQueued();
+			(void)gatewayTransportSend(_msgTmp);
+		#else
+			(void)transportSendRoute(_msgTmp);
+		#endif
+	}
+}
+#endif
+
+uint8_t transportFrameLength(const MyMessage &message) {
+	// signed messages use the whole frame
+	if (mGetSigned(message)) return MAX_MESSAGE_LENGTH;
+	#if defined(MY_TRANSPORT_DEDUP_SIZE)
+		// sequence number follows the payload
+		if (transportHasSequence(message)) return HEADER_SIZE + mGetLength(message) + 1;
+	#endif
+	return min(MAX_MESSAGE_LENGTH, HEADER_SIZE + mGetLength(message));
+}
+
 bool transportSendWrite(uint8_t to, MyMessage &message) {
+	// radio is busy until transmission in flight is completed
+	transportWaitAsyncSend();
 	// set protocol version and update last
 	mSetVersion(message, PROTOCOL_VERSION);
 	message.last = _nc.nodeId;
 
 	// sign message if required
-	if (!signerSignMsg(message)) {
+	if (!transportSignMsg(message)) {
+		TRANSPORT_TRACE(TRACE_SIGN_FAIL, to, message, TRACE_ST_NACK);
 		TRANSPORT_DEBUG(PSTR("!TSF:MSG:SIGN FAIL\n"));
 		setIndication(INDICATION_ERR_SIGN);
 		return false;
 	}
 	
-	// msg length changes if signed
-	uint8_t length = mGetSigned(message) ? MAX_MESSAGE_LENGTH : mGetLength(message);
-	
 	// send
 	setIndication(INDICATION_TX);
-	bool ok = transportSend(to, &message, min(MAX_MESSAGE_LENGTH, HEADER_SIZE + length));
+	ENERGY_TX_BEGIN();
+	bool ok = transportSend(to, &message, transportFrameLength(message));
+	ENERGY_TX_END();
 	
-	TRANSPORT_DEBUG(PSTR("%sTSF:MSG:SEND,%d-%d-%d-%d,s=%d,c=%d,t=%d,pt=%d,l=%d,sg=%d,ft=%d,st=%s:%s\n"),
-			(ok || to == BROADCAST_ADDRESS ? "" : "!"),message.sender,message.last, to, message.destination, message.sensor, mGetCommand(message), message.type,
-			mGetPayloadType(message), mGetLength(message), mGetSigned(message), _transportSM.failedUplinkTransmissions, to==BROADCAST_ADDRESS ? "bc" : (ok ? "OK":"NACK"), message.getString(_convBuf));
+	#if defined(MY_TRANSPORT_TRACE)
+		TRANSPORT_TRACE(TRACE_TX, to, message, to == BROADCAST_ADDRESS ? TRACE_ST_BC : (ok ? TRACE_ST_OK : TRACE_ST_NACK));
+	#else
+		TRANSPORT_DEBUG(PSTR("%sTSF:MSG:SEND,%d-%d-%d-%d,s=%d,c=%d,t=%d,pt=%d,l=%d,sg=%d,ft=%d,st=%s:%s\n"),
+				(ok || to == BROADCAST_ADDRESS ? "" : "!"),message.sender,message.last, to, message.destination, message.sensor, mGetCommand(message), message.type,
+				mGetPayloadType(message), mGetLength(message), mGetSigned(message), _transportSM.failedUplinkTransmissions, to==BROADCAST_ADDRESS ? "bc" : (ok ? "OK":"NACK"), message.getString(_convBuf));
+	#endif
 	
 	return (ok || to==BROADCAST_ADDRESS);
 }
 
+#if defined(MY_RF24_ACK_PAYLOAD) && defined(MY_REPEATER_FEATURE)
+bool transportStageAckPayload(uint8_t to, MyMessage &message) {
+	// same framing as transportSendWrite(), a message signed for the failed transmission keeps its signature
+	mSetVersion(message, PROTOCOL_VERSION);
+	message.last = _nc.nodeId;
+	if (!mGetSigned(message) && !transportSignMsg(message)) return false;
+	const bool ok = transportSetAckPayload(to, &message, transportFrameLength(message));
+	TRANSPORT_DEBUG(PSTR("%sTSF:MSG:ACKPL,TO=%d\n"), (ok ? "" : "!"), to);	// staged as ACK payload
+	return ok;
+}
+#endif
+
+bool transportSendWriteAsync(uint8_t to, MyMessage &message) {
+	#if !defined(MY_RS485_MULTI_MESSAGE)
+		// only one transmission in flight
+		transportWaitAsyncSend();
+	#endif
+	// set protocol version and update last
+	mSetVersion(message, PROTOCOL_VERSION);
+	message.last = _nc.nodeId;
+
+	// sign message if required
+	if (!transportSignMsg(message)) {
+		TRANSPORT_TRACE(TRACE_SIGN_FAIL, to, message, TRACE_ST_NACK);
+		TRANSPORT_DEBUG(PSTR("!TSF:MSG:SIGN FAIL\n"));
+		setIndication(INDICATION_ERR_SIGN);
+		return false;
+	}
+	
+	#if defined(MY_RS485_MULTI_MESSAGE)
+		// a frame to the same node still waiting for the bus takes this message too, one status covers
+		// both. Checked after signing, which may send and sets the final length
+		const bool join = _transportSM.asyncSendStatus == TRANSPORT_TX_PENDING && _transportSM.asyncSendRoute == to &&
+			transportSendAsyncJoinable(to, transportFrameLength(message));
+		if (!join) {
+			// only one transmission in flight
+			transportWaitAsyncSend();
+			ENERGY_TX_BEGIN();
+		}
+	#else
+		ENERGY_TX_BEGIN();
+	#endif
+	// start transmission, frame is copied to radio and message can be reused
+	setIndication(INDICATION_TX);
+	bool ok = transportSendAsync(to, &message, transportFrameLength(message));
+	
+	#if defined(MY_TRANSPORT_TRACE)
+		TRANSPORT_TRACE(TRACE_TX_ASYNC, to, message, ok ? TRACE_ST_OK : TRACE_ST_NACK);
+	#else
+		TRANSPORT_DEBUG(PSTR("%sTSF:MSG:SEND ASYNC,%d-%d-%d-%d,s=%d,c=%d,t=%d,pt=%d,l=%d,sg=%d:%s\n"),
+				(ok ? "" : "!"),message.sender,message.last, to, message.destination, message.sensor, mGetCommand(message), message.type,
+				mGetPayloadType(message), mGetLength(message), mGetSigned(message), message.getString(_convBuf));
+	#endif
+	
+	if (!ok) {
+		ENERGY_TX_END();
+		transportUpdateTxCounter(to, false);
+		_transportSM.asyncSendStatus = TRANSPORT_TX_FAIL;
+		return false;
+	}
+	_transportSM.asyncSendRoute = to;
+	_transportSM.asyncSendStatus = TRANSPORT_TX_PENDING;
+	return true;
+}
+
+void transportUpdateAsyncSend() {
+	if (_transportSM.asyncSendStatus != TRANSPORT_TX_PENDING) return;
+	const uint8_t status = transportSendAsyncStatus();
+	if (status == TRANSPORT_TX_PENDING) return;
+	ENERGY_TX_END();
+	const uint8_t to = _transportSM.asyncSendRoute;
+	// BC messages are not ACKed
+	const bool ok = (status == TRANSPORT_TX_OK || to == BROADCAST_ADDRESS);
+	_transportSM.asyncSendStatus = ok ? TRANSPORT_TX_OK : TRANSPORT_TX_FAIL;
+	transportUpdateTxCounter(to, ok);
+	#if defined(MY_TRANSPORT_DEDUP_SIZE) && defined(MY_TRANSPORT_ASYNC_SEND) && !defined(MY_TRANSPORT_TX_QUEUE_SIZE)
+		if (_dedupInFlightValid && ok) transportDedupStore(_dedupInFlight.sender, _dedupInFlight.hash);
+		_dedupInFlightValid = false;
+	#endif
+	#if defined(MY_TRANSPORT_TRACE)
+		// header of the message in flight is not kept
+		transportTraceRecord(TRACE_TX_DONE, to, _nc.nodeId, to, 0, 0, to == BROADCAST_ADDRESS ? TRACE_ST_BC : (ok ? TRACE_ST_OK : TRACE_ST_NACK));
+	#else
+		TRANSPORT_DEBUG(PSTR("%sTSF:MSG:SEND ASYNC,TO=%d,ft=%d,st=%s\n"), (ok ? "" : "!"), to,
+				_transportSM.failedUplinkTransmissions, to==BROADCAST_ADDRESS ? "bc" : (ok ? "OK":"NACK"));
+	#endif
+}
+
+void transportWaitAsyncSend() {
+	// drivers time out transmissions, i.e. this terminates
+	while (_transportSM.asyncSendStatus == TRANSPORT_TX_PENDING) {
+		transportUpdateAsyncSend();
+	}
+}
+
+void transportProcessBatch(MyMessage &message) {
+	uint8_t pos = 0;
+	MyMessage item;
+	memset((void*)&item, 0, sizeof(item));
+	while (MyMessageBatch::get(message, pos, item)) {
+		#if defined(MY_GATEWAY_FEATURE)
+			// Hand over value to controller
+			transportGatewayHandOver(item);
+		#endif
+		if (receive) {
+			receive(item);
+		}
+	}
+}
+
+#if defined(MY_TRANSPORT_FRAGMENTATION)
+void transportProcessFragment(MyMessage &message) {
+	const uint8_t length = mGetLength(message);
+	if (mGetPayloadType(message) != P_CUSTOM || length < FRAGMENT_HEADER_SIZE) return;
+	const uint8_t *payload = (const uint8_t*)message.data;
+	const uint8_t id = payload[0];
+	const uint8_t index = payload[1] >> 4;
+	const uint8_t count = (payload[1] & 0x0F) + 1;
+	const uint8_t header = index ? FRAGMENT_HEADER_SIZE : FRAGMENT_FIRST_HEADER_SIZE;
+	if (length < header || index >= count) return;
+	const uint16_t offset = FRAGMENT_OFFSET(index);
+	const uint8_t chunk = length - header;
+	if (offset + chunk > MY_TRANSPORT_FRAGMENT_MAX_SIZE) {
+		TRANSPORT_DEBUG(PSTR("!TSF:FRG:SIZE,%d\n"), message.sender);	// payload too large
+		return;
+	}
+	// find transfer, otherwise take a free, expired or the oldest buffer
+	transportReassemblyBuffer *buffer = NULL;
+	transportReassemblyBuffer *victim = &_reassembly[0];
+	bool victimFree = false;
+	for (uint8_t i = 0; i < MY_TRANSPORT_REASSEMBLY_BUFFERS; i++) {
+		transportReassemblyBuffer &b = _reassembly[i];
+		const bool expired = !b.count || hwMillis() - b.started > MY_TRANSPORT_REASSEMBLY_TIMEOUT_MS;
+		if (!expired && b.sender == message.sender && b.id == id) {
+			buffer = &b;
+			break;
+		}
+		if (expired) {
+			if (!victimFree) victim = &b;
+			victimFree = true;
+		} else if (!victimFree && (int32_t)(b.started - victim->started) < 0) {
+			victim = &b;
+		}
+	}
+	if (!buffer || buffer->count != count) {
+		buffer = victim;
+		buffer->sender = message.sender;
+		buffer->id = id;
+		buffer->count = count;
+		buffer->received = 0;
+		buffer->length = 0;
+		buffer->requestAck = false;
+		buffer->started = hwMillis();
+	}
+	// fragments arrive in any order, the one completing the payload may not carry the request
+	if (mGetRequestAck(message)) buffer->requestAck = true;
+	if (!index) {
+		buffer->sensor = message.sensor;
+		buffer->type = payload[2];
+	}
+	memcpy(&buffer->data[offset], &payload[header], chunk);
+	buffer->received |= (uint16_t)1 << index;
+	if (index == count - 1) buffer->length = offset + chunk;
+	const uint16_t all = count == FRAGMENT_MAX_COUNT ? 0xFFFF : ((uint16_t)1 << count) - 1;
+	if (buffer->received != all) {
+		TRANSPORT_DEBUG(PSTR("TSF:FRG:%d,%d/%d\n"), message.sender, index + 1, count);	// fragment stored
+		return;
+	}
+	// complete, release buffer before handing over, receiveFragmented() may send
+	buffer->count = 0;
+	TRANSPORT_DEBUG(PSTR("TSF:FRG:OK,%d,l=%d\n"), message.sender, buffer->length);	// payload complete
+	if (buffer->requestAck) {
+		// single end-to-end ACK for the whole payload, header of original message
+		build(_msgTmp, _nc.nodeId, message.sender, buffer->sensor, C_SET, buffer->type, false).set(buffer->data, 0);
+		mSetAck(_msgTmp, true);
+		TRANSPORT_DEBUG(PSTR("TSF:MSG:ACK REQ\n"));	// ACK requested
+		transportSendRoute(_msgTmp);
+	}
+	#if defined(MY_GATEWAY_FEATURE)
+		// the controller protocol carries MAX_PAYLOAD bytes per message, the payload is handed over in order
+		gatewayTransportSendQueued();
+		for (uint16_t pos = 0; pos < buffer->length; pos += MAX_PAYLOAD) {
+			const uint8_t chunk = min(buffer->length - pos, MAX_PAYLOAD);
+			gatewayTransportSend(build(_msgTmp, message.sender, message.destination, buffer->sensor, C_SET, buffer->type, false).set(&buffer->data[pos], chunk));
+		}
+	#endif
+	if (receiveFragmented) {
+		build(_msgTmp, message.sender, message.destination, buffer->sensor, C_SET, buffer->type, false).set(buffer->data, 0);
+		receiveFragmented(_msgTmp, buffer->data, buffer->length);
+	}
+}
+#endif
+
+#if defined(MY_TRANSPORT_DEDUP_SIZE)
+bool transportHasSequence(const MyMessage &message) {
+	return mGetCommand(message) != C_INTERNAL && !mGetSigned(message) && mGetLength(message) < MAX_PAYLOAD;
+}
+
+uint16_t transportDedupHash(const MyMessage &message) {
+	// everything but the last hop, up to and including the sequence number after the payload
+	const uint8_t *data = (const uint8_t*)&message + 1;
+	const uint8_t len = HEADER_SIZE + min(mGetLength(message), MAX_PAYLOAD);
+	uint16_t hash = 5381;
+	for (uint8_t i = 0; i < len; i++) {
+		hash = (hash << 5) + hash + data[i];
+	}
+	return hash;
+}
+
+bool transportIsDuplicate(const MyMessage &message, const uint8_t length) {
+	// without a sequence number identical messages are legitimate repeats
+	if (!transportHasSequence(message) || length != HEADER_SIZE + mGetLength(message) + 1) return false;
+	const uint16_t hash = transportDedupHash(message);
+	const uint16_t now = (uint16_t)hwMillis();
+	for (uint8_t i = 0; i < MY_TRANSPORT_DEDUP_SIZE; i++) {
+		transportDedupEntry &entry = _dedupCache[i];
+		if (entry.hash == hash && entry.sender == message.sender &&
+			(uint16_t)(now - entry.seen) < MY_TRANSPORT_DEDUP_WINDOW_MS) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void transportDedupStore(const uint8_t sender, const uint16_t hash) {
+	transportDedupEntry &entry = _dedupCache[_dedupNext];
+	entry.sender = sender;
+	entry.hash = hash;
+	entry.seen = (uint16_t)hwMillis();
+	if (++_dedupNext >= MY_TRANSPORT_DEDUP_SIZE) _dedupNext = 0;
+}
+
+void transportDedupRecord(const MyMessage &message) {
+	if (transportHasSequence(message)) transportDedupStore(message.sender, transportDedupHash(message));
+}
+#endif
+
+#if defined(MY_TRANSPORT_MAILBOX_SIZE) && defined(MY_REPEATER_FEATURE)
+static void transportMailboxRemove(uint8_t index) {
+	// keep order
+	_mailboxCount--;
+	for (uint8_t i = index; i < _mailboxCount; i++) {
+		_mailbox[i] = _mailbox[i + 1];
+	}
+}
+
+static void transportMailboxEvict() {
+	uint8_t i = 0;
+	while (i < _mailboxCount) {
+		if (hwMillis() - _mailbox[i].stored > MY_TRANSPORT_MAILBOX_TTL_MS) {
+			TRANSPORT_DEBUG(PSTR("!TSF:MBX:TTL,%d\n"), _mailbox[i].message.destination);	// expired, message dropped
+			transportMailboxRemove(i);
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+bool transportMailboxStore(MyMessage &message) {
+	transportMailboxEvict();
+	if (_mailboxCount == MY_TRANSPORT_MAILBOX_SIZE) {
+		TRANSPORT_DEBUG(PSTR("!TSF:MBX:FULL,%d\n"), message.destination);	// mailbox full, message dropped
+		return false;
+	}
+	_mailbox[_mailboxCount].message = message;
+	_mailbox[_mailboxCount].stored = hwMillis();
+	_mailboxCount++;
+	TRANSPORT_DEBUG(PSTR("TSF:MBX:STORE,%d\n"), message.destination);
+	return true;
+}
+
+void transportMailboxDeliver() {
+	const uint8_t child = _mailboxWake;
+	if (child == BROADCAST_ADDRESS || _mailboxDelivering) return;
+	_mailboxWake = BROADCAST_ADDRESS;
+	transportMailboxEvict();
+	_mailboxDelivering = true;
+	uint8_t i = 0;
+	while (i < _mailboxCount) {
+		if (_mailbox[i].message.destination != child) {
+			i++;
+			continue;
+		}
+		// send a copy, message is modified when signed
+		MyMessage message = _mailbox[i].message;
+		const bool ok = transportSendWrite(child, message);
+		transportUpdateTxCounter(child, ok);
+		if (!ok) break;	// child is sleeping again
+		TRANSPORT_DEBUG(PSTR("TSF:MBX:DLVR,%d\n"), child);
+		transportMailboxRemove(i);
+	}
+	_mailboxDelivering = false;
+}
+#endif
+
+#if defined(MY_TRANSPORT_FW_CACHE_SIZE)
+bool transportFWCacheProcess(MyMessage &message) {
+	// signed replies cannot be handed to another node
+	if (mGetCommand(message) != C_STREAM || mGetSigned(message)) return false;
+	if (message.type == ST_FIRMWARE_RESPONSE && mGetLength(message) == sizeof(ReplyFWBlock)) {
+		const ReplyFWBlock *reply = (const ReplyFWBlock*)message.data;
+		for (uint8_t i = 0; i < _fwCacheCount; i++) {
+			const ReplyFWBlock &cached = _fwCache[i].reply;
+			if (cached.block == reply->block && cached.type == reply->type && cached.version == reply->version) return false;
+		}
+		_fwCache[_fwCacheNext].reply = *reply;
+		_fwCache[_fwCacheNext].servedTo = BROADCAST_ADDRESS;
+		if (_fwCacheCount < MY_TRANSPORT_FW_CACHE_SIZE) _fwCacheCount++;
+		if (++_fwCacheNext >= MY_TRANSPORT_FW_CACHE_SIZE) _fwCacheNext = 0;
+	}
+	else if (message.type == ST_FIRMWARE_REQUEST && message.destination == GATEWAY_ADDRESS &&
+		mGetLength(message) == sizeof(RequestFWBlock)) {
+		const RequestFWBlock *request = (const RequestFWBlock*)message.data;
+		const uint8_t node = message.sender;
+		for (uint8_t i = 0; i < _fwCacheCount; i++) {
+			FirmwareCacheItem &item = _fwCache[i];
+			if (item.reply.block != request->block || item.reply.type != request->type || item.reply.version != request->version) continue;
+			if (item.servedTo == node) {
+				// asked again, cached reply was lost or not accepted (e.g. signing), let the controller answer
+				item.servedTo = BROADCAST_ADDRESS;
+				return false;
+			}
+			item.servedTo = node;
+			TRANSPORT_DEBUG(PSTR("TSF:FWC:HIT,%d,%d\n"), node, item.reply.block);	// FW block served from cache
+			(void)transportRouteMessage(build(_msgTmp, _nc.nodeId, node, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_RESPONSE, false).set(&item.reply, sizeof(ReplyFWBlock)));
+			return true;
+		}
+	}
+	return false;
+}
+#endif
+
+#if defined(MY_TRANSPORT_ATC)
+transportATCEntry* transportGetATCEntry(uint8_t node, uint8_t maxLevel) {
+	for (uint8_t i = 0; i < _transportATCCount; i++) {
+		if (_transportATC[i].node == node) return &_transportATC[i];
+	}
+	uint8_t i;
+	if (_transportATCCount < MY_TRANSPORT_ATC_NEIGHBOURS) {
+		i = _transportATCCount++;
+	}
+	else {
+		i = _transportATCNext;
+		if (++_transportATCNext >= MY_TRANSPORT_ATC_NEIGHBOURS) _transportATCNext = 0;
+	}
+	_transportATC[i].node = node;
+	_transportATC[i].level = maxLevel;
+	_transportATC[i].goodCount = 0;
+	return &_transportATC[i];
+}
+#endif
+
 // EOF MyTransport.cpp
\ No newline at end of file
@@ -52,6 +52,7 @@
  * - TSM:INIT:STATID,ID=x			Node ID x is static
  * - TSM:INIT:TSP OK				Transport device configured and fully operational
  * - TSM:INIT:GW MODE				Node is set up as GW, thus omitting ID and findParent states
+ * - TSM:INIT:WARM,P=x,D=y			Warm boot, parent x and distance y of last boot restored, omitting findParent, ID and uplink states
  * - !TSM:INIT:TSP FAIL				Transport device initialization failed
  *
  * TSM state <b>stParent</b> log status / errors
@@ -76,6 +77,9 @@
  * - TSM:READY						Transition to stReady, i.e. transport is ready and fully operational
  * - !TSM:READY:UPL FAIL,SNP		Too many failed uplink transmissions, search new parent
  * - !TSM:READY:UPL FAIL,STATP		Too many failed uplink transmissions, no SNP, static parent enforced
+ * - TSM:READY:LQ LOW,Q=x,R=y		Uplink quality low (ACK ratio x/255, RSSI y), background search for new parent
+ * - TSM:READY:LQ SWITCH,P=x,D=y	Better parent x with distance y found in background search, verify uplink
+ * - TSM:READY:LQ KEEP				No better parent found in background search
  *
  * TSM state <b>stFailure</b> information / status
  * - TSM:FAILURE					Transition to stFailure state
@@ -92,6 +96,8 @@
  * - TSF:MSG:ACK REQ				ACK message requested
  * - TSF:MSG:ACK					ACK message, do not proceed but forward to callback
  * - TSF:MSG:FPAR RES,ID=x,D=y		Response to find parent received from node x with distance y to GW
+ * - TSF:MSG:FPAR SCORE,ID=x,S=y		Find parent response from node x scored y (lower is better)
+ * - TSF:MSG:FPAR GW GOOD			GW replied with a good RSSI, find parent ends early
  * - TSF:MSG:FPAR PREF FOUND		Preferred parent found
  * - TSF:MSG:FPAR OK,ID=x,D=y		Find parent reponse from node x is valid, distance y to GW
  * - TSF:MSG:FPAR INACTIVE			Find parent response received, but no find parent request active, skip response
@@ -123,6 +129,15 @@
  *  - l=length
  *  - ft=failed uplink transmission counter 
  *  - sg=signing flag
+ *
+ * With MY_TRANSPORT_TRACE, READ and SEND are recorded in a binary trace ring instead and printed when idle
+ * - TRC:time,e=event,peer-sender-destination,c=%d,t=%d,st=%d
+ *
+ * - Trace fields:
+ *  - time=lower 16 bits of hwMillis() when recorded
+ *  - event=TRACE_* id, see MyTransport.h
+ *  - peer=last (receiving) or next hop (sending)
+ *  - st=TRACE_ST_* status
  * 
  * TSF errors
  * - !TSF:ASID:FAIL,ID=x			Assigned ID x is invalid, e.g. 0 (GATEWAY)
@@ -160,6 +175,13 @@
 #define INVALID_HOPS ((uint8_t)255)			//!< invalid hops
 #define MAX_SUBSEQ_MSGS 5					//!< Maximum number of subsequentially processed messages in FIFO (to prevent transport deadlock if HW issue)
 #define CHKUPL_INTERVAL ((uint32_t)10000)	//!< Minimum time interval to re-check uplink
+#define FPAR_SCORE_HOP 16					//!< parent score of one hop, equal to 16dB below MY_TRANSPORT_PARENT_GOOD_RSSI
+
+#define TRANSPORT_TX_IDLE		0			//!< no asynchronous transmission started
+#define TRANSPORT_TX_PENDING	1			//!< asynchronous transmission in flight
+#define TRANSPORT_TX_OK			2			//!< asynchronous transmission completed, recipient ACKed
+#define TRANSPORT_TX_FAIL		3			//!< asynchronous transmission completed, no ACK or HW issue
+#define TX_QUEUE_NONE			0xFF		//!< invalid TX queue index
 
 #define _autoFindParent (bool)(MY_PARENT_NODE_ID == AUTO)				//!<  returns true if static parent id is undefined
 #define isValidDistance(distance) (bool)(distance!=DISTANCE_INVALID)	//!<  returns true if distance is valid
@@ -191,15 +213,171 @@ typedef struct {
 	bool uplinkOk : 1;						//!< flag uplink ok
 	bool pingActive : 1;					//!< flag ping active
 	bool transportActive : 1;				//!< flag transport active
-	uint8_t reserved : 3;					//!< reserved
+	uint8_t asyncSendStatus : 2;			//!< status of last asynchronous transmission, TRANSPORT_TX_*
+	uint8_t reserved : 1;					//!< reserved
 	// 8 bits
 	uint8_t retries : 4;					//!< retries / state re-enter
 	uint8_t failedUplinkTransmissions : 4;	//!< counter failed uplink transmissions
 	// 8 bits
 	uint8_t pingResponse;					//!< stores hops received in I_PONG
+	// 8 bits
+	uint8_t asyncSendRoute;					//!< next hop of asynchronous transmission in flight
 } __attribute__((packed)) transportSM;
 
 
+/**
+* @brief Received frame buffered by a transport driver
+*/
+typedef struct {
+	uint8_t data[MAX_MESSAGE_LENGTH];		//!< received frame (header + payload)
+	uint8_t len;							//!< frame length
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+	int16_t rssi;							//!< RSSI sampled when the frame was captured, see transportGetReceivingRSSI()
+#endif
+#if defined(MY_RF24_ACK_PAYLOAD)
+	uint8_t ackPayload;						//!< NRF24 ACK payload stage that had left the TX FIFO when the frame was captured, 0 if none
+#endif
+} transportRxFrame;
+
+
+/**
+* @brief Outbound TX queue item
+*/
+typedef struct {
+#if defined(MY_MESSAGE_POOL_SIZE)
+	msgPoolHandle message;					//!< pool buffer of queued message
+#else
+	MyMessage message;						//!< queued message
+#endif
+	uint32_t nextAttempt;					//!< earliest timepoint of next transmission attempt
+	uint8_t route;							//!< next hop
+	uint8_t retries;						//!< failed transmission attempts
+} transportTxQueueItem;
+
+
+/**
+* @brief RAM copy of routing table
+*/
+typedef struct {
+	uint8_t route[SIZE_ROUTES];				//!< next hop per node ID
+	uint8_t dirty[SIZE_ROUTES / 8];			//!< bitmap of routes changed since last save
+	uint32_t lastSave;						//!< last save timepoint
+} routingTable;
+
+
+/**
+* @brief Sparse routing table entry
+*/
+typedef struct {
+	uint8_t node;							//!< destination node ID
+	uint8_t route;							//!< next hop
+	uint16_t lastSeen;						//!< last update, in units of 65536ms
+} routingTableEntry;
+
+
+/**
+* @brief Duplicate cache entry
+*/
+typedef struct {
+	uint8_t sender;							//!< origin of message
+	uint16_t hash;							//!< hash of header (without last hop), payload and sequence number
+	uint16_t seen;							//!< reception timepoint, lower 16 bits of hwMillis()
+} transportDedupEntry;
+
+
+/**
+* @brief Mailbox item, message for a sleeping child
+*/
+typedef struct {
+	MyMessage message;						//!< undelivered message
+	uint32_t stored;						//!< timepoint of storage, for TTL
+} transportMailboxItem;
+
+
+/**
+* @brief Reassembly buffer for a fragmented payload
+*/
+typedef struct {
+	uint8_t sender;							//!< origin of payload, BROADCAST_ADDRESS if unused
+	uint8_t id;								//!< transfer id chosen by sender
+	uint8_t sensor;							//!< child sensor of original message
+	uint8_t type;							//!< type of original message, from first fragment
+	uint16_t length;						//!< total length, known once the last fragment arrived
+	uint8_t count;							//!< number of fragments
+	bool requestAck;						//!< end-to-end ACK requested, carried by the last fragment
+	uint16_t received;						//!< bitmap of received fragments
+	uint32_t started;						//!< timepoint of first fragment, for timeout
+	uint8_t data[MY_TRANSPORT_FRAGMENT_MAX_SIZE];	//!< payload
+} transportReassemblyBuffer;
+
+// Fragment payload: transfer id, index << 4 | (count - 1), first fragment also carries the original type
+#define FRAGMENT_HEADER_SIZE		2			//!< header of every fragment
+#define FRAGMENT_FIRST_HEADER_SIZE	3			//!< header of first fragment
+#define FRAGMENT_MAX_COUNT			16			//!< fragments per payload
+#define FRAGMENT_OFFSET(index)		((index) ? (uint16_t)(MAX_PAYLOAD - FRAGMENT_FIRST_HEADER_SIZE) + ((index) - 1) * (uint16_t)(MAX_PAYLOAD - FRAGMENT_HEADER_SIZE) : 0)	//!< payload offset of fragment
+#define FRAGMENT_MAX_SIZE			((MAX_PAYLOAD - FRAGMENT_FIRST_HEADER_SIZE) + (FRAGMENT_MAX_COUNT - 1) * (MAX_PAYLOAD - FRAGMENT_HEADER_SIZE))	//!< largest payload in FRAGMENT_MAX_COUNT fragments
+
+
+/**
+* @brief Per neighbour transmit power, used by the radio HAL if MY_TRANSPORT_ATC is set
+*/
+typedef struct {
+	uint8_t node;							//!< neighbour node ID
+	uint8_t level;							//!< transmit power level, meaning depends on the radio
+	uint8_t goodCount;						//!< consecutive good transmissions since last level change
+} transportATCEntry;
+
+// trace events (MY_TRANSPORT_TRACE)
+#define TRACE_RX				1			//!< frame received
+#define TRACE_RELAY				2			//!< frame relayed straight from driver buffer
+#define TRACE_TX				3			//!< frame sent
+#define TRACE_TX_ASYNC			4			//!< asynchronous transmission started
+#define TRACE_TX_DONE			5			//!< asynchronous transmission completed
+#define TRACE_PVER				6			//!< protocol version mismatch
+#define TRACE_SIGN_FAIL			7			//!< signing failed
+#define TRACE_VERIFY_FAIL		8			//!< signature verification failed
+#define TRACE_DUP				9			//!< duplicate dropped
+
+// trace status
+#define TRACE_ST_OK				0			//!< ACKed or accepted
+#define TRACE_ST_NACK			1			//!< not ACKed or rejected
+#define TRACE_ST_BC				2			//!< broadcast, no ACK
+
+/**
+* @brief Trace ring entry, used if MY_TRANSPORT_TRACE is set
+*/
+typedef struct {
+	uint16_t time;							//!< lower 16 bits of hwMillis()
+	uint8_t event;							//!< TRACE_*
+	uint8_t peer;							//!< last (RX) or next hop (TX)
+	uint8_t sender;							//!< origin of message
+	uint8_t destination;					//!< destination of message
+	uint8_t type;							//!< message type
+	uint8_t status;							//!< command | TRACE_ST_* << 4
+} __attribute__((packed)) transportTraceEntry;
+
+#if defined(MY_TRANSPORT_TRACE)
+	#define TRANSPORT_TRACE(__event, __peer, __message, __status) transportTrace(__event, __peer, __message, __status)	//!< record trace entry
+#else
+	#define TRANSPORT_TRACE(__event, __peer, __message, __status)
+#endif
+
+#define LINK_QUALITY_SEARCH_INTERVAL ((uint32_t)60000)	//!< minimum interval between background parent searches
+
+/**
+* @brief Uplink quality metrics, used if MY_TRANSPORT_LINK_QUALITY is set
+*/
+typedef struct {
+	uint32_t lastSearch;					//!< start of last background parent search
+	int16_t rssi;							//!< EWMA of the RSSI of frames received from parent
+	uint8_t ackRatio;						//!< EWMA of ACKed uplink transmissions, 255 = all ACKed
+	bool searching;							//!< background parent search active
+	uint8_t candidate;						//!< best parent candidate of background search, AUTO if none
+	uint8_t candidateDistance;				//!< distance to GW via candidate
+	uint8_t candidateScore;					//!< score of candidate, lower is better
+} transportLinkQuality;
+
+
 // PRIVATE functions
 
 /**
@@ -269,11 +447,114 @@ void transportProcessFIFO();
 */
 void transportProcessMessage();
 /**
+* @brief Relay message not addressed to this node, update routing table and hop counter
+* @param message
+*/
+void transportRelayMessage(MyMessage &message);
+/**
+* @brief Relay the received frame as is (MY_TRANSPORT_CUT_THROUGH): routing table and last hop are updated, the frame is neither re-signed nor formatted
+* @param frame received frame, last is modified
+* @param length frame length as received
+*/
+void transportForwardFrame(MyMessage &frame, uint8_t length);
+/**
+* @brief Remember a find parent request, answered by transportProcessFindParentRequests() (MY_TRANSPORT_FPAR_STORM_CONTROL)
+* @param requester node ID
+*/
+void transportQueueFindParentRequest(uint8_t requester);
+/**
+* @brief Answer the find parent requests of the current window with one uplink check, MY_TRANSPORT_FPAR_JITTER_MS after the first one
+*/
+void transportProcessFindParentRequests();
+/**
 * @brief Assign node ID
 * @param newNodeId New node ID
 * @return true if node ID valid and successfully assigned
 */
 bool transportAssignNodeID(uint8_t newNodeId);
+#if defined(MY_TRANSPORT_PARENT_SCORING)
+/**
+* @brief Score a find parent response, based on hops, RSSI of the response and failure history
+* @param parent Node ID of candidate
+* @param distance Distance to GW via candidate
+* @return score, lower is better
+*/
+uint8_t transportParentScore(uint8_t parent, uint8_t distance);
+#endif
+#if defined(MY_TRANSPORT_TRACE)
+/**
+* @brief Record a trace entry, the oldest entry is overwritten when the ring is full
+* @param event TRACE_*
+* @param peer last (RX) or next hop (TX)
+* @param message header fields are recorded
+* @param status TRACE_ST_*
+*/
+void transportTrace(uint8_t event, uint8_t peer, const MyMessage &message, uint8_t status);
+/**
+* @brief Record a trace entry from header fields
+* @param event TRACE_*
+* @param peer last (RX) or next hop (TX)
+* @param sender origin of message
+* @param destination destination of message
+* @param command message command
+* @param type message type
+* @param status TRACE_ST_*
+*/
+void transportTraceRecord(uint8_t event, uint8_t peer, uint8_t sender, uint8_t destination, uint8_t command, uint8_t type, uint8_t status);
+/**
+* @brief Print one unprinted trace entry (MY_DEBUG), called when idle
+*/
+void transportTracePrint();
+/**
+* @brief Send all trace entries to the controller as I_DEBUG payloads (3 entries per message)
+*/
+void transportTraceSend();
+#endif
+#if defined(MY_STATS_FEATURE) && defined(MY_SIGNING_FEATURE)
+/**
+* @brief signerSignMsg() with time accounted in NodeStats
+* @param message to sign
+* @return true if signed or signing not required
+*/
+bool transportSignMsg(MyMessage &message);
+/**
+* @brief signerVerifyMsg() with time accounted in NodeStats
+* @param message to verify
+* @return true if verified or verification not required
+*/
+bool transportVerifyMsg(MyMessage &message);
+#else
+	#define transportSignMsg(__message) signerSignMsg(__message)		//!< no time accounting
+	#define transportVerifyMsg(__message) signerVerifyMsg(__message)	//!< no time accounting
+#endif
+#if defined(MY_TRANSPORT_LINK_QUALITY)
+/**
+* @brief Reset uplink metrics, e.g. after parent change
+*/
+void transportLinkQualityReset();
+/**
+* @brief Update uplink metrics with result of a transmission to the parent
+* @param ok true if ACKed
+*/
+void transportLinkQualityTx(bool ok);
+/**
+* @brief Consider a find parent response received during a background search
+* @param sender Node ID of candidate
+* @param distance Distance of candidate to GW
+*/
+void transportLinkQualityCandidate(uint8_t sender, uint8_t distance);
+/**
+* @brief Start a background parent search if the uplink degraded, switch parent when the search ends
+*/
+void transportLinkQualityUpdate();
+#endif
+#if defined(MY_WARM_BOOT)
+/**
+* @brief Restore parent and distance from the warm boot record, first transport initialization only
+* @return true if restored
+*/
+bool transportWarmBoot();
+#endif
 /**
 * @brief Wait and process messages for a defined amount of time until specified message received
 * @param ms Time to wait and process incoming messages in ms
@@ -311,6 +592,174 @@ bool transportSendRoute(MyMessage &message);
 */
 bool transportSendWrite(uint8_t to, MyMessage &message);
 /**
+* @brief Resolve next hop for message according to destination
+* @param message
+* @return next hop
+*/
+uint8_t transportGetRoute(MyMessage &message);
+/**
+* @brief Update failed uplink counter and indication after transmission
+* @param route Next hop the message was sent to
+* @param ok Transmission result
+*/
+void transportUpdateTxCounter(uint8_t route, bool ok);
+/**
+* @brief Route message according to destination and start asynchronous transmission
+*
+* Returns as soon as the frame is handed to the radio, the result is evaluated in transportProcess()
+*
+* @param message
+* @return true if transmission started
+*/
+bool transportRouteMessageAsync(MyMessage &message);
+/**
+* @brief Start asynchronous transmission to recipient, waits for previous asynchronous transmission to complete
+* @param to Recipient of message
+* @param message
+* @return true if transmission started
+*/
+bool transportSendWriteAsync(uint8_t to, MyMessage &message);
+/**
+* @brief Length of the frame sent for a message
+* @param message
+* @return header and payload, the whole frame if signed, plus the sequence number if #MY_TRANSPORT_DEDUP_SIZE is defined
+*/
+uint8_t transportFrameLength(const MyMessage &message);
+#if defined(MY_TRANSPORT_DEDUP_SIZE)
+/**
+* @brief Check if the frame of a message carries the sequence number of its sender after the payload
+*
+* Internal and signed messages carry none, handshakes legitimately repeat and signatures are unique
+*
+* @param message
+* @return true if payload leaves room for the sequence number
+*/
+bool transportHasSequence(const MyMessage &message);
+/**
+* @brief Hash of a message for the duplicate cache
+* @param message
+* @return hash of header (without last hop), payload and sequence number
+*/
+uint16_t transportDedupHash(const MyMessage &message);
+/**
+* @brief Check if message was received before
+*
+* Only frames carrying a sequence number are checked, identical values sent twice are not duplicates
+*
+* @param message
+* @param length received frame length
+* @return true if the same message with the same sequence number was recorded within MY_TRANSPORT_DEDUP_WINDOW_MS
+*/
+bool transportIsDuplicate(const MyMessage &message, const uint8_t length);
+/**
+* @brief Add a message to the duplicate cache
+* @param sender
+* @param hash see transportDedupHash()
+*/
+void transportDedupStore(const uint8_t sender, const uint16_t hash);
+/**
+* @brief Record a message delivered here or successfully forwarded, failed relays are not recorded and the retry of the sender gets through
+* @param message
+*/
+void transportDedupRecord(const MyMessage &message);
+#endif
+#if defined(MY_TRANSPORT_MAILBOX_SIZE)
+/**
+* @brief Store message for a direct child that did not receive it
+*
+* Stored messages are sent when the child transmits again, or dropped after MY_TRANSPORT_MAILBOX_TTL_MS
+*
+* @param message
+* @return true if stored, false if mailbox full
+*/
+bool transportMailboxStore(MyMessage &message);
+/**
+* @brief Deliver stored messages to the child that transmitted last
+*/
+void transportMailboxDeliver();
+#endif
+/**
+* @brief Hand over the values of an I_BATCH message addressed to this node as individual C_SET messages
+* @param message I_BATCH message
+*/
+void transportProcessBatch(MyMessage &message);
+#if defined(MY_TRANSPORT_FRAGMENTATION)
+/**
+* @brief Store fragment and hand over the payload to receiveFragmented() once complete
+*
+* The ACK requested by the last fragment is only sent when the payload is complete.
+* A gateway also hands the payload over to the controller, in C_SET messages of up to MAX_PAYLOAD bytes.
+*
+* @param message I_FRAGMENT addressed to this node
+*/
+void transportProcessFragment(MyMessage &message);
+#endif
+#if defined(MY_TRANSPORT_FW_CACHE_SIZE)
+/**
+* @brief Cache forwarded OTA firmware blocks and answer block requests from the cache
+* @param message Message to be forwarded
+* @return true if message was a block request answered locally, no forwarding required
+*/
+bool transportFWCacheProcess(MyMessage &message);
+#endif
+#if defined(MY_RF24_ACK_PAYLOAD)
+/**
+* @brief Stage message for a direct child as ACK payload of the child's next uplink frame
+* @param to Recipient (direct child)
+* @param message
+* @return true if staged
+*/
+bool transportStageAckPayload(uint8_t to, MyMessage &message);
+#endif
+/**
+* @brief Poll radio driver and evaluate completed asynchronous transmission
+*/
+void transportUpdateAsyncSend();
+/**
+* @brief Block until asynchronous transmission in flight is completed
+*/
+void transportWaitAsyncSend();
+/**
+* @brief Select next queued message to send
+*
+* Messages to the last used next hop are preferred, order of messages to the same destination is kept
+*
+* @return queue index or TX_QUEUE_NONE if no message is due
+*/
+uint8_t transportTxQueueSelect();
+/**
+* @brief Remove sent message from TX queue or schedule retry
+* @param index queue index
+* @param ok Transmission result
+*/
+void transportTxQueueResult(uint8_t index, bool ok);
+/**
+* @brief Send due messages from TX queue
+*/
+void transportProcessTxQueue();
+/**
+* @brief Load routing table from EEPROM to RAM
+*/
+void transportLoadRoutingTable();
+/**
+* @brief Binary search in sparse routing table
+* @param node Node ID
+* @return index of node or insert position if not found
+*/
+uint8_t transportFindRoutingTableEntry(uint8_t node);
+/**
+* @brief Get route to node from routing table
+* @param node Node ID
+* @return next hop or BROADCAST_ADDRESS if route unknown
+*/
+uint8_t transportGetRoutingTable(uint8_t node);
+/**
+* @brief Update route to node in routing table
+* @param node Node ID
+* @param route next hop
+*/
+void transportSetRoutingTable(uint8_t node, uint8_t route);
+/**
 * @brief Check uplink to GW, includes flooding control
 * @param force to override flood control timer
 * @return true if uplink ok
@@ -338,10 +787,33 @@ bool isTransportReady();
 */
 bool isTransportSearchingParent();
 /**
+* @brief Queue message for transmission, the message is routed and sent from transportProcess()
+* @param message
+* @return true if message queued and false if queue full or transport !OK
+*/
+bool transportQueueMessage(MyMessage &message);
+#if defined(MY_MESSAGE_POOL_SIZE)
+/**
+* @brief Queue a pool message for transmission, the queue takes over the handle
+* @param handle
+* @return true if queued, the caller keeps the handle if queue full or transport !OK
+*/
+bool transportQueueHandle(msgPoolHandle handle);
+#endif
+/**
+* @brief Status of last asynchronous transmission
+* @return TRANSPORT_TX_IDLE, TRANSPORT_TX_PENDING, TRANSPORT_TX_OK or TRANSPORT_TX_FAIL
+*/
+uint8_t transportGetAsyncSendStatus();
+/**
 * @brief Clear routing table
 */
 void transportClearRoutingTable();
 /**
+* @brief Write changed routes back to EEPROM, no-op without MY_RAM_ROUTING_TABLE_FEATURE
+*/
+void transportSaveRoutingTable();
+/**
 * @brief Return heart beat, i.e. ms in current state
 */
 uint32_t transportGetHeartbeat();
@@ -370,6 +842,31 @@ uint8_t transportGetAddress();
 */
 bool transportSend(uint8_t to, const void* data, uint8_t len);
 /**
+* @brief Start transmission and return immediately
+*
+* Drivers without asynchronous TX complete the transmission before returning
+*
+* @param to recipient
+* @param data message to be sent
+* @param len length of message (header + payload)
+* @return true if transmission started
+*/
+bool transportSendAsync(uint8_t to, const void* data, uint8_t len);
+/**
+* @brief Poll status of transmission started with transportSendAsync()
+* @return TRANSPORT_TX_PENDING while in flight, TRANSPORT_TX_OK or TRANSPORT_TX_FAIL when completed
+*/
+uint8_t transportSendAsyncStatus();
+#if defined(MY_RS485_MULTI_MESSAGE)
+/**
+* @brief Check if a message can join the frame started with transportSendAsync() that is still waiting for the bus
+* @param to recipient
+* @param len length of message (header + payload)
+* @return true if transportSendAsync() appends it to that frame
+*/
+bool transportSendAsyncJoinable(uint8_t to, uint8_t len);
+#endif
+/**
 * @brief Verify if RX FIFO has pending messages
 * @return true if message available in RX FIFO
 */
@@ -385,9 +882,66 @@ bool transportSanityCheck();
 */
 uint8_t transportReceive(void* data); 
 /**
+* @brief Receive message from FIFO without copying
+* @param data set to frame in driver buffer, valid until next receive, NULL if driver does not buffer frames
+* @return length of recevied message (header + payload)
+*/
+uint8_t transportReceiveBuffer(void** data);
+/**
 * @brief Power down transport HW
 */
 void transportPowerDown();
+#if defined(MY_RF24_ACK_PAYLOAD)
+/**
+* @brief Stage frame as ACK payload for a direct child
+*
+* The frame is returned with the ACK of the next frame received from the child
+*
+* @param to Recipient (direct child)
+* @param data frame (header + payload)
+* @param len frame length
+* @return true if staged, false if another frame is still staged
+*/
+bool transportSetAckPayload(uint8_t to, const void* data, uint8_t len);
+#endif
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+/**
+* @brief Signal strength of the last received frame
+* @return RSSI in dBm, coarse on NRF24 (received power detector), 0 on wired transports
+*/
+int16_t transportGetReceivingRSSI();
+#endif
+#if defined(MY_RADIO_LOOPBACK)
+/**
+* @brief Queue frame for reception (loopback transport)
+* @param data frame (header + payload)
+* @param len frame length
+* @return false if the RX buffer is full
+*/
+bool transportLoopbackInject(const void* data, uint8_t len);
+/**
+* @brief Set the handler receiving all sent frames (loopback transport)
+* @param handler called with recipient and frame, returns the ACK status. NULL ACKs and drops all frames
+*/
+void transportLoopbackSetHandler(bool (*handler)(uint8_t to, const void* data, uint8_t len));
+/**
+* @brief Set the callback polled for incoming frames (loopback transport)
+* @param poll called from transportAvailable() with idle set if no frame is buffered, injects frames arriving from outside the process
+*/
+void transportLoopbackSetPoll(void (*poll)(bool idle));
+#endif
+#if defined(MY_TRANSPORT_ATC)
+/**
+* @brief Get transmit power entry of a neighbour, called by the radio HAL
+*
+* Unknown neighbours replace the oldest entry and start at maxLevel
+*
+* @param node neighbour node ID
+* @param maxLevel radio specific initial transmit power level
+* @return entry, valid until the next call
+*/
+transportATCEntry* transportGetATCEntry(uint8_t node, uint8_t maxLevel);
+#endif
 
 
 #endif // MyTransport_h
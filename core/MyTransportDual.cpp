@@ -0,0 +1,182 @@
+/**
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "MyConfig.h"
+#include "MyTransport.h"
+#include <stdint.h>
+
+// two forward link drivers (MY_RADIO_DUAL): the HALs are compiled into the namespaces MyTransportPrimary
+// (NRF24, or RFM69 next to RS485) and MyTransportSecondary (RFM69 or RS485), the transport interface
+// below dispatches to them. Each neighbour (next hop) is served on the interface it was last heard on.
+
+#define DUAL_RADIO_PRIMARY	(0)
+#define DUAL_RADIO_SECONDARY	(1)
+#define DUAL_RADIO_BOTH		(2)		// broadcast or unknown neighbour, sent on both interfaces
+
+static uint8_t _dualRadioKnown[32];		// bitmap of neighbours heard on either interface
+static uint8_t _dualRadioSecondary[32];	// bitmap of neighbours last heard on the secondary interface
+static uint8_t _dualRadioPending = 0;	// bit per interface with frames available
+static uint8_t _dualRadioRx = DUAL_RADIO_PRIMARY;		// interface of the last received frame
+static bool _dualRadioSelected = false;	// transportReceive() reads from _dualRadioRx
+static uint8_t _dualRadioTx = DUAL_RADIO_PRIMARY;		// interface of the transmission in flight
+static uint8_t _txStatus = TRANSPORT_TX_IDLE;
+
+static uint8_t transportDualRadioLink(uint8_t node) {
+	const uint8_t mask = 1 << (node & 7);
+	if (node == BROADCAST_ADDRESS || !(_dualRadioKnown[node >> 3] & mask)) return DUAL_RADIO_BOTH;
+	return _dualRadioSecondary[node >> 3] & mask ? DUAL_RADIO_SECONDARY : DUAL_RADIO_PRIMARY;
+}
+
+static void transportDualRadioSetLink(uint8_t node, uint8_t radio) {
+	const uint8_t mask = 1 << (node & 7);
+	_dualRadioKnown[node >> 3] |= mask;
+	if (radio == DUAL_RADIO_SECONDARY) {
+		_dualRadioSecondary[node >> 3] |= mask;
+	}
+	else {
+		_dualRadioSecondary[node >> 3] &= ~mask;
+	}
+}
+
+// alternate between the interfaces while both have frames pending
+static uint8_t transportDualRadioSelect() {
+	if (!_dualRadioPending) (void)transportAvailable();
+	const uint8_t other = _dualRadioRx ^ 1;
+	if (_dualRadioPending & (1 << other)) _dualRadioRx = other;
+	_dualRadioPending &= ~(1 << _dualRadioRx);
+	return _dualRadioRx;
+}
+
+bool transportInit() {
+	const bool primary = MyTransportPrimary::transportInit();
+	const bool secondary = MyTransportSecondary::transportInit();
+	return primary && secondary;
+}
+
+void transportSetAddress(uint8_t address) {
+	MyTransportPrimary::transportSetAddress(address);
+	MyTransportSecondary::transportSetAddress(address);
+}
+
+uint8_t transportGetAddress() {
+	return MyTransportPrimary::transportGetAddress();
+}
+
+bool transportSend(uint8_t to, const void* data, uint8_t len) {
+	const uint8_t radio = transportDualRadioLink(to);
+	if (radio == DUAL_RADIO_PRIMARY) return MyTransportPrimary::transportSend(to, data, len);
+	if (radio == DUAL_RADIO_SECONDARY) return MyTransportSecondary::transportSend(to, data, len);
+	if (to == BROADCAST_ADDRESS) {
+		const bool primary = MyTransportPrimary::transportSend(to, data, len);
+		const bool secondary = MyTransportSecondary::transportSend(to, data, len);
+		return primary || secondary;
+	}
+	// unknown neighbour (e.g. after a restart), the interface ACKing the frame serves it from now on.
+	// The primary is a radio with ACKs, RS485 reports success without a receiver and is tried last:
+	// a neighbour on the wire is only tagged once a frame from it was received, see transportReceive()
+	if (MyTransportPrimary::transportSend(to, data, len)) {
+		transportDualRadioSetLink(to, DUAL_RADIO_PRIMARY);
+		return true;
+	}
+	if (MyTransportSecondary::transportSend(to, data, len)) {
+		#if !defined(MY_RS485)
+			transportDualRadioSetLink(to, DUAL_RADIO_SECONDARY);
+		#endif
+		return true;
+	}
+	return false;
+}
+
+bool transportSendAsync(uint8_t to, const void* data, uint8_t len) {
+	_dualRadioTx = transportDualRadioLink(to);
+	if (_dualRadioTx == DUAL_RADIO_PRIMARY) return MyTransportPrimary::transportSendAsync(to, data, len);
+	if (_dualRadioTx == DUAL_RADIO_SECONDARY) return MyTransportSecondary::transportSendAsync(to, data, len);
+	// sent on both interfaces, completed when returning
+	_txStatus = transportSend(to, data, len) ? TRANSPORT_TX_OK : TRANSPORT_TX_FAIL;
+	return true;
+}
+
+#if defined(MY_RS485_MULTI_MESSAGE)
+bool transportSendAsyncJoinable(uint8_t to, uint8_t len) {
+	// the held frame was started for the same neighbour on the wire
+	return _dualRadioTx == DUAL_RADIO_SECONDARY && transportDualRadioLink(to) == DUAL_RADIO_SECONDARY &&
+		MyTransportSecondary::transportSendAsyncJoinable(to, len);
+}
+#endif
+
+uint8_t transportSendAsyncStatus() {
+	if (_dualRadioTx == DUAL_RADIO_PRIMARY) return MyTransportPrimary::transportSendAsyncStatus();
+	if (_dualRadioTx == DUAL_RADIO_SECONDARY) return MyTransportSecondary::transportSendAsyncStatus();
+	return _txStatus;
+}
+
+bool transportAvailable() {
+	// both are polled, the RFM69 and RS485 HALs move frames out of the driver when polled
+	_dualRadioPending = 0;
+	if (MyTransportPrimary::transportAvailable()) _dualRadioPending |= 1 << DUAL_RADIO_PRIMARY;
+	if (MyTransportSecondary::transportAvailable()) _dualRadioPending |= 1 << DUAL_RADIO_SECONDARY;
+	return _dualRadioPending;
+}
+
+bool transportSanityCheck() {
+	const bool primary = MyTransportPrimary::transportSanityCheck();
+	const bool secondary = MyTransportSecondary::transportSanityCheck();
+	return primary && secondary;
+}
+
+uint8_t transportReceiveBuffer(void** data) {
+	*data = NULL;
+	uint8_t len = 0;
+	if (transportDualRadioSelect() == DUAL_RADIO_PRIMARY) len = MyTransportPrimary::transportReceiveBuffer(data);
+	if (*data) {
+		transportDualRadioSetLink(((const uint8_t*)*data)[0], DUAL_RADIO_PRIMARY);
+	}
+	else {
+		// read with transportReceive() from the selected interface
+		_dualRadioSelected = true;
+	}
+	return len;
+}
+
+uint8_t transportReceive(void* data) {
+	const uint8_t radio = _dualRadioSelected ? _dualRadioRx : transportDualRadioSelect();
+	_dualRadioSelected = false;
+	const uint8_t len = radio == DUAL_RADIO_SECONDARY ? MyTransportSecondary::transportReceive(data) : MyTransportPrimary::transportReceive(data);
+	// data[0] is the last hop
+	if (len) transportDualRadioSetLink(((const uint8_t*)data)[0], radio);
+	return len;
+}
+
+void transportPowerDown() {
+	MyTransportPrimary::transportPowerDown();
+	MyTransportSecondary::transportPowerDown();
+}
+
+#if defined(MY_RF24_ACK_PAYLOAD)
+bool transportSetAckPayload(uint8_t to, const void* data, uint8_t len) {
+	// only children on the NRF24 (primary) collect ACK payloads
+	return transportDualRadioLink(to) == DUAL_RADIO_PRIMARY && MyTransportPrimary::transportSetAckPayload(to, data, len);
+}
+#endif
+
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+int16_t transportGetReceivingRSSI() {
+	return _dualRadioRx == DUAL_RADIO_SECONDARY ? MyTransportSecondary::transportGetReceivingRSSI() : MyTransportPrimary::transportGetReceivingRSSI();
+}
+#endif
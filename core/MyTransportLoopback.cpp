@@ -0,0 +1,115 @@
+/**
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "MyConfig.h"
+#include "MyTransport.h"
+#include <stdint.h>
+
+// in-process transport for host builds: frames are injected with transportLoopbackInject()
+// (directly or from the poll callback) and sent frames are handed to the handler set by
+// transportLoopbackSetHandler()
+
+static MyRingBuffer<transportRxFrame, MY_LOOPBACK_RX_BUFFER_SIZE> _rxBuffer;
+static uint8_t _address;
+static uint8_t _txStatus = TRANSPORT_TX_IDLE;
+static bool (*_txHandler)(uint8_t to, const void* data, uint8_t len) = NULL;
+static void (*_rxPoll)(bool idle) = NULL;
+
+bool transportLoopbackInject(const void* data, uint8_t len) {
+	transportRxFrame *frame = _rxBuffer.back();
+	if (len > MAX_MESSAGE_LENGTH || !frame) {
+		STATS_INC(rxDropped);
+		return false;
+	}
+	memcpy(frame->data, data, len);
+	frame->len = len;
+	_rxBuffer.push();
+	return true;
+}
+
+void transportLoopbackSetHandler(bool (*handler)(uint8_t to, const void* data, uint8_t len)) {
+	_txHandler = handler;
+}
+
+void transportLoopbackSetPoll(void (*poll)(bool idle)) {
+	_rxPoll = poll;
+}
+
+bool transportInit() {
+	_rxBuffer.clear();
+	return true;
+}
+
+void transportSetAddress(uint8_t address) {
+	_address = address;
+}
+
+uint8_t transportGetAddress() {
+	return _address;
+}
+
+bool transportSend(uint8_t to, const void* data, uint8_t len) {
+	// without handler every frame is ACKed and dropped
+	return _txHandler ? _txHandler(to, data, len) : true;
+}
+
+bool transportSendAsync(uint8_t to, const void* data, uint8_t len) {
+	// handler is called synchronously, transmission is completed when returning
+	_txStatus = transportSend(to, data, len) ? TRANSPORT_TX_OK : TRANSPORT_TX_FAIL;
+	return true;
+}
+
+uint8_t transportSendAsyncStatus() {
+	return _txStatus;
+}
+
+bool transportAvailable() {
+	if (_rxPoll) _rxPoll(_rxBuffer.empty());
+	return !_rxBuffer.empty();
+}
+
+bool transportSanityCheck() {
+	return true;
+}
+
+uint8_t transportReceiveBuffer(void** data) {
+	// the handler may inject frames while one is processed, use transportReceive()
+	*data = NULL;
+	return 0;
+}
+
+uint8_t transportReceive(void* data) {
+	transportRxFrame *frame = _rxBuffer.front();
+	if (!frame) return 0;
+	const uint8_t len = frame->len;
+	memcpy(data, frame->data, len);
+	_rxBuffer.pop();
+	return len;
+}
+
+void transportPowerDown() {
+	// nothing to power down
+}
+
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+int16_t transportGetReceivingRSSI() {
+	// no radio, every link is good
+	return 0;
+}
+#endif
@@ -29,8 +29,98 @@
 	AES _aes;
 	uint8_t _dataenc[32] = {0};
 	uint8_t _psk[16];
+	// frames up to RF24_CTR_MAX_LENGTH are CTR encrypted with a nonce appended,
+	// longer ones are padded to 32 bytes and CBC encrypted
+	#define RF24_CTR_NONCE_SIZE (4)
+	#define RF24_CTR_MAX_LENGTH (MAX_MESSAGE_LENGTH - RF24_CTR_NONCE_SIZE - 1)
+	static uint32_t _frameCounter;	// upper 16 bits are the epoch stored in EEPROM
+	// erased or cleared EEPROM, or epochs used up: nonces could repeat with the current key, no frames are
+	// encrypted until SecurityPersonalizer stored a new key and epoch 0
+	#define RF24_EPOCH_UNKNOWN (0xFFFF)
+
+	// a new epoch is stored at every boot and when the lower 16 bits wrap, a restarted node does not reuse nonces
+	static void transportStoreEpoch() {
+		uint16_t epoch = _frameCounter >> 16;
+		hwWriteConfigBlock((void*)&epoch, (void*)EEPROM_RF_ENCRYPTION_EPOCH_ADDRESS, sizeof(epoch));
+	}
+
+	static bool transportEpochValid() {
+		return (uint16_t)(_frameCounter >> 16) != RF24_EPOCH_UNKNOWN;
+	}
+#endif
+
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+	static int16_t _rxRSSI = 0;	// RSSI of the frame handed out last
+
+	// RPD only tells if the last frame was received above -64dBm, it is overwritten by the next frame
+	static int16_t transportReadRSSI() {
+		return RF24_getReceivedPowerDetector() ? -60 : -80;
+	}
+#endif
+
+#if defined(MY_RF24_ACK_PAYLOAD)
+	static uint8_t _ackPayload[MAX_MESSAGE_LENGTH];	// staged frame, encrypted if enabled
+	static uint8_t _ackPayloadLen = 0;				// 0 if no frame staged
+	static uint8_t _ackPayloadTo;					// child the frame is staged for
+	static uint32_t _ackPayloadStaged;				// staging timepoint
+	static bool _ackPayloadRestage = false;			// own transmission flushed the TX FIFO
+	static volatile uint8_t _ackPayloadStage = 1;	// incremented per write to the TX FIFO, never 0
+
+	static void transportWriteAckPayload() {
+		if (!_ackPayloadLen) return;
+		RF24_writeAckPayload(_ackPayload, _ackPayloadLen);
+		// after the write: a frame latched in between still sees the old stage
+		if (!++_ackPayloadStage) _ackPayloadStage = 1;
+	}
+
+	// latched when the frame is read from the radio: stage that had left the TX FIFO by then, 0 if none
+	static uint8_t transportAckPayloadLatch() {
+		return RF24_isAckPayloadSent() ? _ackPayloadStage : 0;
+	}
+
+	// the payload goes out with the ACK of the first frame on the node pipe, which is not necessarily from the child.
+	// Frames read before the payload was staged again do not tell anything about the new stage.
+	static void transportCheckAckPayload(const uint8_t* frame, uint8_t stage) {
+		if (!_ackPayloadLen || stage != _ackPayloadStage) return;
+		if (frame[0] == _ackPayloadTo) {
+			// frame[0] is the last hop, i.e. the payload was delivered
+			_ackPayloadLen = 0;
+		}
+		else {
+			transportWriteAckPayload();
+		}
+	}
+#endif
+
+#if defined(MY_RF24_IRQ_PIN)
+	// filled by the ISR, emptied by transportReceiveBuffer()
+	static MyRingBuffer<transportRxFrame, MY_RF24_RX_BUFFER_SIZE> _rxBuffer;
+	static bool _rxBufferHeld = false;			// front frame handed out, released on next receive
+	static volatile uint8_t _rxBufferLost = 0;	// frames discarded due to full buffer
+
+	// called from ISR for each frame in the radio RX FIFO
+	static void transportRxCallback(void) {
+		transportRxFrame *frame = _rxBuffer.back();
+		if (frame) {
+			#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+				frame->rssi = transportReadRSSI();
+			#endif
+			#if defined(MY_RF24_ACK_PAYLOAD)
+				frame->ackPayload = transportAckPayloadLatch();
+			#endif
+			frame->len = RF24_readMessage(frame->data);
+			_rxBuffer.push();
+		}
+		else {
+			// buffer full, discard frame (reading clears RX_DR)
+			(void)RF24_readMessage(NULL);
+			if (_rxBufferLost < 0xFF) _rxBufferLost++;
+			STATS_INC(rxDropped);
+		}
+	}
 #endif
 
+
 bool transportInit() {
 	
 	#if defined(MY_RF24_ENABLE_ENCRYPTION)
@@ -39,8 +129,24 @@ bool transportInit() {
 		_aes.set_key(_psk, 16);
 		// Make sure it is purged from memory when set
 		memset(_psk, 0, 16);
+		uint16_t epoch;
+		hwReadConfigBlock((void*)&epoch, (void*)EEPROM_RF_ENCRYPTION_EPOCH_ADDRESS, sizeof(epoch));
+		if (epoch != RF24_EPOCH_UNKNOWN) {
+			// after epoch 0xFFFE the unknown one is stored, i.e. encryption stops
+			_frameCounter = (uint32_t)(uint16_t)(epoch + 1) << 16;
+			transportStoreEpoch();
+		}
+		else {
+			_frameCounter = (uint32_t)RF24_EPOCH_UNKNOWN << 16;
+		}
+		if (!transportEpochValid()) {
+			RF24_DEBUG(PSTR("!RF24:EPOCH UNKNOWN\n"));	// personalize key and epoch, TX disabled
+		}
 	#endif
 	
+	#if defined(MY_RF24_IRQ_PIN)
+		RF24_registerReceiveCallback(transportRxCallback);
+	#endif
 	return RF24_initialize();
 }
 
@@ -53,25 +159,150 @@ uint8_t transportGetAddress() {
 	return RF24_getNodeID();
 }
 
-bool transportSend(uint8_t recipient, const void* data, uint8_t len) {
-	#if defined(MY_RF24_ENABLE_ENCRYPTION)
+#if defined(MY_RF24_ENABLE_ENCRYPTION)
+	// XOR keystream onto data[1..len-1], data[0] (last, the transmitting node) and the nonce stay in clear
+	static void transportCrypt(uint8_t* data, uint8_t len, const uint8_t* nonce) {
+		uint8_t ctr[N_BLOCK] = {0};
+		ctr[0] = data[0];
+		memcpy(&ctr[1], nonce, RF24_CTR_NONCE_SIZE);
+		_aes.ctr_crypt(&data[1], len - 1, ctr);
+	}
+
+	// encrypt frame into _dataenc, returns frame length on air, 0 if nonces could repeat
+	static uint8_t transportEncrypt(const void* data, uint8_t len) {
+		if (!transportEpochValid()) return 0;
 		// copy input data because it is read-only
 		memcpy(_dataenc,data,len); 
-		// has to be adjusted, WIP!
+		if (len <= RF24_CTR_MAX_LENGTH) {
+			// transmitting node and frame counter make the nonce unique
+			if (!(uint16_t)++_frameCounter) {
+				transportStoreEpoch();
+				if (!transportEpochValid()) return 0;
+			}
+			memcpy(&_dataenc[len], &_frameCounter, RF24_CTR_NONCE_SIZE);
+			transportCrypt(_dataenc, len, &_dataenc[len]);
+			return len + RF24_CTR_NONCE_SIZE;
+		}
+		// no room for a nonce
 		_aes.set_IV(0);
-		len = len > 16 ? 32 : 16;
-		//encrypt data
-		_aes.cbc_encrypt(_dataenc, _dataenc, len/16); 
-		bool status = RF24_sendMessage( recipient, _dataenc, len );
+		_aes.cbc_encrypt(_dataenc, _dataenc, 2);
+		return 32;
+	}
+
+	// decrypt frame in place, returns plaintext length
+	static uint8_t transportDecrypt(uint8_t* data, uint8_t len) {
+		if (len > RF24_CTR_MAX_LENGTH + RF24_CTR_NONCE_SIZE) {
+			_aes.set_IV(0);
+			_aes.cbc_decrypt(data, data, 2);
+			return len;
+		}
+		if (len <= RF24_CTR_NONCE_SIZE) {
+			return 0;
+		}
+		len -= RF24_CTR_NONCE_SIZE;
+		transportCrypt(data, len, &data[len]);
+		return len;
+	}
+#endif
+
+#if defined(MY_TRANSPORT_ATC)
+	static transportATCEntry* _atcLink = NULL;	// neighbour of the transmission in flight
+
+	// select the PA level for the recipient, broadcasts use the configured level
+	static void transportATCBegin(uint8_t recipient) {
+		_atcLink = recipient == BROADCAST_ADDRESS ? NULL : transportGetATCEntry(recipient, MY_RF24_PA_LEVEL);
+		RF24_setPALevel(_atcLink ? _atcLink->level : MY_RF24_PA_LEVEL);
+	}
+
+	// retransmissions indicate a weak link, frames ACKed at the first attempt allow less power.
+	// The configured level is restored, ACK payloads and frames sent outside of ATC use it.
+	static void transportATCEnd(bool ok) {
+		RF24_setPALevel(MY_RF24_PA_LEVEL);
+		if (!_atcLink) return;
+		const uint8_t retransmissions = RF24_getRetransmissions();
+		if (!ok) {
+			_atcLink->level = MY_RF24_PA_LEVEL;
+			_atcLink->goodCount = 0;
+		}
+		else if (retransmissions > 1) {
+			if (_atcLink->level < MY_RF24_PA_LEVEL) _atcLink->level++;
+			_atcLink->goodCount = 0;
+		}
+		else if (retransmissions) {
+			_atcLink->goodCount = 0;
+		}
+		else if (++_atcLink->goodCount >= MY_TRANSPORT_ATC_STEP_DOWN) {
+			if (_atcLink->level > RF24_PA_MIN) _atcLink->level--;
+			_atcLink->goodCount = 0;
+		}
+		_atcLink = NULL;
+	}
+#endif
+
+bool transportSend(uint8_t recipient, const void* data, uint8_t len) {
+	#if defined(MY_TRANSPORT_ATC)
+		transportATCBegin(recipient);
+	#endif
+	#if defined(MY_RF24_ENABLE_ENCRYPTION)
+		len = transportEncrypt(data, len);
+		bool status = len && RF24_sendMessage( recipient, _dataenc, len );
 	#else
 		bool status = RF24_sendMessage( recipient, data, len );
 	#endif
-	
+	#if defined(MY_TRANSPORT_ATC)
+		transportATCEnd(status);
+	#endif
+	STATS_ADD(txRetries, RF24_getRetransmissions());
+	#if defined(MY_RF24_ACK_PAYLOAD)
+		// TX FIFO is flushed when sending
+		transportWriteAckPayload();
+	#endif
 	return status;
 }
 
+bool transportSendAsync(uint8_t recipient, const void* data, uint8_t len) {
+	#if defined(MY_TRANSPORT_ATC)
+		transportATCBegin(recipient);
+	#endif
+	#if defined(MY_RF24_ACK_PAYLOAD)
+		_ackPayloadRestage = true;
+	#endif
+	#if defined(MY_RF24_ENABLE_ENCRYPTION)
+		len = transportEncrypt(data, len);
+		// frame is written to TX FIFO, _dataenc can be reused
+		return len && RF24_sendMessageAsync( recipient, _dataenc, len );
+	#else
+		return RF24_sendMessageAsync( recipient, data, len );
+	#endif
+}
+
+uint8_t transportSendAsyncStatus() {
+	const uint8_t status = RF24_getSendStatus();
+	if (status == RF24_TX_OK || status == RF24_TX_FAIL) STATS_ADD(txRetries, RF24_getRetransmissions());
+	#if defined(MY_TRANSPORT_ATC)
+		if (status == RF24_TX_OK || status == RF24_TX_FAIL) transportATCEnd(status == RF24_TX_OK);
+	#endif
+	#if defined(MY_RF24_ACK_PAYLOAD)
+		if (_ackPayloadRestage && (status == RF24_TX_OK || status == RF24_TX_FAIL)) {
+			_ackPayloadRestage = false;
+			transportWriteAckPayload();
+		}
+	#endif
+	switch (status) {
+		case RF24_TX_PENDING: return TRANSPORT_TX_PENDING;
+		case RF24_TX_OK: return TRANSPORT_TX_OK;
+		case RF24_TX_FAIL: return TRANSPORT_TX_FAIL;
+		default: return TRANSPORT_TX_IDLE;
+	}
+}
+
 bool transportAvailable() {
-	bool avail = RF24_isDataAvailable();
+	#if defined(MY_RF24_IRQ_PIN)
+		// no SPI traffic, frames are read by the ISR
+		bool avail = _rxBuffer.count() > _rxBufferHeld;
+	#else
+		bool avail = RF24_isDataAvailable();
+	#endif
 	return avail;
 }
 
@@ -79,17 +310,99 @@ bool transportSanityCheck() {
 	return RF24_sanityCheck();
 }
 
+uint8_t transportReceiveBuffer(void** data) {
+	#if defined(MY_RF24_IRQ_PIN)
+		if (_rxBufferLost) {
+			RF24_DEBUG(PSTR("RF24:RX buffer full, %d frames lost\n"), _rxBufferLost);
+			_rxBufferLost = 0;
+		}
+		// the frame handed out last time stays valid until now
+		if (_rxBufferHeld) {
+			_rxBuffer.pop();
+			_rxBufferHeld = false;
+		}
+		transportRxFrame *frame = _rxBuffer.front();
+		if (!frame) {
+			*data = NULL;
+			return 0;
+		}
+		transportRxFrame &item = *frame;
+		_rxBufferHeld = true;
+		#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+			_rxRSSI = item.rssi;
+		#endif
+		#if defined(MY_RF24_ENABLE_ENCRYPTION)
+			item.len = transportDecrypt(item.data, item.len);
+		#endif
+		#if defined(MY_RF24_ACK_PAYLOAD)
+			transportCheckAckPayload(item.data, item.ackPayload);
+		#endif
+		*data = item.data;
+		return item.len;
+	#else
+		// frames are read from the radio FIFO, use transportReceive()
+		*data = NULL;
+		return 0;
+	#endif
+}
+
 uint8_t transportReceive(void* data) {
-	uint8_t len = RF24_readMessage(data);
-	#if defined(MY_RF24_ENABLE_ENCRYPTION)
-		// has to be adjusted, WIP!
-		_aes.set_IV(0);
-		// decrypt data
-		_aes.cbc_decrypt((byte*)(data), (byte*)(data), len>16?2:1);
+	#if defined(MY_RF24_IRQ_PIN)
+		void* frame;
+		uint8_t len = transportReceiveBuffer(&frame);
+		if (frame) {
+			memcpy(data, frame, len);
+			// copied, slot can be released right away
+			_rxBuffer.pop();
+			_rxBufferHeld = false;
+		}
+	#else
+		#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+			_rxRSSI = transportReadRSSI();
+		#endif
+		#if defined(MY_RF24_ACK_PAYLOAD)
+			const uint8_t stage = transportAckPayloadLatch();
+		#endif
+		uint8_t len = RF24_readMessage(data);
+		#if defined(MY_RF24_ENABLE_ENCRYPTION)
+			len = transportDecrypt((uint8_t*)data, len);
+		#endif
+		#if defined(MY_RF24_ACK_PAYLOAD)
+			transportCheckAckPayload((const uint8_t*)data, stage);
+		#endif
 	#endif
 	return len;
 }
 
+#if defined(MY_RF24_ACK_PAYLOAD)
+bool transportSetAckPayload(uint8_t to, const void* data, uint8_t len) {
+	// one frame at a time, the radio cannot address ACK payloads to a specific sender
+	if (_ackPayloadLen && hwMillis() - _ackPayloadStaged < MY_RF24_ACK_PAYLOAD_LIFETIME_MS) return false;
+	if (RF24_getSendStatus() == RF24_TX_PENDING) return false;
+	#if defined(MY_RF24_ENABLE_ENCRYPTION)
+		len = transportEncrypt(data, len);
+		if (!len) return false;
+		memcpy(_ackPayload, _dataenc, len);
+	#else
+		memcpy(_ackPayload, data, len);
+	#endif
+	_ackPayloadTo = to;
+	_ackPayloadLen = len;
+	_ackPayloadStaged = hwMillis();
+	// drop an expired payload
+	RF24_flushTX();
+	transportWriteAckPayload();
+	return true;
+}
+#endif
+
 void transportPowerDown() {
 	RF24_powerDown();
 }
+
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+int16_t transportGetReceivingRSSI() {
+	// sampled when the frame was read from the radio
+	return _rxRSSI;
+}
+#endif
@@ -22,13 +22,29 @@
 #include <stdint.h>
 #include "drivers/RFM69/RFM69.h"
 
+#if MAX_MESSAGE_LENGTH > RF69_MAX_DATA_LEN
+	#error MY_RFM69_MAX_MESSAGE_LENGTH exceeds RF69_MAX_DATA_LEN
+#endif
+#if MAX_MESSAGE_LENGTH > 32 && defined(MY_SIGNING_FEATURE)
+	#error Signing requires 32 byte frames, do not set MY_RFM69_MAX_MESSAGE_LENGTH
+#endif
+
 RFM69 _radio(MY_RF69_SPI_CS, MY_RF69_IRQ_PIN, MY_RFM69HW, MY_RF69_IRQ_NUM);
 uint8_t _address;
+uint8_t _txStatus = TRANSPORT_TX_IDLE;
+
+#if defined(MY_RFM69_DEFERRED_IRQ)
+	static MyRingBuffer<transportRxFrame, MY_RFM69_RX_BUFFER_SIZE> _rxBuffer;
+#endif
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+	static int16_t _rxRSSI = 0;	// RSSI of the frame returned by transportReceive(), the driver value is reset by receiveBegin()
+#endif
 
 
 bool transportInit() {
 	// Start up the radio library (_address will be set later by the MySensors library)
 	if (_radio.initialize(MY_RFM69_FREQUENCY, _address, MY_RFM69_NETWORKID)) {
+		_radio.setPowerLevel(MY_RFM69_POWER_LEVEL);
 		#ifdef MY_RFM69_ENABLE_ENCRYPTION
 			uint8_t _psk[16];
 			hwReadConfigBlock((void*)_psk, (void*)EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS, 16);
@@ -49,28 +65,176 @@ uint8_t transportGetAddress() {
 	return _address;
 }
 
+#if defined(MY_TRANSPORT_ATC)
+	#define RFM69_ATC_MAX_LEVEL MY_RFM69_POWER_LEVEL
+	#define RFM69_ATC_HYSTERESIS 6		// dB above target RSSI before stepping down
+	static transportATCEntry* _atcLink = NULL;	// neighbour of the transmission in flight
+
+	// select the power level for the recipient, broadcasts are sent at full power
+	static void transportATCBegin(uint8_t to) {
+		_atcLink = to == BROADCAST_ADDRESS ? NULL : transportGetATCEntry(to, RFM69_ATC_MAX_LEVEL);
+		_radio.setPowerLevel(_atcLink ? _atcLink->level : RFM69_ATC_MAX_LEVEL);
+	}
+
+	// links are assumed to be symmetric, the RSSI of the ACK is still held in the driver.
+	// The configured level is restored, ACKs and frames sent outside of ATC use it.
+	static void transportATCEnd(bool ok) {
+		_radio.setPowerLevel(RFM69_ATC_MAX_LEVEL);
+		if (!_atcLink) return;
+		if (!ok) {
+			_atcLink->level = RFM69_ATC_MAX_LEVEL;
+			_atcLink->goodCount = 0;
+		}
+		else if (_radio.RSSI < MY_RFM69_ATC_TARGET_RSSI) {
+			if (_atcLink->level < RFM69_ATC_MAX_LEVEL) _atcLink->level++;
+			_atcLink->goodCount = 0;
+		}
+		else if (_radio.RSSI < MY_RFM69_ATC_TARGET_RSSI + RFM69_ATC_HYSTERESIS) {
+			_atcLink->goodCount = 0;
+		}
+		else if (++_atcLink->goodCount >= MY_TRANSPORT_ATC_STEP_DOWN) {
+			if (_atcLink->level) _atcLink->level--;
+			_atcLink->goodCount = 0;
+		}
+		_atcLink = NULL;
+	}
+#endif
+
 bool transportSend(uint8_t to, const void* data, uint8_t len) {
-	return _radio.sendWithRetry(to,data,len);
+	#if defined(MY_TRANSPORT_ATC)
+		transportATCBegin(to);
+		const bool ok = _radio.sendWithRetry(to,data,len);
+		transportATCEnd(ok);
+		return ok;
+	#else
+		return _radio.sendWithRetry(to,data,len);
+	#endif
+}
+
+#if defined(MY_TRANSPORT_ASYNC_SEND)
+static uint8_t _txBuffer[MAX_MESSAGE_LENGTH];
+
+uint8_t transportSendAsyncStatus() {
+	const uint8_t status = _radio.updateAsync();
+	#if defined(MY_TRANSPORT_ATC)
+		if (status == RF69_TX_OK || status == RF69_TX_FAIL) transportATCEnd(status == RF69_TX_OK);
+	#endif
+	switch (status) {
+		case RF69_TX_PENDING: return TRANSPORT_TX_PENDING;
+		case RF69_TX_OK: return TRANSPORT_TX_OK;
+		case RF69_TX_FAIL: return TRANSPORT_TX_FAIL;
+		default: return TRANSPORT_TX_IDLE;
+	}
+}
+
+bool transportSendAsync(uint8_t to, const void* data, uint8_t len) {
+	// the driver sends from the buffer while retrying, i.e. it must not be touched while in flight.
+	// The status call also completes ATC of a frame that just finished.
+	if (len > MAX_MESSAGE_LENGTH || transportSendAsyncStatus() == TRANSPORT_TX_PENDING) return false;
+	memcpy(_txBuffer, data, len);
+	#if defined(MY_TRANSPORT_ATC)
+		transportATCBegin(to);
+	#endif
+	return _radio.sendWithRetryAsync(to, _txBuffer, len);
+}
+#else
+bool transportSendAsync(uint8_t to, const void* data, uint8_t len) {
+	// sendWithRetry() blocks, transmission is completed when returning
+	_txStatus = transportSend(to, data, len) ? TRANSPORT_TX_OK : TRANSPORT_TX_FAIL;
+	return true;
+}
+
+uint8_t transportSendAsyncStatus() {
+	return _txStatus;
 }
+#endif
 
+// ACK the frame in the driver buffer, queued to the TX state machine with asynchronous send
+static void transportSendACK() {
+	if (_radio.TARGETID != RF69_BROADCAST_ADDR)
+		_radio.ACKRequested();
+	#if defined(MY_TRANSPORT_ASYNC_SEND)
+		_radio.sendACKAsync();
+	#else
+		_radio.sendACK();
+	#endif
+}
+
+#if defined(MY_RFM69_DEFERRED_IRQ)
 bool transportAvailable() {
+	#if defined(MY_TRANSPORT_ASYNC_SEND)
+		(void)_radio.updateAsync();
+	#endif
+	// receiveDone() switches a sleeping radio to RX
+	ENERGY_RADIO_ON();
+	// bottom half: move frames out of the driver and ACK them, receiveDone() puts the radio back
+	// into RX so the next frame is not lost while the queued ones are processed
+	transportRxFrame *frame;
+	while ((frame = _rxBuffer.back()) && _radio.receiveDone()) {
+		const uint8_t len = _radio.DATALEN < MAX_MESSAGE_LENGTH ? _radio.DATALEN : MAX_MESSAGE_LENGTH;
+		memcpy(frame->data, (const void *)_radio.DATA, len);
+		frame->len = len;
+		#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+			frame->rssi = _radio.RSSI;
+		#endif
+		_rxBuffer.push();
+		transportSendACK();
+	}
+	return !_rxBuffer.empty();
+}
+#else
+bool transportAvailable() {
+	#if defined(MY_TRANSPORT_ASYNC_SEND)
+		(void)_radio.updateAsync();
+	#endif
+	// receiveDone() switches a sleeping radio to RX
+	ENERGY_RADIO_ON();
 	return _radio.receiveDone();
 }
+#endif
 
 bool transportSanityCheck() {
 	// not implemented yet
 	return true;
 }
 
+uint8_t transportReceiveBuffer(void** data) {
+	// driver buffer is reused on ACK/RX, use transportReceive()
+	*data = NULL;
+	return 0;
+}
+
+#if defined(MY_RFM69_DEFERRED_IRQ)
+uint8_t transportReceive(void* data) {
+	transportRxFrame *frame = _rxBuffer.front();
+	if (!frame) return 0;
+	const uint8_t len = frame->len;
+	memcpy(data, frame->data, len);
+	#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+		_rxRSSI = frame->rssi;
+	#endif
+	_rxBuffer.pop();
+	return len;
+}
+#else
 uint8_t transportReceive(void* data) {
 	memcpy(data,(const void *)_radio.DATA, _radio.DATALEN);
+	#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+		_rxRSSI = _radio.RSSI;
+	#endif
 	// Send ack back if this message wasn't a broadcast
-	if (_radio.TARGETID != RF69_BROADCAST_ADDR)
-		_radio.ACKRequested();
-    _radio.sendACK();
+	transportSendACK();
 	return _radio.DATALEN;
-}	
+}
+#endif
 
 void transportPowerDown() {
 	_radio.sleep();
 }
+
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+int16_t transportGetReceivingRSSI() {
+	// sampled by the driver during reception of the frame, latched by transportReceive()
+	return _rxRSSI;
+}
+#endif
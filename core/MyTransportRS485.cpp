@@ -68,19 +68,56 @@
 
 
 #if defined(MY_RS485_DE_PIN)
-	#define assertDE() digitalWrite(MY_RS485_DE_PIN, HIGH); delayMicroseconds(5)
-	#define deassertDE() digitalWrite(MY_RS485_DE_PIN, LOW)
+	#define assertDE() hwDigitalWrite(MY_RS485_DE_PIN, HIGH); delayMicroseconds(5)
+	#define deassertDE() hwDigitalWrite(MY_RS485_DE_PIN, LOW)
 
 #else
 	#define assertDE()
 	#define deassertDE()
 #endif
 
-// We only use SYS_PACK in this application
+// We only use SYS_PACK in this application, plus SYS_POLL in polled mode and
+// SYS_MULTI for frames carrying several length-prefixed messages
 #define	ICSC_SYS_PACK	0x58
+#define	ICSC_SYS_POLL	0x59
+#define	ICSC_SYS_MULTI	0x5A
 
-// Receiving header information
+#if MY_RS485_MAX_MESSAGE_LENGTH > 255
+	#error MY_RS485_MAX_MESSAGE_LENGTH must fit the length byte of the frame
+#endif
+
+#if defined(MY_RS485_CRC16)
+// crc16 (modbus), nibble table
+typedef uint16_t rs485Checksum;
+#define RS485_CS_INIT 0xFFFF
+static const uint16_t _rs485CrcTable[16] PROGMEM = {
+	0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+	0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+inline rs485Checksum _serialChecksum(rs485Checksum cs, uint8_t data) {
+	cs ^= data;
+	cs = (cs >> 4) ^ pgm_read_word(&_rs485CrcTable[cs & 0x0F]);
+	return (cs >> 4) ^ pgm_read_word(&_rs485CrcTable[cs & 0x0F]);
+}
+#else
+// 8 bit sum
+typedef unsigned char rs485Checksum;
+#define RS485_CS_INIT 0
+inline rs485Checksum _serialChecksum(rs485Checksum cs, uint8_t data) {
+	return cs + data;
+}
+#endif
+
+#if defined(MY_RS485_POLLED) && defined(MY_GATEWAY_FEATURE)
+	// the gateway is bus master and hands out transmit slots
+	#define RS485_POLL_MASTER
+#endif
+
+// Receiving header information, ring of the last 6 bytes seen while hunting
+// for a header. _headerPos always points to the oldest byte.
 char _header[6];
+unsigned char _headerPos;
+#define _headerByte(i) _header[(_headerPos + (i)) % 6]
 
 // Reception state machine control and storage variables
 unsigned char _recPhase;
@@ -89,17 +126,62 @@ unsigned char _recCommand;
 unsigned char _recLen;
 unsigned char _recStation;
 unsigned char _recSender;
-unsigned char _recCS;
-unsigned char _recCalcCS;
+rs485Checksum _recCS;
+rs485Checksum _recCalcCS;
+uint32_t _recLastActivity;
 
 AltSoftSerial _dev;
 
 
 unsigned char _nodeId;
-char _data[MY_RS485_MAX_MESSAGE_LENGTH];
-uint8_t _packet_len;
-unsigned char _packet_from;
-bool _packet_received;
+
+// Complete frames waiting for transportReceive()
+typedef struct {
+	unsigned char from;
+	uint8_t len;
+	#if defined(MY_RS485_MULTI_MESSAGE)
+		bool multi;		// data holds [len][message] entries
+		uint8_t pos;	// next entry to hand out
+	#endif
+	char data[MY_RS485_MAX_MESSAGE_LENGTH];
+} rs485Frame;
+MyRingBuffer<rs485Frame, MY_RS485_RX_BUFFER_SIZE> _rxQueue;
+// slot the frame being received is written to, free while receiving
+#define _rxQueueSlot() (*_rxQueue.back())
+
+// Outgoing frame, held until the bus is idle and then handed to the UART
+char _txData[MY_RS485_MAX_MESSAGE_LENGTH];
+uint8_t _txLen;
+uint8_t _txTo;
+volatile bool _txQueued;
+#if defined(MY_RS485_MULTI_MESSAGE)
+uint8_t _txCount;
+#endif
+uint8_t _txRetries;
+uint32_t _txNextAttempt;
+volatile uint8_t _txStatus = TRANSPORT_TX_IDLE;
+volatile bool _txActive;
+volatile bool _txOwnFrame;
+
+#if defined(RS485_POLL_MASTER)
+// Nodes seen on the bus, polled every cycle
+uint8_t _pollKnown[32];
+uint8_t _pollNode;
+uint8_t _pollDiscover;
+uint8_t _pollState;
+uint32_t _pollStart;
+#define RS485_POLL_IDLE		0
+#define RS485_POLL_SENDING	1
+#define RS485_POLL_WAITING	2
+#elif defined(MY_RS485_POLLED)
+// Set when the master has polled us, consumed by the next _serialTxProcess()
+bool _txGranted;
+// EOT of the poll, the master only waits MY_RS485_POLL_SLOT for the reply
+uint32_t _txGrantedAt;
+uint32_t _txDeadline;
+// Give up on a frame if the master has not polled us within this time
+#define RS485_POLL_TX_TIMEOUT 2000
+#endif
 
 // Packet wrapping characters, defined in standard ASCII table
 #define SOH 1
@@ -107,7 +189,10 @@ bool _packet_received;
 #define ETX 3
 #define EOT 4
 
-
+// This is how many times to try and transmit before failing.
+#define RS485_TX_RETRIES 10
+// The bus is considered busy if anything has been seen in the last millisecond
+#define RS485_BUS_IDLE_MS 1
 
 //Reset the state machine and release the data pointer
 void _serialReset(){
@@ -116,57 +201,68 @@ void _serialReset(){
   _recLen = 0;
   _recCommand = 0;
   _recCS = 0;
-  _recCalcCS = 0;
+  _recCalcCS = RS485_CS_INIT;
 }
 
 // This is the main reception state machine.  Progress through the states
 // is keyed on either special control characters, or counted number of bytes
 // received.  If all the data is in the right format, and the calculated
 // checksum matches the received checksum, AND the destination station is
-// our station ID, then look for a registered command that matches the
-// command code.  If all the above is true, execute the command's
-// function.
+// our station ID, then the frame is appended to the RX queue.
 bool _serialProcess()
 {
     char inch;
     unsigned char i;
     if (!_dev.available()) return false;
 
+    // bytes were dropped by the driver, the frame being received is incomplete
+    if (_dev.overflow()) {
+        STATS_INC(rxDropped);
+        _serialReset();
+    }
+
     while(_dev.available()) {
         inch = _dev.read();
 
         switch(_recPhase) {
 
             // Case 0 looks for the header.  Bytes arrive in the serial interface and get
-            // shifted through a header buffer.  When the start and end characters in
-            // the buffer match the SOH/STX pair, and the destination station ID matches
-            // our ID, save the header information and progress to the next state.
+            // stored in a ring of the last 6 bytes.  When the oldest and newest bytes
+            // match the SOH/STX pair, and the destination station ID matches our ID,
+            // save the header information and progress to the next state.
             case 0:
-                memcpy(&_header[0],&_header[1],5);
-                _header[5] = inch;
-                if ((_header[0] == SOH) && (_header[5] == STX) && (_header[1] != _header[2])) {
-                    _recCalcCS = 0;
-                    _recStation = _header[1];
-                    _recSender = _header[2];
-                    _recCommand = _header[3];
-                    _recLen = _header[4];
+                _header[_headerPos] = inch;
+                _headerPos = (_headerPos + 1) % 6;
+                if ((_headerByte(0) == SOH) && (_headerByte(5) == STX) && (_headerByte(1) != _headerByte(2))) {
+                    _recCalcCS = RS485_CS_INIT;
+                    _recStation = _headerByte(1);
+                    _recSender = _headerByte(2);
+                    _recCommand = _headerByte(3);
+                    _recLen = _headerByte(4);
 
                     for (i=1; i<=4; i++) {
-                        _recCalcCS += _header[i];
+                        _recCalcCS = _serialChecksum(_recCalcCS, _headerByte(i));
                     }
                     _recPhase = 1;
                     _recPos = 0;
 
+                    #if defined(RS485_POLL_MASTER)
+                        //Remember every node talking on the bus, it gets polled from now on
+                        if (_recSender != _nodeId && _recSender != BROADCAST_ADDRESS) {
+                            _pollKnown[_recSender >> 3] |= 1 << (_recSender & 7);
+                        }
+                    #endif
+
                     //Check if we should process this message
                     //We reject the message if we are the sender
                     //We reject if we are not the receiver and message is not a broadcast
+                    //We reject if it does not fit, or there is no room left to queue it
                     if ((_recSender == _nodeId) ||
                         (_recStation != _nodeId &&
-                         _recStation != BROADCAST_ADDRESS)) {
-						_dev.print(" wrongid: ");
-						_dev.print(_recStation);
-						_dev.print(" - ");
-						_dev.println(_nodeId);
+                         _recStation != BROADCAST_ADDRESS) ||
+                        (_recLen > MY_RS485_MAX_MESSAGE_LENGTH) ||
+                        (_recLen && _rxQueue.full())) {
+                        if (_recLen && _rxQueue.full() && _recSender != _nodeId) STATS_INC(rxDropped);
                         _serialReset();
                         break;
                     }
@@ -179,10 +275,10 @@ bool _serialProcess()
                 break;
 
             // Case 1 receives the data portion of the packet.  Read in "_recLen" number
-            // of bytes and store them in the _data array.
+            // of bytes and store them directly in the next free RX queue slot.
             case 1:
-                _data[_recPos++] = inch;
-                _recCalcCS += inch;
+                _rxQueueSlot().data[_recPos++] = inch;
+                _recCalcCS = _serialChecksum(_recCalcCS, inch);
                 if (_recPos == _recLen) {
                     _recPhase = 2;
                 }
@@ -194,135 +290,292 @@ bool _serialProcess()
                 // Packet properly terminated?
                 if (inch == ETX) {
                     _recPhase = 3;
+                    _recPos = 0;
                 } else {
                     _serialReset();
                 }
                 break;
 
-            // Next comes the checksum.  We have already calculated it from the incoming
-            // data, so just store the incoming checksum byte for later.
+            // Next comes the checksum, low byte first.  We have already calculated it from
+            // the incoming data, so just store the incoming checksum for later.
             case 3:
-                _recCS = inch;
-                _recPhase = 4;
+                _recCS |= (rs485Checksum)(uint8_t)inch << (8 * _recPos);
+                if (++_recPos == sizeof(rs485Checksum)) {
+                    _recPhase = 4;
+                }
                 break;
 
             // The final state - check the last character is EOT and that the checksum matches.
-            // If that test passes, then look for a valid command callback to execute.
-            // Execute it if found.
+            // If that test passes, commit the frame to the RX queue.
             case 4:
-                if (inch == EOT) {
-                    if (_recCS == _recCalcCS) {
-                        // First, check for system level commands.  It is possible
-                        // to register your own callback as well for system level
-                        // commands which will be called after the system default
-                        // hook.
-
-                        switch (_recCommand) {
-						    case ICSC_SYS_PACK:
-						    	_packet_from = _recSender;
-						    	_packet_len = _recLen;
-						    	_packet_received = true;
-                                break;
+                if (inch == EOT && _recCS == _recCalcCS && _recCommand == ICSC_SYS_PACK &&
+                    _recLen <= MAX_MESSAGE_LENGTH && !_rxQueue.full()) {
+                    _rxQueueSlot().from = _recSender;
+                    _rxQueueSlot().len = _recLen;
+                    #if defined(MY_RS485_MULTI_MESSAGE)
+                        _rxQueueSlot().multi = false;
+                    #endif
+                    _rxQueue.push();
+                }
+                #if defined(MY_RS485_MULTI_MESSAGE)
+                    else if (inch == EOT && _recCS == _recCalcCS && _recCommand == ICSC_SYS_MULTI && !_rxQueue.full()) {
+                        // entries must add up to the frame exactly
+                        rs485Frame &frame = _rxQueueSlot();
+                        uint8_t pos = 0;
+                        while (pos < _recLen && frame.data[pos] && (uint8_t)frame.data[pos] <= MAX_MESSAGE_LENGTH) {
+                            pos += 1 + (uint8_t)frame.data[pos];
+                        }
+                        if (pos == _recLen) {
+                            frame.from = _recSender;
+                            frame.len = _recLen;
+                            frame.multi = true;
+                            frame.pos = 0;
+                            _rxQueue.push();
                         }
                     }
-                }
+                #endif
+                #if defined(MY_RS485_POLLED) && !defined(RS485_POLL_MASTER)
+                    else if (inch == EOT && _recCS == _recCalcCS && _recCommand == ICSC_SYS_POLL &&
+                             _recStation == _nodeId) {
+                        _txGranted = true;
+                        _txGrantedAt = hwMillis();
+                    }
+                #endif
                 //Clear the data
                 _serialReset();
-                //Return true, we have processed one command
-                return true;
                 break;
         }
     }
+    _recLastActivity = hwMillis();
     return true;
 }
 
-bool transportSend(uint8_t to, const void* data, uint8_t len)
+// Called from the UART ISR once the stop bit of the last byte has left the wire
+void _serialTxComplete()
 {
-	const char *datap = static_cast<char const *>(data);
-    unsigned char i;
-    unsigned char cs = 0;
-    unsigned char del;
-
-	// This is how many times to try and transmit before failing.
-	unsigned char timeout = 10;
-
-	// Let's start out by looking for a collision.  If there has been anything seen in
-	// the last millisecond, then wait for a random time and check again.
+	deassertDE();
+	_txActive = false;
+	// a frame started meanwhile is still pending
+	if (_txOwnFrame && !_txQueued) _txStatus = TRANSPORT_TX_OK;
+}
 
-	while (_serialProcess()) {
-		del = rand() % 20;
-		for (i = 0; i < del; i++) {
-			delay(1);
-			_serialProcess();
-		}
-		timeout--;
-		if (timeout == 0) {
-			// Failed to transmit!!!
-			return false;
-		}
-	}
+// Hand a frame to the UART. It fits the UART TX buffer, so these writes only
+// queue bytes and the rest is shifted out from the ISR.
+void _serialWriteFrame(uint8_t to, uint8_t command, const char *datap, uint8_t len)
+{
+	unsigned char i;
+	rs485Checksum cs = RS485_CS_INIT;
 
-	#if defined(MY_RS485_DE_PIN)
-		digitalWrite(MY_RS485_DE_PIN, HIGH);
-		delayMicroseconds(5);
-	#endif
+	_txActive = true;
+	assertDE();
 
-		// Start of header by writing multiple SOH
-    for(byte w=0;w<1;w++)  _dev.write(SOH);
-    _dev.write(to);  // Destination address
-    cs += to;
+    _dev.write(SOH);     // Start of header
+    _dev.write(to);      // Destination address
+    cs = _serialChecksum(cs, to);
     _dev.write(_nodeId); // Source address
-    cs += _nodeId;
-    _dev.write(ICSC_SYS_PACK);  // Command code
-    cs += ICSC_SYS_PACK;
-    _dev.write(len);      // Length of text
-    cs += len;
-    _dev.write(STX);      // Start of text
+    cs = _serialChecksum(cs, _nodeId);
+    _dev.write(command); // Command code
+    cs = _serialChecksum(cs, command);
+    _dev.write(len);     // Length of text
+    cs = _serialChecksum(cs, len);
+    _dev.write(STX);     // Start of text
     for(i=0; i<len; i++) {
         _dev.write(datap[i]);      // Text bytes
-        cs += datap[i];
+        cs = _serialChecksum(cs, datap[i]);
     }
     _dev.write(ETX);      // End of text
-    _dev.write(cs);
+    for(i=0; i<sizeof(rs485Checksum); i++) {
+        _dev.write((uint8_t)(cs >> (8 * i)));
+    }
     _dev.write(EOT);
+}
 
-	#if defined(MY_RS485_DE_PIN)
-		#ifdef __PIC32MX__
-			// MPIDE has nothing yet for this.  It uses the hardware buffer, which
-			// could be up to 8 levels deep.  For now, let's just delay for 8
-			// characters worth.
-			delayMicroseconds((F_CPU/9600)+1);
-		#else
-		#if defined(ARDUINO) && ARDUINO >= 100
-			#if ARDUINO >= 104
-				// Arduino 1.0.4 and upwards does it right
-				_dev.flush();
-			#else
-				// Between 1.0.0 and 1.0.3 it almost does it - need to compensate
-				// for the hardware buffer. Delay for 2 bytes worth of transmission.
-				_dev.flush();
-				delayMicroseconds((20000000UL/9600)+1);
-			#endif
-			#endif
-		#endif
-		digitalWrite(MY_RS485_DE_PIN, LOW);
+// Send the frame waiting in _txData
+void _serialWritePending()
+{
+	_txOwnFrame = true;
+	_txQueued = false;
+	#if defined(MY_RS485_MULTI_MESSAGE)
+		if (_txCount > 1) {
+			_serialWriteFrame(_txTo, ICSC_SYS_MULTI, _txData, _txLen);
+		} else {
+			_serialWriteFrame(_txTo, ICSC_SYS_PACK, _txData + 1, _txLen - 1);
+		}
+	#else
+		_serialWriteFrame(_txTo, ICSC_SYS_PACK, _txData, _txLen);
 	#endif
-    return true;
 }
 
+bool _serialBusIdle()
+{
+	return !_serialProcess() && _recPhase == 0 && hwMillis() - _recLastActivity >= RS485_BUS_IDLE_MS;
+}
 
+#if defined(RS485_POLL_MASTER)
+// Next node to poll: every known node once per cycle, then one unknown
+// address so new nodes get discovered, then the unassigned address.
+uint8_t _serialNextPoll()
+{
+	if (_pollNode != BROADCAST_ADDRESS) {
+		while (++_pollNode < BROADCAST_ADDRESS) {
+			if (_pollKnown[_pollNode >> 3] & (1 << (_pollNode & 7))) return _pollNode;
+		}
+		for (uint8_t i = 0; i < BROADCAST_ADDRESS - 1; i++) {
+			if (++_pollDiscover >= BROADCAST_ADDRESS) _pollDiscover = 1;
+			if (_pollDiscover != _nodeId &&
+				!(_pollKnown[_pollDiscover >> 3] & (1 << (_pollDiscover & 7)))) return _pollDiscover;
+		}
+	}
+	// wrap, AUTO address last
+	_pollNode = 0;
+	return AUTO;
+}
+
+// Master side of the bus: own frames go out between slots, otherwise
+// keep polling nodes. A slot ends once the reply window has passed and the
+// bus has gone quiet, so every node gets at most one frame per cycle.
+void _serialTxProcess()
+{
+	if (_txActive) return;
+	if (_pollState == RS485_POLL_SENDING) {
+		_pollState = RS485_POLL_WAITING;
+		_pollStart = hwMillis();
+	}
+	if (_pollState == RS485_POLL_WAITING) {
+		if (!_serialBusIdle() || hwMillis() - _pollStart < MY_RS485_POLL_SLOT) return;
+		_pollState = RS485_POLL_IDLE;
+	}
+	if (_txQueued) {
+		_serialWritePending();
+		return;
+	}
+	_txOwnFrame = false;
+	_pollState = RS485_POLL_SENDING;
+	_serialWriteFrame(_serialNextPoll(), ICSC_SYS_POLL, NULL, 0);
+}
+#elif defined(MY_RS485_POLLED)
+// Node side of the bus: only talk right after the master polled us
+void _serialTxProcess()
+{
+	_serialProcess();
+	// a late reply would collide with the next slot
+	const bool granted = _txGranted && hwMillis() - _txGrantedAt < MY_RS485_POLL_SLOT;
+	_txGranted = false;
+	if (!_txQueued || _txActive) return;
+	if (granted) {
+		_serialWritePending();
+	} else if ((int32_t)(hwMillis() - _txDeadline) > 0) {
+		// master gone?
+		_txQueued = false;
+		_txStatus = TRANSPORT_TX_FAIL;
+	}
+}
+#else
+// Hand the pending frame to the UART if the bus has been quiet long enough,
+// otherwise back off for a random time. Never blocks.
+void _serialTxProcess()
+{
+	if (!_txQueued || _txActive) return;
+	if ((int32_t)(hwMillis() - _txNextAttempt) < 0) return;
+
+	// Let's start out by looking for a collision. If we are in the middle of a
+	// frame or there has been anything seen recently, wait and check again.
+	if (!_serialBusIdle()) {
+		if (--_txRetries == 0) {
+			// Failed to transmit!!!
+			_txQueued = false;
+			_txStatus = TRANSPORT_TX_FAIL;
+			return;
+		}
+		_txNextAttempt = hwMillis() + rand() % 20;
+		return;
+	}
+	_serialWritePending();
+}
+#endif
 
 bool transportInit() {
     // Reset the state machine
 	_dev.begin(MY_RS485_BAUD_RATE);
+	_dev.onTransmitComplete(_serialTxComplete);
     _serialReset();
+	_rxQueue.clear();
+	_txActive = false;
+	_txQueued = false;
+	_txStatus = TRANSPORT_TX_IDLE;
 	#if defined(MY_RS485_DE_PIN)
     	pinMode(MY_RS485_DE_PIN, OUTPUT);
-        digitalWrite(MY_RS485_DE_PIN, LOW);
+        hwDigitalWrite(MY_RS485_DE_PIN, LOW);
 	#endif
     return true;
 }
 
+// Wait until the frame waiting for the bus and the one on the wire are gone
+void _serialTxFlush()
+{
+	while (_txQueued || _txActive) {
+		_serialTxProcess();
+	}
+}
+
+// Start a new frame waiting for the bus
+void _serialTxStart(uint8_t to)
+{
+	_txTo = to;
+	_txLen = 0;
+	_txRetries = RS485_TX_RETRIES;
+	_txNextAttempt = hwMillis();
+	#if defined(MY_RS485_POLLED) && !defined(RS485_POLL_MASTER)
+		_txDeadline = hwMillis() + RS485_POLL_TX_TIMEOUT;
+	#endif
+	_txQueued = true;
+}
+
+bool transportSendAsync(uint8_t to, const void* data, uint8_t len) {
+	#if defined(MY_RS485_MULTI_MESSAGE)
+		// messages to the same destination are packed into the frame waiting for the bus
+		if (len == 0 || len + 1 > MY_RS485_MAX_MESSAGE_LENGTH) return false;
+		if (_txQueued && (_txTo != to || _txLen + 1 + len > MY_RS485_MAX_MESSAGE_LENGTH)) _serialTxFlush();
+		if (!_txQueued) {
+			_serialTxStart(to);
+			_txCount = 0;
+		}
+		_txData[_txLen++] = len;
+		_txCount++;
+	#else
+		// only one frame in flight, the copy is released once the UART is done
+		if (_txStatus == TRANSPORT_TX_PENDING || len > MY_RS485_MAX_MESSAGE_LENGTH) return false;
+		_serialTxStart(to);
+	#endif
+	memcpy(&_txData[_txLen], data, len);
+	_txLen += len;
+	// with MY_RS485_MULTI_MESSAGE the status covers every message in the frame
+	_txStatus = TRANSPORT_TX_PENDING;
+	_serialTxProcess();
+	return true;
+}
+
+uint8_t transportSendAsyncStatus() {
+	_serialTxProcess();
+	return _txStatus;
+}
+
+#if defined(MY_RS485_MULTI_MESSAGE)
+bool transportSendAsyncJoinable(uint8_t to, uint8_t len) {
+	_serialTxProcess();
+	return _txQueued && _txTo == to && len && _txLen + 1 + len <= MY_RS485_MAX_MESSAGE_LENGTH;
+}
+#endif
+
+bool transportSend(uint8_t to, const void* data, uint8_t len)
+{
+	if (!transportSendAsync(to, data, len)) return false;
+	while (_txStatus == TRANSPORT_TX_PENDING) {
+		_serialTxProcess();
+	}
+	return _txStatus == TRANSPORT_TX_OK;
+}
+
 void transportSetAddress(uint8_t address) {
 	_nodeId = address;
 }
@@ -334,7 +587,8 @@ uint8_t transportGetAddress() {
 
 bool transportAvailable() {
 	_serialProcess();
-	return _packet_received;
+	_serialTxProcess();
+	return !_rxQueue.empty();
 }
 
 bool transportSanityCheck() {
@@ -342,11 +596,30 @@ bool transportSanityCheck() {
 	return true;
 }
 
+uint8_t transportReceiveBuffer(void** data) {
+	// driver buffer is reused on ACK/RX, use transportReceive()
+	*data = NULL;
+	return 0;
+}
+
 uint8_t transportReceive(void* data) {
-	if (_packet_received) {
-		memcpy(data,_data,_packet_len);
-		_packet_received = false;
-		return _packet_len;
+	if (!_rxQueue.empty()) {
+		rs485Frame &frame = *_rxQueue.front();
+		#if defined(MY_RS485_MULTI_MESSAGE)
+			if (frame.multi) {
+				const uint8_t len = frame.data[frame.pos];
+				memcpy(data, &frame.data[frame.pos + 1], len);
+				frame.pos += 1 + len;
+				if (frame.pos >= frame.len) {
+					_rxQueue.pop();
+				}
+				return len;
+			}
+		#endif
+		const uint8_t len = frame.len;
+		memcpy(data, frame.data, len);
+		_rxQueue.pop();
+		return len;
 	}
 	else {
 		return (0);
@@ -354,7 +627,13 @@ uint8_t transportReceive(void* data) {
 }
 
 void transportPowerDown() {
-	// Nothing to shut down here
+	// Nothing to shut down here, just get buffered frames out and DE released
+	_serialTxFlush();
 }
 
-
+#if defined(MY_TRANSPORT_PARENT_SCORING) || defined(MY_TRANSPORT_LINK_QUALITY)
+int16_t transportGetReceivingRSSI() {
+	// wired, link quality does not vary
+	return 0;
+}
+#endif
@@ -134,6 +134,8 @@ static void xor_block (byte * d, byte * s)
     }
 }
 
+// byte-wise rounds, replaced by the round tables with AES_TTABLE
+#if !defined(AES_TTABLE)
 static void copy_and_key (byte * d, byte * s, byte * k)
 {
   for (byte i = 0 ; i < N_BLOCK ; i += 4)
@@ -225,6 +227,51 @@ static void inv_mix_sub_columns (byte dt[N_BLOCK], byte st[N_BLOCK])
       dt[(i+15)&15] = is_box (a9^a2  ^  bc^b1  ^  c9     ^  dc^d2) ;
     }
 }
+#endif
+
+/******************************************************************************/
+
+#if defined(AES_TTABLE)
+// Round tables for the first row, the other rows are byte rotations of it:
+// Te[x] = (2,1,1,3)*S[x] and Td[x] = (e,9,d,b)*Si[x] as big endian columns.
+// They are generated on first use, 2 KB of RAM instead of flash reads.
+static uint32_t Te [0x100], Td [0x100] ;
+static bool tables_ready = false ;
+
+#define ROR8(x)  (((x) >> 8) | ((x) << 24))
+#define ROR16(x) (((x) >> 16) | ((x) << 16))
+#define ROR24(x) (((x) >> 24) | ((x) << 8))
+#define LOAD32(p) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | ((uint32_t) (p)[2] << 8) | (p)[3])
+#define STORE32(p, v) { (p)[0] = (v) >> 24 ; (p)[1] = (v) >> 16 ; (p)[2] = (v) >> 8 ; (p)[3] = (v) ; }
+#define SBOX_WORD(box, a, b, c, d) (((uint32_t) box ((a) >> 24) << 24) | ((uint32_t) box (((b) >> 16) & 0xff) << 16) \
+                                   | ((uint32_t) box (((c) >> 8) & 0xff) << 8) | box ((d) & 0xff))
+
+static byte gf_mul (byte a, byte b)
+{
+  byte r = 0 ;
+  while (b)
+    {
+      if (b & 1)
+        r ^= a ;
+      a = f2 (a) ;
+      b >>= 1 ;
+    }
+  return r ;
+}
+
+static void make_tables ()
+{
+  for (int x = 0 ; x < 0x100 ; x++)
+    {
+      byte s = s_box (x), s2 = f2 (s) ;
+      Te [x] = ((uint32_t) s2 << 24) | ((uint32_t) s << 16) | ((uint32_t) s << 8) | (byte) (s2 ^ s) ;
+      byte i = is_box (x) ;
+      Td [x] = ((uint32_t) gf_mul (i, 14) << 24) | ((uint32_t) gf_mul (i, 9) << 16)
+             | ((uint32_t) gf_mul (i, 13) << 8) | gf_mul (i, 11) ;
+    }
+  tables_ready = true ;
+}
+#endif
 
 /******************************************************************************/
 
@@ -253,28 +300,32 @@ AES::AES(){
 
 byte AES::set_key (byte key [], int keylen)
 {
-  byte hi ;
+  byte hi, rounds ;
   switch (keylen)
     {
     case 16:
     case 128: 
       keylen = 16; // 10 rounds
-      round = 10 ;
+      rounds = 10 ;
       break;
     case 24:
     case 192: 
       keylen = 24; // 12 rounds
-      round = 12 ;
+      rounds = 12 ;
       break;
     case 32:
     case 256: 
       keylen = 32; // 14 rounds
-      round = 14 ;
+      rounds = 14 ;
       break;
     default: 
       round = 0; 
       return AES_FAILURE;
     }
+  // The schedule starts with the key itself, setting the same key again keeps it
+  if (round == rounds && memcmp (key_sched, key, keylen) == 0)
+    return AES_SUCCESS ;
+  round = rounds ;
   hi = (round + 1) << 4 ;
   copy_n_bytes (key_sched, key, keylen) ;
   byte t[4] ;
@@ -302,6 +353,23 @@ byte AES::set_key (byte key [], int keylen)
       for (byte i = 0 ; i < N_COL ; i++)
         key_sched [cc + i] = key_sched [tt + i] ^ t[i] ;
     }
+#if defined(AES_TTABLE)
+  if (!tables_ready)
+    make_tables () ;
+  const byte nw = (round + 1) * N_COL ;
+  for (byte i = 0 ; i < nw ; i++)
+    rk_enc [i] = LOAD32 (key_sched + 4 * i) ;
+  // Equivalent inverse cipher: reversed round order, InvMixColumns on the inner round keys
+  for (byte r = 0 ; r <= round ; r++)
+    for (byte c = 0 ; c < N_COL ; c++)
+      {
+        uint32_t w = rk_enc [(round - r) * N_COL + c] ;
+        if (r > 0 && r < round)
+          w = Td [s_box (w >> 24)] ^ ROR8 (Td [s_box ((w >> 16) & 0xff)])
+            ^ ROR16 (Td [s_box ((w >> 8) & 0xff)]) ^ ROR24 (Td [s_box (w & 0xff)]) ;
+        rk_dec [r * N_COL + c] = w ;
+      }
+#endif
   return AES_SUCCESS ;
 }
 
@@ -311,6 +379,10 @@ void AES::clean ()
 {
   for (byte i = 0 ; i < KEY_SCHEDULE_BYTES ; i++)
     key_sched [i] = 0 ;
+#if defined(AES_TTABLE)
+  memset (rk_enc, 0, sizeof (rk_enc)) ;
+  memset (rk_dec, 0, sizeof (rk_dec)) ;
+#endif
   round = 0 ;
 }
 
@@ -332,6 +404,36 @@ void AES::copy_n_bytes (byte * d, byte * s, byte nn)
 
 /******************************************************************************/
 
+#if defined(AES_TTABLE)
+byte AES::encrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
+{
+  if (!round)
+    return AES_FAILURE ;
+  const uint32_t * rk = rk_enc ;
+  uint32_t s0 = LOAD32 (plain) ^ rk[0], s1 = LOAD32 (plain + 4) ^ rk[1] ;
+  uint32_t s2 = LOAD32 (plain + 8) ^ rk[2], s3 = LOAD32 (plain + 12) ^ rk[3] ;
+  uint32_t t0, t1, t2, t3 ;
+  for (int r = 1 ; r < round ; r++)
+    {
+      rk += N_COL ;
+      t0 = Te [s0 >> 24] ^ ROR8 (Te [(s1 >> 16) & 0xff]) ^ ROR16 (Te [(s2 >> 8) & 0xff]) ^ ROR24 (Te [s3 & 0xff]) ^ rk[0] ;
+      t1 = Te [s1 >> 24] ^ ROR8 (Te [(s2 >> 16) & 0xff]) ^ ROR16 (Te [(s3 >> 8) & 0xff]) ^ ROR24 (Te [s0 & 0xff]) ^ rk[1] ;
+      t2 = Te [s2 >> 24] ^ ROR8 (Te [(s3 >> 16) & 0xff]) ^ ROR16 (Te [(s0 >> 8) & 0xff]) ^ ROR24 (Te [s1 & 0xff]) ^ rk[2] ;
+      t3 = Te [s3 >> 24] ^ ROR8 (Te [(s0 >> 16) & 0xff]) ^ ROR16 (Te [(s1 >> 8) & 0xff]) ^ ROR24 (Te [s2 & 0xff]) ^ rk[3] ;
+      s0 = t0 ; s1 = t1 ; s2 = t2 ; s3 = t3 ;
+    }
+  rk += N_COL ;
+  t0 = SBOX_WORD (s_box, s0, s1, s2, s3) ^ rk[0] ;
+  t1 = SBOX_WORD (s_box, s1, s2, s3, s0) ^ rk[1] ;
+  t2 = SBOX_WORD (s_box, s2, s3, s0, s1) ^ rk[2] ;
+  t3 = SBOX_WORD (s_box, s3, s0, s1, s2) ^ rk[3] ;
+  STORE32 (cipher, t0) ;
+  STORE32 (cipher + 4, t1) ;
+  STORE32 (cipher + 8, t2) ;
+  STORE32 (cipher + 12, t3) ;
+  return AES_SUCCESS ;
+}
+#else
 byte AES::encrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
 {
   if (round)
@@ -352,6 +454,7 @@ byte AES::encrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
     return AES_FAILURE ;
   return AES_SUCCESS ;
 }
+#endif
 
 /******************************************************************************/
 
@@ -387,6 +490,37 @@ byte AES::cbc_encrypt (byte * plain, byte * cipher, int n_block)
 
 /******************************************************************************/
 
+#if defined(AES_TTABLE)
+byte AES::decrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
+{
+  // plain is the input ciphertext and cipher the output plaintext, as in the byte oriented version
+  if (!round)
+    return AES_FAILURE ;
+  const uint32_t * rk = rk_dec ;
+  uint32_t s0 = LOAD32 (plain) ^ rk[0], s1 = LOAD32 (plain + 4) ^ rk[1] ;
+  uint32_t s2 = LOAD32 (plain + 8) ^ rk[2], s3 = LOAD32 (plain + 12) ^ rk[3] ;
+  uint32_t t0, t1, t2, t3 ;
+  for (int r = 1 ; r < round ; r++)
+    {
+      rk += N_COL ;
+      t0 = Td [s0 >> 24] ^ ROR8 (Td [(s3 >> 16) & 0xff]) ^ ROR16 (Td [(s2 >> 8) & 0xff]) ^ ROR24 (Td [s1 & 0xff]) ^ rk[0] ;
+      t1 = Td [s1 >> 24] ^ ROR8 (Td [(s0 >> 16) & 0xff]) ^ ROR16 (Td [(s3 >> 8) & 0xff]) ^ ROR24 (Td [s2 & 0xff]) ^ rk[1] ;
+      t2 = Td [s2 >> 24] ^ ROR8 (Td [(s1 >> 16) & 0xff]) ^ ROR16 (Td [(s0 >> 8) & 0xff]) ^ ROR24 (Td [s3 & 0xff]) ^ rk[2] ;
+      t3 = Td [s3 >> 24] ^ ROR8 (Td [(s2 >> 16) & 0xff]) ^ ROR16 (Td [(s1 >> 8) & 0xff]) ^ ROR24 (Td [s0 & 0xff]) ^ rk[3] ;
+      s0 = t0 ; s1 = t1 ; s2 = t2 ; s3 = t3 ;
+    }
+  rk += N_COL ;
+  t0 = SBOX_WORD (is_box, s0, s3, s2, s1) ^ rk[0] ;
+  t1 = SBOX_WORD (is_box, s1, s0, s3, s2) ^ rk[1] ;
+  t2 = SBOX_WORD (is_box, s2, s1, s0, s3) ^ rk[2] ;
+  t3 = SBOX_WORD (is_box, s3, s2, s1, s0) ^ rk[3] ;
+  STORE32 (cipher, t0) ;
+  STORE32 (cipher + 4, t1) ;
+  STORE32 (cipher + 8, t2) ;
+  STORE32 (cipher + 12, t3) ;
+  return AES_SUCCESS ;
+}
+#else
 byte AES::decrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
 {
   if (round)
@@ -407,6 +541,7 @@ byte AES::decrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
     return AES_FAILURE ;
   return AES_SUCCESS ;
 }
+#endif
 
 /******************************************************************************/
 
@@ -444,6 +579,23 @@ byte AES::cbc_decrypt (byte * cipher, byte * plain, int n_block)
   return AES_SUCCESS ;
 }
 
+/******************************************************************************/
+
+byte AES::ctr_crypt (byte * data, int len, byte ctr [N_BLOCK])
+{
+  byte keystream [N_BLOCK] ;
+  while (len > 0)
+    {
+      if (encrypt (ctr, keystream) != AES_SUCCESS)
+        return AES_FAILURE ;
+      // big endian increment of the whole counter block
+      for (byte i = N_BLOCK ; i-- && !++ctr [i] ; ) ;
+      for (byte i = 0 ; i < N_BLOCK && len > 0 ; i++, len--)
+        *data++ ^= keystream [i] ;
+    }
+  return AES_SUCCESS ;
+}
+
 /*****************************************************************************/
 
 void AES::set_IV(unsigned long long int IVCl){
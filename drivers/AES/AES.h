@@ -149,6 +149,19 @@ class AES
 	 *
 	 */
 	byte cbc_decrypt (byte * cipher, byte * plain, int n_block) ;
+
+	/** CTR encrypt or decrypt a number of bytes in place.
+	 *  
+	 *  The keystream is the encrypted counter block, the counter block is
+	 *  incremented (big endian) for every block of data as in NIST SP 800-38A.
+	 *
+	 *  @param *data Pointer, points to the data to be ciphered.
+	 *  @param len integer, the number of bytes to be ciphered, no padding is needed.
+	 *  @param ctr byte Array that holds the initial counter block, it is updated.
+	 *  @return 0 if SUCCESS or -1 if FAILURE
+	 *
+	 */
+	byte ctr_crypt (byte * data, int len, byte ctr [N_BLOCK]) ;
 		
 	/** Sets IV (initialization vector) and IVC (IV counter).
 	 *  This function changes the ivc and iv variables needed for AES.
@@ -296,6 +309,10 @@ class AES
  private:
   int round ;/**< holds the number of rounds to be used. */
   byte key_sched [KEY_SCHEDULE_BYTES] ;/**< holds the pre-computed key for the encryption/decrpytion. */
+  #if defined(AES_TTABLE)
+	uint32_t rk_enc [KEY_SCHEDULE_BYTES/4] ;/**< holds the key schedule as big endian words for encryption. */
+	uint32_t rk_dec [KEY_SCHEDULE_BYTES/4] ;/**< holds the equivalent inverse cipher key schedule for decryption. */
+  #endif
   unsigned long long int IVC;/**< holds the initialization vector counter in numerical format. */
   byte iv[16];/**< holds the initialization vector that will be used in the cipher. */
   int pad;/**< holds the size of the padding. */
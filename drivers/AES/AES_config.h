@@ -22,7 +22,11 @@
 #include <stdint.h>
 #include <string.h>
 
-#if defined(__ARDUINO_X86__) || (defined (__linux) || defined (linux))
+#if defined(ARDUINO_ARCH_NATIVE)
+	// host build, PROGMEM helpers come from drivers/Native/Arduino.h
+	#include <Arduino.h>
+	#define printf_P printf
+#elif defined(__ARDUINO_X86__) || (defined (__linux) || defined (linux))
 	#undef PROGMEM
 	#define PROGMEM __attribute__(( section(".progmem.data") ))
 	#define pgm_read_byte(p) (*(p))
@@ -37,6 +41,10 @@
 	#include <avr/pgmspace.h>
 #endif
 
+// 32 bit cores use T-table rounds, define AES_NO_TTABLE to keep the byte oriented code
+#if !defined(AES_NO_TTABLE) && (defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_NATIVE))
+	#define AES_TTABLE
+#endif
 #define N_ROW                   4
 #define N_COL                   4
 #define N_BLOCK   (N_ROW * N_COL)
@@ -17,7 +17,78 @@ static uint8_t sha204p_receive_response(uint8_t size, uint8_t *response);
 static uint8_t sha204m_read(uint8_t *tx_buffer, uint8_t *rx_buffer, uint8_t zone, uint16_t address);
 static uint8_t sha204c_resync(uint8_t size, uint8_t *response);
 static uint8_t sha204c_send_and_receive(uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer, uint8_t execution_delay, uint8_t execution_timeout);
+static void sha204m_assemble(uint8_t op_code, uint8_t param1, uint16_t param2, uint8_t datalen1, uint8_t *data1, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *poll_delay, uint8_t *poll_timeout, uint8_t *response_size);
 
+#if defined(MY_SIGNING_ATSHA204_SERIAL)
+/* SWI UART functions: one UART character (230400 baud, 7N1) per single-wire bit, the signal
+ * is wired to RX and TX. Transfers are buffered by the serial driver, interrupts stay enabled. */
+
+#define SWI_UART_BAUD		(230400)
+#define SWI_UART_WAKE_BAUD	(115200)	//! 0x00 at this rate is a low pulse longer than the wake-up pulse
+#define SWI_UART_BIT_ONE	(0x7F)		//! start bit only
+#define SWI_UART_BIT_ZERO	(0x7D)		//! start bit and zero pulse
+#define SWI_UART_CHAR_TIME_OUT	(200)	//! max gap between the characters of a response (us)
+
+static void swi_set_signal_pin(uint8_t is_high)
+{
+  if (is_high)
+  {
+    MY_SIGNING_ATSHA204_SERIAL.begin(SWI_UART_BAUD, SERIAL_7N1);
+    return;
+  }
+  // wake-up token: hold the line low for more than 60us
+  MY_SIGNING_ATSHA204_SERIAL.begin(SWI_UART_WAKE_BAUD, SERIAL_7N1);
+  MY_SIGNING_ATSHA204_SERIAL.write((uint8_t)0x00);
+  MY_SIGNING_ATSHA204_SERIAL.flush();
+}
+
+static uint8_t swi_send_bytes(uint8_t count, uint8_t *buffer)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    for (uint8_t bit_mask = 1; bit_mask > 0; bit_mask <<= 1)
+      MY_SIGNING_ATSHA204_SERIAL.write((uint8_t)((buffer[i] & bit_mask) ? SWI_UART_BIT_ONE : SWI_UART_BIT_ZERO));
+  }
+  MY_SIGNING_ATSHA204_SERIAL.flush();
+  // drop the echo of what was sent on the shared line
+  while (MY_SIGNING_ATSHA204_SERIAL.available())
+    (void)MY_SIGNING_ATSHA204_SERIAL.read();
+  return SWI_FUNCTION_RETCODE_SUCCESS;
+}
+
+static uint8_t swi_send_byte(uint8_t value)
+{
+  return swi_send_bytes(1, &value);
+}
+
+static uint8_t swi_receive_bytes(uint8_t count, uint8_t *buffer)
+{
+  uint8_t i;
+  uint16_t time_out = SWI_RECEIVE_TIME_OUT + SWI_UART_CHAR_TIME_OUT;
+  uint32_t start = micros();
+
+  for (i = 0; i < count; i++)
+  {
+    uint8_t value = 0;
+    for (uint8_t bit_mask = 1; bit_mask > 0; bit_mask <<= 1)
+    {
+      while (!MY_SIGNING_ATSHA204_SERIAL.available())
+      {
+        if (micros() - start > time_out)
+          // Indicate that we timed out after having received at least one byte.
+          return i > 0 ? SWI_FUNCTION_RETCODE_RX_FAIL : SWI_FUNCTION_RETCODE_TIMEOUT;
+      }
+      if (MY_SIGNING_ATSHA204_SERIAL.read() == SWI_UART_BIT_ONE)
+        value |= bit_mask;
+      start = micros();
+      time_out = SWI_UART_CHAR_TIME_OUT;
+    }
+    buffer[i] = value;
+  }
+  return SWI_FUNCTION_RETCODE_SUCCESS;
+}
+
+#else
 /* SWI bit bang functions */
 
 static void swi_set_signal_pin(uint8_t is_high)
@@ -182,6 +253,7 @@ static uint8_t swi_receive_bytes(uint8_t count, uint8_t *buffer)
   }
   return status;
 }
+#endif
 
 /* Physical functions */
 
@@ -442,7 +514,10 @@ static uint8_t sha204c_check_crc(uint8_t *response)
 
 void atsha204_init(uint8_t pin)
 {
-#if defined(ARDUINO_ARCH_AVR)
+#if defined(MY_SIGNING_ATSHA204_SERIAL)
+  device_pin = pin;
+  MY_SIGNING_ATSHA204_SERIAL.begin(SWI_UART_BAUD, SERIAL_7N1);
+#elif defined(ARDUINO_ARCH_AVR)
   device_pin = digitalPinToBitMask(pin);  // Find the bit value of the pin
   uint8_t port = digitalPinToPort(pin); // temoporarily used to get the next three registers
 
@@ -470,7 +545,9 @@ void atsha204_sleep(void)
 uint8_t atsha204_wakeup(uint8_t *response)
 {
   swi_set_signal_pin(0);
+#if !defined(MY_SIGNING_ATSHA204_SERIAL)
   delayMicroseconds(10*SHA204_WAKEUP_PULSE_WIDTH);
+#endif
   swi_set_signal_pin(1);
   delay(SHA204_WAKEUP_DELAY);
 
@@ -495,59 +572,58 @@ uint8_t atsha204_wakeup(uint8_t *response)
   return ret_code;
 }
 
-uint8_t atsha204_execute(uint8_t op_code, uint8_t param1, uint16_t param2,
-			uint8_t datalen1, uint8_t *data1,	uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer)
+static void sha204m_assemble(uint8_t op_code, uint8_t param1, uint16_t param2,
+			uint8_t datalen1, uint8_t *data1, uint8_t *tx_buffer, uint8_t rx_size,
+			uint8_t *poll_delay, uint8_t *poll_timeout, uint8_t *response_size)
 {
-	uint8_t poll_delay, poll_timeout, response_size;
 	uint8_t *p_buffer;
 	uint8_t len;
-  (void)tx_size;
 
 	// Supply delays and response size.
 	switch (op_code)
 	{
 		case SHA204_GENDIG:
-			poll_delay = GENDIG_DELAY;
-			poll_timeout = GENDIG_EXEC_MAX - GENDIG_DELAY;
-			response_size = GENDIG_RSP_SIZE;
+			*poll_delay = GENDIG_DELAY;
+			*poll_timeout = GENDIG_EXEC_MAX - GENDIG_DELAY;
+			*response_size = GENDIG_RSP_SIZE;
 			break;
 
 		case SHA204_HMAC:
-			poll_delay = HMAC_DELAY;
-			poll_timeout = HMAC_EXEC_MAX - HMAC_DELAY;
-			response_size = HMAC_RSP_SIZE;
+			*poll_delay = HMAC_DELAY;
+			*poll_timeout = HMAC_EXEC_MAX - HMAC_DELAY;
+			*response_size = HMAC_RSP_SIZE;
 			break;
 
 		case SHA204_NONCE:
-			poll_delay = NONCE_DELAY;
-			poll_timeout = NONCE_EXEC_MAX - NONCE_DELAY;
-			response_size = param1 == NONCE_MODE_PASSTHROUGH
+			*poll_delay = NONCE_DELAY;
+			*poll_timeout = NONCE_EXEC_MAX - NONCE_DELAY;
+			*response_size = param1 == NONCE_MODE_PASSTHROUGH
 								? NONCE_RSP_SIZE_SHORT : NONCE_RSP_SIZE_LONG;
 			break;
 
 		case SHA204_RANDOM:
-			poll_delay = RANDOM_DELAY;
-			poll_timeout = RANDOM_EXEC_MAX - RANDOM_DELAY;
-			response_size = RANDOM_RSP_SIZE;
+			*poll_delay = RANDOM_DELAY;
+			*poll_timeout = RANDOM_EXEC_MAX - RANDOM_DELAY;
+			*response_size = RANDOM_RSP_SIZE;
 			break;
 
 		case SHA204_SHA:
-			poll_delay = SHA_DELAY;
-			poll_timeout = SHA_EXEC_MAX - SHA_DELAY;
-      response_size = param1 == SHA_INIT
+			*poll_delay = SHA_DELAY;
+			*poll_timeout = SHA_EXEC_MAX - SHA_DELAY;
+      *response_size = param1 == SHA_INIT
                 ? SHA_RSP_SIZE_SHORT : SHA_RSP_SIZE_LONG;
 			break;
 
     case SHA204_WRITE:
-      poll_delay = WRITE_DELAY;
-      poll_timeout = WRITE_EXEC_MAX - WRITE_DELAY;
-      response_size = WRITE_RSP_SIZE;
+      *poll_delay = WRITE_DELAY;
+      *poll_timeout = WRITE_EXEC_MAX - WRITE_DELAY;
+      *response_size = WRITE_RSP_SIZE;
       break;
 
 		default:
-			poll_delay = 0;
-			poll_timeout = SHA204_COMMAND_EXEC_MAX;
-			response_size = rx_size;
+			*poll_delay = 0;
+			*poll_timeout = SHA204_COMMAND_EXEC_MAX;
+			*response_size = rx_size;
 	}
 
 	// Assemble command.
@@ -565,12 +641,98 @@ uint8_t atsha204_execute(uint8_t op_code, uint8_t param1, uint16_t param2,
 	}
 
 	sha204c_calculate_crc(len - SHA204_CRC_SIZE, tx_buffer, p_buffer);
+}
+
+uint8_t atsha204_execute(uint8_t op_code, uint8_t param1, uint16_t param2,
+			uint8_t datalen1, uint8_t *data1,	uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer)
+{
+	uint8_t poll_delay, poll_timeout, response_size;
+  (void)tx_size;
+
+	sha204m_assemble(op_code, param1, param2, datalen1, data1, tx_buffer, rx_size,
+				&poll_delay, &poll_timeout, &response_size);
 
 	// Send command and receive response.
 	return sha204c_send_and_receive(&tx_buffer[0], response_size,
 				&rx_buffer[0],	poll_delay, poll_timeout);
 }
 
+/* Command in progress for atsha204_execute_start() / atsha204_execute_poll() */
+static struct {
+	uint8_t *tx_buffer;     // NULL when no command is in progress
+	uint8_t *rx_buffer;
+	uint8_t response_size;
+	uint8_t poll_delay;
+	uint8_t poll_timeout;
+	unsigned long start;
+} sha204_pending;
+
+uint8_t atsha204_execute_start(uint8_t op_code, uint8_t param1, uint16_t param2,
+			uint8_t datalen1, uint8_t *data1,	uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer)
+{
+  (void)tx_size;
+
+	sha204m_assemble(op_code, param1, param2, datalen1, data1, tx_buffer, rx_size,
+				&sha204_pending.poll_delay, &sha204_pending.poll_timeout, &sha204_pending.response_size);
+	sha204_pending.rx_buffer = rx_buffer;
+	sha204_pending.tx_buffer = NULL;
+
+	// Send command once, retries and re-synchronization are left to the blocking path
+	if (swi_send_byte(SHA204_SWI_FLAG_CMD) != SWI_FUNCTION_RETCODE_SUCCESS ||
+		swi_send_bytes(tx_buffer[SHA204_BUFFER_POS_COUNT], tx_buffer) != SWI_FUNCTION_RETCODE_SUCCESS)
+	{
+		return sha204c_send_and_receive(tx_buffer, sha204_pending.response_size, rx_buffer,
+					sha204_pending.poll_delay, sha204_pending.poll_timeout);
+	}
+	sha204_pending.tx_buffer = tx_buffer;
+	sha204_pending.start = millis();
+	return SHA204_EXECUTING;
+}
+
+uint8_t atsha204_execute_poll(void)
+{
+	uint8_t ret_code;
+	uint8_t *tx_buffer = sha204_pending.tx_buffer;
+	uint8_t *rx_buffer = sha204_pending.rx_buffer;
+	const unsigned long elapsed = millis() - sha204_pending.start;
+
+	if (tx_buffer == NULL)
+		return SHA204_FUNC_FAIL;
+
+	// Leave the device alone for the minimum execution time
+	if (elapsed < sha204_pending.poll_delay)
+		return SHA204_EXECUTING;
+
+	ret_code = sha204p_receive_response(sha204_pending.response_size, rx_buffer);
+	if (ret_code == SHA204_RX_NO_RESPONSE &&
+		elapsed <= (unsigned long)sha204_pending.poll_delay + sha204_pending.poll_timeout)
+		return SHA204_EXECUTING;
+
+	sha204_pending.tx_buffer = NULL;
+	if (ret_code == SHA204_SUCCESS && sha204c_check_crc(rx_buffer) == SHA204_SUCCESS)
+	{
+		// Received non-status response, or a status response without error.
+		if (rx_buffer[SHA204_BUFFER_POS_COUNT] > SHA204_RSP_SIZE_MIN)
+			return SHA204_SUCCESS;
+		switch (rx_buffer[SHA204_BUFFER_POS_STATUS])
+		{
+			case SHA204_STATUS_BYTE_PARSE:
+				return SHA204_PARSE_ERROR;
+			case SHA204_STATUS_BYTE_EXEC:
+				return SHA204_CMD_FAIL;
+			case SHA204_STATUS_BYTE_COMM:
+				break;
+			default:
+				return SHA204_SUCCESS;
+		}
+	}
+
+	// Timeout, communication or CRC error: resend the command the blocking way,
+	// just like atsha204_execute() does.
+	return sha204c_send_and_receive(tx_buffer, sha204_pending.response_size, rx_buffer,
+				sha204_pending.poll_delay, sha204_pending.poll_timeout);
+}
+
 uint8_t atsha204_getSerialNumber(uint8_t * response)
 {
   uint8_t readCommand[READ_COUNT];
@@ -20,6 +20,7 @@
 #define SHA204_RX_FAIL              ((uint8_t)  0xE6) //!< Timed out while waiting for response. Number of bytes received is > 0.
 #define SHA204_RX_NO_RESPONSE       ((uint8_t)  0xE7) //!< Not an error while the Command layer is polling for a command response.
 #define SHA204_RESYNC_WITH_WAKEUP   ((uint8_t)  0xE8) //!< re-synchronization succeeded, but only after generating a Wake-up
+#define SHA204_EXECUTING            ((uint8_t)  0xE9) //!< Command started by atsha204_execute_start() is still executing
 
 #define SHA204_COMM_FAIL            ((uint8_t)  0xF0) //!< Communication with device failed. Same as in hardware dependent modules.
 #define SHA204_TIMEOUT              ((uint8_t)  0xF1) //!< Timed out while waiting for response. Number of bytes received is 0.
@@ -246,6 +247,10 @@ uint8_t atsha204_wakeup(uint8_t *response);
 uint8_t atsha204_execute(uint8_t op_code, uint8_t param1, uint16_t param2,
 												uint8_t datalen1, uint8_t *data1, uint8_t tx_size,
 												uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer);
+uint8_t atsha204_execute_start(uint8_t op_code, uint8_t param1, uint16_t param2,
+												uint8_t datalen1, uint8_t *data1, uint8_t tx_size,
+												uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer);
+uint8_t atsha204_execute_poll(void);
 uint8_t atsha204_getSerialNumber(uint8_t *response);
 
 #endif
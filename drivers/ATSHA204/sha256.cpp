@@ -7,8 +7,15 @@
 #endif
 #include "sha256.h"
 
+#if defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_ESP8266)
+	// 32 bit cores: unrolled rounds, constants read as plain words
+	#define SHA256_WORD_ROUNDS
+	#define SHA256_K_ATTR
+#else
+	#define SHA256_K_ATTR PROGMEM
+#endif
 
-const uint32_t sha256K[] PROGMEM = {
+const uint32_t sha256K[] SHA256_K_ATTR = {
   0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
   0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
   0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
@@ -42,6 +49,56 @@ uint32_t Sha256Class::ror32(uint32_t number, uint8_t bits) {
   return ((number << (32-bits)) | (number >> bits));
 }
 
+#if defined(SHA256_WORD_ROUNDS)
+#define SHA256_ROR(x,n) (((x) >> (n)) | ((x) << (32-(n))))
+#define SHA256_S0(x) (SHA256_ROR(x,2) ^ SHA256_ROR(x,13) ^ SHA256_ROR(x,22))
+#define SHA256_S1(x) (SHA256_ROR(x,6) ^ SHA256_ROR(x,11) ^ SHA256_ROR(x,25))
+#define SHA256_G0(x) (SHA256_ROR(x,7) ^ SHA256_ROR(x,18) ^ ((x) >> 3))
+#define SHA256_G1(x) (SHA256_ROR(x,17) ^ SHA256_ROR(x,19) ^ ((x) >> 10))
+// working variables rotate by renaming, d becomes e and h becomes a
+#define SHA256_ROUND(a,b,c,d,e,f,g,h,k) \
+  t1 = h + SHA256_S1(e) + (g ^ (e & (g ^ f))) + sha256K[k] + w[(k)&15]; \
+  d += t1; \
+  h = t1 + SHA256_S0(a) + ((b & c) | (a & (b | c)));
+
+void Sha256Class::hashBlock() {
+  uint32_t a,b,c,d,e,f,g,h,t1;
+  uint32_t *w = buffer.w;
+
+  a=state.w[0];
+  b=state.w[1];
+  c=state.w[2];
+  d=state.w[3];
+  e=state.w[4];
+  f=state.w[5];
+  g=state.w[6];
+  h=state.w[7];
+
+  for (uint8_t i=0; i<64; i+=8) {
+    if (i>=16) {
+      for (uint8_t j=i; j<i+8; j++) {
+        w[j&15] += SHA256_G1(w[(j-2)&15]) + w[(j-7)&15] + SHA256_G0(w[(j-15)&15]);
+      }
+    }
+    SHA256_ROUND(a,b,c,d,e,f,g,h,i);
+    SHA256_ROUND(h,a,b,c,d,e,f,g,i+1);
+    SHA256_ROUND(g,h,a,b,c,d,e,f,i+2);
+    SHA256_ROUND(f,g,h,a,b,c,d,e,i+3);
+    SHA256_ROUND(e,f,g,h,a,b,c,d,i+4);
+    SHA256_ROUND(d,e,f,g,h,a,b,c,i+5);
+    SHA256_ROUND(c,d,e,f,g,h,a,b,i+6);
+    SHA256_ROUND(b,c,d,e,f,g,h,a,i+7);
+  }
+  state.w[0] += a;
+  state.w[1] += b;
+  state.w[2] += c;
+  state.w[3] += d;
+  state.w[4] += e;
+  state.w[5] += f;
+  state.w[6] += g;
+  state.w[7] += h;
+}
+#else
 void Sha256Class::hashBlock() {
   uint8_t i;
   uint32_t a,b,c,d,e,f,g,h,t1,t2;
@@ -82,6 +139,7 @@ void Sha256Class::hashBlock() {
   state.w[6] += g;
   state.w[7] += h;
 }
+#endif
 
 void Sha256Class::addUncounted(uint8_t data) {
   buffer.b[bufferOffset ^ 3] = data;
@@ -97,6 +155,27 @@ void Sha256Class::write(uint8_t data) {
   addUncounted(data);
 }
 
+void Sha256Class::write(const uint8_t* data, size_t length) {
+  byteCount += length;
+  // fill partial block
+  while (length && bufferOffset) {
+    addUncounted(*data++);
+    length--;
+  }
+  // whole blocks are loaded as big endian words
+  while (length >= BUFFER_SIZE) {
+    for (uint8_t i=0; i<BUFFER_SIZE/4; i++) {
+      buffer.w[i] = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+      data += 4;
+    }
+    hashBlock();
+    length -= BUFFER_SIZE;
+  }
+  while (length--) {
+    addUncounted(*data++);
+  }
+}
+
 void Sha256Class::pad() {
   // Implement SHA-256 padding (fips180-2 §5.1.1)
 
@@ -138,35 +217,44 @@ uint8_t* Sha256Class::result(void) {
 #define HMAC_IPAD 0x36
 #define HMAC_OPAD 0x5c
 
-uint8_t keyBuffer[BLOCK_LENGTH]; // K0 in FIPS-198a
-uint8_t innerHash[HASH_LENGTH];
-
 void Sha256Class::initHmac(const uint8_t* key, int keyLength) {
   uint8_t i;
+  uint8_t keyBuffer[BLOCK_LENGTH]; // K0 in FIPS-198a
   memset(keyBuffer,0,BLOCK_LENGTH);
   if (keyLength > BLOCK_LENGTH) {
     // Hash long keys
     init();
-    for (;keyLength--;) write(*key++);
+    write(key, keyLength);
     memcpy(keyBuffer,result(),HASH_LENGTH);
   } else {
     // Block length keys are used as is
     memcpy(keyBuffer,key,keyLength);
   }
-  // Start inner hash
+  // The pad blocks only depend on the key, keep their states for later HMACs
   init();
-  for (i=0; i<BLOCK_LENGTH; i++) {
-    write(keyBuffer[i] ^ HMAC_IPAD);
-  }
+  for (i=0; i<BLOCK_LENGTH; i++) write(keyBuffer[i] ^ HMAC_OPAD);
+  outerState = state;
+  init();
+  for (i=0; i<BLOCK_LENGTH; i++) write(keyBuffer[i] ^ HMAC_IPAD);
+  innerState = state;
+  memset(keyBuffer,0,BLOCK_LENGTH);
+}
+
+void Sha256Class::initHmac(void) {
+  // Start inner hash
+  state = innerState;
+  byteCount = BLOCK_LENGTH;
+  bufferOffset = 0;
 }
 
 uint8_t* Sha256Class::resultHmac(void) {
-  uint8_t i;
+  uint8_t innerHash[HASH_LENGTH];
   // Complete inner hash
   memcpy(innerHash,result(),HASH_LENGTH);
   // Calculate outer hash
-  init();
-  for (i=0; i<BLOCK_LENGTH; i++) write(keyBuffer[i] ^ HMAC_OPAD);
-  for (i=0; i<HASH_LENGTH; i++) write(innerHash[i]);
+  state = outerState;
+  byteCount = BLOCK_LENGTH;
+  bufferOffset = 0;
+  write(innerHash, HASH_LENGTH);
   return result();
 }
@@ -3,6 +3,7 @@
 #define Sha256_h
 #if !DOXYGEN
 #include <inttypes.h>
+#include <stddef.h>
 
 #define HASH_LENGTH 32
 #define BLOCK_LENGTH 64
@@ -21,9 +22,11 @@ class Sha256Class
   public:
     void init(void);
     void initHmac(const uint8_t* secret, int secretLength);
+    void initHmac(void); // restart HMAC with the key of the last initHmac(secret, ...)
     uint8_t* result(void);
     uint8_t* resultHmac(void);
     void write(uint8_t);
+    void write(const uint8_t* data, size_t length);
   private:
     void pad();
     void addUncounted(uint8_t data);
@@ -33,8 +36,8 @@ class Sha256Class
     uint8_t bufferOffset;
     _state state;
     uint32_t byteCount;
-    uint8_t keyBuffer[BLOCK_LENGTH];
-    uint8_t innerHash[HASH_LENGTH];
+    _state innerState; // state after the K0^ipad block
+    _state outerState; // state after the K0^opad block
 };
 
 #endif
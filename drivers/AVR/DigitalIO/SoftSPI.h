@@ -104,6 +104,22 @@ class SoftSPI {
     transferBit(0, &rxData, txData);
     return rxData;
   }
+  //----------------------------------------------------------------------------
+  /** Soft SPI receive bytes, MOSI is not driven.
+   * @param[out] buf Buffer for data received.
+   * @param[in] count Number of bytes.
+   */
+  void receive(uint8_t* buf, size_t count) {
+    while (count--) *buf++ = receive();
+  }
+  //----------------------------------------------------------------------------
+  /** Soft SPI send bytes, MISO is not sampled.
+   * @param[in] buf Data to send.
+   * @param[in] count Number of bytes.
+   */
+  void send(const uint8_t* buf, size_t count) {
+    while (count--) send(*buf++);
+  }
 
  private:
   //----------------------------------------------------------------------------
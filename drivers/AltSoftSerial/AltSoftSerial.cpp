@@ -46,7 +46,18 @@ static uint16_t rx_target;
 static uint16_t rx_stop_ticks=0;
 static volatile uint8_t rx_buffer_head;
 static volatile uint8_t rx_buffer_tail;
-#define RX_BUFFER_SIZE 80
+static volatile bool rx_overflow = false;
+// sizes can be set before including the driver, indices are single bytes
+#ifndef ALTSS_RX_BUFFER_SIZE
+#define ALTSS_RX_BUFFER_SIZE 80
+#endif
+#ifndef ALTSS_TX_BUFFER_SIZE
+#define ALTSS_TX_BUFFER_SIZE 68
+#endif
+#if ALTSS_RX_BUFFER_SIZE > 255 || ALTSS_TX_BUFFER_SIZE > 255
+#error AltSoftSerial buffers must not exceed 255 bytes
+#endif
+#define RX_BUFFER_SIZE ALTSS_RX_BUFFER_SIZE
 static volatile uint8_t rx_buffer[RX_BUFFER_SIZE];
 
 static volatile uint8_t tx_state=0;
@@ -54,8 +65,9 @@ static uint8_t tx_byte;
 static uint8_t tx_bit;
 static volatile uint8_t tx_buffer_head;
 static volatile uint8_t tx_buffer_tail;
-#define TX_BUFFER_SIZE 68
-static volatile uint8_t tx_buffer[RX_BUFFER_SIZE];
+#define TX_BUFFER_SIZE ALTSS_TX_BUFFER_SIZE
+static volatile uint8_t tx_buffer[TX_BUFFER_SIZE];
+static void (*tx_complete_callback)(void) = NULL;
 
 
 #ifndef INPUT_PULLUP
@@ -166,6 +178,7 @@ ISR(COMPARE_A_INTERRUPT)
 		tx_state = 0;
 		CONFIG_MATCH_NORMAL();
 		DISABLE_INT_COMPARE_A();
+		if (tx_complete_callback) tx_complete_callback();
 	} else {
 		tx_state = 1;
 		if (++tail >= TX_BUFFER_SIZE) tail = 0;
@@ -183,6 +196,16 @@ void AltSoftSerial::flushOutput(void)
 	while (tx_state) /* wait */ ;
 }
 
+bool AltSoftSerial::transmitting(void)
+{
+	return tx_state != 0;
+}
+
+void AltSoftSerial::onTransmitComplete(void (*callback)(void))
+{
+	tx_complete_callback = callback;
+}
+
 
 /****************************************/
 /**            Reception               **/
@@ -227,6 +250,8 @@ ISR(CAPTURE_INTERRUPT)
 				if (head != rx_buffer_tail) {
 					rx_buffer[head] = rx_byte;
 					rx_buffer_head = head;
+				} else {
+					rx_overflow = true;
 				}
 				CONFIG_CAPTURE_FALLING_EDGE();
 				rx_bit = 0;
@@ -257,6 +282,8 @@ ISR(COMPARE_B_INTERRUPT)
 	if (head != rx_buffer_tail) {
 		rx_buffer[head] = rx_byte;
 		rx_buffer_head = head;
+	} else {
+		rx_overflow = true;
 	}
 	rx_state = 0;
 	CONFIG_CAPTURE_FALLING_EDGE();
@@ -303,6 +330,14 @@ void AltSoftSerial::flushInput(void)
 	rx_buffer_head = rx_buffer_tail;
 }
 
+bool AltSoftSerial::overflow(void)
+{
+	const bool r = rx_overflow || timing_error;
+	rx_overflow = false;
+	timing_error = false;
+	return r;
+}
+
 
 #ifdef ALTSS_USE_FTM0
 void ftm0_isr(void)
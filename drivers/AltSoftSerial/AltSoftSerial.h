@@ -60,11 +60,13 @@ public:
 	using Print::write;
 	static void flushInput(); //!< flushInput
 	static void flushOutput(); //!< flushOutput
+	static bool transmitting(); //!< true while bytes are queued or being shifted out
+	static void onTransmitComplete(void (*callback)(void)); //!< callback from ISR after the last stop bit
 	// for drop-in compatibility with NewSoftSerial, rxPin & txPin ignored
 	//AltSoftSerial(uint8_t rxPin, uint8_t txPin, bool inverse = false) { }
 	bool listen() { return false; } //!< listen
 	bool isListening() { return true; } //!< isListening
-	bool overflow() { bool r = timing_error; timing_error = false; return r; } //!< overflow
+	static bool overflow(); //!< true if bytes were dropped (RX buffer full) since the last call
 	static int library_version() { return 1; } //!< library_version
 	static void enable_timer0(bool) { } //!< enable_timer0
 	static bool timing_error; //!< timing_error
@@ -0,0 +1,147 @@
+/**
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * Minimal Arduino API for host builds (ARDUINO_ARCH_NATIVE), see tests/Native.
+ * Only what the MySensors core uses is provided: timing, no-op pins, PROGMEM
+ * access and a Serial backed by stdin/stdout.
+ */
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH			0x1
+#define LOW				0x0
+#define INPUT			0x0
+#define OUTPUT			0x1
+#define INPUT_PULLUP	0x2
+#define CHANGE			1
+#define FALLING			2
+#define RISING			3
+
+#define PROGMEM
+#define PSTR(x) (x)
+#define F(x) (x)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+#define interrupts()
+#define noInterrupts()
+#define digitalPinToInterrupt(p) (p)
+
+// microseconds since first call, i.e. since start like on the boards
+static inline uint64_t _nativeMicros() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	const uint64_t now = (uint64_t)ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+	static const uint64_t start = now;
+	return now - start;
+}
+
+// 32 bit wrap around like the Arduino cores
+static inline uint32_t millis() { return (uint32_t)(_nativeMicros() / 1000); }
+static inline uint32_t micros() { return (uint32_t)_nativeMicros(); }
+static inline void delay(unsigned long ms) { usleep(ms * 1000); }
+static inline void delayMicroseconds(unsigned int us) { usleep(us); }
+
+static inline void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+static inline void digitalWrite(uint8_t pin, uint8_t value) { (void)pin; (void)value; }
+static inline int digitalRead(uint8_t pin) { (void)pin; return HIGH; }
+static inline int analogRead(uint8_t pin) { (void)pin; return 0; }
+static inline void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode) { (void)interrupt; (void)isr; (void)mode; }
+static inline void detachInterrupt(uint8_t interrupt) { (void)interrupt; }
+
+// Arduino core entry points used by MyMainDefault.cpp
+static inline void init() {}
+void serialEventRun(void) __attribute__((weak));
+
+static inline long random(long howbig) { return howbig ? rand() % howbig : 0; }
+static inline long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+static inline void randomSeed(unsigned long seed) { srand(seed); }
+
+static inline char *ltoa(long value, char *buf, int base) {
+	// bases other than 10 and 16 are not used by the core
+	snprintf(buf, 34, base == 16 ? "%lx" : "%ld", value);
+	return buf;
+}
+static inline char *ultoa(unsigned long value, char *buf, int base) {
+	snprintf(buf, 34, base == 16 ? "%lx" : "%lu", value);
+	return buf;
+}
+static inline char *itoa(int value, char *buf, int base) { return ltoa(value, buf, base); }
+static inline char *utoa(unsigned int value, char *buf, int base) { return ultoa(value, buf, base); }
+static inline char *dtostrf(double value, signed char width, unsigned char prec, char *buf) {
+	sprintf(buf, "%*.*f", width, prec, value);
+	return buf;
+}
+
+/**
+ * @brief Serial port on stdin/stdout
+ */
+class NativeSerial {
+public:
+	void begin(unsigned long baud) { (void)baud; setvbuf(stdout, NULL, _IOLBF, 0); }
+	int available() {
+		struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+		return poll(&fd, 1, 0) > 0 && (fd.revents & POLLIN) ? 1 : 0;
+	}
+	int read() {
+		uint8_t c;
+		return ::read(STDIN_FILENO, &c, 1) == 1 ? c : -1;
+	}
+	int availableForWrite() {
+		// room of a UART transmit buffer, if stdout takes data
+		struct pollfd fd = { STDOUT_FILENO, POLLOUT, 0 };
+		return poll(&fd, 1, 0) > 0 && (fd.revents & POLLOUT) ? 64 : 0;
+	}
+	size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+	size_t write(const uint8_t *buf, size_t len) { return fwrite(buf, 1, len, stdout); }
+	size_t print(const char *s) { return fputs(s, stdout) == EOF ? 0 : strlen(s); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(int n) { return printf("%d", n); }
+	size_t print(unsigned int n) { return printf("%u", n); }
+	size_t print(long n) { return printf("%ld", n); }
+	size_t print(unsigned long n) { return printf("%lu", n); }
+	size_t println() { return print("\n"); }
+	template <typename T> size_t println(T value) { return print(value) + println(); }
+	void flush() { fflush(stdout); }
+	operator bool() { return true; }
+};
+
+extern NativeSerial Serial;
+
+#endif
@@ -9,6 +9,11 @@
 
 PubSubClient::PubSubClient() {
     this->_state = MQTT_DISCONNECTED;
+    this->segmentCallback = NULL;
+    this->ackCallback = NULL;
+#ifdef MQTT_OUT_BUFFER_SIZE
+    this->outLength = 0;
+#endif
     this->_client = NULL;
     this->stream = NULL;
     setCallback(NULL);
@@ -124,6 +129,9 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
         }
         if (result == 1) {
             nextMsgId = 1;
+#ifdef MQTT_OUT_BUFFER_SIZE
+            outLength = 0;
+#endif
             // Leave room in the buffer for header and variable length field
             uint16_t length = 5;
             unsigned int j;
@@ -229,6 +237,26 @@ boolean PubSubClient::readByte(uint8_t * result, uint16_t * index){
   return false;
 }
 
+// reads length bytes into result, as many per client call as are available
+boolean PubSubClient::readBytes(uint8_t * result, uint16_t length) {
+   uint32_t previousMillis = millis();
+   while (length) {
+     int avail = _client->available();
+     int got = 0;
+     if (avail > 0) {
+       got = _client->read(result, avail < length ? avail : length);
+     }
+     if (got > 0) {
+       result += got;
+       length -= got;
+       previousMillis = millis();
+     } else if (millis() - previousMillis >= ((int32_t) MQTT_SOCKET_TIMEOUT * 1000)) {
+       return false;
+     }
+   }
+   return true;
+}
+
 uint16_t PubSubClient::readPacket(uint8_t* lengthLength) {
     uint16_t len = 0;
     if(!readByte(buffer, &len)) return 0;
@@ -259,17 +287,31 @@ uint16_t PubSubClient::readPacket(uint8_t* lengthLength) {
         }
     }
 
-    for (uint16_t i = start;i<length;i++) {
-        if(!readByte(&digit)) return 0;
-        if (this->stream) {
+    if (this->stream) {
+        for (uint16_t i = start;i<length;i++) {
+            if(!readByte(&digit)) return 0;
             if (isPublish && len-*lengthLength-2>skip) {
                 this->stream->write(digit);
             }
+            if (len < MQTT_MAX_PACKET_SIZE) {
+                buffer[len] = digit;
+            }
+            len++;
         }
-        if (len < MQTT_MAX_PACKET_SIZE) {
-            buffer[len] = digit;
+    } else {
+        // the part that fits goes to the buffer in bulk
+        uint16_t remaining = length > start ? length - start : 0;
+        uint16_t fit = len < MQTT_MAX_PACKET_SIZE ? MQTT_MAX_PACKET_SIZE - len : 0;
+        if (fit > remaining) {
+            fit = remaining;
+        }
+        if(!readBytes(buffer + len, fit)) return 0;
+        len += fit;
+        // drain an oversized packet
+        for (uint16_t i = fit;i<remaining;i++) {
+            if(!readByte(&digit)) return 0;
+            len++;
         }
-        len++;
     }
 
     if (!this->stream && len > MQTT_MAX_PACKET_SIZE) {
@@ -305,18 +347,38 @@ boolean PubSubClient::loop() {
                 lastInActivity = t;
                 uint8_t type = buffer[0]&0xF0;
                 if (type == MQTTPUBLISH) {
-                    if (callback) {
-                        uint16_t tl = (buffer[llen+1]<<8)+buffer[llen+2];
-                        char topic[tl+1];
-                        for (uint16_t i=0;i<tl;i++) {
-                            topic[i] = buffer[llen+3+i];
+                    uint16_t tl = (buffer[llen+1]<<8)+buffer[llen+2];
+                    if ((callback || segmentCallback) && llen+3+tl <= len) {
+                        // move the topic over its length field to terminate it in place
+                        memmove(buffer+llen+2,buffer+llen+3,tl);
+                        buffer[llen+2+tl] = 0;
+                        char *topic = (char*) buffer+llen+2;
+                        MQTTSegment segments[MQTT_MAX_TOPIC_SEGMENTS];
+                        uint8_t count = 0;
+                        if (segmentCallback) {
+                            // split from the last level, the first segment keeps the rest
+                            uint16_t end = tl;
+                            for (uint16_t i = tl; i > 0 && count < MQTT_MAX_TOPIC_SEGMENTS-1; i--) {
+                                if (topic[i-1] == '/') {
+                                    count++;
+                                    segments[MQTT_MAX_TOPIC_SEGMENTS-count].str = topic+i;
+                                    segments[MQTT_MAX_TOPIC_SEGMENTS-count].length = end-i;
+                                    end = i-1;
+                                }
+                            }
+                            count++;
+                            segments[MQTT_MAX_TOPIC_SEGMENTS-count].str = topic;
+                            segments[MQTT_MAX_TOPIC_SEGMENTS-count].length = end;
                         }
-                        topic[tl] = 0;
                         // msgId only present for QOS>0
                         if ((buffer[0]&0x06) == MQTTQOS1) {
                             msgId = (buffer[llen+3+tl]<<8)+buffer[llen+3+tl+1];
                             payload = buffer+llen+3+tl+2;
-                            callback(topic,payload,len-llen-3-tl-2);
+                            if (segmentCallback) {
+                                segmentCallback(topic,segments+MQTT_MAX_TOPIC_SEGMENTS-count,count,payload,len-llen-3-tl-2);
+                            } else {
+                                callback(topic,payload,len-llen-3-tl-2);
+                            }
 
                             buffer[0] = MQTTPUBACK;
                             buffer[1] = 2;
@@ -327,9 +389,17 @@ boolean PubSubClient::loop() {
 
                         } else {
                             payload = buffer+llen+3+tl;
-                            callback(topic,payload,len-llen-3-tl);
+                            if (segmentCallback) {
+                                segmentCallback(topic,segments+MQTT_MAX_TOPIC_SEGMENTS-count,count,payload,len-llen-3-tl);
+                            } else {
+                                callback(topic,payload,len-llen-3-tl);
+                            }
                         }
                     }
+                } else if (type == MQTTPUBACK) {
+                    if (ackCallback && len >= 4) {
+                        ackCallback((buffer[2]<<8)+buffer[3]);
+                    }
                 } else if (type == MQTTPINGREQ) {
                     buffer[0] = MQTTPINGRESP;
                     buffer[1] = 0;
@@ -357,14 +427,25 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
 }
 
 boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
+    return publish(topic, payload, plength, retained, 0, 0, false);
+}
+
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained, uint8_t qos, uint16_t msgId, boolean dup) {
+    if (qos > 1) {
+        return false;
+    }
     if (connected()) {
-        if (MQTT_MAX_PACKET_SIZE < 5 + 2+strlen(topic) + plength) {
+        if (MQTT_MAX_PACKET_SIZE < 5 + 2+strlen(topic) + (qos ? 2 : 0) + plength) {
             // Too long
             return false;
         }
         // Leave room in the buffer for header and variable length field
         uint16_t length = 5;
         length = writeString(topic,buffer,length);
+        if (qos) {
+            buffer[length++] = (msgId >> 8);
+            buffer[length++] = (msgId & 0xFF);
+        }
         uint16_t i;
         for (i=0;i<plength;i++) {
             buffer[length++] = payload[i];
@@ -373,11 +454,38 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
         if (retained) {
             header |= 1;
         }
+        if (qos) {
+            header |= MQTTQOS1;
+        }
+        if (dup) {
+            header |= 8;
+        }
         return write(header,buffer,length-5);
     }
     return false;
 }
 
+uint16_t PubSubClient::newMessageId() {
+    nextMsgId++;
+    if (nextMsgId == 0) {
+        nextMsgId = 1;
+    }
+    return nextMsgId;
+}
+
+boolean PubSubClient::flush() {
+#ifdef MQTT_OUT_BUFFER_SIZE
+    if (outLength) {
+        const uint16_t rc = _client->write(outBuffer,outLength);
+        const boolean result = (rc == outLength);
+        outLength = 0;
+        lastOutActivity = millis();
+        return result;
+    }
+#endif
+    return true;
+}
+
 boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
     uint8_t llen = 0;
     uint8_t digit;
@@ -445,6 +553,22 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
         buf[5-llen+i] = lenBuf[i];
     }
 
+#ifdef MQTT_OUT_BUFFER_SIZE
+    if ((header & 0xF0) == MQTTPUBLISH && length+1+llen <= MQTT_OUT_BUFFER_SIZE) {
+        // coalesce with other PUBLISH packets
+        if (outLength+length+1+llen > MQTT_OUT_BUFFER_SIZE && !flush()) {
+            return false;
+        }
+        memcpy(outBuffer+outLength,buf+(4-llen),length+1+llen);
+        outLength += length+1+llen;
+        return true;
+    }
+    // keep packet order
+    if (!flush()) {
+        return false;
+    }
+#endif
+
 #ifdef MQTT_MAX_TRANSFER_SIZE
     uint8_t* writeBuf = buf+(4-llen);
     uint16_t bytesRemaining = length+1+llen;  //Match the length type
@@ -481,10 +605,7 @@ boolean PubSubClient::subscribe(const char* topic, uint8_t qos) {
     if (connected()) {
         // Leave room in the buffer for header and variable length field
         uint16_t length = 5;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
-        }
+        newMessageId();
         buffer[length++] = (nextMsgId >> 8);
         buffer[length++] = (nextMsgId & 0xFF);
         length = writeString((char*)topic, buffer,length);
@@ -514,6 +635,7 @@ boolean PubSubClient::unsubscribe(const char* topic) {
 }
 
 void PubSubClient::disconnect() {
+    flush();
     buffer[0] = MQTTDISCONNECT;
     buffer[1] = 0;
     _client->write(buffer,2);
@@ -576,8 +698,23 @@ PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
     return *this;
 }
 
+PubSubClient& PubSubClient::setSegmentCallback(MQTT_SEGMENT_CALLBACK_SIGNATURE) {
+    this->segmentCallback = segmentCallback;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setAckCallback(void (*ackCallback)(uint16_t)) {
+    this->ackCallback = ackCallback;
+    return *this;
+}
+
 PubSubClient& PubSubClient::setClient(Client& client){
     this->_client = &client;
+    this->segmentCallback = NULL;
+    this->ackCallback = NULL;
+#ifdef MQTT_OUT_BUFFER_SIZE
+    this->outLength = 0;
+#endif
     return *this;
 }
 
@@ -36,11 +36,22 @@
 #define MQTT_SOCKET_TIMEOUT 15
 #endif
 
+// MQTT_OUT_BUFFER_SIZE : coalesce PUBLISH packets into one network write of
+//  up to this many bytes. Buffered packets are written when the buffer is full,
+//  before any other packet and on flush(). Leave undefined to write every packet.
+//#define MQTT_OUT_BUFFER_SIZE 256
+
 // MQTT_MAX_TRANSFER_SIZE : limit how much data is passed to the network client
 //  in each write call. Needed for the Arduino Wifi Shield. Leave undefined to
 //  pass the entire MQTT packet in each write call.
 //#define MQTT_MAX_TRANSFER_SIZE 80
 
+// MQTT_MAX_TOPIC_SEGMENTS : topic levels handed to the segment callback. Topics
+//  with more levels are split from the end, the first segment keeps the rest.
+#ifndef MQTT_MAX_TOPIC_SEGMENTS
+#define MQTT_MAX_TOPIC_SEGMENTS 8
+#endif
+
 // Possible values for client.state()
 #define MQTT_CONNECTION_TIMEOUT     -4
 #define MQTT_CONNECTION_LOST        -3
@@ -80,6 +91,14 @@
 #define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
 #endif
 
+/** Topic level of a received PUBLISH, points into the packet buffer */
+struct MQTTSegment {
+   const char* str; //!< first character, not terminated
+   uint16_t length; //!< number of characters
+};
+
+#define MQTT_SEGMENT_CALLBACK_SIGNATURE void (*segmentCallback)(char*, const MQTTSegment*, uint8_t, uint8_t*, unsigned int)
+
 /** PubSubClient class */
 class PubSubClient {
 private:
@@ -90,9 +109,16 @@ private:
    unsigned long lastInActivity;
    bool pingOutstanding;
    MQTT_CALLBACK_SIGNATURE;
+   MQTT_SEGMENT_CALLBACK_SIGNATURE;
+   void (*ackCallback)(uint16_t);
+#ifdef MQTT_OUT_BUFFER_SIZE
+   uint8_t outBuffer[MQTT_OUT_BUFFER_SIZE];
+   uint16_t outLength;
+#endif
    uint16_t readPacket(uint8_t*);
    boolean readByte(uint8_t * result);
    boolean readByte(uint8_t * result, uint16_t * index);
+   boolean readBytes(uint8_t * result, uint16_t length);
    boolean write(uint8_t header, uint8_t* buf, uint16_t length);
    uint16_t writeString(const char* string, uint8_t* buf, uint16_t pos);
    IPAddress ip;
@@ -120,6 +146,8 @@ public:
    PubSubClient& setServer(uint8_t * ip, uint16_t port); //!< setServer
    PubSubClient& setServer(const char * domain, uint16_t port); //!< setServer
    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE); //!< setCallback
+   PubSubClient& setSegmentCallback(MQTT_SEGMENT_CALLBACK_SIGNATURE); //!< setSegmentCallback, called instead of the callback with the topic split into levels
+   PubSubClient& setAckCallback(void (*ackCallback)(uint16_t)); //!< setAckCallback, called with message id of every PUBACK
    PubSubClient& setClient(Client& client); //!< setClient
    PubSubClient& setStream(Stream& stream); //!< setStream
 
@@ -132,6 +160,9 @@ public:
    boolean publish(const char* topic, const char* payload, boolean retained); //!< publish
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength); //!< publish
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained); //!< publish
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained, uint8_t qos, uint16_t msgId, boolean dup); //!< publish with QoS 0 or 1
+   uint16_t newMessageId(); //!< newMessageId, id for next QoS 1 publish
+   boolean flush(); //!< flush, write buffered PUBLISH packets (MQTT_OUT_BUFFER_SIZE)
    boolean publish_P(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained); //!< publish_P
    boolean subscribe(const char* topic); //!< subscribe
    boolean subscribe(const char* topic, uint8_t qos); //!< subscribe
@@ -24,13 +24,19 @@
 
 LOCAL uint8_t MY_RF24_BASE_ADDR[MY_RF24_ADDR_WIDTH] = { MY_RF24_BASE_RADIO_ID };
 LOCAL uint8_t MY_RF24_NODE_ADDRESS = AUTO;
+LOCAL uint8_t RF24_txStatus = RF24_TX_IDLE;
+LOCAL uint8_t RF24_txAddressLSB = BROADCAST_ADDRESS;
+LOCAL uint32_t RF24_txStart;
+#if defined(MY_RF24_IRQ_PIN)
+	LOCAL RF24_receiveCallbackType RF24_receiveCallback = NULL;
+#endif
 
 LOCAL void RF24_csn(bool level) {
-	digitalWrite(MY_RF24_CS_PIN, level);		
+	hwDigitalWrite(MY_RF24_CS_PIN, level);
 }
 
 LOCAL void RF24_ce(bool level) {
-	digitalWrite(MY_RF24_CE_PIN, level);
+	hwDigitalWrite(MY_RF24_CE_PIN, level);
 }
 
 LOCAL uint8_t RF24_spiMultiByteTransfer(uint8_t cmd, uint8_t* buf, uint8_t len, bool aReadMode) {
@@ -38,10 +44,27 @@ LOCAL uint8_t RF24_spiMultiByteTransfer(uint8_t cmd, uint8_t* buf, uint8_t len,
 	#if !defined(MY_SOFTSPI)
 		_SPI.beginTransaction(SPISettings(MY_RF24_SPI_MAX_SPEED, MY_RF24_SPI_DATA_ORDER, MY_RF24_SPI_DATA_MODE));
 	#endif
+	// no guard delays needed, CSN setup/hold and inactive times are in the ns range
 	RF24_csn(LOW);
-	// timing
-	delayMicroseconds(10);
 	uint8_t status = _SPI.transfer( cmd );
+	#if defined(MY_SOFTSPI)
+		if (buf != NULL && len > 1) {
+			// payload in one burst, reads leave MOSI alone and writes skip sampling MISO
+			if (aReadMode) {
+				_SPI.receive(buf, len);
+				status = buf[len - 1];
+			} else _SPI.send(buf, len);
+			len = 0;
+		}
+	#else
+		if (aReadMode && buf != NULL && len > 1) {
+			// read payload in one burst, in place
+			memset(buf, NOP, len);
+			_SPI.transfer(buf, len);
+			status = buf[len - 1];
+			len = 0;
+		}
+	#endif
 	while ( len-- ) {
 		if (aReadMode) {		
 			status = _SPI.transfer( NOP );
@@ -52,8 +75,6 @@ LOCAL uint8_t RF24_spiMultiByteTransfer(uint8_t cmd, uint8_t* buf, uint8_t len,
 	#if !defined(MY_SOFTSPI)
 		_SPI.endTransaction();
 	#endif
-	// timing
-	delayMicroseconds(10);
 	return status;
 } 
 
@@ -102,6 +123,41 @@ LOCAL void RF24_setRFSetup(uint8_t RFsetup) {
 	RF24_writeByteRegister(RF_SETUP, RFsetup);
 }
 
+LOCAL void RF24_setPALevel(uint8_t level) {
+	RF24_setRFSetup(((uint8_t)(MY_RF24_RF_SETUP) & ~RF24_RF_SETUP_PA_MASK) | (level << 1));
+}
+
+LOCAL uint8_t RF24_getRetransmissions(void) {
+	// ARC_CNT of the last frame, reset when a new frame is sent
+	return RF24_readByteRegister(OBSERVE_TX) & 0x0F;
+}
+
+LOCAL bool RF24_getReceivedPowerDetector(void) {
+	// RPD: last frame received above -64dBm, latched until the next frame
+	return RF24_readByteRegister(RPD) & 0x01;
+}
+
+#if defined(MY_RF24_CSMA)
+// RPD is latched by the last valid frame: if set, RX is restarted and RPD sampled again after Tstby2a + Tdelay_AGC
+LOCAL bool RF24_isChannelClear(void) {
+	if (!RF24_getReceivedPowerDetector()) return true;
+	RF24_ce(LOW);
+	RF24_ce(HIGH);
+	delayMicroseconds(170);
+	return !RF24_getReceivedPowerDetector();
+}
+#endif
+
+LOCAL void RF24_writeAckPayload(const void* buf, uint8_t len) {
+	// returned with the ACK of the next frame received on the node pipe, TX FIFO holds up to 3 payloads
+	RF24_spiMultiByteTransfer( W_ACK_PAYLOAD | NODE_PIPE, (uint8_t*)buf, len, false );
+}
+
+LOCAL bool RF24_isAckPayloadSent(void) {
+	// in PRX the TX FIFO only holds ACK payloads
+	return RF24_readByteRegister(FIFO_STATUS) & _BV(TX_EMPTY);
+}
+
 LOCAL void RF24_setFeature(uint8_t feature) {
 	RF24_writeByteRegister(FEATURE, feature);
 }
@@ -138,10 +194,15 @@ LOCAL void RF24_enableFeatures(void) {
 }
 
 LOCAL void RF24_openWritingPipe(uint8_t recipient) {	
+	// RX0 is reset to node address when listening, TX address is kept
+	if (recipient == RF24_txAddressLSB && MY_RF24_NODE_ADDRESS == AUTO) return;
 	RF24_DEBUG(PSTR("RF24:open writing pipe, recipient=%d\n"), recipient);	
 	// only write LSB of RX0 and TX pipe
 	RF24_setPipeLSB(RX_ADDR_P0, recipient);
-	RF24_setPipeLSB(TX_ADDR, recipient);
+	if (recipient != RF24_txAddressLSB) {
+		RF24_setPipeLSB(TX_ADDR, recipient);
+		RF24_txAddressLSB = recipient;
+	}
 }
 
 LOCAL void RF24_startListening(void) {
@@ -165,14 +226,23 @@ LOCAL void RF24_stopListening(void) {
 }
 
 LOCAL void RF24_powerDown(void) {
+	// abort transmission in flight
+	if (RF24_txStatus == RF24_TX_PENDING) RF24_txStatus = RF24_TX_FAIL;
 	RF24_ce(LOW);
 	RF24_setRFConfiguration(MY_RF24_CONFIGURATION);
 	RF24_DEBUG(PSTR("RF24:power down\n"));
 }
 
-LOCAL bool RF24_sendMessage( uint8_t recipient, const void* buf, uint8_t len ) {
-	uint8_t status;
-
+LOCAL bool RF24_sendMessageAsync( uint8_t recipient, const void* buf, uint8_t len ) {
+	// previous transmission still in flight
+	if (RF24_txStatus == RF24_TX_PENDING) return false;
+	#if defined(MY_RF24_CSMA)
+		// listen before talk, send anyway after the last attempt
+		for (uint8_t attempt = 0; attempt < MY_RF24_CSMA_ATTEMPTS && !RF24_isChannelClear(); attempt++) {
+			RF24_DEBUG(PSTR("RF24:channel busy\n"));
+			delayMicroseconds(random((long)MY_RF24_CSMA_BACKOFF_US << attempt));
+		}
+	#endif
 	RF24_stopListening();
 	RF24_openWritingPipe( recipient );		
 	RF24_DEBUG(PSTR("RF24:send message to %d, len=%d\n"),recipient,len);
@@ -184,25 +254,44 @@ LOCAL bool RF24_sendMessage( uint8_t recipient, const void* buf, uint8_t len ) {
 	RF24_spiMultiByteTransfer( W_TX_PAYLOAD, (uint8_t*)buf, len, false );
 	// go, TX starts after ~10us
 	RF24_ce(HIGH);
-	// timeout counter to detect HW issues
-	uint16_t timeout = 0xFFFF;
-	do {
-		status = RF24_getStatus();
-	} while  (!(status & ( _BV(MAX_RT) | _BV(TX_DS) )) && timeout--);
-	// timeout value after successful TX on 16Mhz AVR ~ 65500, i.e. msg is transmitted after ~36 loop cycles
-	RF24_ce(LOW);
-	// reset interrupts
-	RF24_setStatus(_BV(TX_DS) | _BV(MAX_RT) );
-	// Max retries exceeded
-	if( status & _BV(MAX_RT)){
-		// flush packet
-		RF24_DEBUG(PSTR("RF24:MAX_RT\n"));
-		RF24_flushTX();
+	RF24_txStart = millis();
+	RF24_txStatus = RF24_TX_PENDING;
+	return true;
+}
+
+LOCAL uint8_t RF24_getSendStatus(void) {
+	if (RF24_txStatus == RF24_TX_PENDING) {
+		uint8_t status = RF24_getStatus();
+		// timeout to detect HW issues
+		bool timeout = (millis() - RF24_txStart) > RF24_TX_TIMEOUT_MS;
+		if ( (status & ( _BV(MAX_RT) | _BV(TX_DS) )) || timeout ) {
+			RF24_ce(LOW);
+			// reset interrupts
+			RF24_setStatus(_BV(TX_DS) | _BV(MAX_RT) );
+			// Max retries exceeded
+			if( status & _BV(MAX_RT)){
+				// flush packet
+				RF24_DEBUG(PSTR("RF24:MAX_RT\n"));
+				RF24_flushTX();
+			}
+			RF24_startListening();
+			// OK if message sent and not timeout
+			RF24_txStatus = (status & _BV(TX_DS)) ? RF24_TX_OK : RF24_TX_FAIL;
+		}
 	}
-		
-	RF24_startListening();
-	// true if message sent and not timeout
-	return (status & _BV(TX_DS) && timeout);
+	return RF24_txStatus;
+}
+
+LOCAL bool RF24_sendMessage( uint8_t recipient, const void* buf, uint8_t len ) {
+	// complete pending async transmission
+	while (RF24_getSendStatus() == RF24_TX_PENDING);
+	RF24_txStatus = RF24_TX_IDLE;
+	(void)RF24_sendMessageAsync(recipient, buf, len);
+	// msg is transmitted after ~36 status polls on 16Mhz AVR
+	while (RF24_getSendStatus() == RF24_TX_PENDING);
+	const bool result = (RF24_txStatus == RF24_TX_OK);
+	RF24_txStatus = RF24_TX_IDLE;
+	return result;
 }
 
 LOCAL uint8_t RF24_getDynamicPayloadSize(void) {
@@ -232,6 +321,38 @@ LOCAL uint8_t RF24_readMessage( void* buf) {
 	return len;
 }
 
+#if defined(MY_RF24_IRQ_PIN)
+LOCAL void RF24_irqHandler(void) {
+	if (RF24_receiveCallback) {
+		#if defined(MY_GATEWAY_SERIAL)
+			// draining the FIFO takes several 100us, allow nested interrupts to prevent serial RX overruns
+			// own handler is detached to prevent recursion, a pending edge is handled after re-attaching
+			detachInterrupt(digitalPinToInterrupt(MY_RF24_IRQ_PIN));
+			interrupts();
+		#endif
+		// read FIFO until empty, acc. to datasheet: read payload, clear RX_DR, read FIFO status, repeat if more data
+		while (RF24_isDataAvailable()) {
+			// callback must call RF24_readMessage(), which clears RX_DR
+			RF24_receiveCallback();
+		}
+		#if defined(MY_GATEWAY_SERIAL)
+			noInterrupts();
+			attachInterrupt(digitalPinToInterrupt(MY_RF24_IRQ_PIN), RF24_irqHandler, FALLING);
+		#endif
+	}
+	else {
+		// no receiver registered, clear RX interrupt
+		RF24_setStatus(_BV(RX_DR));
+	}
+}
+
+LOCAL void RF24_registerReceiveCallback(RF24_receiveCallbackType cb) {
+	noInterrupts();
+	RF24_receiveCallback = cb;
+	interrupts();
+}
+#endif
+
 LOCAL void RF24_setNodeAddress(uint8_t address) {
 	if(address!=AUTO){
 		MY_RF24_NODE_ADDRESS = address;
@@ -248,7 +369,12 @@ LOCAL uint8_t RF24_getNodeID(void) {
 
 LOCAL bool RF24_sanityCheck(void) {
 	// detect HW defect ot interrupted SPI line, CE disconnect cannot be detected
-	bool status = RF24_readByteRegister(RF_SETUP) == MY_RF24_RF_SETUP;
+	#if defined(MY_TRANSPORT_ATC)
+		// PA level is adjusted per link
+		bool status = (RF24_readByteRegister(RF_SETUP) & ~RF24_RF_SETUP_PA_MASK) == ((uint8_t)(MY_RF24_RF_SETUP) & ~RF24_RF_SETUP_PA_MASK);
+	#else
+		bool status = RF24_readByteRegister(RF_SETUP) == MY_RF24_RF_SETUP;
+	#endif
 	status &= RF24_readByteRegister(RF_CH) == MY_RF24_CHANNEL;
 	return status;
 }
@@ -259,6 +385,11 @@ LOCAL bool RF24_initialize(void) {
 	pinMode(MY_RF24_CS_PIN,OUTPUT);
 	// Initialize SPI
 	_SPI.begin();
+	#if defined(MY_RF24_IRQ_PIN)
+		pinMode(MY_RF24_IRQ_PIN, INPUT);
+		// SPI transactions in main loop must not be interrupted by the ISR
+		_SPI.usingInterrupt(digitalPinToInterrupt(MY_RF24_IRQ_PIN));
+	#endif
 	RF24_ce(LOW);
 	RF24_csn(HIGH);
 	// CRC and power up
@@ -296,11 +427,16 @@ LOCAL bool RF24_initialize(void) {
 	// pipe 0, set full address, later only LSB is updated
 	RF24_setPipeAddress(RX_ADDR_P0, (uint8_t*)&MY_RF24_BASE_ADDR, MY_RF24_ADDR_WIDTH);
 	RF24_setPipeAddress(TX_ADDR, (uint8_t*)&MY_RF24_BASE_ADDR, MY_RF24_ADDR_WIDTH);
+	RF24_txAddressLSB = MY_RF24_BASE_ADDR[0];
 	// reset FIFO
 	RF24_flushRX();
 	RF24_flushTX();
 	// reset interrupts
 	RF24_setStatus(_BV(TX_DS) | _BV(MAX_RT) | _BV(RX_DR));
+	#if defined(MY_RF24_IRQ_PIN)
+		// IRQ is active low
+		attachInterrupt(digitalPinToInterrupt(MY_RF24_IRQ_PIN), RF24_irqHandler, FALLING);
+	#endif
 	return true;
 }
 
@@ -61,12 +61,27 @@
 	#endif
 #endif
 
+#if defined(MY_RF24_IRQ_PIN)
+	#if defined(MY_SOFTSPI)
+		#error MY_RF24_IRQ_PIN requires hardware SPI (SPI transactions), disable MY_SOFTSPI
+	#endif
+	#if defined(ARDUINO_ARCH_ESP8266)
+		#error MY_RF24_IRQ_PIN is not supported on ESP8266
+	#endif
+#endif
+
 // RF24 settings
-#define MY_RF24_CONFIGURATION (uint8_t) (RF24_CRC_16 << 2)
+#if defined(MY_RF24_IRQ_PIN)
+	// IRQ pin only asserted on RX_DR, TX_DS and MAX_RT are masked
+	#define MY_RF24_CONFIGURATION (uint8_t) ( (RF24_CRC_16 << 2) | _BV(MASK_TX_DS) | _BV(MASK_MAX_RT) )
+#else
+	#define MY_RF24_CONFIGURATION (uint8_t) (RF24_CRC_16 << 2)
+#endif
 #define MY_RF24_FEATURE (uint8_t)( _BV(EN_DPL) | _BV(EN_ACK_PAY) )
 #define MY_RF24_RF_SETUP (uint8_t)( ((MY_RF24_DATARATE & 0b10 ) << 4) | ((MY_RF24_DATARATE & 0b01 ) << 3) | (MY_RF24_PA_LEVEL << 1) ) + 1 // +1 for Si24R1
+#define RF24_RF_SETUP_PA_MASK (uint8_t)(0b11 << 1) // PA level bits, changed at runtime by MY_TRANSPORT_ATC
 
-// pipes
+// pipes, 2..5 unused: addresses differ in the LSB only, which is the node ID (see MY_RF24_BASE_RADIO_ID)
 #define BROADCAST_PIPE 1
 #define NODE_PIPE 0
 
@@ -99,6 +114,15 @@
 // ARD, auto retry count
 #define RF24_ARC 15
 
+// TX timeout to detect HW issues, worst case ARC * ARD + air time is ~25ms
+#define RF24_TX_TIMEOUT_MS 100
+
+// async TX status
+#define RF24_TX_IDLE		0
+#define RF24_TX_PENDING		1
+#define RF24_TX_OK			2
+#define RF24_TX_FAIL		3
+
 // nRF24L01(+) register definitions
 #define NRF_CONFIG  0x00
 #define EN_AA       0x01
@@ -227,6 +251,8 @@ LOCAL void RF24_startListening(void);
 LOCAL void RF24_stopListening(void);
 LOCAL void RF24_powerDown(void); 
 LOCAL bool RF24_sendMessage(uint8_t recipient, const void* buf, uint8_t len);
+LOCAL bool RF24_sendMessageAsync(uint8_t recipient, const void* buf, uint8_t len);
+LOCAL uint8_t RF24_getSendStatus(void);
 LOCAL uint8_t RF24_getDynamicPayloadSize(void);
 LOCAL bool RF24_isDataAvailable();
 LOCAL uint8_t RF24_readMessage(void* buf); 
@@ -238,6 +264,14 @@ LOCAL void RF24_setChannel(uint8_t channel);
 LOCAL void RF24_setRetries(uint8_t retransmitDelay, uint8_t retransmitCount);
 LOCAL void RF24_setAddressWidth(uint8_t width);
 LOCAL void RF24_setRFSetup(uint8_t RFsetup);
+LOCAL void RF24_setPALevel(uint8_t level);
+LOCAL uint8_t RF24_getRetransmissions(void);
+LOCAL bool RF24_getReceivedPowerDetector(void);
+#if defined(MY_RF24_CSMA)
+LOCAL bool RF24_isChannelClear(void);
+#endif
+LOCAL void RF24_writeAckPayload(const void* buf, uint8_t len);
+LOCAL bool RF24_isAckPayloadSent(void);
 LOCAL void RF24_setFeature(uint8_t feature);
 LOCAL void RF24_setPipe(uint8_t pipe);
 LOCAL void RF24_setAutoACK(uint8_t pipe);
@@ -248,4 +282,11 @@ LOCAL void RF24_setPipeLSB(uint8_t pipe, uint8_t LSB);
 LOCAL void RF24_setStatus(uint8_t status);
 LOCAL void RF24_enableFeatures(void);
 
+#if defined(MY_RF24_IRQ_PIN)
+	// receive callback, called from ISR for each frame in RX FIFO. Must call RF24_readMessage() to clear RX_DR
+	typedef void (*RF24_receiveCallbackType)(void);
+	LOCAL void RF24_registerReceiveCallback(RF24_receiveCallbackType cb);
+	LOCAL void RF24_irqHandler(void);
+#endif
+
 #endif // __RF24_H__
\ No newline at end of file
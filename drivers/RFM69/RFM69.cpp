@@ -32,6 +32,13 @@
 #include "RFM69registers.h"
 #include <SPI.h>
 
+// With SPI transactions only the radio IRQ is masked while the bus is in use (SPI.usingInterrupt()),
+// instead of all interrupts around every radio access. Only the AVR and SAMD cores implement
+// usingInterrupt(), ESP8266 has transactions without it and keeps the cli() guard
+#if defined(SPI_HAS_TRANSACTION) && (defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_SAMD)) && !defined(MY_RFM69_DEFERRED_IRQ)
+#define RF69_SPI_GUARD_IRQ
+#endif
+
 volatile uint8_t RFM69::DATA[RF69_MAX_DATA_LEN];
 volatile uint8_t RFM69::_mode;        // current transceiver state
 volatile uint8_t RFM69::DATALEN;
@@ -42,6 +49,9 @@ volatile uint8_t RFM69::ACK_REQUESTED;
 volatile uint8_t RFM69::ACK_RECEIVED; // should be polled immediately after sending a packet with ACK request
 volatile int16_t RFM69::RSSI;          // most accurate RSSI during reception (closest to the reception)
 RFM69* RFM69::selfPointer;
+#if defined(MY_RFM69_DEFERRED_IRQ)
+volatile bool RFM69::_irqPending;    // set by ISR, handled by receiveDone()/canSend()
+#endif
 
 bool RFM69::initialize(uint8_t freqBand, uint8_t nodeID, uint8_t networkID)
 {
@@ -117,6 +127,10 @@ bool RFM69::initialize(uint8_t freqBand, uint8_t nodeID, uint8_t networkID)
   } // wait for ModeReady
   if (millis()-start >= timeout)
     return false;
+#if defined(RF69_SPI_GUARD_IRQ)
+  // SPI transactions of all devices on the bus mask the radio IRQ, the ISR talks to the radio as well
+  SPI.usingInterrupt(_interruptNum);
+#endif
   attachInterrupt(_interruptNum, RFM69::isr0, RISING);
 
   selfPointer = this;
@@ -215,6 +229,9 @@ void RFM69::setPowerLevel(uint8_t powerLevel)
 
 bool RFM69::canSend()
 {
+#if defined(MY_RFM69_DEFERRED_IRQ)
+  if (_irqPending) return false; // frame waiting in the FIFO, collect it with receiveDone() first
+#endif
   if (_mode == RF69_MODE_RX && PAYLOADLEN == 0 && readRSSI() < CSMA_LIMIT) // if signal stronger than -100dBm is detected assume channel activity
   {
     setMode(RF69_MODE_STANDBY);
@@ -225,9 +242,22 @@ bool RFM69::canSend()
 
 void RFM69::send(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK)
 {
+#if defined(MY_TRANSPORT_ASYNC_SEND)
+  finishAsync();
+#endif
   writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
   uint32_t now = millis();
+#if defined(MY_RFM69_CSMA_BACKOFF_MS)
+  // channel busy: random backoff before the next assessment
+  while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS)
+  {
+    const uint32_t backoff = millis();
+    const uint16_t wait = random(1, MY_RFM69_CSMA_BACKOFF_MS + 1);
+    while (millis() - backoff < wait) receiveDone();
+  }
+#else
   while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) receiveDone();
+#endif
   sendFrame(toAddress, buffer, bufferSize, requestACK, false);
 }
 
@@ -273,6 +303,9 @@ void RFM69::sendACK(const void* buffer, uint8_t bufferSize) {
   ACK_REQUESTED = 0;   // TWS added to make sure we don't end up in a timing race and infinite loop sending Acks
   uint8_t sender = SENDERID;
   int16_t _RSSI = RSSI; // save payload received RSSI value
+#if defined(MY_TRANSPORT_ASYNC_SEND)
+  finishAsync();
+#endif
   writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
   uint32_t now = millis();
   while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) {
@@ -290,6 +323,16 @@ void RFM69::interruptHook(uint8_t CTLbyte) {
     
 // internal function
 void RFM69::sendFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK)
+{
+  sendFrameStart(toAddress, buffer, bufferSize, requestACK, sendACK);
+  uint32_t txStart = millis();
+  while (digitalRead(_interruptPin) == 0 && millis() - txStart < RF69_TX_LIMIT_MS); // wait for DIO0 to turn HIGH signalling transmission finish
+  //while (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PACKETSENT == 0x00); // wait for ModeReady
+  setMode(RF69_MODE_STANDBY);
+}
+
+// internal function - fill the FIFO and switch to TX, DIO0 goes HIGH when the frame is sent
+void RFM69::sendFrameStart(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK)
 {
   setMode(RF69_MODE_STANDBY); // turn off receiver to prevent reception while filling fifo
   while ((readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // wait for ModeReady
@@ -317,12 +360,149 @@ void RFM69::sendFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize,
 
   // no need to wait for transmit mode to be ready since its handled by the radio
   setMode(RF69_MODE_TX);
-  uint32_t txStart = millis();
-  while (digitalRead(_interruptPin) == 0 && millis() - txStart < RF69_TX_LIMIT_MS); // wait for DIO0 to turn HIGH signalling transmission finish
-  //while (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PACKETSENT == 0x00); // wait for ModeReady
-  setMode(RF69_MODE_STANDBY);
 }
 
+#if defined(MY_TRANSPORT_ASYNC_SEND)
+// same as sendWithRetry() but returns right away, the transmission is carried out by updateAsync()
+// buffer must stay valid until updateAsync() no longer returns RF69_TX_PENDING
+bool RFM69::sendWithRetryAsync(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries, uint8_t retryWaitTime) {
+  if (_asyncState != RF69_ASYNC_IDLE) return false;
+  _asyncBuffer = buffer;
+  _asyncSize = bufferSize;
+  _asyncTo = toAddress;
+  _asyncRetries = retries;
+  _asyncWait = retryWaitTime;
+  _asyncTimer = millis();
+#if defined(MY_RFM69_CSMA_BACKOFF_MS)
+  _asyncBackoff = _asyncTimer;
+#endif
+  _asyncState = RF69_ASYNC_CSMA;
+  _asyncStatus = RF69_TX_PENDING;
+  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+  return true;
+}
+
+// ACK the frame just read from DATA once the channel is free, see updateAsync()
+void RFM69::sendACKAsync() {
+  ACK_REQUESTED = 0;
+  _ackTo = SENDERID;
+  _ackTimer = millis();
+  _ackPending = true;
+}
+
+// internal function - the FIFO and DIO0 mapping are shared, a frame or ACK in flight must not be overwritten.
+// Every state is bounded by RF69_CSMA_LIMIT_MS, RF69_TX_LIMIT_MS or the retry wait time.
+void RFM69::finishAsync() {
+  while (_frameActive || _ackPending || _asyncState != RF69_ASYNC_IDLE)
+  {
+    updateAsync();
+    yield();
+  }
+}
+
+// advances the asynchronous TX/ACK state machine, to be called from the main loop
+uint8_t RFM69::updateAsync() {
+#if defined(MY_RFM69_DEFERRED_IRQ)
+  handlePendingIrq();
+#endif
+  if (_frameActive)
+  {
+    // DIO0 is "Packet Sent" during TX
+    if (digitalRead(_interruptPin) == 0 && millis() - _frameTimer < RF69_TX_LIMIT_MS) return _asyncStatus;
+    _frameActive = false;
+    setMode(RF69_MODE_STANDBY);
+    if (_asyncState == RF69_ASYNC_TX)
+    {
+      if (_asyncTo == RF69_BROADCAST_ADDR)
+      {
+        _asyncState = RF69_ASYNC_IDLE;
+        _asyncStatus = RF69_TX_OK;
+      }
+      else
+      {
+        _asyncState = RF69_ASYNC_WAIT_ACK;
+        _asyncTimer = millis();
+      }
+    }
+    receiveBegin();
+  }
+  // keep listening, a received frame stays in DATA until the application fetched it with receiveDone()
+  if ((_ackPending || _asyncState != RF69_ASYNC_IDLE) && _mode != RF69_MODE_RX && PAYLOADLEN == 0) receiveBegin();
+
+  // a requested ACK has priority, the sender is waiting for it
+  if (_ackPending)
+  {
+    if (canSend() || millis() - _ackTimer >= RF69_CSMA_LIMIT_MS)
+    {
+      _ackPending = false;
+      sendFrameStart(_ackTo, "", 0, false, true);
+      _frameActive = true;
+      _frameTimer = millis();
+    }
+    return _asyncStatus;
+  }
+
+  switch (_asyncState)
+  {
+  case RF69_ASYNC_CSMA:
+#if defined(MY_RFM69_CSMA_BACKOFF_MS)
+    if ((int32_t)(millis() - _asyncBackoff) < 0) break;
+#endif
+    if (canSend() || millis() - _asyncTimer >= RF69_CSMA_LIMIT_MS)
+    {
+      sendFrameStart(_asyncTo, _asyncBuffer, _asyncSize, _asyncTo != RF69_BROADCAST_ADDR, false);
+      _asyncState = RF69_ASYNC_TX;
+      _frameActive = true;
+      _frameTimer = millis();
+    }
+#if defined(MY_RFM69_CSMA_BACKOFF_MS)
+    else
+    {
+      // channel busy: random backoff before the next assessment
+      _asyncBackoff = millis() + random(1, MY_RFM69_CSMA_BACKOFF_MS + 1);
+    }
+#endif
+    break;
+  case RF69_ASYNC_WAIT_ACK:
+    if (_mode == RF69_MODE_RX && PAYLOADLEN > 0 && ACK_RECEIVED)
+    {
+      // ACK frames carry no payload, drop them here
+      const bool ok = (SENDERID == _asyncTo);
+      const int16_t ackRSSI = RSSI;
+      receiveBegin();
+      RSSI = ackRSSI; // keep the link quality of the ACK for the application
+      if (ok)
+      {
+        _asyncState = RF69_ASYNC_IDLE;
+        _asyncStatus = RF69_TX_OK;
+        break;
+      }
+    }
+    if (millis() - _asyncTimer >= _asyncWait)
+    {
+      if (_asyncRetries)
+      {
+        _asyncRetries--;
+        _asyncState = RF69_ASYNC_CSMA;
+        _asyncTimer = millis();
+#if defined(MY_RFM69_CSMA_BACKOFF_MS)
+        _asyncBackoff = _asyncTimer;
+#endif
+      }
+      else
+      {
+        _asyncState = RF69_ASYNC_IDLE;
+        _asyncStatus = RF69_TX_FAIL;
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  return _asyncStatus;
+}
+#endif
+
 // internal function - interrupt gets called when a packet is received
 void RFM69::interruptHandler() {
   //pinMode(4, OUTPUT);
@@ -355,10 +535,10 @@ void RFM69::interruptHandler() {
     
     interruptHook(CTLbyte);     // TWS: hook to derived class interrupt function
 
-    for (uint8_t i = 0; i < DATALEN; i++)
-    {
-      DATA[i] = SPI.transfer(0);
-    }
+    // read payload in one burst, in place
+    uint8_t len = DATALEN < RF69_MAX_DATA_LEN ? DATALEN : RF69_MAX_DATA_LEN;
+    memset((void*)DATA, 0, len);
+    SPI.transfer((void*)DATA, len);
     if (DATALEN < RF69_MAX_DATA_LEN) DATA[DATALEN] = 0; // add null at end of string
     unselect();
     setMode(RF69_MODE_RX);
@@ -368,7 +548,21 @@ void RFM69::interruptHandler() {
 }
 
 // internal function
+#if defined(MY_RFM69_DEFERRED_IRQ)
+// only flag the event, the FIFO is read in receiveDone() outside of ISR context
+void RFM69::isr0() { _irqPending = true; }
+
+// internal function - bottom half of isr0()
+void RFM69::handlePendingIrq() {
+  if (_irqPending)
+  {
+    _irqPending = false;
+    interruptHandler();
+  }
+}
+#else
 void RFM69::isr0() { selfPointer->interruptHandler(); }
+#endif
 
 // internal function
 void RFM69::receiveBegin() {
@@ -387,20 +581,32 @@ void RFM69::receiveBegin() {
 
 // checks if a packet was received and/or puts transceiver in receive (ie RX or listen) mode
 bool RFM69::receiveDone() {
+#if defined(MY_RFM69_DEFERRED_IRQ)
+  handlePendingIrq();
+#else
 //ATOMIC_BLOCK(ATOMIC_FORCEON)
 //{
   noInterrupts(); // re-enabled in unselect() via setMode() or via receiveBegin()
+#endif
   if (_mode == RF69_MODE_RX && PAYLOADLEN > 0)
   {
     setMode(RF69_MODE_STANDBY); // enables interrupts
+#if defined(RF69_SPI_GUARD_IRQ)
+    interrupts();
+#endif
     return true;
   }
-  else if (_mode == RF69_MODE_RX) // already in RX no payload yet
+  else if (_mode == RF69_MODE_RX || _mode == RF69_MODE_TX) // already in RX no payload yet, or asynchronous frame in flight
   {
+#if !defined(MY_RFM69_DEFERRED_IRQ)
     interrupts(); // explicitly re-enable interrupts
+#endif
     return false;
   }
   receiveBegin();
+#if defined(RF69_SPI_GUARD_IRQ)
+  interrupts();
+#endif
   return false;
 //}
 }
@@ -454,7 +660,13 @@ void RFM69::writeReg(uint8_t addr, uint8_t value)
 
 // select the RFM69 transceiver (save SPI settings, set CS low)
 void RFM69::select() {
-  noInterrupts();
+#if !defined(MY_RFM69_DEFERRED_IRQ) && !defined(RF69_SPI_GUARD_IRQ)
+  noInterrupts(); // the ISR talks to the radio as well
+#endif
+#if defined(SPI_HAS_TRANSACTION)
+  // settings are applied in one go and the bus is shared properly with other SPI devices
+  SPI.beginTransaction(SPISettings(RF69_SPI_SPEED, MSBFIRST, SPI_MODE0));
+#else
 #if defined (SPCR) && defined (SPSR)
   // save current SPI settings
   _SPCR = SPCR;
@@ -464,18 +676,25 @@ void RFM69::select() {
   SPI.setDataMode(SPI_MODE0);
   SPI.setBitOrder(MSBFIRST);
   SPI.setClockDivider(SPI_CLOCK_DIV4); // decided to slow down from DIV2 after SPI stalling in some instances, especially visible on mega1284p when RFM69 and FLASH chip both present
+#endif
   digitalWrite(_slaveSelectPin, LOW);
 }
 
 // unselect the RFM69 transceiver (set CS high, restore SPI settings)
 void RFM69::unselect() {
   digitalWrite(_slaveSelectPin, HIGH);
+#if defined(SPI_HAS_TRANSACTION)
+  SPI.endTransaction();
+#else
   // restore SPI settings to what they were before talking to RFM69
 #if defined (SPCR) && defined (SPSR)
   SPCR = _SPCR;
   SPSR = _SPSR;
 #endif
+#endif
+#if !defined(MY_RFM69_DEFERRED_IRQ) && !defined(RF69_SPI_GUARD_IRQ)
   interrupts();
+#endif
 }
 
 // true  = disable filtering to capture all frames on network
@@ -71,9 +71,22 @@
 #define COURSE_TEMP_COEF    -90 // puts the temperature reading in the ballpark, user can fine tune the returned value
 #define RF69_BROADCAST_ADDR 255
 #define RF69_CSMA_LIMIT_MS 1000
+#define RF69_SPI_SPEED 4000000 // SPI clock with SPI transactions, DIV4 at 16MHz like before (RFM69 max. 10MHz)
 #define RF69_TX_LIMIT_MS   1000
 #define RF69_FSTEP  61.03515625 // == FXOSC / 2^19 = 32MHz / 2^19 (p13 in datasheet)
 
+// asynchronous transmission status, see RFM69::updateAsync()
+#define RF69_TX_IDLE        0
+#define RF69_TX_PENDING     1
+#define RF69_TX_OK          2
+#define RF69_TX_FAIL        3
+
+// internal states of the asynchronous transmission
+#define RF69_ASYNC_IDLE     0 // nothing to send
+#define RF69_ASYNC_CSMA     1 // waiting for a free channel
+#define RF69_ASYNC_TX       2 // frame in flight
+#define RF69_ASYNC_WAIT_ACK 3 // waiting for the recipient's ACK
+
 // TWS: define CTLbyte bits
 #define RFM69_CTL_SENDACK   0x80
 #define RFM69_CTL_REQACK    0x40
@@ -99,6 +112,12 @@ class RFM69 {
       _promiscuousMode = false;
       _powerLevel = 31;
       _isRFM69HW = isRFM69HW;
+#if defined(MY_TRANSPORT_ASYNC_SEND)
+      _asyncState = RF69_ASYNC_IDLE;
+      _asyncStatus = RF69_TX_IDLE;
+      _ackPending = false;
+      _frameActive = false;
+#endif
     }
 
     bool initialize(uint8_t freqBand, uint8_t ID, uint8_t networkID=1); //!< initialize
@@ -111,6 +130,11 @@ class RFM69 {
     bool ACKReceived(uint8_t fromNodeID); //!< ACKReceived
     bool ACKRequested(); //!< ACKRequested
     virtual void sendACK(const void* buffer = "", uint8_t bufferSize=0); //!< sendACK
+#if defined(MY_TRANSPORT_ASYNC_SEND)
+    bool sendWithRetryAsync(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries=2, uint8_t retryWaitTime=40); //!< sendWithRetry without blocking, see updateAsync()
+    void sendACKAsync(); //!< sendACK without blocking, see updateAsync()
+    uint8_t updateAsync(); //!< advance asynchronous TX/ACK, returns RF69_TX_*
+#endif
     uint32_t getFrequency(); //!< getFrequency
     void setFrequency(uint32_t freqHz); //!< setFrequency
     void encrypt(const char* key); //!< encrypt
@@ -133,8 +157,32 @@ class RFM69 {
     void virtual interruptHandler(); //!< interruptHandler
     virtual void interruptHook(uint8_t CTLbyte); //!< interruptHook
     virtual void sendFrame(uint8_t toAddress, const void* buffer, uint8_t size, bool requestACK=false, bool sendACK=false); //!< sendFrame
+    void sendFrameStart(uint8_t toAddress, const void* buffer, uint8_t size, bool requestACK, bool sendACK); //!< sendFrameStart
 
     static RFM69* selfPointer; //!< selfPointer
+#if defined(MY_RFM69_DEFERRED_IRQ)
+    static volatile bool _irqPending; //!< DIO0 fired, FIFO not read yet
+    void handlePendingIrq(); //!< handlePendingIrq
+#endif
+#if defined(MY_TRANSPORT_ASYNC_SEND)
+    void finishAsync(); //!< complete the asynchronous TX/ACK before sending synchronously
+    const void* _asyncBuffer; //!< _asyncBuffer
+    uint8_t _asyncSize; //!< _asyncSize
+    uint8_t _asyncTo; //!< _asyncTo
+    uint8_t _asyncRetries; //!< _asyncRetries
+    uint8_t _asyncWait; //!< _asyncWait
+    uint8_t _asyncState; //!< _asyncState
+    uint8_t _asyncStatus; //!< _asyncStatus
+    uint32_t _asyncTimer; //!< _asyncTimer
+#if defined(MY_RFM69_CSMA_BACKOFF_MS)
+    uint32_t _asyncBackoff; //!< next channel assessment while the channel is busy
+#endif
+    uint8_t _ackTo; //!< _ackTo
+    bool _ackPending; //!< _ackPending
+    uint32_t _ackTimer; //!< _ackTimer
+    bool _frameActive; //!< _frameActive
+    uint32_t _frameTimer; //!< _frameTimer
+#endif
     uint8_t _slaveSelectPin; //!< _slaveSelectPin
     uint8_t _interruptPin; //!< _interruptPin
     uint8_t _interruptNum; //!< _interruptNum
@@ -41,6 +41,9 @@
 #define MY_RADIO_NRF24
 //#define MY_RADIO_RFM69
 
+// Sample the sensor in tasks instead of blocking the radio
+#define MY_TASKS 2
+
 #include <SPI.h>
 #include <MySensors.h>
 
@@ -62,7 +65,7 @@
 #define         GAS_CO                       (1)
 #define         GAS_SMOKE                    (2)
 /*****************************Globals***********************************************/
-unsigned long SLEEP_TIME = 30000; // Sleep time between reads (in milliseconds)
+unsigned long SLEEP_TIME = 30000; // Time between reads (in milliseconds)
 //VARIABLES
 float Ro = 10000.0;    // this has to be tuned 10K Ohm
 int val = 0;           // variable to store the value coming from the sensor
@@ -84,9 +87,14 @@ float           SmokeCurve[3] ={2.3,0.53,-0.44};    //two points are taken from
 
 MyMessage msg(CHILD_ID_MQ, V_LEVEL);
 
+// samples of the running calibration or reading
+int samples = 0;
+float sum = 0;
+
 void setup()
 {
-  Ro = MQCalibration(MQ_SENSOR_ANALOG_PIN);         //Calibrating the sensor. Please make sure the sensor is in clean air
+  //Calibrating the sensor. Please make sure the sensor is in clean air
+  scheduleEvery(MQCalibrationSample, CALIBRATION_SAMPLE_INTERVAL);
 }
 
 void presentation() {
@@ -99,19 +107,23 @@ void presentation() {
 
 void loop()
 {
-  uint16_t valMQ = MQGetGasPercentage(MQRead(MQ_SENSOR_ANALOG_PIN)/Ro,GAS_CO);
-  Serial.println(val);
+  // nothing blocks here, the tasks below sample the sensor while the radio keeps being serviced
+}
+
+void report(float rs)
+{
+  uint16_t valMQ = MQGetGasPercentage(rs/Ro,GAS_CO);
 
    Serial.print("LPG:");
-   Serial.print(MQGetGasPercentage(MQRead(MQ_SENSOR_ANALOG_PIN)/Ro,GAS_LPG) );
+   Serial.print(MQGetGasPercentage(rs/Ro,GAS_LPG) );
    Serial.print( "ppm" );
    Serial.print("    ");
    Serial.print("CO:");
-   Serial.print(MQGetGasPercentage(MQRead(MQ_SENSOR_ANALOG_PIN)/Ro,GAS_CO) );
+   Serial.print(valMQ);
    Serial.print( "ppm" );
    Serial.print("    ");
    Serial.print("SMOKE:");
-   Serial.print(MQGetGasPercentage(MQRead(MQ_SENSOR_ANALOG_PIN)/Ro,GAS_SMOKE) );
+   Serial.print(MQGetGasPercentage(rs/Ro,GAS_SMOKE) );
    Serial.print( "ppm" );
    Serial.print("\n");
 
@@ -119,8 +131,6 @@ void loop()
       send(msg.set((int16_t)ceil(valMQ)));
       lastMQ = ceil(valMQ);
   }
-
-  sleep(SLEEP_TIME); //sleep for: sleepTime
 }
 
 /****************** MQResistanceCalculation ****************************************
@@ -135,51 +145,41 @@ float MQResistanceCalculation(int raw_adc)
   return ( ((float)RL_VALUE*(1023-raw_adc)/raw_adc));
 }
 
-/***************************** MQCalibration ****************************************
-Input:   mq_pin - analog channel
-Output:  Ro of the sensor
-Remarks: This function assumes that the sensor is in clean air. It use
+/***************************** MQCalibrationSample **********************************
+Remarks: Task taking one calibration sample every CALIBRATION_SAMPLE_INTERVAL. This
+         function assumes that the sensor is in clean air. It use
          MQResistanceCalculation to calculates the sensor resistance in clean air
          and then divides it with RO_CLEAN_AIR_FACTOR. RO_CLEAN_AIR_FACTOR is about
-         10, which differs slightly between different sensors.
+         10, which differs slightly between different sensors. Starts the readings
+         once Ro is known.
 ************************************************************************************/
-float MQCalibration(int mq_pin)
+void MQCalibrationSample()
 {
-  int i;
-  float val=0;
+  sum += MQResistanceCalculation(analogRead(MQ_SENSOR_ANALOG_PIN));
+  if (++samples < CALIBARAION_SAMPLE_TIMES) return;
 
-  for (i=0;i<CALIBARAION_SAMPLE_TIMES;i++) {            //take multiple samples
-    val += MQResistanceCalculation(analogRead(mq_pin));
-    delay(CALIBRATION_SAMPLE_INTERVAL);
-  }
-  val = val/CALIBARAION_SAMPLE_TIMES;                   //calculate the average value
-
-  val = val/RO_CLEAN_AIR_FACTOR;                        //divided by RO_CLEAN_AIR_FACTOR yields the Ro
+  Ro = sum/CALIBARAION_SAMPLE_TIMES/RO_CLEAN_AIR_FACTOR; //divided by RO_CLEAN_AIR_FACTOR yields the Ro
                                                         //according to the chart in the datasheet
-
-  return val;
+  samples = 0;
+  sum = 0;
+  unschedule(MQCalibrationSample);
+  scheduleEvery(MQReadSample, READ_SAMPLE_INTERVAL);
 }
-/*****************************  MQRead *********************************************
-Input:   mq_pin - analog channel
-Output:  Rs of the sensor
-Remarks: This function use MQResistanceCalculation to caculate the sensor resistenc (Rs).
-         The Rs changes as the sensor is in the different consentration of the target
-         gas. The sample times and the time interval between samples could be configured
-         by changing the definition of the macros.
+
+/*****************************  MQReadSample ***************************************
+Remarks: Task taking one sample every READ_SAMPLE_INTERVAL. After READ_SAMPLE_TIMES
+         samples the average Rs of the sensor is reported and the next reading
+         starts after SLEEP_TIME.
 ************************************************************************************/
-float MQRead(int mq_pin)
+void MQReadSample()
 {
-  int i;
-  float rs=0;
-
-  for (i=0;i<READ_SAMPLE_TIMES;i++) {
-    rs += MQResistanceCalculation(analogRead(mq_pin));
-    delay(READ_SAMPLE_INTERVAL);
-  }
-
-  rs = rs/READ_SAMPLE_TIMES;
+  sum += MQResistanceCalculation(analogRead(MQ_SENSOR_ANALOG_PIN));
+  if (++samples < READ_SAMPLE_TIMES) return;
 
-  return rs;
+  report(sum/READ_SAMPLE_TIMES);
+  samples = 0;
+  sum = 0;
+  scheduleEvery(MQReadSample, READ_SAMPLE_INTERVAL, SLEEP_TIME);
 }
 
 /*****************************  MQGetGasPercentage **********************************
@@ -36,6 +36,10 @@ void setup()
   for (int i=0;i<EEPROM_LOCAL_CONFIG_ADDRESS;i++) {
     hwWriteConfig(i,0xFF);  
   }
+  // configuration image slots (MY_CONFIG_IMAGE), restored at boot otherwise
+  for (int i=0;i<MY_CONFIG_IMAGE_SLOTS*(int)sizeof(ConfigImage);i++) {
+    hwWriteConfig(EEPROM_CONFIG_IMAGE_ADDRESS+i,0xFF);
+  }
   Serial.println("Clearing done. You're ready to go!");
 }
 
@@ -0,0 +1,211 @@
+/**
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * DESCRIPTION
+ * Microbenchmarks of the library hot paths: SHA256, soft signing, AES, the serial
+ * protocol, payload conversion and a radio round trip (ping). Each line reports
+ * the time per operation, and the CPU cycles per operation on the boards:
+ *
+ * BM:<name>,n=<iterations>,ns=<ns/op>,cyc=<cycles/op>
+ *
+ * Runs once at startup as a serial gateway. Define BENCHMARK_PING_NODE with the
+ * ID of a powered node to include the radio round trip.
+ *
+ * The same sketch runs on the host build (tests/Native, "make bench"), there the
+ * loopback transport answers the pings.
+ */
+
+#if defined(ARDUINO_ARCH_NATIVE)
+	#define MY_RADIO_LOOPBACK
+	#define BENCHMARK_PING_NODE 1
+	#define BENCHMARK_SCALE 1000
+#else
+	// Enable and select radio type attached
+	#define MY_RADIO_NRF24
+	//#define MY_RADIO_RFM69
+	//#define BENCHMARK_PING_NODE 1
+	#define BENCHMARK_SCALE 1
+#endif
+
+#define MY_GATEWAY_SERIAL
+#define MY_SIGNING_SOFT
+
+#include <MySensors.h>
+#if !defined(MY_RF24_ENABLE_ENCRYPTION)
+	#include <drivers/AES/AES.cpp>
+#endif
+
+// keeps results from being optimized away
+volatile uint32_t benchmarkSink;
+
+static unsigned long benchmarkStart;
+
+static void benchmarkBegin() {
+	benchmarkStart = micros();
+}
+
+static void benchmarkEnd(const char *name, unsigned long iterations) {
+	const unsigned long elapsed = micros() - benchmarkStart;
+	char buffer[64];
+	#if defined(F_CPU)
+		snprintf_P(buffer, sizeof(buffer), PSTR("BM:%s,n=%lu,ns=%lu,cyc=%lu\n"), name, iterations,
+			(unsigned long)((uint64_t)elapsed * 1000 / iterations), (unsigned long)((uint64_t)elapsed * (F_CPU / 1000000UL) / iterations));
+	#else
+		snprintf_P(buffer, sizeof(buffer), PSTR("BM:%s,n=%lu,ns=%lu\n"), name, iterations,
+			(unsigned long)((uint64_t)elapsed * 1000 / iterations));
+	#endif
+	Serial.print(buffer);
+}
+
+#define BENCHMARK(__name, __iterations, __code) { \
+	const unsigned long __n = (unsigned long)(__iterations) * BENCHMARK_SCALE; \
+	benchmarkBegin(); \
+	for (unsigned long __i = 0; __i < __n; __i++) { __code; } \
+	benchmarkEnd(__name, __n); \
+}
+
+static void benchmarkSha256() {
+	uint8_t data[32] = { 0 };
+	BENCHMARK("sha256", 50, {
+		signerSha256Init();
+		signerSha256Update(data, sizeof(data));
+		data[0] = signerSha256Final()[0];
+	});
+}
+
+static void benchmarkSigning() {
+	// the node signs and verifies its own messages, the nonce is exchanged in place
+	MyMessage nonce;
+	MyMessage msg;
+	unsigned long signing = 0;
+	unsigned long verifying = 0;
+	bool ok = true;
+	const unsigned long n = 20UL * BENCHMARK_SCALE;
+	for (unsigned long i = 0; i < n; i++) {
+		unsigned long start = micros();
+		build(nonce, getNodeId(), getNodeId(), NODE_SENSOR_ID, C_INTERNAL, I_NONCE_RESPONSE, false);
+		(void)signerAtsha204SoftGetNonce(nonce);
+		verifying += micros() - start;
+		start = micros();
+		signerAtsha204SoftPutNonce(nonce);
+		build(msg, getNodeId(), getNodeId(), 1, C_SET, V_TEMP, false).set((uint32_t)i);
+		ok &= signerAtsha204SoftSignMsg(msg);
+		signing += micros() - start;
+		start = micros();
+		ok &= signerAtsha204SoftVerifyMsg(msg);
+		verifying += micros() - start;
+	}
+	benchmarkStart = micros() - signing;
+	benchmarkEnd("hmac sign", n);
+	benchmarkStart = micros() - verifying;
+	benchmarkEnd(ok ? "hmac verify" : "hmac verify FAILED", n);
+}
+
+static void benchmarkAES() {
+	AES aes;
+	uint8_t key[16] = { 0 };
+	uint8_t iv[N_BLOCK] = { 0 };
+	uint8_t plain[32] = { 0 };
+	uint8_t cipher[32];
+	aes.set_key(key, 16);
+	BENCHMARK("aes encrypt 16", 100, aes.cbc_encrypt(plain, cipher, 1, iv));
+	BENCHMARK("aes decrypt 16", 100, aes.cbc_decrypt(cipher, plain, 1, iv));
+	BENCHMARK("aes encrypt 32", 100, aes.cbc_encrypt(plain, cipher, 2, iv));
+	BENCHMARK("aes decrypt 32", 100, aes.cbc_decrypt(cipher, plain, 2, iv));
+}
+
+static void benchmarkProtocol() {
+	MyMessage msg;
+	char input[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+	BENCHMARK("protocolParse", 100, {
+		// protocolParse() splits the input in place
+		strcpy_P(input, PSTR("12;6;1;0;0;36.5\n"));
+		(void)protocolParse(msg, input);
+	});
+	BENCHMARK("protocolFormat", 100, benchmarkSink = (uintptr_t)protocolFormat(msg));
+}
+
+static void benchmarkGetString() {
+	MyMessage msg(1, V_TEMP);
+	char buffer[MAX_PAYLOAD * 2 + 1];
+	uint8_t custom[MAX_PAYLOAD] = { 0 };
+	msg.set("benchmark");
+	BENCHMARK("getString string", 100, benchmarkSink = (uintptr_t)msg.getString(buffer));
+	msg.set((uint8_t)200);
+	BENCHMARK("getString byte", 100, benchmarkSink = (uintptr_t)msg.getString(buffer));
+	msg.set((int16_t)-12345);
+	BENCHMARK("getString int16", 100, benchmarkSink = (uintptr_t)msg.getString(buffer));
+	msg.set((uint16_t)54321);
+	BENCHMARK("getString uint16", 100, benchmarkSink = (uintptr_t)msg.getString(buffer));
+	msg.set((int32_t)-1234567890L);
+	BENCHMARK("getString long32", 100, benchmarkSink = (uintptr_t)msg.getString(buffer));
+	msg.set((uint32_t)3234567890UL);
+	BENCHMARK("getString ulong32", 100, benchmarkSink = (uintptr_t)msg.getString(buffer));
+	msg.set(custom, sizeof(custom));
+	BENCHMARK("getString custom", 100, benchmarkSink = (uintptr_t)msg.getString(buffer));
+	msg.set(21.54f, 2);
+	BENCHMARK("getString float32", 100, benchmarkSink = (uintptr_t)msg.getString(buffer));
+}
+
+#if defined(BENCHMARK_PING_NODE)
+static void benchmarkRoundTrip() {
+	uint8_t hops = 0;
+	BENCHMARK("ping round trip", 20, hops = transportPingNode(BENCHMARK_PING_NODE));
+	if (hops == INVALID_HOPS) Serial.print("BM:ping round trip FAILED\n");
+}
+
+#if defined(MY_RADIO_LOOPBACK)
+// node BENCHMARK_PING_NODE answers pings right away
+static bool benchmarkPeer(uint8_t to, const void* data, uint8_t len) {
+	(void)len;
+	const MyMessage &msg = *(const MyMessage *)data;
+	if (to == BENCHMARK_PING_NODE && mGetCommand(msg) == C_INTERNAL && msg.type == I_PING) {
+		MyMessage pong;
+		build(pong, BENCHMARK_PING_NODE, msg.sender, NODE_SENSOR_ID, C_INTERNAL, I_PONG, false).set((uint8_t)1);
+		mSetVersion(pong, PROTOCOL_VERSION);
+		pong.last = BENCHMARK_PING_NODE;
+		(void)transportLoopbackInject(&pong, HEADER_SIZE + mGetLength(pong));
+	}
+	return true;
+}
+
+void before() {
+	transportLoopbackSetHandler(benchmarkPeer);
+}
+#endif
+#endif
+
+void setup() {
+	benchmarkSha256();
+	benchmarkSigning();
+	benchmarkAES();
+	benchmarkProtocol();
+	benchmarkGetString();
+	#if defined(BENCHMARK_PING_NODE)
+		benchmarkRoundTrip();
+	#endif
+	Serial.print("BM:done\n");
+	#if defined(ARDUINO_ARCH_NATIVE)
+		exit(0);
+	#endif
+}
+
+void loop() {
+}
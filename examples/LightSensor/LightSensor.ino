@@ -20,6 +20,7 @@
  *
  * REVISION HISTORY
  * Version 1.0 - Henrik EKblad
+ * Version 1.1 - Report by exception (MY_REPORT_POLICIES)
  * 
  * DESCRIPTION
  * Example sketch showing how to measue light level using a LM393 photo-resistor 
@@ -33,6 +34,9 @@
 #define MY_RADIO_NRF24
 //#define MY_RADIO_RFM69
 
+// Skip unchanged light levels in send()
+#define MY_REPORT_POLICIES 1
+
 #include <SPI.h>
 #include <MySensors.h>  
 
@@ -42,8 +46,12 @@
 unsigned long SLEEP_TIME = 30000; // Sleep time between reads (in milliseconds)
 
 MyMessage msg(CHILD_ID_LIGHT, V_LIGHT_LEVEL);
-int lastLightLevel;
 
+void setup()
+{
+  // send changed levels only, unchanged ones at least once per hour
+  setReportPolicy(CHILD_ID_LIGHT, V_LIGHT_LEVEL, 0, 60*60*1000UL);
+}
 
 void presentation()  {
   // Send the sketch version information to the gateway and Controller
@@ -57,10 +65,7 @@ void loop()
 {     
   int16_t lightLevel = (1023-analogRead(LIGHT_SENSOR_ANALOG_PIN))/10.23; 
   Serial.println(lightLevel);
-  if (lightLevel != lastLightLevel) {
-      send(msg.set(lightLevel));
-      lastLightLevel = lightLevel;
-  }
+  send(msg.set(lightLevel));
   sleep(SLEEP_TIME);
 }
 
@@ -0,0 +1,77 @@
+/**
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * DESCRIPTION
+ * Load generator for capacity planning of channels and repeater counts. The node
+ * sends sequenced, timestamped probes to the gateway at LOADTEST_RATE probes per
+ * second, the gateway echoes each probe and accounts loss, reordering, duplicates
+ * and the round trip times per node.
+ *
+ * Enable MY_LOADTEST_FEATURE on the gateway too, then request the result from the
+ * controller (answered with one LoadTestReport per node, "R" also resets):
+ *
+ * 0;255;3;0;35;R
+ *
+ * The gateway debug output shows the same as
+ * LDT:<node>,rx=,lost=,reord=,dup=,rtt=<min>/<p50>/<p90>/<p99>/<max>
+ * Run several nodes with this sketch to load a channel.
+ */
+
+// Enable debug prints to serial monitor
+//#define MY_DEBUG
+
+// Enable and select radio type attached
+#define MY_RADIO_NRF24
+//#define MY_RADIO_RFM69
+
+#define MY_LOADTEST_FEATURE
+
+#include <SPI.h>
+#include <MySensors.h>
+
+// Probes per second
+#define LOADTEST_RATE 10
+// Stop after this many probes, 0 runs forever
+#define LOADTEST_PROBES 1000
+
+static uint32_t probes = 0;
+static uint32_t failed = 0;
+
+void presentation() {
+	sendSketchInfo("Load Test", "1.0");
+}
+
+void loop() {
+	static unsigned long last = 0;
+	if (LOADTEST_PROBES && probes >= LOADTEST_PROBES) return;
+	if (millis() - last >= 1000 / LOADTEST_RATE) {
+		last += 1000 / LOADTEST_RATE;
+		// catch up after long transmissions without bursting
+		if (millis() - last >= 1000 / LOADTEST_RATE) last = millis();
+		if (!sendLoadTestProbe()) failed++;
+		probes++;
+		if (LOADTEST_PROBES && probes == LOADTEST_PROBES) {
+			Serial.print("Load test done, probes: ");
+			Serial.print(probes);
+			Serial.print(", not ACKed by the first hop: ");
+			Serial.println(failed);
+		}
+	}
+}
@@ -1050,6 +1050,9 @@ void setup()
   }
   Serial.println();
   hwWriteConfigBlock((void*)key, (void*)EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS, 16);
+  // RF24 encryption frame counters start over with the new key
+  uint16_t epoch = 0;
+  hwWriteConfigBlock((void*)&epoch, (void*)EEPROM_RF_ENCRYPTION_EPOCH_ADDRESS, sizeof(epoch));
 #endif // STORE_AES_KEY
 
 #ifdef USE_SOFT_SIGNING
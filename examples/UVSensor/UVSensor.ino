@@ -72,7 +72,10 @@ void loop()
 {
   unsigned long currentTime = millis();
   
-  uint16_t uv = analogRead(UV_SENSOR_ANALOG_PIN);// Get UV value
+  // Get UV value, averaged over 16 conversions sampled in the background
+  hwAdcStart(UV_SENSOR_ANALOG_PIN, 16);
+  while (!hwAdcReady()) wait(1);
+  uint16_t uv = hwAdcRead();
   if (uv>1170)
     uv=1170;
     
@@ -0,0 +1,114 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ */
+
+// Node simulation on the loopback transport, see tests/Native/Makefile
+// The transport handler plays the gateway: it answers parent search, ping,
+// registration and config requests and exits once the sensor values arrived.
+// The values are sent from a task, the unchanged humidity only once (report policy).
+
+#define MY_DEBUG
+#define MY_RADIO_LOOPBACK
+#define MY_NODE_ID 1
+#define MY_TASKS 2
+#define MY_REPORT_POLICIES 2
+
+#include <MySensors.h>
+
+#define SIMULATION_VALUES 3
+#define SIMULATION_TIMEOUT 30000
+
+static uint8_t _values = 0;
+static uint8_t _humidity = 0;
+static int16_t _status = -1;	// last status received, the change deferred by minInterval must arrive
+
+// reply from the gateway to the node
+static void gatewayReply(uint8_t type, uint8_t value) {
+	MyMessage reply;
+	build(reply, GATEWAY_ADDRESS, MY_NODE_ID, NODE_SENSOR_ID, C_INTERNAL, type, false).set(value);
+	mSetVersion(reply, PROTOCOL_VERSION);
+	reply.last = GATEWAY_ADDRESS;
+	(void)transportLoopbackInject(&reply, HEADER_SIZE + mGetLength(reply));
+}
+
+static bool gateway(uint8_t to, const void* data, uint8_t len) {
+	(void)len;
+	const MyMessage &msg = *(const MyMessage *)data;
+	if (to != GATEWAY_ADDRESS && to != BROADCAST_ADDRESS) return false;
+	if (mGetCommand(msg) == C_INTERNAL) {
+		if (msg.type == I_FIND_PARENT) gatewayReply(I_FIND_PARENT_RESPONSE, 0);
+		else if (msg.type == I_PING) gatewayReply(I_PONG, 1);
+		else if (msg.type == I_REGISTRATION_REQUEST) gatewayReply(I_REGISTRATION_RESPONSE, 1);
+		else if (msg.type == I_CONFIG) gatewayReply(I_CONFIG, 'M');
+	}
+	else if (mGetCommand(msg) == C_SET && msg.type == V_HUM && ++_humidity > 1) {
+		printf("simulation failed, unchanged value sent again\n");
+		exit(1);
+	}
+	else if (mGetCommand(msg) == C_SET && msg.type == V_STATUS) {
+		_status = msg.getByte();
+	}
+	else if (mGetCommand(msg) == C_SET && msg.type == V_TEMP) {
+		if (++_values >= SIMULATION_VALUES && _status == 0) {
+			printf("simulation passed\n");
+			exit(0);
+		}
+	}
+	return true;
+}
+
+void before() {
+	transportLoopbackSetHandler(gateway);
+}
+
+static void sendTemperature() {
+	static MyMessage temperature(0, V_TEMP);
+	static MyMessage humidity(1, V_HUM);
+	static MyMessage status(2, V_STATUS);
+	static bool toggled = false;
+	send(temperature.set(21.5f, 1));
+	send(humidity.set(40.2f, 1));
+	if (!toggled) {
+		// on, then off within minInterval: off is sent once it has passed
+		send(status.set((uint8_t)1));
+		send(status.set((uint8_t)0));
+		toggled = true;
+	}
+}
+
+void setup() {
+	(void)setReportPolicy(1, V_HUM, 0.5f);
+	(void)setReportPolicy(2, V_STATUS, 0, 0, 500);
+	scheduleEvery(sendTemperature, 100);
+}
+
+void presentation() {
+	sendSketchInfo("Loopback node", "1.0");
+	present(0, S_TEMP);
+	present(1, S_HUM);
+	present(2, S_BINARY);
+}
+
+void loop() {
+	if (millis() > SIMULATION_TIMEOUT) {
+		printf("simulation timed out\n");
+		exit(1);
+	}
+}
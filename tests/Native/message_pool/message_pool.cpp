@@ -0,0 +1,105 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ */
+
+// Message pool exhaustion on the loopback transport, see tests/Native/Makefile
+// The TX queue takes pool buffers until only the one kept for signing is left,
+// the queued messages are then signed and sent with that buffer. The transport
+// handler plays the gateway, it requires signatures and answers nonce requests.
+
+#define MY_DEBUG
+#define MY_RADIO_LOOPBACK
+#define MY_NODE_ID 1
+#define MY_SIGNING_SOFT
+#define MY_TRANSPORT_TX_QUEUE_SIZE 4
+#define MY_MESSAGE_POOL_SIZE 4
+
+#include <MySensors.h>
+
+#define SIMULATION_TIMEOUT 10000
+#define SIMULATION_QUEUED (MY_MESSAGE_POOL_SIZE - MSG_POOL_SIGNING_RESERVE)
+
+static uint8_t _signedValues = 0;
+
+static void fail(const char *reason) {
+	printf("simulation failed, %s\n", reason);
+	exit(1);
+}
+
+// reply from the gateway to the node
+static void gatewayReply(MyMessage &reply) {
+	mSetVersion(reply, PROTOCOL_VERSION);
+	reply.last = GATEWAY_ADDRESS;
+	(void)transportLoopbackInject(&reply, HEADER_SIZE + mGetLength(reply));
+}
+
+static void gatewayReply(uint8_t type, uint8_t value) {
+	MyMessage reply;
+	gatewayReply(build(reply, GATEWAY_ADDRESS, MY_NODE_ID, NODE_SENSOR_ID, C_INTERNAL, type, false).set(value));
+}
+
+static bool gateway(uint8_t to, const void* data, uint8_t len) {
+	(void)len;
+	const MyMessage &msg = *(const MyMessage *)data;
+	if (to != GATEWAY_ADDRESS && to != BROADCAST_ADDRESS) return false;
+	if (mGetCommand(msg) == C_INTERNAL) {
+		if (msg.type == I_FIND_PARENT) gatewayReply(I_FIND_PARENT_RESPONSE, 0);
+		else if (msg.type == I_PING) gatewayReply(I_PONG, 1);
+		else if (msg.type == I_REGISTRATION_REQUEST) gatewayReply(I_REGISTRATION_RESPONSE, 1);
+		else if (msg.type == I_CONFIG) gatewayReply(I_CONFIG, 'M');
+		else if (msg.type == I_NONCE_REQUEST) {
+			uint8_t nonce[MAX_PAYLOAD];
+			memset(nonce, 0x5A, sizeof(nonce));
+			MyMessage reply;
+			gatewayReply(build(reply, GATEWAY_ADDRESS, MY_NODE_ID, msg.sensor, C_INTERNAL, I_NONCE_RESPONSE, false).set(nonce, sizeof(nonce)));
+		}
+	}
+	else if (mGetCommand(msg) == C_SET && msg.type == V_VAR1) {
+		if (!mGetSigned(msg)) fail("queued value sent unsigned");
+		_signedValues++;
+	}
+	return true;
+}
+
+void before() {
+	transportLoopbackSetHandler(gateway);
+}
+
+void setup() {
+	// the gateway requires signed messages from now on
+	SET_SIGN(GATEWAY_ADDRESS);
+	// fill the TX queue, the last buffer is kept for signing
+	MyMessage value;
+	build(value, MY_NODE_ID, GATEWAY_ADDRESS, 1, C_SET, V_VAR1, false);
+	for (uint8_t i = 0; i < MY_TRANSPORT_TX_QUEUE_SIZE; i++) {
+		const bool queued = transportQueueMessage(value.set(i));
+		if (queued != (i < SIMULATION_QUEUED)) fail(queued ? "queue took the signing buffer" : "queue rejected a message");
+	}
+	if (msgPoolAvailable() != MSG_POOL_SIGNING_RESERVE) fail("wrong number of free buffers");
+}
+
+void loop() {
+	if (_signedValues == SIMULATION_QUEUED) {
+		if (msgPoolAvailable() != MY_MESSAGE_POOL_SIZE) fail("buffers not released");
+		printf("simulation passed\n");
+		exit(0);
+	}
+	if (millis() > SIMULATION_TIMEOUT) fail("timed out");
+}
@@ -0,0 +1,121 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ */
+
+// Node of the network simulator (see simulator.cpp), built three times:
+// sensor node, repeater (-DSIM_REPEATER) and serial gateway (-DSIM_GATEWAY).
+// The radio is the loopback transport connected to the simulator over the
+// socket in MY_SIM_FD; node IDs are seeded into the EEPROM file by the simulator.
+
+#define MY_DEBUG
+#if defined(SIM_GATEWAY)
+	#define MY_GATEWAY_SERIAL
+	#define MY_GATEWAY_SERIAL_TX_BUFFER_SIZE 256
+	#define MY_GATEWAY_RX_QUEUE_SIZE 4
+#elif defined(SIM_REPEATER)
+	#define MY_REPEATER_FEATURE
+#endif
+#define MY_RADIO_LOOPBACK
+#define MY_LOOPBACK_RX_BUFFER_SIZE 16
+#define MY_CONFIG_IMAGE
+#define MY_ENERGY_FEATURE
+#define MY_TIME_SERVICE
+// all nodes power up within the boot spread, the default find parent responses block
+// the gateway up to 1s per request
+#define MY_TRANSPORT_FPAR_STORM_CONTROL
+#define MY_TRANSPORT_DEDUP_SIZE 8
+#if defined(SIM_GATEWAY) || defined(SIM_REPEATER)
+	// relays and controller commands share the message pool
+	#define MY_TRANSPORT_TX_QUEUE_SIZE 4
+	#define MY_MESSAGE_POOL_SIZE 8
+#endif
+
+#include <MySensors.h>
+#include <sys/socket.h>
+#include "simulator.h"
+
+static int _simFd = -1;
+
+#define SIM_NONE	-1	// nothing received
+#define SIM_QUEUED	-2	// frame queued for transportReceive()
+
+// read one packet from the simulator, returns the ACK status of SIM_ACK packets
+static int simRead(int timeout) {
+	struct pollfd fd = { _simFd, POLLIN, 0 };
+	if (poll(&fd, 1, timeout) <= 0) return SIM_NONE;
+	uint8_t packet[SIM_PACKET_SIZE];
+	const ssize_t len = recv(_simFd, packet, sizeof(packet), 0);
+	if (len <= 0) exit(0);	// simulator ended
+	if (packet[0] == SIM_FRAME) {
+		(void)transportLoopbackInject(&packet[1], len - 1);
+		return SIM_QUEUED;
+	}
+	return packet[0] == SIM_ACK ? packet[1] : SIM_NONE;
+}
+
+static void simPoll(bool idle) {
+	// idle nodes block for a short while, keeps 100+ processes from spinning
+	int timeout = idle ? 1 : 0;
+	while (simRead(timeout) == SIM_QUEUED) timeout = 0;
+}
+
+static bool simSend(uint8_t to, const void* data, uint8_t len) {
+	uint8_t packet[SIM_PACKET_SIZE];
+	packet[0] = SIM_TRANSMIT;
+	packet[1] = to;
+	memcpy(&packet[2], data, len);
+	(void)send(_simFd, packet, len + 2, 0);
+	// frames arriving before the ACK are queued
+	int ack;
+	while ((ack = simRead(-1)) < 0);
+	return ack;
+}
+
+void before() {
+	_simFd = atoi(getenv("MY_SIM_FD"));
+	// staggered power up, a radio that is still off hears nothing
+	const uint32_t boot = atol(getenv("MY_SIM_BOOT"));
+	while (millis() < boot) {
+		uint8_t packet[SIM_PACKET_SIZE];
+		if (recv(_simFd, packet, sizeof(packet), MSG_DONTWAIT) <= 0) delay(1);
+	}
+	transportLoopbackSetHandler(simSend);
+	transportLoopbackSetPoll(simPoll);
+}
+
+#if !defined(SIM_GATEWAY)
+static MyMessage _value(1, V_VAR1);
+
+void presentation() {
+	present(1, S_CUSTOM);
+}
+
+void loop() {
+	static const uint32_t messages = atol(getenv("MY_SIM_MESSAGES"));
+	static const unsigned long interval = atol(getenv("MY_SIM_INTERVAL"));
+	static uint32_t seq = 0;
+	// spread the first message over one interval
+	static unsigned long last = millis() - interval + random(interval);
+	if (seq < messages && millis() - last >= interval) {
+		last = millis();
+		send(_value.set(seq++));
+	}
+}
+#endif
@@ -0,0 +1,427 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ */
+
+// Network simulator on the host build: runs a serial gateway, repeaters and sensor
+// nodes as separate processes (the core keeps its state in globals) and models the
+// radio medium as an event queue with per-link latency and loss. Reports delivery
+// ratio, latency percentiles and the reconvergence time after a repeater fails.
+// Unicast frames are retransmitted up to -a times until ACKed, like the auto
+// retransmit of the radios. Exits with 1 if less than -d of the values sent reached
+// the controller or not every node relayed by the failed repeater reconverged.
+//
+// usage: simulator [-n nodes] [-r repeaters] [-m messages] [-i interval ms] [-l loss]
+//                  [-e edge loss] [-t latency ms] [-a retransmits] [-b boot spread ms]
+//                  [-k kill repeater after s] [-d min delivery ratio] [-s seed] [-v]
+
+#include <Arduino.h>
+#include "core/MyMessage.h"
+#include "core/MyEepromAddresses.h"
+#include "simulator.h"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <queue>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+
+struct simNode {
+	pid_t pid;
+	int radio;				// socket to the loopback transport of the node
+	double x, y;
+	bool repeater;
+	bool alive;
+	bool affected;			// relayed by the failed repeater before it died
+	uint32_t recovered;		// first delivery at the controller after the repeater failed
+	std::map<uint8_t, uint32_t> relays;	// repeater -> last time it relayed for this node
+};
+
+struct simEvent {
+	uint32_t time;
+	uint8_t type;			// SIM_FRAME or SIM_ACK
+	uint8_t node;
+	std::vector<uint8_t> data;
+	bool operator<(const simEvent &other) const { return time > other.time; }
+};
+
+static std::vector<simNode> _nodes;
+static std::priority_queue<simEvent> _events;
+static std::map<uint64_t, uint32_t> _sent;		// (sender, seq) -> first transmission
+static std::map<uint64_t, uint32_t> _delivered;	// (sender, seq) -> latency
+static double _range = 100;
+static double _loss = 0.02;
+static double _edgeLoss = 0.3;
+static uint32_t _latency = 5;
+static uint8_t _retransmits = 3;
+static uint32_t _frames = 0;
+static uint32_t _lostFrames = 0;
+static uint32_t _retransmitted = 0;
+static uint32_t _killed = 0;	// time the repeater failed
+static FILE *_gatewayLog = NULL;	// debug messages of the gateway (-v)
+static int _serialIn = -1;		// gateway stdin
+static int _serialOut = -1;		// gateway stdout
+
+static inline uint32_t now() {
+	return millis();
+}
+
+static inline uint64_t key(uint8_t sender, uint32_t seq) {
+	return ((uint64_t)sender << 32) | seq;
+}
+
+static double distance(const simNode &a, const simNode &b) {
+	return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+// a frame from a to b arrives, loss grows towards the edge of the range
+static bool linkDelivers(const simNode &a, const simNode &b) {
+	const double d = distance(a, b);
+	if (d > _range || !b.alive) return false;
+	const double loss = _loss + _edgeLoss * (d / _range) * (d / _range);
+	return drand48() >= loss;
+}
+
+static uint32_t linkLatency() {
+	return _latency + (uint32_t)(drand48() * _latency);
+}
+
+static void schedule(uint32_t time, uint8_t type, uint8_t node, const uint8_t *data, size_t len) {
+	simEvent event;
+	event.time = time;
+	event.type = type;
+	event.node = node;
+	event.data.assign(data, data + len);
+	_events.push(event);
+}
+
+static void transmit(uint8_t from, uint8_t to, const uint8_t *frame, size_t len) {
+	const MyMessage &msg = *(const MyMessage *)frame;
+	_frames++;
+	// first transmission of a sensor value, relaying keeps sender and changes last
+	if (mGetCommand(msg) == C_SET && msg.type == V_VAR1) {
+		uint32_t seq;
+		memcpy(&seq, msg.data, sizeof(seq));
+		if (msg.last == msg.sender) _sent.insert(std::make_pair(key(msg.sender, seq), now()));
+		else if (msg.sender < _nodes.size()) _nodes[msg.sender].relays[msg.last] = now();
+	}
+	uint32_t arrival = now() + linkLatency();
+	uint8_t ack = 1;
+	if (to == SIM_BROADCAST) {
+		for (size_t i = 0; i < _nodes.size(); i++) {
+			if (i == from) continue;
+			if (linkDelivers(_nodes[from], _nodes[i])) schedule(arrival, SIM_FRAME, i, frame, len);
+			else if (distance(_nodes[from], _nodes[i]) <= _range) _lostFrames++;
+		}
+	}
+	else {
+		// auto retransmit until ACKed, every attempt takes the air for one latency
+		for (uint8_t attempt = 0; attempt <= _retransmits; attempt++) {
+			if (attempt) {
+				_frames++;
+				_retransmitted++;
+				arrival += linkLatency();
+			}
+			ack = to < _nodes.size() && linkDelivers(_nodes[from], _nodes[to]);
+			if (ack) break;
+			_lostFrames++;
+		}
+		if (ack) schedule(arrival, SIM_FRAME, to, frame, len);
+	}
+	// the ACK returns after the frame arrived
+	schedule(arrival, SIM_ACK, from, &ack, 1);
+}
+
+static void dispatch(const simEvent &event) {
+	simNode &node = _nodes[event.node];
+	if (!node.alive) return;
+	uint8_t packet[SIM_PACKET_SIZE];
+	packet[0] = event.type;
+	memcpy(&packet[1], event.data.data(), event.data.size());
+	(void)send(node.radio, packet, event.data.size() + 1, 0);
+}
+
+// controller side of the serial gateway
+static void controllerLine(const char *line) {
+	unsigned int sender, sensor, command, ack, type;
+	char payload[64] = "";
+	if (sscanf(line, "%u;%u;%u;%u;%u;%63[^\n]", &sender, &sensor, &command, &ack, &type, payload) < 5) return;
+	if (command == C_SET && type == V_VAR1 && sender < _nodes.size()) {
+		const uint32_t seq = strtoul(payload, NULL, 10);
+		std::map<uint64_t, uint32_t>::iterator sent = _sent.find(key(sender, seq));
+		if (sent != _sent.end() && !_delivered.count(key(sender, seq))) {
+			_delivered[key(sender, seq)] = now() - sent->second;
+			if (_killed && !_nodes[sender].recovered) _nodes[sender].recovered = now();
+		}
+	}
+	else if (command == C_INTERNAL && type == I_LOG_MESSAGE) {
+		if (_gatewayLog) fprintf(_gatewayLog, "%u %s\n", now(), payload);
+	}
+	else if (command == C_INTERNAL && type == I_CONFIG) {
+		// metric
+		char reply[32];
+		const int len = snprintf(reply, sizeof(reply), "%u;255;3;0;%d;M\n", sender, I_CONFIG);
+		(void)write(_serialIn, reply, len);
+	}
+	else if (command == C_INTERNAL && type == I_TIME) {
+		char reply[32];
+		const int len = snprintf(reply, sizeof(reply), "%u;255;3;0;%d;%lu\n", sender, I_TIME, (unsigned long)time(NULL));
+		(void)write(_serialIn, reply, len);
+	}
+}
+
+static pid_t spawn(const std::string &binary, const std::string &dir, uint8_t id, int fd, int in, int out, uint32_t boot, uint32_t messages, uint32_t interval, bool verbose) {
+	// seed the node ID, the rest of the EEPROM is erased
+	char eeprom[256];
+	snprintf(eeprom, sizeof(eeprom), "%s/node%u.eeprom", dir.c_str(), id);
+	uint8_t config[1024];
+	memset(config, 0xFF, sizeof(config));
+	config[EEPROM_NODE_ID_ADDRESS] = id;
+	FILE *file = fopen(eeprom, "wb");
+	if (file) {
+		(void)fwrite(config, 1, sizeof(config), file);
+		fclose(file);
+	}
+	const pid_t pid = fork();
+	if (pid) return pid;
+	char value[32];
+	setenv("MY_NATIVE_EEPROM", eeprom, 1);
+	snprintf(value, sizeof(value), "%d", fd);
+	setenv("MY_SIM_FD", value, 1);
+	snprintf(value, sizeof(value), "%u", boot);
+	setenv("MY_SIM_BOOT", value, 1);
+	snprintf(value, sizeof(value), "%u", messages);
+	setenv("MY_SIM_MESSAGES", value, 1);
+	snprintf(value, sizeof(value), "%u", interval);
+	setenv("MY_SIM_INTERVAL", value, 1);
+	if (in >= 0) dup2(in, STDIN_FILENO);
+	if (out >= 0) dup2(out, STDOUT_FILENO);
+	else {
+		char log[256];
+		snprintf(log, sizeof(log), "%s/node%u.log", dir.c_str(), id);
+		const int null = open(verbose ? log : "/dev/null", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		dup2(null, STDOUT_FILENO);
+	}
+	srand48(id);
+	execl(binary.c_str(), binary.c_str(), (char *)NULL);
+	_exit(1);
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &values, double p) {
+	if (values.empty()) return 0;
+	return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int nodes = 20;
+	unsigned int repeaters = 4;
+	uint32_t messages = 10;
+	uint32_t interval = 2000;
+	uint32_t boot = 10000;
+	uint32_t kill = 0;
+	double minRatio = 0.9;
+	long seed = 1;
+	bool verbose = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:r:m:i:l:e:t:a:b:k:d:s:v")) != -1) {
+		switch (opt) {
+			case 'n': nodes = atoi(optarg); break;
+			case 'r': repeaters = atoi(optarg); break;
+			case 'm': messages = atol(optarg); break;
+			case 'i': interval = atol(optarg); break;
+			case 'l': _loss = atof(optarg); break;
+			case 'e': _edgeLoss = atof(optarg); break;
+			case 't': _latency = atol(optarg); break;
+			case 'a': _retransmits = atoi(optarg); break;
+			case 'b': boot = atol(optarg); break;
+			case 'k': kill = atol(optarg) * 1000; break;
+			case 'd': minRatio = atof(optarg); break;
+			case 's': seed = atol(optarg); break;
+			case 'v': verbose = true; break;
+			default: fprintf(stderr, "usage: %s [-n nodes] [-r repeaters] [-m messages] [-i interval] [-l loss] [-e edge loss] [-t latency] [-a retransmits] [-b boot spread] [-k kill after s] [-d min delivery ratio] [-s seed] [-v]\n", argv[0]); return 2;
+		}
+	}
+	if (nodes + repeaters > 254 || (kill && !repeaters)) {
+		fprintf(stderr, "at most 254 nodes, -k needs a repeater\n");
+		return 2;
+	}
+	srand48(seed);
+	signal(SIGPIPE, SIG_IGN);
+	const std::string bin = dirname(strdup(argv[0]));
+	char dir[] = "/tmp/mysensors-sim-XXXXXX";
+	if (!mkdtemp(dir)) return 1;
+
+	if (verbose) _gatewayLog = fopen((std::string(dir) + "/node0.log").c_str(), "w");
+
+	// gateway in the center, repeaters on a ring, sensor nodes spread over 1.6 times the
+	// range, each within the range of two of them to survive the failure of one
+	_nodes.resize(1 + repeaters + nodes);
+	for (size_t i = 0; i < _nodes.size(); i++) {
+		simNode &node = _nodes[i];
+		node.repeater = i && i <= repeaters;
+		node.alive = true;
+		node.affected = false;
+		node.recovered = 0;
+		if (!i) node.x = node.y = 0;
+		else if (node.repeater) {
+			const double angle = 2 * M_PI * (i - 1) / repeaters;
+			node.x = cos(angle) * _range * 0.8;
+			node.y = sin(angle) * _range * 0.8;
+		}
+		else {
+			unsigned int parents = 0;
+			while (parents < std::min(2u, repeaters + 1)) {
+				const double angle = 2 * M_PI * drand48();
+				const double radius = sqrt(drand48()) * _range * 1.6;
+				node.x = cos(angle) * radius;
+				node.y = sin(angle) * radius;
+				parents = 0;
+				for (size_t j = 0; j <= repeaters; j++) parents += distance(node, _nodes[j]) < _range * 0.9;
+			}
+		}
+	}
+	for (size_t i = 0; i < _nodes.size(); i++) {
+		int sockets[2];
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets)) return 1;
+		fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+		_nodes[i].radio = sockets[0];
+		if (!i) {
+			// the controller talks to the gateway over its serial (stdin/stdout)
+			int in[2], out[2];
+			if (pipe(in) || pipe(out)) return 1;
+			fcntl(in[1], F_SETFD, FD_CLOEXEC);
+			fcntl(out[0], F_SETFD, FD_CLOEXEC);
+			_nodes[i].pid = spawn(bin + "/gateway", dir, i, sockets[1], in[0], out[1], 0, 0, 0, verbose);
+			close(in[0]);
+			close(out[1]);
+			_serialIn = in[1];
+			_serialOut = out[0];
+		}
+		else {
+			// repeaters power up first, sensor nodes over the rest of the boot spread
+			const uint32_t delay = _nodes[i].repeater ? drand48() * boot / 4 : boot / 4 + drand48() * boot * 3 / 4;
+			_nodes[i].pid = spawn(bin + (_nodes[i].repeater ? "/repeater" : "/node"), dir, i, sockets[1], -1, -1, delay, messages, interval, verbose);
+		}
+		close(sockets[1]);
+	}
+
+	// boot, all messages, then time for retries and reconvergence
+	const uint32_t duration = boot + messages * interval + 10000;
+	const uint32_t start = now();
+	std::string serial;
+	std::vector<struct pollfd> fds(_nodes.size() + 1);
+	while (now() - start < duration) {
+		if (kill && !_killed && now() - start >= kill) {
+			// fail the repeater relaying for most nodes
+			std::vector<unsigned int> load(_nodes.size(), 0);
+			for (size_t i = 1; i < _nodes.size(); i++) {
+				for (std::map<uint8_t, uint32_t>::iterator it = _nodes[i].relays.begin(); it != _nodes[i].relays.end(); ++it) {
+					if (it->first < _nodes.size() && now() - it->second < 2 * interval) load[it->first]++;
+				}
+			}
+			const size_t victim = std::max_element(load.begin() + 1, load.begin() + 1 + repeaters) - load.begin();
+			for (size_t i = 1; i < _nodes.size(); i++) {
+				std::map<uint8_t, uint32_t>::iterator it = _nodes[i].relays.find(victim);
+				_nodes[i].affected = it != _nodes[i].relays.end() && now() - it->second < 2 * interval;
+			}
+			::kill(_nodes[victim].pid, SIGKILL);
+			_nodes[victim].alive = false;
+			_killed = now();
+			printf("repeater %u failed at %us, relayed for %u nodes\n", (unsigned int)victim, (now() - start) / 1000, load[victim]);
+		}
+		// deliver due events
+		while (!_events.empty() && _events.top().time <= now()) {
+			dispatch(_events.top());
+			_events.pop();
+		}
+		const int timeout = _events.empty() ? 10 : std::min<int>(10, _events.top().time - now());
+		for (size_t i = 0; i < _nodes.size(); i++) {
+			fds[i].fd = _nodes[i].alive ? _nodes[i].radio : -1;
+			fds[i].events = POLLIN;
+		}
+		fds[_nodes.size()].fd = _serialOut;
+		fds[_nodes.size()].events = POLLIN;
+		if (poll(fds.data(), fds.size(), std::max(timeout, 0)) <= 0) continue;
+		for (size_t i = 0; i < _nodes.size(); i++) {
+			if (!(fds[i].revents & POLLIN)) continue;
+			uint8_t packet[SIM_PACKET_SIZE];
+			const ssize_t len = recv(_nodes[i].radio, packet, sizeof(packet), 0);
+			if (len > 2 && packet[0] == SIM_TRANSMIT) transmit(i, packet[1], &packet[2], len - 2);
+			else if (len <= 0) _nodes[i].alive = false;
+		}
+		if (fds[_nodes.size()].revents & POLLIN) {
+			char buffer[512];
+			const ssize_t len = read(_serialOut, buffer, sizeof(buffer));
+			if (len <= 0) break;
+			serial.append(buffer, len);
+			size_t end;
+			while ((end = serial.find('\n')) != std::string::npos) {
+				controllerLine(serial.substr(0, end + 1).c_str());
+				serial.erase(0, end + 1);
+			}
+		}
+	}
+	for (size_t i = 0; i < _nodes.size(); i++) {
+		if (_nodes[i].alive) ::kill(_nodes[i].pid, SIGKILL);
+		waitpid(_nodes[i].pid, NULL, 0);
+	}
+
+	// report
+	std::vector<uint32_t> latencies;
+	for (std::map<uint64_t, uint32_t>::iterator it = _delivered.begin(); it != _delivered.end(); ++it) latencies.push_back(it->second);
+	std::sort(latencies.begin(), latencies.end());
+	// every node and repeater sends, the failed repeater only until it died
+	uint32_t expected = 0;
+	for (size_t i = 1; i < _nodes.size(); i++) {
+		if (_nodes[i].alive) expected += messages;
+	}
+	for (std::map<uint64_t, uint32_t>::iterator it = _sent.begin(); it != _sent.end(); ++it) {
+		const uint8_t sender = it->first >> 32;
+		if (sender < _nodes.size() && !_nodes[sender].alive) expected++;
+	}
+	const double ratio = expected ? (double)_delivered.size() / expected : 0;
+	bool passed = ratio >= minRatio;
+	printf("nodes=%u repeaters=%u messages=%u interval=%ums loss=%.2f+%.2f latency=%ums\n", nodes, repeaters, messages, interval, _loss, _edgeLoss, _latency);
+	printf("frames=%u lost=%u retransmits=%u\n", _frames, _lostFrames, _retransmitted);
+	printf("delivered=%u/%u ratio=%.3f (min %.3f)\n", (unsigned int)_delivered.size(), expected, ratio, minRatio);
+	printf("latency p50=%ums p90=%ums p99=%ums max=%ums\n", percentile(latencies, 0.5), percentile(latencies, 0.9),
+		percentile(latencies, 0.99), latencies.empty() ? 0 : latencies.back());
+	if (_killed) {
+		unsigned int affected = 0, reconverged = 0;
+		uint32_t reconvergence = 0;
+		for (size_t i = 1; i < _nodes.size(); i++) {
+			if (!_nodes[i].affected || !_nodes[i].alive) continue;
+			affected++;
+			if (_nodes[i].recovered) {
+				reconverged++;
+				reconvergence = std::max(reconvergence, _nodes[i].recovered - _killed);
+			}
+		}
+		printf("reconverged=%u/%u within %ums\n", reconverged, affected, reconvergence);
+		// a failure nobody noticed tests nothing
+		passed = passed && affected && reconverged == affected;
+	}
+	if (verbose) printf("logs in %s\n", dir);
+	printf("simulation %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,6 @@
+// socket protocol between simulator and nodes, one SOCK_SEQPACKET packet per message
+#define SIM_TRANSMIT	'T'		// node -> simulator: recipient, frame
+#define SIM_FRAME		'F'		// simulator -> node: received frame
+#define SIM_ACK			'A'		// simulator -> node: ACK status of the last transmission
+#define SIM_PACKET_SIZE	(2 + MAX_MESSAGE_LENGTH)
+#define SIM_BROADCAST	255		// BROADCAST_ADDRESS